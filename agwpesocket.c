@@ -412,7 +412,7 @@ void agwpe_sendto(const void *_ap, const uint8_t *axaddr, const int axaddrlen, c
 	agwpe_flush(com); // write out buffered data
 
 	// Account transmission
-	erlang_add(agwpe->iface->callsign, ERLANG_TX, axaddrlen+axdatalen + 10, 1);  // agwpe_sendto()
+	interface_erlang_add(agwpe->iface, ERLANG_TX, axaddrlen+axdatalen + 10, 1);  // agwpe_sendto()
 }
 
 
@@ -721,7 +721,9 @@ int agwpe_postpoll(struct aprxpolls *app)
 			if (P->revents & POLLOUT)
 				agwpe_flush(S);
 
+			rx_frame_ns = monotonic_ns();
 			agwpe_read(S);
+			rx_frame_ns = 0;
 		}
 	}
 
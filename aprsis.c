@@ -60,17 +60,26 @@ struct aprsis_host {
 	enum aprsis_mode mode;
 };
 
+#define APRSIS_WRMARKS 32
+
 struct aprsis {
 	int server_socket;
 	struct aprsis_host *H;
 	time_t next_reconnect;
 	time_t last_read;
+	int64_t rd_ns;		/* monotonic_ns() of the last read() */
 	int wrbuf_len;
 	int wrbuf_cur;
 	int rdbuf_len;
 	int rdbuf_cur;
 	int rdlin_len;
 
+	/* Ends of the lines of received frames in wrbuf[], and the
+	   rx_frame_ns of those, for the RF to APRS-IS latency */
+	int     wrmark_count;
+	int     wrmark_end[APRSIS_WRMARKS];
+	int64_t wrmark_ns[APRSIS_WRMARKS];
+
 	char wrbuf[16000];
 	char rdbuf[3000];
 	char rdline[500];
@@ -125,6 +134,7 @@ static void aprsis_close(struct aprsis *A, const char *why)
 
 	A->wrbuf_len = 0;
 	A->wrbuf_cur = 0;
+	A->wrmark_count = 0;
 	A->next_reconnect = tick.tv_sec + 10;
 	A->last_read = tick.tv_sec;
 
@@ -138,8 +148,33 @@ static void aprsis_close(struct aprsis *A, const char *why)
 }
 
 
+/*
+ *  aprsis_wrmarks_written() - wrbuf[] is written up to wrbuf_cur,
+ *  account the latency of received frames that went out
+ */
+// APRS-IS communicator
+static void aprsis_wrmarks_written(struct aprsis *A, const int written)
+{
+	int n = 0;
+	int64_t now_ns;
+
+	APRX_PROBE3(aprsis__write, A->H->server_name, written, A->wrbuf_len - A->wrbuf_cur);
+	if (A->wrmark_count == 0 || A->wrmark_end[0] > A->wrbuf_cur)
+		return;
+	now_ns = monotonic_ns();
+	while (n < A->wrmark_count && A->wrmark_end[n] <= A->wrbuf_cur) {
+		metric_observe(METRIC_HIST_PATH_RF_IS, now_ns - A->wrmark_ns[n]);
+		++n;
+	}
+	A->wrmark_count -= n;
+	memmove(A->wrmark_end, A->wrmark_end + n, A->wrmark_count * sizeof(A->wrmark_end[0]));
+	memmove(A->wrmark_ns,  A->wrmark_ns + n,  A->wrmark_count * sizeof(A->wrmark_ns[0]));
+}
+
 /*
  *  aprsis_queue_() - internal routine - queue data to specific APRS-IS instance
+ *
+ *  A non-zero rx_ns is the rx_frame_ns of an igated frame.
  */
 // APRS-IS communicator
 static int aprsis_queue_(
@@ -148,7 +183,8 @@ static int aprsis_queue_(
 		const char qtype,
 		const char *gwcall,
 		const char * const text,
-		int textlen) {
+		int textlen,
+		const int64_t rx_ns) {
 	int i;
 	char addrbuf[1000];
 	int addrlen, len;
@@ -172,6 +208,7 @@ static int aprsis_queue_(
 
 	if (A->wrbuf_cur >= A->wrbuf_len && A->wrbuf_len > 0) {
 		A->wrbuf_cur = A->wrbuf_len = 0;
+		A->wrmark_count = 0;
 	}
 
 	addrlen = 0;
@@ -192,12 +229,15 @@ static int aprsis_queue_(
 			memcpy(A->wrbuf, A->wrbuf + A->wrbuf_cur,
 					A->wrbuf_len - A->wrbuf_cur);
 			A->wrbuf_len -= A->wrbuf_cur;
+			for (i = 0; i < A->wrmark_count; ++i)
+				A->wrmark_end[i] -= A->wrbuf_cur;
 			A->wrbuf_cur = 0;
 		}
 
 		/* Check again if it fits in.. */
 		if ((sizeof(A->wrbuf) - 10) <= (A->wrbuf_len + len)) {
 			/* NOT!	 Too bad, drop it.. */
+			metric_add(METRIC_APRSIS_DROP_WRBUF, 1);
 			return 2;
 		}
 	}
@@ -229,6 +269,12 @@ static int aprsis_queue_(
 	memcpy(A->wrbuf + A->wrbuf_len, text, textlen);
 	A->wrbuf_len += textlen;	/* Always supplied with tail newline.. */
 
+	if (rx_ns != 0 && A->wrmark_count < APRSIS_WRMARKS) {
+		A->wrmark_end[A->wrmark_count] = A->wrbuf_len;
+		A->wrmark_ns[A->wrmark_count]  = rx_ns;
+		A->wrmark_count += 1;
+	}
+
 	/* -- debug --
 	   fwrite(A->wrbuf,A->wrbuf_len,1,stdout);
 	   return 0;
@@ -247,6 +293,7 @@ static int aprsis_queue_(
 		}
 
 		A->wrbuf_cur += i;
+		aprsis_wrmarks_written(A, i);
 		if (A->wrbuf_cur >= A->wrbuf_len) {	/* Wrote all ! */
 			A->wrbuf_cur = A->wrbuf_len = 0;
 		}
@@ -383,6 +430,7 @@ fail_out:;
 
 	aprxlog("CONNECT APRSIS %s:%s",
 			A->H->server_name, A->H->server_port);
+	metric_add(METRIC_APRSIS_CONNECTS, 1);
 
 	/* From now the socket will be non-blocking for its entire lifetime.. */
 	fd_nonblockingmode(A->server_socket);
@@ -396,7 +444,7 @@ fail_out:;
 
 	A->last_read = tick.tv_sec;
 
-	aprsis_queue_(A, NULL, qTYPE_LOCALGEN, "", aprsislogincmd, strlen(aprsislogincmd));
+	aprsis_queue_(A, NULL, qTYPE_LOCALGEN, "", aprsislogincmd, strlen(aprsislogincmd), 0);
 
 	return;			/* just a place-holder */
 }
@@ -406,6 +454,8 @@ fail_out:;
 static int aprsis_sockreadline(struct aprsis *A)
 {
 	int i, c;
+	struct iovec iov[2];
+	struct msghdr msg;
 
 	/* Reads multiple lines from buffer,
 	   Last one is left into incomplete state */
@@ -423,8 +473,16 @@ static int aprsis_sockreadline(struct aprsis *A)
 					aprxlog(A->rdline, A->rdlin_len,
 							">> %s:%s >> ", A->H->server_name, A->H->server_port);
 
-				/* Send the A->rdline content to main program */
-				c = send(aprsis_up, A->rdline, A->rdlin_len, 0);
+				/* Send the A->rdline content to main program,
+				   after the read() time of it */
+				iov[0].iov_base = &A->rd_ns;
+				iov[0].iov_len  = sizeof(A->rd_ns);
+				iov[1].iov_base = A->rdline;
+				iov[1].iov_len  = A->rdlin_len;
+				memset(&msg, 0, sizeof(msg));
+				msg.msg_iov    = iov;
+				msg.msg_iovlen = 2;
+				c = sendmsg(aprsis_up, &msg, 0);
 				/* This may fail with SIGPIPE.. */
 				if (c < 0 && (errno == EPIPE ||
 				              errno == ECONNRESET ||
@@ -475,6 +533,7 @@ static int aprsis_sockread(struct aprsis *A)
 
 		/* we just ignore the readback.. but do time-stamp the event */
 		A->last_read = tick.tv_sec;
+		A->rd_ns = monotonic_ns();
 
 		aprsis_sockreadline(A);
 	}
@@ -484,6 +543,7 @@ static int aprsis_sockread(struct aprsis *A)
 
 struct aprsis_tx_msg_head {
 	time_t then;
+	int64_t rx_ns;		/* rx_frame_ns of an igated frame */
 	int addrlen;
 	int gwlen;
 	int textlen;
@@ -524,6 +584,7 @@ static void aprsis_readup(void)
 	textlen = head.textlen;
 
 	if (head.then + 10 < tick.tv_sec) {
+		metric_add(METRIC_APRSIS_DROP_STALE, 1);
 		return;		/* Too old, discard */
 		// rflog();
 	}
@@ -544,7 +605,7 @@ static void aprsis_readup(void)
 	/* Now queue the thing! */
 
 	if (AprsIS != NULL)
-		aprsis_queue_(AprsIS, addr, head.qtype, gwcall, text, textlen);
+		aprsis_queue_(AprsIS, addr, head.qtype, gwcall, text, textlen, head.rx_ns);
 }
 
 
@@ -585,6 +646,7 @@ int aprsis_queue(
 
 	memset(&head, 0, sizeof(head));
 	head.then    = tick.tv_sec;
+	head.rx_ns   = rx_frame_ns;
 	head.addrlen = addrlen;
 	head.gwlen   = gwlen;
 	head.textlen = textlen;
@@ -629,12 +691,15 @@ static int aprsis_prepoll_(struct aprxpolls *app)
 		A->last_read = tick.tv_sec;	/* mark it non-zero.. */
 	}
 
+	metric_set(METRIC_APRSIS_CONNECTED, A->server_socket >= 0);
 	if (A->server_socket < 0) {
 		return -1;	/* Not open, do nothing */
 	}
 
 	if (debug>3) printf("aprsis_prepoll_()\n");
 
+	metric_set(METRIC_APRSIS_WRBUF, A->wrbuf_len - A->wrbuf_cur);
+
 	if (time_reset) {
 		aprsis_close(A, "time_reset!");
 	}
@@ -727,6 +792,7 @@ static int aprsis_postpoll_(struct aprxpolls *app)
 								A->H->server_port);
 
 					A->wrbuf_cur += i;
+					aprsis_wrmarks_written(A, i);
 					if (A->wrbuf_cur >= A->wrbuf_len) {	/* Wrote all! */
 						A->wrbuf_len = A->wrbuf_cur = 0;
 					} else {
@@ -970,6 +1036,8 @@ void aprsis_start(void) {
 // Shutdown the aprsis thread
 void aprsis_stop(void) {
 	die_now = 1;
+	if (aprsis_down < 0)
+		return;		/* Never started, like on a digi only setup */
 	pthread_cancel(aprsis_thread);
 	pthread_join(aprsis_thread, NULL);
 }
@@ -1060,9 +1128,15 @@ static int aprsis_comssockread(int fd) {
 	/* TODO: do something with the data ?
 	   A receive-only iGate does nothing, but Rx/Tx would do... */
 
-	/* Send the frame to Tx-IGate function */
-	if (i > 0)
-		igate_from_aprsis(buf, i);
+	/* Send the frame to Tx-IGate function, it comes after
+	   the read() time of it */
+	if (i > (int) sizeof(rx_frame_ns)) {
+		const int64_t t0 = monotonic_ns();
+		memcpy(&rx_frame_ns, buf, sizeof(rx_frame_ns));
+		igate_from_aprsis(buf + sizeof(rx_frame_ns), i - sizeof(rx_frame_ns));
+		rx_frame_ns = 0;
+		metric_observe(METRIC_HIST_IGATE_FROM_APRSIS, monotonic_ns() - t0);
+	}
 
 	return 1;
 }
@@ -48,17 +48,67 @@ void erlang_snmp(void)
 		struct erlangline *E = ErlangLines[i];
 
 		printf("%s", E->name);
-		printf("   %ld %ld   %ld  %ld  %ld  %ld    %d\n",
-		       E->SNMP.bytes_rx, E->SNMP.packets_rx,
-		       E->SNMP.bytes_rxdrop, E->SNMP.packets_rxdrop,
-		       E->SNMP.bytes_tx, E->SNMP.packets_tx,
+		printf("   %llu %llu   %llu  %llu  %llu  %llu    %d\n",
+		       (unsigned long long) E->SNMP[ERLANG_COL_BYTES_RX],
+		       (unsigned long long) E->SNMP[ERLANG_COL_PACKETS_RX],
+		       (unsigned long long) E->SNMP[ERLANG_COL_BYTES_RXDROP],
+		       (unsigned long long) E->SNMP[ERLANG_COL_PACKETS_RXDROP],
+		       (unsigned long long) E->SNMP[ERLANG_COL_BYTES_TX],
+		       (unsigned long long) E->SNMP[ERLANG_COL_PACKETS_TX],
 		       (int) (now.tv_sec - E->last_update));
 	}
 }
 
+/* Completed periods of one series, newest first.  Each column
+   is walked back sequentially from the period in progress. */
+static void erlang_xml_series(const struct erlangline *E, int series,
+			      int minutes, int count)
+{
+	const uint32_t *col[ERLANG_COLUMNS];
+	char logtime[40];
+	int age, c, k;
+
+	if (erlang_slots(series) == 0)
+		return;
+	if (count <= 0 || count >= erlang_slots(series))
+		count = erlang_slots(series) - 1;	/* all of the history */
+	for (c = 0; c < ERLANG_COLUMNS; ++c)
+		col[c] = erlang_column(E, series, c);
+
+	for (age = 1; age <= count; ++age) {
+		/* Stamped at the period end, like aprx logs them */
+		time_t t = erlang_period_start(E, series, age - 1);
+
+		k = erlang_slot(E, series, age);
+		if (k < 0)
+			break;
+		if (epochtime) {
+			sprintf(logtime, "%ld", (long) t);
+		} else {
+			strftime(logtime, sizeof(logtime),
+				 "%Y-%m-%d %H:%M", gmtime(&t));
+		}
+		printf("%s  %s", logtime, E->name);
+		printf(" %2dm  %5ld  %3ld  %5ld  %3ld  %5ld  %3ld %5.3f  %5.3f  %5.3f\n",
+		       minutes,
+		       (long) col[ERLANG_COL_BYTES_RX][k],
+		       (long) col[ERLANG_COL_PACKETS_RX][k],
+		       (long) col[ERLANG_COL_BYTES_RXDROP][k],
+		       (long) col[ERLANG_COL_PACKETS_RXDROP][k],
+		       (long) col[ERLANG_COL_BYTES_TX][k],
+		       (long) col[ERLANG_COL_PACKETS_TX][k],
+		       (float) col[ERLANG_COL_BYTES_RX][k] /
+		       ((float) E->erlang_capa * minutes),
+		       (float) col[ERLANG_COL_BYTES_RXDROP][k] /
+		       ((float) E->erlang_capa * minutes),
+		       (float) col[ERLANG_COL_BYTES_TX][k] /
+		       ((float) E->erlang_capa * minutes));
+	}
+}
+
 void erlang_xml(int topmode)
 {
-	int i, j, k, t;
+	int i;
 
 	/* What this outputs is not XML, but a mild approximation
 	   of the data that XML version would output.. 
@@ -74,117 +124,28 @@ void erlang_xml(int topmode)
 
 	for (i = 0; i < ErlangLinesCount; ++i) {
 		struct erlangline *E = ErlangLines[i];
-		char logtime[40];
-		struct tm *wallclock;
 
 		printf("\nSNMP  %s", E->name);
-		printf("   %ld %ld   %ld  %ld  %ld  %ld   %d\n",
-		       E->SNMP.bytes_rx, E->SNMP.packets_rx,
-		       E->SNMP.bytes_rxdrop, E->SNMP.packets_rxdrop,
-		       E->SNMP.bytes_tx, E->SNMP.packets_tx,
+		printf("   %llu %llu   %llu  %llu  %llu  %llu   %d\n",
+		       (unsigned long long) E->SNMP[ERLANG_COL_BYTES_RX],
+		       (unsigned long long) E->SNMP[ERLANG_COL_PACKETS_RX],
+		       (unsigned long long) E->SNMP[ERLANG_COL_BYTES_RXDROP],
+		       (unsigned long long) E->SNMP[ERLANG_COL_PACKETS_RXDROP],
+		       (unsigned long long) E->SNMP[ERLANG_COL_BYTES_TX],
+		       (unsigned long long) E->SNMP[ERLANG_COL_PACKETS_TX],
 		       (int) (now.tv_sec - E->last_update));
 
 		printf("\n1min data\n");
-		k = E->e1_cursor;
-		t = E->e1_max;
-		if (topmode)
-			t = 90;
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e1_max - 1;
-			if (E->e1[k].update == 0)
-				continue;
-			if (epochtime) {
-				sprintf(logtime, "%ld",
-					(long) E->e1[k].update);
-			} else {
-				wallclock = gmtime(&E->e1[k].update);
-				strftime(logtime, sizeof(logtime),
-					 "%Y-%m-%d %H:%M", wallclock);
-			}
-			printf("%s  %s", logtime, E->name);
-			printf(" %2dm  %5ld  %3ld  %5ld  %3ld  %5ld  %3ld %5.3f  %5.3f  %5.3f\n",
-			       1,
-			       E->e1[k].bytes_rx,     E->e1[k].packets_rx,
-			       E->e1[k].bytes_rxdrop, E->e1[k].packets_rxdrop,
-			       E->e1[k].bytes_tx,     E->e1[k].packets_tx,
-			       (float) E->e1[k].bytes_rx /
-			       ((float) E->erlang_capa * 60.0),
-			       (float) E->e1[k].bytes_rxdrop /
-			       ((float) E->erlang_capa * 60.0),
-			       (float)E->e1[k].bytes_tx/((float)E->erlang_capa*60.0)
-				);
-		}
-
+		erlang_xml_series(E, ERLANG_SERIES_1MIN, 1,
+				  topmode ? 90 : 0);
 
 		printf("\n10min data\n");
-		k = E->e10_cursor;
-		t = E->e10_max;
-		if (topmode)
-			t = 10;
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e10_max - 1;
-			if (E->e10[k].update == 0)
-				continue;
-			if (epochtime) {
-				sprintf(logtime, "%ld",
-					(long) E->e10[k].update);
-			} else {
-				wallclock = gmtime(&E->e10[k].update);
-				strftime(logtime, sizeof(logtime),
-					 "%Y-%m-%d %H:%M", wallclock);
-			}
-			printf("%s  %s", logtime, E->name);
-			printf(" %2dm  %5ld  %3ld  %5ld  %3ld  %5ld  %3ld %5.3f  %5.3f  %5.3f\n",
-			       10,
-			       E->e10[k].bytes_rx,     E->e10[k].packets_rx,
-			       E->e10[k].bytes_rxdrop, E->e10[k].packets_rxdrop,
-			       E->e10[k].bytes_tx,     E->e10[k].packets_tx,
-			       (float) E->e10[k].bytes_rx /
-			       ((float) E->erlang_capa * 60.0),
-			       (float) E->e10[k].bytes_rxdrop /
-			       ((float) E->erlang_capa * 60.0),
-			       (float)E->e10[k].bytes_tx/((float)E->erlang_capa*60.0)
-				);
-		}
-
+		erlang_xml_series(E, ERLANG_SERIES_10MIN, 10,
+				  topmode ? 10 : 0);
 
 		printf("\n60min data\n");
-		k = E->e60_cursor;
-		t = E->e60_max;
-		if (topmode)
-			t = 3;
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e60_max - 1;
-			if (E->e60[k].update == 0)
-				continue;
-			if (epochtime) {
-				sprintf(logtime, "%ld",
-					(long) E->e60[k].update);
-			} else {
-				wallclock = gmtime(&E->e60[k].update);
-				strftime(logtime, sizeof(logtime),
-					 "%Y-%m-%d %H:%M", wallclock);
-			}
-			printf("%s  %s", logtime, E->name);
-			printf(" %2dm  %5ld  %3ld  %5ld  %3ld  %5ld  %3ld %5.3f  %5.3f  %5.3f\n",
-			       60,
-			       E->e60[k].bytes_rx,     E->e60[k].packets_rx,
-			       E->e60[k].bytes_rxdrop, E->e60[k].packets_rxdrop,
-			       E->e60[k].bytes_tx,     E->e60[k].packets_tx,
-			       (float) E->e60[k].bytes_rx /
-			       ((float) E->erlang_capa * 60.0),
-			       (float) E->e60[k].bytes_rxdrop /
-			       ((float) E->erlang_capa * 60.0),
-			       (float)E->e60[k].bytes_tx/((float)E->erlang_capa*60.0)
-				);
-		}
-
+		erlang_xml_series(E, ERLANG_SERIES_60MIN, 60,
+				  topmode ? 3 : 0);
 	}
 
 
@@ -192,9 +153,23 @@ void erlang_xml(int topmode)
 }
 
 
+/* The metrics.c region of the store, as text or as JSON */
+void erlang_metrics(int json)
+{
+	const void *region = erlang_metrics_region(NULL);
+
+	if (!region) {
+		fprintf(stderr, "No metrics in %s\n", erlang_backingstore);
+		exit(1);
+	}
+	metrics_dump(stdout, region, json);
+	exit(0);
+}
+
+
 void usage(void)
 {
-	printf("Usage: aprx-stat [-t] [-f arpx-erlang.dat] {-S|-x|-X}\n");
+	printf("Usage: aprx-stat [-t] [-f arpx-erlang.dat] {-S|-x|-X|-m|-j}\n");
 	exit(64);
 }
 
@@ -203,10 +178,11 @@ int main(int argc, char **argv)
 	int opt;
 	int mode_snmp = 0;
 	int mode_xml = 0;
+	int mode_metrics = 0;
 
         gettimeofday(&now, NULL);
 
-	while ((opt = getopt(argc, argv, "f:StxX?h")) != -1) {
+	while ((opt = getopt(argc, argv, "f:StxXmj?h")) != -1) {
 		switch (opt) {
 		case 'f':
 			erlang_backingstore = optarg;
@@ -223,6 +199,12 @@ int main(int argc, char **argv)
 		case 't':
 			epochtime = 1;
 			break;
+		case 'm':
+			mode_metrics = 1;
+			break;
+		case 'j':
+			mode_metrics = 2;
+			break;
 		default:
 			usage();
 			break;
@@ -240,6 +222,8 @@ int main(int argc, char **argv)
 		erlang_xml(0);
 	} else if (mode_xml == 2) {
 		erlang_xml(1);
+	} else if (mode_metrics) {
+		erlang_metrics(mode_metrics == 2);
 	} else
 		usage();
 
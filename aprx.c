@@ -49,6 +49,9 @@ const char *swname = "aprx";
 const char *swversion = APRXVERSION;
 
 
+/* Benchmark programs link all of aprx but this main(), see Makefile */
+#ifndef APRX_NO_MAIN
+
 static void sig_handler(int sig)
 {
 	die_now = 1;
@@ -94,6 +97,8 @@ static void versionprint()
         exit(1);
 }
 
+#endif /* APRX_NO_MAIN */
+
 void fd_nonblockingmode(int fd)
 {
 	int __i = fcntl(fd, F_GETFL, 0);
@@ -111,6 +116,13 @@ static struct timeval old_tick; // monotonic
 
 static int timetick_count;
 
+#ifdef APRX_NO_MAIN
+// The benchmarks link this build of aprx.c, and replay-bench runs
+// the tick ahead of the clock to the timestamps of what it replays.
+// The aprx program has no such thing.
+int64_t bench_tick_skew_ns;
+#endif
+
 void timetick(void)
 {
 	++timetick_count;
@@ -127,6 +139,13 @@ void timetick(void)
         // if (debug) printf("newtick: %d.%6d\n", tick.tv_sec, tick.tv_usec);
 #else
 	gettimeofday(&tick, NULL); // fallback when no clock_gettime() is available
+#endif
+#ifdef APRX_NO_MAIN
+	if (bench_tick_skew_ns > 0) {
+		const int64_t usec = tick.tv_usec + (bench_tick_skew_ns / 1000) % 1000000;
+		tick.tv_sec  += bench_tick_skew_ns / 1000000000LL + usec / 1000000;
+		tick.tv_usec  = usec % 1000000;
+	}
 #endif
         // Wall clock time
         // gettimeofday(&tick, NULL);
@@ -158,6 +177,25 @@ void timetick(void)
         // if (debug>1) printf("TIMETICK %ld:%6d  %d delta=%d ms\n", tick.tv_sec, tick.tv_usec, timetick_count, delta);
 }
 
+// Set by the readers of KISS, Linux AX.25, AGWPE and APRS-IS while
+// the frames they got are processed, and carried along in pbuf_t
+int64_t rx_frame_ns;
+
+// Finer than tick, for latency measurements of individual frames
+int64_t monotonic_ns(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL;
+#endif
+}
+
+#ifndef APRX_NO_MAIN
 int main(int argc, char *const argv[])
 {
 	int i;
@@ -227,6 +265,7 @@ int main(int argc, char *const argv[])
 	aprsis_init();
 #endif
 	filter_init();
+	crc_init();
 	pbuf_init();
 
 	i = readconfig(cfgfile);
@@ -375,6 +414,7 @@ int main(int argc, char *const argv[])
 #ifndef DISABLE_IGATE
 	igate_start();
 #endif
+	openmetrics_start();
 
         aprxlog("aprx start - %s",swversion);
 
@@ -419,6 +459,7 @@ int main(int argc, char *const argv[])
 		i = dprsgw_prepoll(&app);
                 // if (debug>3)printf("after dprsgw prepoll - timeout millis=%d\n",aprxpolls_millis(&app));
 #endif
+		i = openmetrics_prepoll(&app);
 
                 // All pre-polls are done
                 if (can_clear_timereset) {
@@ -460,6 +501,7 @@ int main(int argc, char *const argv[])
 		i = historydb_postpoll(&app);
 		i = dprsgw_postpoll(&app);
 #endif
+		i = openmetrics_postpoll(&app);
 
 	}
 	aprxpolls_free(&app); // valgrind..
@@ -475,6 +517,7 @@ int main(int argc, char *const argv[])
 
 	exit(0);
 }
+#endif /* APRX_NO_MAIN */
 
 
 void printtime(char *buf, int buflen)
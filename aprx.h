@@ -103,6 +103,7 @@ extern void   *memrchr(const void *s, int c, size_t n);
 #include <math.h>
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <netinet/in.h>
 
@@ -117,9 +118,11 @@ extern void   *memrchr(const void *s, int c, size_t n);
 struct aprxpolls; // forward declarator
 
 #include "cellmalloc.h"
+#include "callsign.h"
 #include "historydb.h"
 #include "keyhash.h"
 #include "pbuf.h"
+#include "probes.h"
 
 #if 0
 #define static			/*ignore statics during debug */
@@ -169,6 +172,8 @@ extern const char *swname;
 extern const char *swversion;
 
 extern void timetick(void);
+extern int64_t monotonic_ns(void); // CLOCK_MONOTONIC right now, in nanoseconds
+extern int64_t rx_frame_ns;        // monotonic_ns() of the read() of the frame being processed, 0 = none
 extern struct timeval tick;  // Monotonic clock, progresses regularly from boot. NOT wall clock time.
 extern int time_reset;      // Set during ONE call cycle of prepolls
 extern int debug;
@@ -222,12 +227,29 @@ typedef enum {
 	LINETYPE_DPRSGW		/* Special DPRS RX GW mode              */
 } LineType;
 
+/* KISS encoded frame on a serialport transmit queue */
+struct kissframe {
+	struct kissframe *next;
+	int     len;		/* encoded length                       */
+	int     cursor;		/* this much is already written         */
+	int     tncid;		/* sub-port on multiport KISS           */
+	int64_t rx_ns;		/* monotonic_ns() of originating read(),
+				   0 when not a digipeated frame        */
+	uint8_t buf[];
+};
+
 typedef enum {
 	KISSSTATE_SYNCHUNT = 0,
 	KISSSTATE_COLLECTING,
 	KISSSTATE_KISSFESC
 } KissState;
 
+/* Cached ErlangLines[] index of a port name, see erlang_add_h() */
+struct erlanghandle {
+	int index;
+	int generation;		/* 0 = not resolved yet                 */
+};
+
 struct serialport {
 	int fd;			/* UNIX fd of the port                  */
 
@@ -236,6 +258,10 @@ struct serialport {
 					   watchdog */
 	int read_timeout;	/* seconds                              */
 	int poll_millis;        /* milliseconds (0 = none.)             */
+	struct timeval poll_tv;	/* next active KISS poll                */
+	int low_latency;	/* VMIN=1 VTIME=0, ASYNC_LOW_LATENCY,
+				   TCP_NODELAY on tcp! ports            */
+	int64_t rd_ns;		/* monotonic_ns() at last read()        */
 
 	LineType linetype;
 
@@ -256,6 +282,7 @@ struct serialport {
 	const char *ttyname;	/* "/dev/ttyUSB1234-bar22-xyz7" --
 				   Linux TTY-names can be long..        */
 	const char *ttycallsign[16]; /* callsign                             */
+	struct erlanghandle erlang[16]; /* .. and its erlang line          */
 	const void *netax25[16];
 
 	char *initstring[16];	/* optional init-string to be sent to
@@ -275,11 +302,21 @@ struct serialport {
 	uint8_t rdline[2000];	/* processed into lines/records         */
 	int rdlinelen;		/* length of this record                */
 
-	uint8_t wrbuf[4000];	/* buffering area for raw stream read */
+	uint8_t wrbuf[4000];	/* buffering area for raw stream write,
+				   init strings and KISS polls          */
 	int wrlen, wrcursor;	/* wrlen = last byte in buffer,
 				   wrcursor = next to write.
 				   When wrlen == 0, buffer is empty.    */
 
+	struct kissframe *txq_head, *txq_tail; /* KISS frames to write  */
+	int     txq_count;	/* frames on queue                      */
+	int     txq_bytes;	/* bytes on queue                       */
+	int     txq_maxcount;	/* queue depth high-water mark          */
+	long    txq_frames;	/* frames queued, ever                  */
+	long    txq_drops;	/* frames dropped, queue full           */
+	int     metrics_port;	/* slot of metrics_port_register(),
+				   -1 = none, -2 = not yet asked        */
+
 	void *dprsgw;		/* opaque DPRS GW data */
 };
 
@@ -297,6 +334,8 @@ extern int  ttyreader_getc(struct serialport *tty);
 // extern void               ttyreader_setkissparams(struct serialport *tty, const int tncid, const char *callsign, const int timeout);
 extern int  ttyreader_parse_ttyparams(struct configfile *cf, struct serialport *tty, char *str);
 extern void ttyreader_linewrite(struct serialport *S);
+extern void ttyreader_txq_purge(struct serialport *S);
+extern int  ttyreader_txq_limit; /* bytes */
 extern int  ttyreader_parse_nullparams(struct configfile *cf, struct serialport *tty, char *str);
 
 extern void hexdumpfp(FILE *fp, const uint8_t *buf, const int len, int axaddr);
@@ -373,6 +412,21 @@ extern int  dprsgw_postpoll(struct aprxpolls *app);
 
 
 /* erlang.c */
+
+/* Latency histogram, log2 buckets of microseconds:
+   bucket 0 is < 1 us, bucket i is [ 2^(i-1), 2^i ) us,
+   and the last one takes everything above. */
+#define LATENCYHIST_BUCKETS 24
+struct latencyhist {
+	uint32_t count;
+	uint32_t bucket[LATENCYHIST_BUCKETS];
+	int64_t  sum_ns;
+	int64_t  max_ns;
+};
+extern void latencyhist_add(struct latencyhist *h, int64_t ns);
+extern int  latencyhist_format(const struct latencyhist *h, char *buf, int buflen);
+extern void erlang_logline(const char *msgbuf);
+
 extern void erlang_init(const char *syslog_facility_name);
 extern void erlang_start(int do_create);
 extern int  erlang_prepoll(struct aprxpolls *app);
@@ -416,98 +470,249 @@ typedef enum {
 } ErlangMode;
 
 extern void erlang_add(const char *portname, ErlangMode erl, int bytes, int packets);
+extern void erlang_add_h(struct erlanghandle *h, const char *portname, ErlangMode erl, int bytes, int packets);
 extern void erlang_set(const char *portname, int bytes_per_minute);
 
 extern int erlangsyslog;
 extern int erlanglog1min;
 extern const char *erlang_backingstore;
 
-/* The   struct erlangline  is shared in between the aprx, and
-   erlang reporter application: aprx-stat */
-
-struct erlang_rxtxbytepkt {
-	long packets_rx, packets_rxdrop, packets_tx ;
-	long bytes_rx,   bytes_rxdrop,   bytes_tx ;
-	time_t update;
-};
-
-
-struct erlangline {
-	const void *refp;
-	int index;
-	char name[31];
-	uint8_t __subport;
-	time_t last_update;
-
-	int erlang_capa;	/* bytes, 1 minute                      */
-
-	struct erlang_rxtxbytepkt SNMP;	/* SNMPish counters             */
-
-#ifdef ERLANGSTORAGE
-	struct erlang_rxtxbytepkt erl1m;	/*  1 minute erlang period    */
-	struct erlang_rxtxbytepkt erl10m;	/* 10 minute erlang period    */
-	struct erlang_rxtxbytepkt erl60m;	/* 60 minute erlang period    */
-#else
-#if (USE_ONE_MINUTE_DATA == 1)
-	struct erlang_rxtxbytepkt erl1m;	/*  1 minute erlang period    */
-#else
-	struct erlang_rxtxbytepkt erl10m;	/* 10 minute erlang period    */
-#endif
-#endif
-
-#ifdef ERLANGSTORAGE
-	int e1_cursor, e1_max;	/* next store point + max cursor index */
-	int e10_cursor, e10_max;
-	int e60_cursor, e60_max;
-#else
-#if (USE_ONE_MINUTE_DATA == 1)
-	int e1_cursor, e1_max;	/* next store point + max cursor index */
-#else
-	int e10_cursor, e10_max;
-#endif
-#endif
-
+/* The erlang store is shared in between the aprx, and erlang
+   reporter application: aprx-stat.
+
+   It is a file of fixed-stride records with explicit-width fields:
+
+	struct erlanghead	at offset 0
+	line 0			at offset head_size
+	line 1			at offset head_size + line_size
+	...
+
+   Every line starts with struct erlangline, and at linehead_size
+   from the line start follow its history rings.  Each series
+   (1 minute, 10 minute, 60 minute) is six uint32_t columns of
+   series_slots[] entries, one column after another in the order
+   of ERLANG_COL_*.  Period number P of a series covers wall clock
+   seconds [ P * period, (P+1) * period ), and lives in slot
+   P % slots.  Line's period[] tells the period that is being
+   accumulated now, thus no timestamps are stored.
+
+   Readers go by the header fields, not by sizeof() of these
+   structs, see erlang_column() and friends.
+
+   In between the header and line 0 there may be the metrics.c
+   region, see  struct metrics_head. */
+
+#define ERLANG_STORE_MAGIC   "APRXERL\n"	/* 8 bytes, no NUL      */
+#define ERLANG_STORE_VERSION 2
+
+#define ERLANG_SERIES_1MIN   0
+#define ERLANG_SERIES_10MIN  1
+#define ERLANG_SERIES_60MIN  2
+#define ERLANG_SERIES_MAX    3
+
+#define ERLANG_COL_BYTES_RX       0
+#define ERLANG_COL_PACKETS_RX     1
+#define ERLANG_COL_BYTES_RXDROP   2
+#define ERLANG_COL_PACKETS_RXDROP 3
+#define ERLANG_COL_BYTES_TX       4
+#define ERLANG_COL_PACKETS_TX     5
+#define ERLANG_COLUMNS            6
+
+/* History depth in completed periods, the ring has one more slot
+   for the period in progress.  Zero when the series is not kept. */
 #ifdef ERLANGSTORAGE
-
 #define APRXERL_1M_COUNT   (60*24)    // 1 day of 1 minute data
 #define APRXERL_10M_COUNT  (60*24*7)  // 1 week of 10 minute data
 #define APRXERL_60M_COUNT  (24*31*3)  // 3 months of hourly data
-	struct erlang_rxtxbytepkt e1[APRXERL_1M_COUNT];
-	struct erlang_rxtxbytepkt e10[APRXERL_10M_COUNT];
-	struct erlang_rxtxbytepkt e60[APRXERL_60M_COUNT];
 #else /* EMBEDDED */		/* When making very small memory footprint,
 				   like embedding on Linksys WRT54GL ... */
-
-#define APRXERL_1M_COUNT   (22)	      // 22 minutes of 1 minute data
-#define APRXERL_10M_COUNT  (3)	      // 30 minutes of 10 minute data
 #if (USE_ONE_MINUTE_DATA == 1)
-	struct erlang_rxtxbytepkt e1[APRXERL_1M_COUNT];
+#define APRXERL_1M_COUNT   (22)	      // 22 minutes of 1 minute data
+#define APRXERL_10M_COUNT  (0)
 #else
-	struct erlang_rxtxbytepkt e10[APRXERL_10M_COUNT];
+#define APRXERL_1M_COUNT   (0)
+#define APRXERL_10M_COUNT  (3)	      // 30 minutes of 10 minute data
 #endif
+#define APRXERL_60M_COUNT  (0)
 #endif
-};
 
-struct erlanghead {
-	char title[32];
-	int version;		/* format version                       */
-	int linecount;
-	time_t last_update;
-
-	pid_t server_pid;
-	time_t start_time;
-
-	char mycall[16];
+struct erlanghead {			/* 128 bytes                    */
+	char     magic[8];		/* ERLANG_STORE_MAGIC           */
+	uint32_t version;		/* ERLANG_STORE_VERSION         */
+	uint32_t head_size;		/* offset of line 0             */
+	uint32_t line_size;		/* line stride                  */
+	uint32_t linehead_size;		/* ring offset within a line    */
+	uint32_t linecount;
+	uint32_t series_count;		/* ERLANG_SERIES_MAX            */
+	uint32_t series_period[ERLANG_SERIES_MAX]; /* seconds           */
+	uint32_t series_slots[ERLANG_SERIES_MAX];  /* 0 = not kept      */
+	int64_t  last_update;
+	int64_t  start_time;
+	int32_t  server_pid;
+	char     mycall[16];
+	uint32_t metrics_offset;	/* metrics.c region, 0 = none   */
+	uint32_t metrics_size;
+	char     filler[28];
+};
 
-	double align_filler;
+struct erlangline {			/* 128 bytes                    */
+	char     name[32];
+	int32_t  index;
+	int32_t  erlang_capa;		/* bytes, 1 minute              */
+	int64_t  last_update;
+	int64_t  created;		/* no history before this       */
+	uint64_t SNMP[ERLANG_COLUMNS];	/* SNMPish counters, ERLANG_COL_* */
+	int64_t  period[ERLANG_SERIES_MAX]; /* period in progress       */
 };
 
-#define ERLANGLINE_STRUCT_VERSION ((sizeof(struct erlanghead)<<16)+sizeof(struct erlangline))
+extern const uint32_t *erlang_column(const struct erlangline *E, int series, int col);
+extern int     erlang_slots(int series);
+extern int     erlang_slot(const struct erlangline *E, int series, int age);
+extern int64_t erlang_period_start(const struct erlangline *E, int series, int age);
 
 extern struct erlanghead *ErlangHead;
 extern struct erlangline **ErlangLines;
 extern int ErlangLinesCount;
 
+extern const void *erlang_metrics_region(uint32_t *sizep);
+
+
+/* metrics.c */
+
+/* Counters and gauges of one uint64_t each, the id is the value
+   index.  Every one of these has a single writer thread. */
+enum metric_id {
+	/* counters */
+	METRIC_RX_FRAMES,		/* KISS frames received            */
+	METRIC_RX_DROP_KISS_CMD,	/* bad KISS command byte           */
+	METRIC_RX_DROP_KISS_TNCID,	/* no interface on the TNC id      */
+	METRIC_RX_DROP_KISS_CRC,	/* FLEXNET, BPQ or SMACK checksum  */
+	METRIC_RX_DROP_SHORT,		/* shorter than AX.25 addresses    */
+	METRIC_RX_DROP_AX25,		/* rejected by ax25_to_tnc2()      */
+	METRIC_IGATE_DROP_RULES,	/* forbidden source, via, payload  */
+	METRIC_IGATE_DROP_QUEUE,	/* APRS-IS did not take it         */
+	METRIC_DIGI_DROP_RATELIMIT,	/* source or transmitter buckets   */
+	METRIC_DIGI_DROP_DUPE,
+	METRIC_DIGI_DROP_HOPS,		/* no hops left, or over limits    */
+	METRIC_DIGI_DROP_FILTER,	/* DIRECTONLY, data body filters   */
+	METRIC_DIGI_DROP_NOMEM,		/* no dupecheck cell for it        */
+	METRIC_APRSIS_DROP_WRBUF,	/* APRS-IS write buffer full       */
+	METRIC_APRSIS_DROP_STALE,	/* queued for over 10 seconds      */
+	METRIC_APRSIS_CONNECTS,
+	METRIC_DUPECHECK_HITS,		/* dupe records seen again         */
+	/* gauges */
+	METRIC_APRSIS_WRBUF,		/* bytes                           */
+	METRIC_KISS_WRBUF,		/* bytes, all serial ports         */
+	METRIC_DIGI_VISCOUS,		/* packets on viscous delay queues */
+	METRIC_DUPECHECK_CELLS,
+	METRIC_HISTORYDB_CELLS,
+	METRIC_APRSIS_CONNECTED,	/* 1 when the server is connected  */
+	METRIC_SCALARS
+};
+#define METRIC_FIRST_GAUGE METRIC_APRSIS_WRBUF
+
+/* Log-linear histograms of nanoseconds: values below METRIC_HIST_SUB
+   have their own buckets, above that every power of two is split in
+   METRIC_HIST_SUB linear buckets.  The values are count, sum, and
+   then the buckets. */
+enum metric_hist_id {
+	METRIC_HIST_KISS_RX,		/* KISS frame processing           */
+	METRIC_HIST_IGATE_FROM_APRSIS,	/* APRS-IS line to Tx-iGate done   */
+	METRIC_HIST_DIGI_LATENCY,	/* frame read() to KISS write()    */
+	/* rx_frame_ns to the hand-over of the frame, per path */
+	METRIC_HIST_PATH_RF_RF,		/* digipeat, to transmitter        */
+	METRIC_HIST_PATH_RF_RF_VISCOUS,	/* .. through viscous delay        */
+	METRIC_HIST_PATH_IS_RF,		/* Tx-iGate, to transmitter        */
+	METRIC_HIST_PATH_RF_IS,		/* Rx-iGate, to APRS-IS write()    */
+	METRIC_HISTS
+};
+#define METRIC_HIST_SUBBITS  2
+#define METRIC_HIST_SUB      (1 << METRIC_HIST_SUBBITS)
+#define METRIC_HIST_BUCKETS  (METRIC_HIST_SUB * 36)	/* up to 2^37 ns */
+#define METRIC_HIST_VALUES   (2 + METRIC_HIST_BUCKETS)
+#define METRIC_HIST_BASE(h)  (METRIC_SCALARS + (h) * METRIC_HIST_VALUES)
+
+/* Per serial port values, in METRIC_PORTS fixed slots so that the
+   region size does not depend on the configuration. */
+enum metric_port_id {
+	METRIC_PORT_TXQ_DROPS,		/* KISS frames, TX queue was full  */
+	METRIC_PORT_TXQ_FRAMES,		/* gauge, frames on the TX queue   */
+	METRIC_PORT_TXQ_MAXFRAMES,	/* gauge, its high-water mark      */
+	METRIC_PORT_VALUES
+};
+#define METRIC_PORTS         16
+#define METRIC_PORT_BASE(p)  (METRIC_HIST_BASE(METRIC_HISTS) + (p) * METRIC_PORT_VALUES)
+#define METRIC_VALUES        METRIC_PORT_BASE(METRIC_PORTS)
+
+#define METRIC_KIND_COUNTER   1
+#define METRIC_KIND_GAUGE     2
+#define METRIC_KIND_HISTOGRAM 3
+
+/* The region in the erlang store file, fixed-width fields */
+struct metrics_head {			/* 16 bytes                     */
+	uint32_t count;			/* descriptors                  */
+	uint32_t desc_size;
+	uint32_t values_offset;		/* from the region start        */
+	uint32_t values_count;		/* uint64_t values              */
+};
+struct metrics_desc {			/* 64 bytes                     */
+	char     name[48];
+	uint32_t kind;			/* METRIC_KIND_*                */
+	uint32_t value;			/* index of the first value     */
+	uint32_t buckets;		/* histograms                   */
+	uint32_t subbits;		/* histograms                   */
+};
+
+extern uint64_t *metrics_values;
+
+extern uint32_t metrics_region_size(void);
+extern void     metrics_region_init(void *region);
+extern void     metrics_attach(void *region);
+extern int      metrics_region_ok(const void *region, uint32_t size);
+extern uint64_t metrics_bucket_low(int idx, int subbits);
+extern void     metrics_dump(FILE *fp, const void *region, int json);
+extern const char *metrics_name(int i, int *kindp);
+extern int      metrics_port_register(const char *name);
+extern const char *metrics_port_name(int p);
+extern const char *metrics_port_value_name(int v, int *kindp);
+
+static inline void metric_add(const int id, const uint64_t n)
+{
+	metrics_values[id] += n;
+}
+
+static inline void metric_set(const int id, const uint64_t v)
+{
+	metrics_values[id] = v;
+}
+
+static inline int metric_hist_index(const uint64_t v)
+{
+	int e, i;
+
+	if (v < METRIC_HIST_SUB)
+		return (int) v;
+#ifdef __GNUC__
+	e = 63 - __builtin_clzll(v);
+#else
+	for (e = METRIC_HIST_SUBBITS; (v >> (e + 1)) != 0; ++e)
+		;
+#endif
+	i = ((e - METRIC_HIST_SUBBITS + 1) << METRIC_HIST_SUBBITS) |
+		(int) ((v >> (e - METRIC_HIST_SUBBITS)) & (METRIC_HIST_SUB - 1));
+	return i < METRIC_HIST_BUCKETS ? i : METRIC_HIST_BUCKETS - 1;
+}
+
+static inline void metric_observe(const int h, const int64_t ns)
+{
+	uint64_t *m = metrics_values + METRIC_HIST_BASE(h);
+	const uint64_t v = ns > 0 ? (uint64_t) ns : 0;
+
+	m[0] += 1;
+	m[1] += v;
+	m[2 + metric_hist_index(v)] += 1;
+}
+
 
 /* dupecheck.c */
 
@@ -533,6 +738,7 @@ typedef struct dupe_record_t {
 	int16_t	 alen;	// Address length
 	int16_t	 plen;	// Payload length
 
+	callkey_t srckey, dstkey; // Packed SRC and DEST, CALLKEY_NONE if not packable
 	char	 addresses[20];
 	char	*packet;
 	char	 packetbuf[200]; /* 99.9+ % of time this is enough.. */
@@ -568,6 +774,13 @@ extern int      check_crc_16(const uint8_t *buf, int n);   /* SMACK's CRC-16 */
 extern int      check_crc_flex(const uint8_t *buf, int n); /* FLEXNET's CRC */
 extern int      check_crc_ccitt(const uint8_t *buf, int n);
 
+#define CRC_ENGINE_BYTEWISE 0
+#define CRC_ENGINE_SLICE8   1
+#define CRC_ENGINE_CLMUL    2
+#define CRC_ENGINE_BEST     CRC_ENGINE_CLMUL
+extern void     crc_init(void);
+extern int      crc_set_engine(int engine);
+
 /* KISS protocol encoder/decoder specials */
 
 #define KISS_FEND  (0xC0)
@@ -576,8 +789,11 @@ extern int      check_crc_ccitt(const uint8_t *buf, int n);
 #define KISS_TFESC (0xDD)
 
 extern int  kissencoder(void *, int, LineType, const void *, int, int);
+extern int  kissencoder_v(void *, int, LineType, const struct iovec *, int, int);
 extern void kiss_kisswrite(struct serialport *S, const int tncid, const uint8_t *ax25raw, const int ax25rawlen);
+extern void kiss_kisswritev(struct serialport *S, const int tncid, const uint8_t *axaddr, const int axaddrlen, const uint8_t *axdata, const int axdatalen, const int64_t rx_ns);
 extern int  kiss_pullkiss(struct serialport *S);
+extern int  kiss_deframe(struct serialport *S, int (*frameproc)(struct serialport *S));
 extern void kiss_poll(struct serialport *S);
 
 
@@ -591,6 +807,7 @@ typedef enum {
 
 struct filter_t;       // Forward declarator
 struct digipeater;     // Forward declarator
+struct digi_hoptable;  // Forward declarator
 
 struct tracewide {
 	int    maxreq;
@@ -628,17 +845,14 @@ struct digipeater_source {
 	int	               viscous_queue_space;
 	struct dupe_record_t **viscous_queue;
 
-	int sourceregscount;
-	regex_t **sourceregs;
+	// Via hop classification table, see digipeater.c
+	struct digi_hoptable  *hoptable;
 
-	int destinationregscount;
-	regex_t **destinationregs;
-
-	int viaregscount;
-	regex_t **viaregs;
-
-	int dataregscount;
-	regex_t **dataregs;
+	// Reject regex sets, see regexset.c
+	struct regexset *sourceregs;
+	struct regexset *destinationregs;
+	struct regexset *viaregs;
+	struct regexset *dataregs;
 };
 
 struct digipeater {
@@ -668,6 +882,17 @@ extern void digipeater_receive(struct digipeater_source *src, struct pbuf_t *pb)
 extern int  digipeater_receive_filter(struct digipeater_source *src, struct pbuf_t *pb);
 extern dupecheck_t *digipeater_find_dupecheck(const struct aprx_interface *aif);
 extern struct digipeater* digipeater_find_by_iface(const struct aprx_interface *aif);
+struct ombuf;
+extern void digipeater_openmetrics(struct ombuf *ob);
+
+/* regexset.c */
+struct regexset;
+extern void regexset_add(struct regexset **setp, const char *pattern, regex_t *re);
+extern int  regexset_compile(struct regexset *set);
+extern int  regexset_match(const struct regexset *set, const char *field);
+extern int  regexset_match_each(const struct regexset *set, const char *field);
+extern int  regexset_count(const struct regexset *set);
+extern void regexset_free(struct regexset *set);
 
 /* interface.c */
 
@@ -690,9 +915,11 @@ struct aprx_interface {
 
 	char       *callsign;      // Callsign of this interface
 	uint8_t     ax25call[7];   // AX.25 address field format callsign
+	callkey_t   callkey;       // Packed upper-cased callsign, set at store time
 
 	int	    aliascount;
 	char	  **aliases;	   // Alias callsigns for this interface
+	callkey_t  *aliaskeys;	   // .. and their packed keys
 
 	int8_t	    subif;	   // Sub-interface index - for KISS uses
 	uint8_t	    txrefcount;    // Number of digipeaters using this as Tx
@@ -712,8 +939,20 @@ struct aprx_interface {
 
 	int	                   digisourcecount;
 	struct digipeater_source **digisources;
+
+	struct latencyhist txlatency; // serial read() to write() of digipeats
+	struct erlanghandle erlang;   // Erlang line of the callsign
 };
 
+/* Erlang accounting on an interface that is otherwise const for the
+   caller -- the handle is a lookup cache, not interface state. */
+static inline void interface_erlang_add(const struct aprx_interface *aif,
+					ErlangMode erl, int bytes, int packets)
+{
+	erlang_add_h((struct erlanghandle *)&aif->erlang, aif->callsign,
+		     erl, bytes, packets);
+}
+
 extern struct aprx_interface aprsis_interface;
 
 extern int                     top_interfaces_group;
@@ -729,6 +968,7 @@ extern int interface_is_telemetrable(const struct aprx_interface *iface );
 
 extern void interface_receive_ax25( const struct aprx_interface *aif, const char *ifaddress, const int is_aprs, const int ui_pid, const uint8_t *axbuf, const int axaddrlen, const int axlen, const char *tnc2buf, const int tnc2addrlen, const int tnc2len);
 extern void interface_transmit_ax25(const struct aprx_interface *aif, uint8_t *axaddr, const int axaddrlen, const char *axdata, const int axdatalen);
+extern void interface_transmit_ax25_ts(const struct aprx_interface *aif, uint8_t *axaddr, const int axaddrlen, const char *axdata, const int axdatalen, const int64_t rx_ns);
 extern void interface_receive_3rdparty(const struct aprx_interface *aif, char **heads, const int headscount,  const char *gwtype, const char *tnc2data, const int tnc2datalen);
 extern int  interface_transmit_beacon(const struct aprx_interface *aif, const char *src, const char *dest, const char *via, const char *tncbuf, const int tnclen);
 extern int process_message_to_myself(const struct aprx_interface*const srcif, const struct pbuf_t*const pb);
@@ -766,12 +1006,18 @@ extern void filter_init(void);
 extern int  filter_parse(struct filter_t **ffp, const char *filt);
 extern void filter_free(struct filter_t *c);
 extern int  filter_process(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb);
+extern int  filter_process_chain(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb);
+extern void filter_compile(struct filter_t *f);
+extern void filter_uncompile(struct filter_t *f);
 
 extern void filter_preprocess_dupefilter(struct pbuf_t *pb);
 extern void filter_postprocess_dupefilter(struct pbuf_t *pb, historydb_t *historydb);
 
 extern float filter_lat2rad(float lat);
 extern float filter_lon2rad(float lon);
+extern void  filter_pos_vector(const float lat, const float lon, double xyz[3]);
+extern double filter_range_cosdist(const float km);
+extern int   filter_range_test(const double xyz1[3], const double xyz2[3], const float km, const double cosdist);
 
 #ifdef ENABLE_AGWPE
 /* agwpesocket.c */
@@ -783,3 +1029,20 @@ extern int  agwpe_postpoll(struct aprxpolls *);
 extern void agwpe_init(void);
 extern void agwpe_start(void);
 #endif
+
+/* openmetrics.c */
+struct ombuf {				/* reused, grows as needed      */
+	char *buf;
+	int   len;
+	int   size;
+};
+extern void ombuf_printf(struct ombuf *ob, const char *fmt, ...)
+#ifdef __GNUC__
+	__attribute__ ((format (printf, 2, 3)))
+#endif
+	;
+extern void ombuf_label(struct ombuf *ob, const char *s, int maxlen);
+extern void openmetrics_config(const char *host, const char *port);
+extern void openmetrics_start(void);
+extern int  openmetrics_prepoll(struct aprxpolls *app);
+extern int  openmetrics_postpoll(struct aprxpolls *app);
@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+#  aprsis-load.sh -- the APRS-IS client of aprx under load and faults
+#
+#  Runs aprsis-sim, and a paced replay-bench with it as the APRS-IS
+#  server.  replay-bench uplinks the RF traffic it replays (100/s),
+#  and Tx-igates the messages of the simulator feed to its stations.
+#  Then both print their reports:  igate throughput both ways, drops
+#  of the uplink queue, and the reconnect latency.
+#
+#  Usage:  aprsis-load.sh [seconds [aprsis-sim options]]
+#
+#	bench/aprsis-load.sh 120 -r 50 -s 40:15 -d 60 -w
+#
+#  Without options the feed is 20 lines/s written in pieces, with
+#  an 8 second stall every 30 seconds and a disconnect a minute after
+#  each login.  Run in the build directory after "make bench".
+#
+
+SECS=${1:-60}
+[ $# -gt 0 ] && shift
+[ $# -eq 0 ] && set -- -r 20 -s 30:8 -d 60 -w
+PORT=${APRSIS_SIM_PORT:-24580}
+BIN=${BENCHBIN:-bench}
+
+$BIN/aprsis-sim -v -P $PORT "$@" > aprsis-sim.out &
+SIM=$!
+trap 'kill $SIM 2>/dev/null' 0 1 2 15
+
+$BIN/replay-bench -p -n `expr $SECS \* 100` -a 127.0.0.1:$PORT
+RC=$?
+
+kill -TERM $SIM
+wait $SIM
+grep -v '^t=' aprsis-sim.out
+echo "(per second status in aprsis-sim.out)"
+exit $RC
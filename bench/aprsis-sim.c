@@ -0,0 +1,444 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  aprsis-sim:  a stand-in APRS-IS server for load and soak tests
+ *
+ *  Greets, answers the "user .. pass .." login with a logresp, sends
+ *  "#" heartbeats, and streams a feed to the logged in clients at a
+ *  given rate:  lines of a recorded file in a loop, or generated
+ *  positions and messages.  The generated messages go to the station
+ *  calls that replay-bench generates traffic from, so with it they
+ *  are Tx-igated.  Lines from the clients are counted.
+ *
+ *  Faults to inject:
+ *	-s every:len	stall, neither read nor write for 'len' seconds
+ *			at the end of each 'every' seconds
+ *	-d secs		disconnect a client 'secs' after its login
+ *	-w		write the feed in small random pieces
+ *
+ *  At the end (-t seconds, or a signal) it reports the feed sent and
+ *  what of it the clients did not take in time (the backpressure),
+ *  the uplinked lines, and the reconnect latency:  time from a close
+ *  to the next login.  With -v a status line every second.
+ *
+ *  Usage:  aprsis-sim [-v] [-w] [-P port] [-r lines/s] [-f feed-file]
+ *		       [-H heartbeat-secs] [-s every:len] [-d secs] [-t secs]
+ *
+ *  See  aprsis-load.sh  for running it against replay-bench.
+ */
+
+#include "aprx.h"
+#include <time.h>
+
+#define SIM_CLIENTS  4
+#define SIM_WRBUF    32768
+
+struct sim_client {
+	int      fd;
+	int      login;		/* seen the "user" line               */
+	int      rdlen;
+	char     rdbuf[2048];	/* the incomplete line                */
+	int      wrlen;
+	char     wrbuf[SIM_WRBUF];
+	int64_t  next_write;	/* -w pieces are apart in time        */
+	int64_t  login_ns;
+};
+
+static struct sim_client clients[SIM_CLIENTS];
+static int listen_fd = -1;
+static volatile int sim_die;
+
+static int     opt_verbose, opt_pieces, opt_heartbeat = 20;
+static double  opt_rate = 10;
+static int     opt_stall_every, opt_stall_len, opt_disconnect, opt_time;
+
+static char  **feed_lines;
+static int     feed_count, feed_next;
+
+/* What is reported */
+static uint64_t st_accepts, st_logins, st_heartbeats, st_disconnects;
+static uint64_t st_feed_lines, st_feed_bytes, st_feed_dropped, st_partial;
+static uint64_t st_up_lines, st_up_bytes, st_up_comments;
+static int64_t  st_reconn_min = -1, st_reconn_max, st_reconn_sum;
+static int      st_reconn_count, st_wrbuf_max;
+static int64_t  last_close_ns = -1;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sig_die(int sig)
+{
+	sim_die = 1;
+}
+
+static int stalled(int64_t t)
+{
+	int s;
+
+	if (opt_stall_every <= 0)
+		return 0;
+	s = (int) (t / 1000000000LL) % opt_stall_every;
+	return s >= opt_stall_every - opt_stall_len;
+}
+
+static void sim_close(struct sim_client *C, int64_t t)
+{
+	close(C->fd);
+	C->fd = -1;
+	if (C->login)
+		last_close_ns = t;
+}
+
+/* Queue to a client, drop it when the client does not keep up */
+static void sim_queue(struct sim_client *C, const char *s, int len)
+{
+	if (C->wrlen + len > SIM_WRBUF) {
+		++st_feed_dropped;
+		return;
+	}
+	memcpy(C->wrbuf + C->wrlen, s, len);
+	C->wrlen += len;
+	if (C->wrlen > st_wrbuf_max)
+		st_wrbuf_max = C->wrlen;
+}
+
+/* The next feed line, with its CRLF */
+static int feed_line(char *buf, int size)
+{
+	static int n;
+	int s;
+
+	if (feed_count > 0) {
+		const char *l = feed_lines[feed_next++ % feed_count];
+		return snprintf(buf, size, "%s\r\n", l);
+	}
+	++n;
+	if (n % 5 != 0)
+		return snprintf(buf, size,
+				"SIM%03d>APRS,TCPIP*,qAC,SIM:!5920.00N/01800.00E-feed %d\r\n",
+				n % 1000, n);
+	/* A message to a replay-bench station */
+	s = (n / 5) % 900;
+	return snprintf(buf, size,
+			"SIMMSG>APRS,TCPIP*,qAC,SIM::OH%dR%02d   :feed %d{%d\r\n",
+			1 + s % 9, (s / 9) % 100, n, n % 1000);
+}
+
+static void sim_accept(int64_t t)
+{
+	static const char greeting[] = "# aprsis-sim\r\n";
+	int fd = accept(listen_fd, NULL, NULL), i;
+
+	if (fd < 0)
+		return;
+	for (i = 0; i < SIM_CLIENTS; ++i) {
+		struct sim_client *C = &clients[i];
+		if (C->fd >= 0)
+			continue;
+		memset(C, 0, sizeof(*C));
+		C->fd = fd;
+		fd_nonblockingmode(fd);
+		++st_accepts;
+		sim_queue(C, greeting, sizeof(greeting) - 1);
+		return;
+	}
+	close(fd);
+}
+
+static void sim_line(struct sim_client *C, const char *line, int64_t t)
+{
+	char resp[200];
+	const char *u, *p;
+
+	if (!C->login) {
+		if (strncmp(line, "user ", 5) != 0)
+			return;
+		C->login = 1;
+		C->login_ns = t;
+		++st_logins;
+		u = line + 5;
+		p = strstr(line, " pass ");
+		snprintf(resp, sizeof(resp), "# logresp %.*s %s, server APRSISSIM\r\n",
+			 (int) strcspn(u, " "), u,
+			 (p && strncmp(p + 6, "-1", 2) != 0) ? "verified" : "unverified");
+		sim_queue(C, resp, strlen(resp));
+		if (last_close_ns >= 0) {
+			const int64_t d = t - last_close_ns;
+			if (st_reconn_min < 0 || d < st_reconn_min)
+				st_reconn_min = d;
+			if (d > st_reconn_max)
+				st_reconn_max = d;
+			st_reconn_sum += d;
+			++st_reconn_count;
+			last_close_ns = -1;
+		}
+		return;
+	}
+	if (line[0] == '#')
+		++st_up_comments;
+	else
+		++st_up_lines;
+}
+
+static void sim_read(struct sim_client *C, int64_t t)
+{
+	char buf[4096];
+	int n = read(C->fd, buf, sizeof(buf)), i;
+
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+		sim_close(C, t);
+		return;
+	}
+	if (n < 0)
+		return;
+	st_up_bytes += n;
+	for (i = 0; i < n; ++i) {
+		if (buf[i] == '\r' || buf[i] == '\n') {
+			if (C->rdlen > 0) {
+				C->rdbuf[C->rdlen] = 0;
+				sim_line(C, C->rdbuf, t);
+			}
+			C->rdlen = 0;
+		} else if (C->rdlen < sizeof(C->rdbuf) - 1) {
+			C->rdbuf[C->rdlen++] = buf[i];
+		}
+	}
+}
+
+static void sim_write(struct sim_client *C, int64_t t)
+{
+	int len = C->wrlen, n;
+
+	if (opt_pieces) {
+		if (t < C->next_write)
+			return;
+		len = 1 + random() % 24;
+		if (len > C->wrlen)
+			len = C->wrlen;
+		C->next_write = t + (random() % 3000) * 1000LL;
+		++st_partial;
+	}
+	n = write(C->fd, C->wrbuf, len);
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EINTR)
+			sim_close(C, t);
+		return;
+	}
+	C->wrlen -= n;
+	memmove(C->wrbuf, C->wrbuf + n, C->wrlen);
+}
+
+static int read_feed(const char *fname)
+{
+	FILE *fp = fopen(fname, "r");
+	char line[1000];
+
+	if (fp == NULL) {
+		perror(fname);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (line[0] == 0)
+			continue;
+		feed_lines = realloc(feed_lines, (feed_count + 1) * sizeof(char *));
+		feed_lines[feed_count++] = strdup(line);
+	}
+	fclose(fp);
+	return feed_count > 0 ? 0 : -1;
+}
+
+static void report(int64_t elapsed)
+{
+	const double secs = elapsed / 1e9;
+
+	printf("aprsis-sim: %.1f s, %llu connects, %llu logins, %llu disconnects by us\n",
+	       secs, (unsigned long long) st_accepts, (unsigned long long) st_logins,
+	       (unsigned long long) st_disconnects);
+	printf("  feed        %8llu lines %9llu bytes  %7.1f lines/s  %llu heartbeats\n",
+	       (unsigned long long) st_feed_lines, (unsigned long long) st_feed_bytes,
+	       st_feed_lines / secs, (unsigned long long) st_heartbeats);
+	printf("  backpressure %7llu lines not taken in time, write queue max %d bytes",
+	       (unsigned long long) st_feed_dropped, st_wrbuf_max);
+	if (opt_pieces)
+		printf(", %llu partial writes", (unsigned long long) st_partial);
+	printf("\n");
+	printf("  uplink      %8llu lines %9llu bytes  %7.1f lines/s  %llu comments\n",
+	       (unsigned long long) st_up_lines, (unsigned long long) st_up_bytes,
+	       st_up_lines / secs, (unsigned long long) st_up_comments);
+	if (st_reconn_count > 0)
+		printf("  reconnect   %8d times  latency min %.2f s  mean %.2f s  max %.2f s\n",
+		       st_reconn_count, st_reconn_min / 1e9,
+		       st_reconn_sum / 1e9 / st_reconn_count, st_reconn_max / 1e9);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in sin;
+	struct pollfd pfds[1 + SIM_CLIENTS];
+	const char *port = "14580";
+	int64_t t0, t, next_feed, next_heartbeat, next_status;
+	uint64_t up_last = 0;
+	int i, n, on = 1;
+	char line[1100];
+
+	while ((i = getopt(argc, argv, "vwP:r:f:H:s:d:t:")) != -1) {
+		switch (i) {
+		case 'v': opt_verbose = 1; break;
+		case 'w': opt_pieces = 1; break;
+		case 'P': port = optarg; break;
+		case 'r': opt_rate = atof(optarg); break;
+		case 'f':
+			if (read_feed(optarg) < 0)
+				return 1;
+			break;
+		case 'H': opt_heartbeat = atoi(optarg); break;
+		case 's':
+			if (sscanf(optarg, "%d:%d", &opt_stall_every, &opt_stall_len) != 2 ||
+			    opt_stall_len >= opt_stall_every) {
+				fprintf(stderr, "aprsis-sim: bad -s every:len '%s'\n", optarg);
+				return 1;
+			}
+			break;
+		case 'd': opt_disconnect = atoi(optarg); break;
+		case 't': opt_time = atoi(optarg); break;
+		default:
+			fprintf(stderr, "Usage:  aprsis-sim [-v] [-w] [-P port] [-r lines/s] [-f feed-file]\n"
+				"\t\t   [-H heartbeat-secs] [-s every:len] [-d secs] [-t secs]\n");
+			return 1;
+		}
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT,  sig_die);
+	signal(SIGTERM, sig_die);
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family      = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port        = htons(atoi(port));
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd >= 0)
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (listen_fd < 0 ||
+	    bind(listen_fd, (struct sockaddr *) &sin, sizeof(sin)) < 0 ||
+	    listen(listen_fd, SIM_CLIENTS) < 0) {
+		perror("aprsis-sim: listen");
+		return 1;
+	}
+	fd_nonblockingmode(listen_fd);
+	for (i = 0; i < SIM_CLIENTS; ++i)
+		clients[i].fd = -1;
+
+	t0 = now_ns();
+	next_feed      = t0;
+	next_heartbeat = t0 + opt_heartbeat * 1000000000LL;
+	next_status    = t0 + 1000000000LL;
+
+	while (!sim_die) {
+		t = now_ns();
+		if (opt_time > 0 && t - t0 >= opt_time * 1000000000LL)
+			break;
+		const int stall = stalled(t - t0);
+
+		/* The feed, at its rate, to the logged in clients */
+		if (opt_rate <= 0 || stall) {
+			next_feed = t;
+		} else {
+			while (next_feed <= t) {
+				n = feed_line(line, sizeof(line));
+				for (i = 0; i < SIM_CLIENTS; ++i)
+					if (clients[i].fd >= 0 && clients[i].login)
+						sim_queue(&clients[i], line, n);
+				++st_feed_lines;
+				st_feed_bytes += n;
+				next_feed += (int64_t) (1e9 / opt_rate);
+			}
+		}
+		if (opt_heartbeat > 0 && t >= next_heartbeat) {
+			if (!stall) {
+				time_t now = time(NULL);
+				struct tm tm;
+				char hb[100];
+				gmtime_r(&now, &tm);
+				strftime(line, sizeof(line), "%d %b %Y %H:%M:%S GMT", &tm);
+				n = snprintf(hb, sizeof(hb), "# aprsis-sim %s APRSISSIM 127.0.0.1:%s\r\n",
+					     line, port);
+				for (i = 0; i < SIM_CLIENTS; ++i)
+					if (clients[i].fd >= 0 && clients[i].login)
+						sim_queue(&clients[i], hb, n);
+				++st_heartbeats;
+			}
+			next_heartbeat = t + opt_heartbeat * 1000000000LL;
+		}
+		for (i = 0; i < SIM_CLIENTS; ++i) {
+			struct sim_client *C = &clients[i];
+			if (C->fd >= 0 && C->login && opt_disconnect > 0 &&
+			    t - C->login_ns >= opt_disconnect * 1000000000LL) {
+				++st_disconnects;
+				sim_close(C, t);
+			}
+		}
+		if (opt_verbose && t >= next_status) {
+			int pending = 0;
+			for (i = 0; i < SIM_CLIENTS; ++i)
+				if (clients[i].fd >= 0)
+					pending += clients[i].wrlen;
+			printf("t=%4d  uplink %5llu/s  feed queue %6d bytes%s\n",
+			       (int) ((t - t0) / 1000000000LL),
+			       (unsigned long long) (st_up_lines - up_last), pending,
+			       stall ? "  STALLED" : "");
+			up_last = st_up_lines;
+			next_status += 1000000000LL;
+		}
+
+		/* Nothing is read nor written while stalled */
+		n = 0;
+		pfds[n].fd     = listen_fd;
+		pfds[n].events = POLLIN;
+		++n;
+		for (i = 0; i < SIM_CLIENTS && !stall; ++i) {
+			struct sim_client *C = &clients[i];
+			if (C->fd < 0)
+				continue;
+			pfds[n].fd     = C->fd;
+			pfds[n].events = POLLIN;
+			if (C->wrlen > 0 && t >= C->next_write)
+				pfds[n].events |= POLLOUT;
+			++n;
+		}
+		if (poll(pfds, n, opt_pieces ? 1 : 10) <= 0)
+			continue;
+
+		t = now_ns();
+		if (pfds[0].revents)
+			sim_accept(t);
+		for (i = 1; i < n; ++i) {
+			struct sim_client *C = NULL;
+			int k;
+			for (k = 0; k < SIM_CLIENTS; ++k)
+				if (clients[k].fd == pfds[i].fd)
+					C = &clients[k];
+			if (C == NULL)
+				continue;
+			if (pfds[i].revents & (POLLIN | POLLERR | POLLHUP))
+				sim_read(C, t);
+			if (C->fd >= 0 && (pfds[i].revents & POLLOUT))
+				sim_write(C, t);
+		}
+	}
+	report(now_ns() - t0);
+	return 0;
+}
@@ -0,0 +1,130 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  crc-bench:  CRC-16 (SMACK), FLEXNET and CRC-CCITT engines
+ *
+ *  Checks every engine against the byte-wise one, bit for bit, on
+ *  random buffers of 0..2100 bytes at every alignment, then reports
+ *  throughput of each engine on AX.25 sized (~80 byte) and on 2 kB
+ *  buffers.  The engines that the CPU does not have are reported
+ *  as falling back.
+ *
+ *  Usage:  crc-bench
+ */
+
+#include "aprx.h"
+#include <time.h>
+
+static const char *engine_names[] = { "bytewise", "slice8", "clmul" };
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void reference(const uint8_t *buf, int len, uint16_t seed, uint16_t out[3])
+{
+	crc_set_engine(CRC_ENGINE_BYTEWISE);
+	out[0] = calc_crc_16(buf, len);
+	out[1] = calc_crc_flex(buf, len);
+	out[2] = calc_crc_ccitt(seed, buf, len);
+}
+
+static int verify(const uint8_t *pool, int engine)
+{
+	int errors = 0, i;
+
+	for (i = 0; i < 4000; ++i) {
+		const int len   = (i < 100) ? i : (random() % 2101);
+		const int align = i % 16;
+		const uint16_t seed = random();
+		uint16_t ref[3], got[3];
+
+		reference(pool + align, len, seed, ref);
+		crc_set_engine(engine);
+		got[0] = calc_crc_16(pool + align, len);
+		got[1] = calc_crc_flex(pool + align, len);
+		got[2] = calc_crc_ccitt(seed, pool + align, len);
+		if (memcmp(ref, got, sizeof(ref)) != 0) {
+			if (errors < 5)
+				printf("  MISMATCH %s len=%d align=%d: "
+				       "crc16 %04x/%04x flex %04x/%04x ccitt %04x/%04x\n",
+				       engine_names[engine], len, align,
+				       ref[0], got[0], ref[1], got[1], ref[2], got[2]);
+			++errors;
+		}
+	}
+	return errors;
+}
+
+static void measure(const uint8_t *pool, int engine, int len)
+{
+	const long total = 200L * 1000 * 1000;
+	const int  rounds = total / len;
+	volatile uint16_t sink = 0;
+	double t0, t16, tflex, tccitt;
+	int k;
+
+	crc_set_engine(engine);
+	t0 = now_ns();
+	for (k = 0; k < rounds; ++k)
+		sink ^= calc_crc_16(pool + (k & 7), len);
+	t16 = now_ns() - t0;
+	t0 = now_ns();
+	for (k = 0; k < rounds; ++k)
+		sink ^= calc_crc_flex(pool + (k & 7), len);
+	tflex = now_ns() - t0;
+	t0 = now_ns();
+	for (k = 0; k < rounds; ++k)
+		sink ^= calc_crc_ccitt(0xffff, pool + (k & 7), len);
+	tccitt = now_ns() - t0;
+
+	printf("  %-8s %5d B:  crc16 %7.1f MB/s  flex %7.1f MB/s  ccitt %7.1f MB/s\n",
+	       engine_names[engine], len,
+	       (double)rounds * len * 1e3 / t16,
+	       (double)rounds * len * 1e3 / tflex,
+	       (double)rounds * len * 1e3 / tccitt);
+	(void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t pool[4096];
+	int engine, errors = 0, i;
+
+	srandom(12345);
+	for (i = 0; i < (int)sizeof(pool); ++i)
+		pool[i] = random();
+
+	crc_init();
+	printf("crc-bench:\n");
+	for (engine = CRC_ENGINE_BYTEWISE; engine <= CRC_ENGINE_BEST; ++engine) {
+		const int got = crc_set_engine(engine);
+		if (got != engine) {
+			printf("  %-8s not available, falls back to %s\n",
+			       engine_names[engine], engine_names[got]);
+			continue;
+		}
+		if (engine != CRC_ENGINE_BYTEWISE)
+			errors += verify(pool, engine);
+	}
+	printf("  %d mismatches\n", errors);
+
+	for (engine = CRC_ENGINE_BYTEWISE; engine <= CRC_ENGINE_BEST; ++engine) {
+		if (crc_set_engine(engine) != engine)
+			continue;
+		measure(pool, engine, 80);
+		measure(pool, engine, 2048);
+	}
+	crc_set_engine(CRC_ENGINE_BEST);
+	return errors != 0;
+}
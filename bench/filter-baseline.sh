@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+#  filter-baseline.sh -- filter-bench against the filter code of an older tree
+#
+#  Exports REV of this repository into a temporary directory, builds
+#  its objects, and links bench/filter-bench.c built with
+#  -DFILTER_BENCH_BASELINE against them, so the reference is that
+#  tree's own filter_process().  Then the reference and the current
+#  bench/filter-bench are run in turns, and the best ns/packet of each,
+#  their ratio, and whether the verdicts agree are printed.
+#
+#  Usage:  filter-baseline.sh REV [runs]
+#
+#	bench/filter-baseline.sh 45de828 5
+#
+#  Run it in the build directory, bench/filter-bench is made there.
+#
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]; then
+	echo "Usage: $0 REV [runs]" 1>&2
+	exit 64
+fi
+REV="$1"
+RUNS="${2:-5}"
+CC="${CC:-gcc}"
+CFLAGS="-O2 -g -Wall -fcommon -I. -pthread"
+
+SRCDIR=$(cd "$(dirname "$0")/.." && pwd)
+CURRENT=./bench/filter-bench
+make bench/filter-bench >/dev/null || exit 1
+
+TMP=$(mktemp -d /tmp/filter-baseline.XXXXXX) || exit 1
+trap 'rm -rf "$TMP"' 0 1 2 15
+
+git -C "$SRCDIR" archive "$REV" | tar -x -C "$TMP" || exit 1
+(
+	cd "$TMP" &&
+	CFLAGS="$CFLAGS" ./configure >build.log 2>&1 &&
+	make aprx >>build.log 2>&1 &&
+	rm -f aprx.o &&
+	make aprx.o CFLAGS="$CFLAGS -Dmain=aprx_baseline_main" >>build.log 2>&1 &&
+	$CC $CFLAGS -DFILTER_BENCH_BASELINE -I. -o filter-bench-base \
+		"$SRCDIR/bench/filter-bench.c" *.o -lm -pthread >>build.log 2>&1
+) || {
+	echo "$0: building $REV failed, see below" 1>&2
+	tail -20 "$TMP/build.log" 1>&2
+	exit 1
+}
+
+best() {
+	awk '/^filter_process / { if (b == "" || $2 < b) b = $2 } END { print b }' "$1"
+}
+
+: > "$TMP/base.out"
+: > "$TMP/cur.out"
+i=0
+while [ $i -lt "$RUNS" ]; do
+	"$TMP/filter-bench-base" >> "$TMP/base.out" || exit 1
+	"$CURRENT" >> "$TMP/cur.out" || exit 1
+	i=$((i + 1))
+done
+
+B=$(best "$TMP/base.out")
+C=$(best "$TMP/cur.out")
+VB=$(grep -m1 '^verdicts' "$TMP/base.out")
+VC=$(grep -m1 '^verdicts' "$TMP/cur.out")
+
+printf "%-10s %8s ns/packet\n" "$REV" "$B"
+printf "%-10s %8s ns/packet\n" "current" "$C"
+awk -v b="$B" -v c="$C" 'BEGIN { printf("speedup    %8.2f x\n", b / c) }'
+if [ "$VB" = "$VC" ]; then
+	echo "verdicts   same"
+else
+	echo "verdicts   DIFFER"
+	echo "  $REV: $VB"
+	echo "  current: $VC"
+	exit 1
+fi
@@ -0,0 +1,311 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  filter-bench:  compiled filter program  vs.  filter chain walk
+ *
+ *  Runs a 15 clause digipeater source filter over a mix of parsed
+ *  APRS packets with both filter_process() and the uncompiled
+ *  filter_process_chain(), verifies that they agree, and reports
+ *  time per packet.  Then a position group of r/ and a/ clauses, and
+ *  b/ lists of growing length against their linear scan are timed.
+ *
+ *  Built with -DFILTER_BENCH_BASELINE it only times filter_process()
+ *  on the 15 clauses, and links to the objects of an older tree, see
+ *  filter-baseline.sh.  Both print the verdicts, to be compared.
+ *
+ *  Usage:  filter-bench [rounds]
+ */
+
+#include "aprx.h"
+#include <time.h>
+
+static const char *filters[] = {
+	"-b/N0CALL*/NOCALL*",
+	"-d/TCPIP*/TCPXX*",
+	"-t/c",
+	"-u/TEL*",
+	"r/60.17/24.94/50",
+	"r/61.50/23.76/30",
+	"r/60.45/22.27/25",
+	"a/62.0/20.0/59.0/27.0",
+	"t/m",
+	"b/OH2MQK-1/OH2MQK-2/OH2MQK-3/OH2XYZ/OH7LZB-9",
+	"p/SM/LA",
+	"s/->",
+	"o/TEST*",
+	"-p/EW",
+	"u/APRX*",
+	NULL
+};
+
+static const char *packets[] = {
+	"OH2ABC>APRS,WIDE2-1:!6010.00N/02455.00E>moving",
+	"OH1XYZ-9>APOT21,OH1RDP*,WIDE2-1:!6300.00N/02800.00E>far away",
+	"SV1ABC>APRS,WIDE2-1:!3800.00N/02340.00E-greece",
+	"OH2ABC>APRS,WIDE2-1:>status text here",
+	"OH2ABC>APRS,WIDE2-1::OH2MQK   :hello there{1",
+	"OH2ABC>APRS,WIDE2-1:T#005,199,000,255,073,123,01101001",
+	"OH2WX>APRS,WIDE2-1:_10090556c220s004g005t077r000p000P000h50b09900wRSW",
+	"OH2ABC>APRS,WIDE2-1:;TESTOBJ  *111111z6012.00N/02500.00E-object",
+	"N0CALL>APRS,WIDE2-1:!6010.00N/02455.00E>rejected",
+	"SM5ABC>APRS,WIDE1-1:!5920.00N/01800.00E>sweden",
+	"OH2ABC>TELEM,WIDE2-1:just text",
+	"OH3ABC>APRS,WIDE2-2:!6130.00N/02345.00E#digi",
+	"OH2ABC>APRX29,WIDE2-1:!6010.00N/02455.00E#aprx",
+	"EW1ABC>APRS,WIDE2-1:<IGATE,MSG_CNT=0",
+	"OH2ABC>APRS,WIDE2-1:?APRS?",
+	"OH5XYZ>APRS,WIDE2-1:=6200.00N/02700.00E-home",
+	NULL
+};
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct pbuf_t *make_pbuf(const char *p)
+{
+	const char *c = strchr(p, ':');
+	struct pbuf_t *pb = pbuf_new(1, 1, c - p, p, strlen(p), 0, "", 0);
+	if (pb != NULL)
+		parse_aprs(pb, NULL);
+	return pb;
+}
+
+#ifndef FILTER_BENCH_BASELINE
+/*
+ *  The position clauses alone, the program tests them in one op.
+ */
+static int bench_posgroup(struct pbuf_t **pbs, const int npb, const int rounds)
+{
+	static const char *pos[] = {
+		"r/60.17/24.94/50", "r/61.50/23.76/30", "r/60.45/22.27/25",
+		"a/62.0/20.0/59.0/27.0", "r/40.00/20.00/-100", "A/45.0/10.0/44.0/11.0",
+		NULL
+	};
+	struct filter_t *f = NULL;
+	int i, n, r, sink = 0, errors = 0;
+	double t0, t_chain, t_prog;
+
+	for (n = 0; pos[n]; ++n)
+		filter_parse(&f, pos[n]);
+	for (i = 0; i < npb; ++i)
+		if (filter_process(pbs[i], f, NULL) != filter_process_chain(pbs[i], f, NULL))
+			++errors;
+
+	t0 = now_ns();
+	for (r = 0; r < rounds; ++r)
+		for (i = 0; i < npb; ++i)
+			sink += filter_process_chain(pbs[i], f, NULL);
+	t_chain = now_ns() - t0;
+
+	t0 = now_ns();
+	for (r = 0; r < rounds; ++r)
+		for (i = 0; i < npb; ++i)
+			sink += filter_process(pbs[i], f, NULL);
+	t_prog = now_ns() - t0;
+
+	printf("position group %d clauses  chain %6.1f  program %6.1f ns/packet   [%d]%s\n",
+	       n, t_chain / ((double)rounds * npb), t_prog / ((double)rounds * npb),
+	       sink & 1, errors ? "  MISMATCH" : "");
+	filter_free(f);
+	return errors;
+}
+
+static unsigned int bench_seed = 1;
+
+static unsigned int bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return (bench_seed >> 16) & 0x7FFF;
+}
+
+/* A random callsign, maybe with a SSID */
+static int bench_call(char *buf)
+{
+	static const char *pfx[] = { "OH", "SM", "LA", "DL", "G", "K", "N0", "EW" };
+	int n = sprintf(buf, "%s%d", pfx[bench_rand() % 8], bench_rand() % 10);
+	int i, m = 1 + bench_rand() % 3;
+
+	for (i = 0; i < m; ++i)
+		buf[n++] = 'A' + bench_rand() % 26;
+	if (bench_rand() % 2)
+		n += sprintf(buf+n, "-%d", 1 + bench_rand() % 15);
+	buf[n] = 0;
+	return n;
+}
+
+static void bench_lowercase(char *s)
+{
+	for ( ; *s; ++s)
+		if ('A' <= *s && *s <= 'Z' && bench_rand() % 2)
+			*s += 'a' - 'A';
+}
+
+/*
+ *  b/ list of 'count' random entries: exact callsigns, some of them
+ *  in mixed case, and prefixes with a * wild-card.  The same list
+ *  with filter_uncompile() is the linear scan reference.  Packets
+ *  are from members, in mixed case, and from others.
+ *  Lookup cost should not depend on the count.
+ */
+static int bench_budlist(const int count, const int rounds)
+{
+	struct filter_t *f = NULL, *g = NULL;
+	struct pbuf_t *pbs[64];
+	static char calls[1000][16];
+	char buf[400], pkt[100];
+	int i, r, n, npb = 0, sink = 0, errors = 0;
+	double t0, t_scan, t_set;
+
+	bench_seed = count;
+	for (i = 0; i < count && i < 1000; ) {
+		n = sprintf(buf, "b");
+		for (r = 0; r < 20 && i < count; ++r, ++i) {
+			const int kind = bench_rand() % 10;
+			const int len  = bench_call(calls[i]);
+			if (kind < 1) {
+				const int cut = 4 + bench_rand() % 2;
+				calls[i][cut < len ? cut : len-1] = 0;
+				n += sprintf(buf+n, "/%s*", calls[i]);
+			} else {
+				if (kind < 3)
+					bench_lowercase(calls[i]);
+				n += sprintf(buf+n, "/%s", calls[i]);
+			}
+		}
+		filter_parse(&f, buf);
+		filter_parse(&g, buf);
+	}
+	filter_uncompile(g);
+
+	for (i = 0; i < 64; ++i) {
+		char call[16];
+		if (i % 2) {
+			bench_call(call);
+		} else {
+			/* a member, a wild-card one gets some tail */
+			strcpy(call, calls[bench_rand() % count]);
+			if (strlen(call) < 5)
+				strcat(call, "XY-7");
+		}
+		bench_lowercase(call);
+		sprintf(pkt, "%s>APRS:>budlist", call);
+		if ((pbs[npb] = make_pbuf(pkt)) != NULL)
+			++npb;
+	}
+
+	for (i = 0; i < npb; ++i)
+		if (filter_process(pbs[i], f, NULL) != filter_process(pbs[i], g, NULL))
+			++errors;
+
+	t0 = now_ns();
+	for (r = 0; r < rounds; ++r)
+		for (i = 0; i < npb; ++i)
+			sink += filter_process(pbs[i], g, NULL);
+	t_scan = now_ns() - t0;
+
+	t0 = now_ns();
+	for (r = 0; r < rounds; ++r)
+		for (i = 0; i < npb; ++i)
+			sink += filter_process(pbs[i], f, NULL);
+	t_set = now_ns() - t0;
+
+	printf("budlist %5d calls  linear %8.1f  callset %6.1f ns/packet   [%d]%s\n", count,
+	       t_scan / ((double)rounds * npb), t_set / ((double)rounds * npb),
+	       sink & 1, errors ? "  MISMATCH" : "");
+
+	for (i = 0; i < npb; ++i)
+		pbuf_put(pbs[i]);
+	filter_free(f);
+	filter_free(g);
+	return errors;
+}
+#endif /* FILTER_BENCH_BASELINE */
+
+int main(int argc, char *argv[])
+{
+	struct filter_t *f = NULL;
+	struct pbuf_t *pbs[64];
+	int npb = 0, i, r, rounds = 200000;
+	int sink = 0, mismatch = 0;
+	double t0, t_chain, t_prog;
+
+	if (argc > 1)
+		rounds = atoi(argv[1]);
+
+	timetick();
+	filter_init();
+	pbuf_init();
+#ifndef DISABLE_IGATE
+	historydb_init();
+#endif
+
+	for (i = 0; filters[i]; ++i) {
+		if (filter_parse(&f, filters[i])) {
+			fprintf(stderr, "filter parse failed: %s\n", filters[i]);
+			return 1;
+		}
+	}
+	for (i = 0; packets[i]; ++i) {
+		struct pbuf_t *pb = make_pbuf(packets[i]);
+		if (pb != NULL)
+			pbs[npb++] = pb;
+	}
+
+	printf("verdicts            ");
+	for (i = 0; i < npb; ++i)
+		printf(" %d", filter_process(pbs[i], f, NULL));
+	printf("\n");
+
+#ifndef FILTER_BENCH_BASELINE
+	for (i = 0; i < npb; ++i) {
+		int a = filter_process_chain(pbs[i], f, NULL);
+		int b = filter_process(pbs[i], f, NULL);
+		if (a != b) {
+			printf("MISMATCH chain=%d prog=%d  %s\n", a, b, pbs[i]->data);
+			++mismatch;
+		}
+	}
+
+	t0 = now_ns();
+	for (r = 0; r < rounds; ++r)
+		for (i = 0; i < npb; ++i)
+			sink += filter_process_chain(pbs[i], f, NULL);
+	t_chain = now_ns() - t0;
+#endif
+
+	t0 = now_ns();
+	for (r = 0; r < rounds; ++r)
+		for (i = 0; i < npb; ++i)
+			sink += filter_process(pbs[i], f, NULL);
+	t_prog = now_ns() - t0;
+
+	printf("filter-bench clauses=%d packets=%d rounds=%d mismatches=%d\n",
+	       (int)(sizeof(filters)/sizeof(filters[0]) - 1), npb, rounds, mismatch);
+#ifndef FILTER_BENCH_BASELINE
+	printf("filter_process_chain %8.1f ns/packet\n", t_chain / ((double)rounds * npb));
+#endif
+	printf("filter_process       %8.1f ns/packet\n", t_prog  / ((double)rounds * npb));
+#ifndef FILTER_BENCH_BASELINE
+	printf("speedup              %8.2f x   [%d]\n", t_chain / t_prog, sink & 1);
+
+	mismatch += bench_posgroup(pbs, npb, rounds);
+	mismatch += bench_budlist(10,   rounds / 16);
+	mismatch += bench_budlist(100,  rounds / 16);
+	mismatch += bench_budlist(1000, rounds / 64);
+#else
+	printf("                              [%d]\n", sink & 1);
+#endif
+
+	return mismatch ? 1 : 0;
+}
@@ -0,0 +1,333 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  kiss-bench:  KISS deframer throughput
+ *
+ *  Builds a KISS byte stream of APRS frames (with escaped FEND and
+ *  FESC bytes, doubled and shared FENDs, and a bit of line noise),
+ *  or reads a recorded one from a file, and feeds it in read() sized
+ *  chunks to kiss_deframe() and to the previous byte-at-a-time
+ *  deframer.  Verifies that both deliver the same frames, and
+ *  reports MB/s.
+ *
+ *  First it sends frames through kiss_kisswrite() and back in with
+ *  kiss_pullkiss() on KISS, SMACK and FLEXNET lines, on TNC ids 0
+ *  and above, and checks that each one arrives on its own port.
+ *
+ *  Usage:  kiss-bench [recorded-kiss-stream-file]
+ */
+
+#include "aprx.h"
+#include <time.h>
+
+static const char *packets[] = {
+	"OH2ABC>APRS,WIDE2-1:!6010.00N/02455.00E>moving along",
+	"OH1XYZ-9>APOT21,OH1RDP*,WIDE2-1:!6300.00N/02800.00E>far away",
+	"OH2WX>APRS,WIDE2-1:_10090556c220s004g005t077r000p000P000h50b09900wRSW",
+	"OH2ABC>APRS,WIDE2-1::OH2MQK   :hello there{1",
+	"OH3ABC>APRS,WIDE2-2:!6130.00N/02345.00E#digi \300\333 escapes \333\334",
+	"OH5XYZ>APRS,WIDE1-1,WIDE2-1:=6200.00N/02700.00E-home",
+	NULL
+};
+
+static uint32_t frames_seen, frames_sum;
+
+static int count_frame(struct serialport *S)
+{
+	int i;
+	uint32_t h = S->rdlinelen;
+	for (i = 0; i < S->rdlinelen; ++i)
+		h = h * 31 + S->rdline[i];
+	frames_seen += 1;
+	frames_sum  += h;
+	return 0;
+}
+
+/* The previous per-byte deframer, for reference */
+static int ref_getc(struct serialport *S)
+{
+	if (S->rdcursor >= S->rdlen)
+		return -1;
+	return S->rdbuf[S->rdcursor++];
+}
+
+static void ref_deframe(struct serialport *S)
+{
+	int c;
+
+	if (S->kissstate == KISSSTATE_SYNCHUNT) {
+		for (;;) {
+			c = ref_getc(S);
+			if (c < 0)
+				return;
+			if (c == KISS_FEND)
+				break;
+		}
+		S->kissstate = KISSSTATE_COLLECTING;
+	}
+	for (;;) {
+		c = ref_getc(S);
+		if (c < 0)
+			return;
+		if (c == KISS_FEND) {
+			if (S->rdlinelen > 0) {
+				count_frame(S);
+				S->kissstate = KISSSTATE_COLLECTING;
+				S->rdlinelen = 0;
+			}
+			continue;
+		}
+		if (S->kissstate == KISSSTATE_KISSFESC) {
+			S->kissstate = KISSSTATE_COLLECTING;
+			if (c == KISS_TFEND)
+				c = KISS_FEND;
+			else if (c == KISS_TFESC)
+				c = KISS_FESC;
+			else
+				continue;
+		} else if (c == KISS_FESC) {
+			S->kissstate = KISSSTATE_KISSFESC;
+			continue;
+		}
+		if (S->rdlinelen >= (sizeof(S->rdline) - 3)) {
+			S->kissstate = KISSSTATE_SYNCHUNT;
+			S->rdlinelen = 0;
+			continue;
+		}
+		S->rdline[S->rdlinelen++] = c;
+	}
+}
+
+static int kiss_escape(uint8_t *d, const uint8_t *s, int len)
+{
+	uint8_t *d0 = d;
+	for (; len > 0; --len, ++s) {
+		if (*s == KISS_FEND) {
+			*d++ = KISS_FESC; *d++ = KISS_TFEND;
+		} else if (*s == KISS_FESC) {
+			*d++ = KISS_FESC; *d++ = KISS_TFESC;
+		} else
+			*d++ = *s;
+	}
+	return d - d0;
+}
+
+/* AX.25 frame out of a TNC2 line, only what this test needs */
+static int make_ax25(uint8_t *ax, const char *tnc2)
+{
+	char hdr[200], *src, *dst, *via, *rest;
+	const char *c = strchr(tnc2, ':');
+	int n;
+
+	memcpy(hdr, tnc2, c - tnc2);
+	hdr[c - tnc2] = 0;
+	src  = strtok(hdr, ">");
+	rest = strtok(NULL, "");
+	dst  = strtok(rest, ",");
+	parse_ax25addr(ax + 7, src, 0x60);
+	parse_ax25addr(ax,     dst, 0xE0);
+	n = 14;
+	while ((via = strtok(NULL, ",")) != NULL) {
+		parse_ax25addr(ax + n, via, 0x60);
+		n += 7;
+	}
+	ax[n-1] |= 0x01;
+	ax[n++] = 0x03;
+	ax[n++] = 0xF0;
+	memcpy(ax + n, c + 1, strlen(c + 1));
+	return n + strlen(c + 1);
+}
+
+static uint8_t *make_stream(int *lenp, int nframes)
+{
+	uint8_t *buf = malloc(nframes * 600 + 16);
+	uint8_t  ax[400];
+	int i, n = 0;
+
+	for (i = 0; i < nframes; ++i) {
+		int axlen = make_ax25(ax + 1, packets[i % 6]);
+		ax[0] = (i % 3) << 4; // multiport tncid, cmd 0
+		if (i % 7 != 3)
+			buf[n++] = KISS_FEND; // some frames share the flag
+		if (i % 11 == 5)
+			buf[n++] = KISS_FEND; // extra FEND fill
+		n += kiss_escape(buf + n, ax, axlen + 1);
+		buf[n++] = KISS_FEND;
+		if (i % 97 == 50) {
+			// line noise before the next FEND
+			memcpy(buf + n, "\001\002garbage", 9);
+			n += 9;
+		}
+	}
+	*lenp = n;
+	return buf;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double run(const uint8_t *stream, int len, int chunk, int rounds, int ref,
+		  uint32_t *nframes, uint32_t *sum)
+{
+	static struct serialport S;
+	double t0;
+	int k, off;
+
+	frames_seen = frames_sum = 0;
+	t0 = now_ns();
+	for (k = 0; k < rounds; ++k) {
+		memset(&S, 0, sizeof(S));
+		S.ttyname = "bench";
+		for (off = 0; off < len; off += chunk) {
+			int n = (len - off < chunk) ? len - off : chunk;
+			memcpy(S.rdbuf, stream + off, n);
+			S.rdlen = n;
+			S.rdcursor = 0;
+			if (ref)
+				ref_deframe(&S);
+			else
+				kiss_deframe(&S, count_frame);
+		}
+	}
+	*nframes = frames_seen;
+	*sum     = frames_sum;
+	return now_ns() - t0;
+}
+
+/*
+ *  Encode a frame with kiss_kisswrite() into a pipe, and decode what
+ *  comes out with kiss_pullkiss().  A frame that gets through is
+ *  Rx-igated, and so it lands in the rflog, with the port name that
+ *  the decoder picked from the TNC id.  (BPQCRC is not here, aprx
+ *  does not add the XOR byte when it sends.)
+ */
+static int roundtrip(void)
+{
+	static const LineType linetypes[] = { LINETYPE_KISS, LINETYPE_KISSSMACK, LINETYPE_KISSFLEXNET };
+	static const char *lt_names[] = { "kiss", "smack", "flexnet" };
+	static const int tncids[] = { 0, 1, 4 };
+	static struct serialport T, R;
+	static char portnames[3][3][16];
+	char logname[] = "/tmp/kiss-bench.XXXXXX";
+	char line[400];
+	const char *packet = packets[0];
+	uint8_t ax[400];
+	int axlen, fds[2], l, t, n, bad = 0, fd;
+	FILE *fp;
+
+	fd = mkstemp(logname);
+	if (fd < 0 || pipe(fds) < 0) {
+		perror("kiss-bench roundtrip");
+		return 1;
+	}
+	close(fd);
+	rflogfile = logname;
+	axlen = make_ax25(ax, packet);
+
+	for (l = 0; l < 3; ++l) {
+		for (t = 0; t < 3; ++t) {
+			const int tncid = tncids[t];
+			char *portname = portnames[l][t];
+
+			sprintf(portname, "RT-%s-%d", lt_names[l], tncid);
+			memset(&T, 0, sizeof(T));
+			T.ttyname  = "roundtrip";
+			T.fd       = fds[1];
+			T.linetype = linetypes[l];
+			T.smack_subids = 0xFF;
+			T.ttycallsign[tncid] = portname;
+			kiss_kisswrite(&T, tncid, ax, axlen);
+			ttyreader_txq_purge(&T);
+
+			memset(&R, 0, sizeof(R));
+			R.ttyname  = "roundtrip";
+			R.fd       = -1;
+			R.linetype = linetypes[l];
+			R.ttycallsign[tncid] = portname;
+			n = read(fds[0], R.rdbuf, sizeof(R.rdbuf));
+			R.rdlen = n > 0 ? n : 0;
+			kiss_pullkiss(&R);
+		}
+	}
+	close(fds[0]);
+	close(fds[1]);
+	rflogfile = NULL;
+
+	// Every port has the packet once in the rflog
+	fp = fopen(logname, "r");
+	if (fp == NULL) {
+		perror(logname);
+		return 1;
+	}
+	for (l = 0; l < 3; ++l) {
+		for (t = 0; t < 3; ++t) {
+			int found = 0;
+			rewind(fp);
+			while (fgets(line, sizeof(line), fp) != NULL) {
+				char *p = strstr(line, portnames[l][t]);
+				if (p != NULL && p[strlen(portnames[l][t])] == ' ' &&
+				    strstr(p, packet) != NULL)
+					++found;
+			}
+			if (found != 1) {
+				printf("roundtrip %-7s tncid %d: frame arrived %d times [MISMATCH]\n",
+				       lt_names[l], tncids[t], found);
+				++bad;
+			}
+		}
+	}
+	fclose(fp);
+	unlink(logname);
+	printf("roundtrip kiss, smack, flexnet on tncid 0, 1, 4: %d of 9 frames %s\n",
+	       9 - bad, bad ? "[MISMATCH]" : "[ok]");
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	static const int chunks[] = { 64, 512, 2000 };
+	uint8_t *stream;
+	int len, i, rounds = 50, bad;
+
+	bad = roundtrip();
+
+	if (argc > 1) {
+		FILE *fp = fopen(argv[1], "r");
+		if (fp == NULL) {
+			perror(argv[1]);
+			return 1;
+		}
+		stream = malloc(16*1024*1024);
+		len = fread(stream, 1, 16*1024*1024, fp);
+		fclose(fp);
+		rounds = 5;
+	} else {
+		stream = make_stream(&len, 20000);
+	}
+
+	for (i = 0; i < 3; ++i) {
+		uint32_t n1, s1, n2, s2;
+		double t_ref = run(stream, len, chunks[i], rounds, 1, &n1, &s1);
+		double t_new = run(stream, len, chunks[i], rounds, 0, &n2, &s2);
+		int ok = (n1 == n2 && s1 == s2);
+		if (!ok) ++bad;
+		printf("chunk %4d   per-byte %7.1f MB/s   kiss_deframe %7.1f MB/s   (%.1fx)  frames %u/%u %s\n",
+		       chunks[i],
+		       (double)len * rounds / t_ref * 1e3,
+		       (double)len * rounds / t_new * 1e3,
+		       t_ref / t_new, n1 / rounds, n2 / rounds, ok ? "[ok]" : "[MISMATCH]");
+	}
+	free(stream);
+	return bad;
+}
@@ -0,0 +1,691 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  micro-bench:  ns/op of the per-packet building blocks
+ *
+ *	keyhash, keyhashuc	callsigns, and whole TNC2 packets
+ *	dupecheck_pbuf		hits, and new records in steady state,
+ *				at growing numbers of live records
+ *	historydb		insert of new and of known stations,
+ *				lookup hits and misses, at growing sizes
+ *	parse_aprs		Mic-E, compressed, uncompressed, objects,
+ *				items, messages, status and weather
+ *	filter_process		range, b/ list, and a digipeater list
+ *	cellmalloc, cellfree	both arena policies, and malloc()
+ *
+ *  Each case runs for about -t milliseconds, -r times, and the median
+ *  and the best run are reported, one case per line, tab separated:
+ *
+ *	# micro-bench machine=x86_64 cpu="..." ms=200 runs=5
+ *	name                    size  ns/op  best-ns/op  ops
+ *
+ *  or with -j as JSON.  The size is the table size or the corpus
+ *  entries the case runs over.  Arguments select the cases whose
+ *  name contains one of them.  micro-compare.sh puts two result
+ *  files side by side.
+ *
+ *  Exits nonzero when a corpus packet does not parse as it should.
+ *
+ *  Usage:  micro-bench [-j] [-t ms] [-r runs] [case ...]
+ */
+
+#include "aprx.h"
+#include <time.h>
+#include <sys/utsname.h>
+
+typedef void (*bench_fn)(void *arg, uint64_t ops);
+typedef void (*reset_fn)(void *arg);
+
+static int      opt_json, opt_ms = 50, opt_runs = 3;
+static char   **selection;
+static int      selections, results;
+static volatile uint64_t sink;
+
+static const struct sample {
+	const char *kind;
+	const char *tnc2;
+	int         type;	/* T_* bits that parse_aprs() must set */
+} corpus[] = {
+	{ "mic-e",        "OH2ABC-9>SU2PQX,WIDE1-1:`c0_l!>[/`\"4T}_%",          T_POSITION },
+	{ "mic-e",        "OH7LZB-9>T4SP0W,OH7RDA*,WIDE2-1:`oPLlO@>/]\"4N}=",   T_POSITION },
+	{ "mic-e",        "OH3XYZ-7>SX3U9Y,WIDE1-1,WIDE2-1:'l*p!sxk/]=",         T_POSITION },
+	{ "compressed",   "OH2ABC>APRS,WIDE2-1:=/5L!!<*e7>7P[",                  T_POSITION },
+	{ "compressed",   "OH5ABC-1>APRX29,TCPIP*:!/;IRY/-a7#  G/A=000100",       T_POSITION },
+	{ "compressed",   "OH1ABC-5>APDR13,WIDE1-1:=/:x]DPjnfk_\"G",              T_POSITION },
+	{ "uncompressed", "OH2ABC>APRS,WIDE2-1:!6010.00N/02455.00E>moving",      T_POSITION },
+	{ "uncompressed", "OH5XYZ>APOT21,OH5RUU*,WIDE2-1:=6200.00N/02700.00E-PHG2360 home", T_POSITION },
+	{ "uncompressed", "OH2WX>APRS:@092345z6010.00N/02455.00E_090/000g000t041r000p000P000h85b10020", T_POSITION | T_WX },
+	{ "object",       "OH2ABC>APRS,WIDE2-1:;LEADER   *092345z4903.50N/07201.75W>088/036", T_OBJECT },
+	{ "object",       "OH7RDA>APRX28:;OH7RDB-1 *111111z6253.63N/02740.09Er145.625MHz T123 -060", T_OBJECT },
+	{ "item",         "OH2ABC>APRS:)AID #2!4903.50N/07201.75WA",            T_ITEM },
+	{ "message",      "OH2ABC>APRS,WIDE2-1::OH2MQK   :hello there{1",        T_MESSAGE },
+	{ "message",      "OH2MQK>APRX29::OH2ABC   :ack1",                        T_MESSAGE },
+	{ "message",      "OH2ABC-7>APRS::BLN1     :net tonight 2100",            T_MESSAGE },
+	{ "status",       "OH2ABC>APRS,WIDE2-1:>status text here",                T_STATUS },
+	{ "weather",      "OH2WX>APRS,WIDE2-1:_10090556c220s004g005t077r000p000P000h50b09900wRSW", T_WX },
+	{ NULL, NULL, 0 }
+};
+
+static const char *digi_filters[] = {
+	"-b/N0CALL*/NOCALL*",
+	"-d/TCPIP*/TCPXX*",
+	"-t/c",
+	"-u/TEL*",
+	"r/60.17/24.94/50",
+	"r/61.50/23.76/30",
+	"r/60.45/22.27/25",
+	"a/62.0/20.0/59.0/27.0",
+	"t/m",
+	"b/OH2MQK-1/OH2MQK-2/OH2MQK-3/OH2XYZ/OH7LZB-9",
+	"p/SM/LA",
+	"s/->",
+	"o/TEST*",
+	"-p/EW",
+	"u/APRX*",
+	NULL
+};
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int selected(const char *name)
+{
+	int i;
+
+	if (selections == 0)
+		return 1;
+	for (i = 0; i < selections; ++i)
+		if (strstr(name, selection[i]) != NULL)
+			return 1;
+	return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	const double x = *(const double *) a, y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+static void header(void)
+{
+	struct utsname u;
+	char line[256], cpu[128] = "unknown", *v;
+	FILE *fp = fopen("/proc/cpuinfo", "r");
+
+	/* x86 has "model name", a Raspberry Pi "Model" */
+	while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+		if ((strncmp(line, "model name", 10) == 0 ||
+		     strncmp(line, "Model", 5) == 0) &&
+		    (v = strchr(line, ':')) != NULL) {
+			for (++v; *v == ' ' || *v == '\t'; ++v)
+				;
+			v[strcspn(v, "\n")] = 0;
+			snprintf(cpu, sizeof(cpu), "%s", v);
+		}
+	}
+	if (fp != NULL)
+		fclose(fp);
+	if (uname(&u) < 0)
+		strcpy(u.machine, "unknown");
+
+	if (opt_json)
+		printf("{\"machine\": \"%s\", \"cpu\": \"%s\", \"ms\": %d, \"runs\": %d,\n"
+		       " \"results\": [", u.machine, cpu, opt_ms, opt_runs);
+	else
+		printf("# micro-bench machine=%s cpu=\"%s\" ms=%d runs=%d\n"
+		       "# name\tsize\tns/op\tbest-ns/op\tops\n",
+		       u.machine, cpu, opt_ms, opt_runs);
+}
+
+static void result(const char *name, int size, double ns, double best, uint64_t ops)
+{
+	if (opt_json)
+		printf("%s\n  {\"name\": \"%s\", \"size\": %d, \"ns_op\": %.2f, \"best_ns_op\": %.2f, \"ops\": %llu}",
+		       results ? "," : "", name, size, ns, best, (unsigned long long) ops);
+	else
+		printf("%-24s\t%d\t%.2f\t%.2f\t%llu\n",
+		       name, size, ns, best, (unsigned long long) ops);
+	++results;
+}
+
+/*
+ *  measure()  -- time 'fn' over the runs, each about opt_ms long.
+ *
+ *  With 'fixed' the runs are 'fixed' ops each, and 'reset' is
+ *  called before each run, outside of the timing.  Then there are
+ *  more runs, up to 100, until they add up to opt_ms.
+ */
+static void measure(const char *name, int size, bench_fn fn, reset_fn reset,
+		    void *arg, uint64_t fixed)
+{
+	double ns[100], t0, t, spent = 0;
+	uint64_t ops = fixed ? fixed : 1, total = 0;
+	int runs = opt_runs > 100 ? 100 : opt_runs, i;
+
+	if (!selected(name))
+		return;
+
+	if (!fixed) {
+		/* Calibrate to a run of about opt_ms */
+		for (;;) {
+			t0 = now_ns();
+			fn(arg, ops);
+			t = now_ns() - t0;
+			if (t >= opt_ms * 1e6 / 8 || ops >= (1ULL << 40))
+				break;
+			ops *= 2;
+		}
+		ops = (uint64_t) (ops * (opt_ms * 1e6 / (t > 1 ? t : 1)));
+		if (ops < 1)
+			ops = 1;
+	}
+	for (i = 0; i < runs || (fixed && i < 100 && spent < opt_ms * 1e6); ++i) {
+		if (reset)
+			reset(arg);
+		t0 = now_ns();
+		fn(arg, ops);
+		t = now_ns() - t0;
+		ns[i]  = t / ops;
+		spent += t;
+		total += ops;
+	}
+	runs = i;
+	qsort(ns, runs, sizeof(ns[0]), cmp_double);
+	result(name, size, ns[runs / 2], ns[0], total);
+}
+
+static struct pbuf_t *make_pbuf(const char *p)
+{
+	const char *c = strchr(p, ':');
+	struct pbuf_t *pb = pbuf_new(1, 1, c - p, p, strlen(p), 0, "", 0);
+	if (pb != NULL)
+		parse_aprs(pb, NULL);
+	return pb;
+}
+
+/* Callsign of station 'i', 'c' tells one set of them from another */
+static char *station_call(int i, int c)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "OH%d%c%02d-%d", i % 10, c, (i / 10) % 100, 1 + (i / 1000) % 15);
+	return strdup(buf);
+}
+
+/* A position packet of station 'i' */
+static struct pbuf_t *station_pbuf(int i)
+{
+	char buf[200], *call = station_call(i, 'X');
+
+	snprintf(buf, sizeof(buf), "%s>APRS,WIDE1-1:!60%02d.%02dN/024%02d.%02dE-micro-bench",
+		 call, i % 60, i % 100, (i / 60) % 60, (i / 7) % 100);
+	free(call);
+	return make_pbuf(buf);
+}
+
+/* ---------------------------------------------------------------- */
+
+struct keys {
+	char **s;
+	int   *len;
+	int    count;
+	unsigned int (*hash)(const void *, int, unsigned int);
+};
+
+static void keys_run(void *arg, uint64_t ops)
+{
+	struct keys *K = arg;
+	unsigned int h = 0;
+	uint64_t i;
+
+	for (i = 0; i < ops; ++i) {
+		const int k = i % K->count;
+		h ^= K->hash(K->s[k], K->len[k], 0);
+	}
+	sink += h;
+}
+
+static void bench_keyhash(void)
+{
+	struct keys K;
+	char buf[32];
+	int i, n;
+
+	K.count = 1024;
+	K.s   = calloc(K.count, sizeof(char *));
+	K.len = calloc(K.count, sizeof(int));
+	for (i = 0; i < K.count; ++i) {
+		if (i % 2)
+			snprintf(buf, sizeof(buf), "OH%dX%02d-%d", i % 10, (i / 10) % 100, i % 16);
+		else
+			snprintf(buf, sizeof(buf), "oh%dx%02d", i % 10, (i / 10) % 100);
+		K.s[i]   = strdup(buf);
+		K.len[i] = strlen(buf);
+	}
+	K.hash = keyhash;
+	measure("keyhash callsign", K.count, keys_run, NULL, &K, 0);
+	K.hash = keyhashuc;
+	measure("keyhashuc callsign", K.count, keys_run, NULL, &K, 0);
+
+	for (n = 0; corpus[n].tnc2; ++n) {
+		K.s[n]   = (char *) corpus[n].tnc2;
+		K.len[n] = strlen(corpus[n].tnc2);
+	}
+	K.count = n;
+	K.hash = keyhash;
+	measure("keyhash packet", K.count, keys_run, NULL, &K, 0);
+	K.hash = keyhashuc;
+	measure("keyhashuc packet", K.count, keys_run, NULL, &K, 0);
+}
+
+/* ---------------------------------------------------------------- */
+
+/*
+ *  The pbuf arena holds some 280 packets, so the tables are filled
+ *  one packet at a time, and the timed loops run over a pool of
+ *  POOL packets.
+ */
+#define POOL 128
+
+struct dupes {
+	dupecheck_t    *dpc;
+	struct pbuf_t  *pool[POOL];
+	int             pooled, count;
+	uint64_t        nomem;
+};
+
+/* Expire every record of every dupechecker */
+static void dupes_flush(void)
+{
+	struct aprxpolls app = APRXPOLLS_INIT;
+
+	tick.tv_sec += 100000;
+	dupecheck_postpoll(&app);
+}
+
+/* Records of stations from..to, without their pbufs like a direct digi */
+static void dupes_fill(struct dupes *D, int from, int to)
+{
+	dupe_record_t *dp;
+	struct pbuf_t *pb;
+	int i;
+
+	for (i = from; i < to; ++i) {
+		if ((pb = station_pbuf(i)) == NULL)
+			continue;
+		if ((dp = dupecheck_pbuf(D->dpc, pb, 0)) == NULL)
+			++D->nomem;
+		else if (dp->pbuf != NULL) {
+			pbuf_put(dp->pbuf);
+			dp->pbuf = NULL;
+		}
+		pbuf_put(pb);
+	}
+}
+
+static void dupes_run(void *arg, uint64_t ops)
+{
+	struct dupes *D = arg;
+	uint64_t i;
+
+	for (i = 0; i < ops; ++i)
+		if (dupecheck_pbuf(D->dpc, D->pool[i % D->pooled], 0) == NULL)
+			++D->nomem;
+}
+
+/* All but the pool in the table, the pool goes in timed */
+static void dupes_reset(void *arg)
+{
+	struct dupes *D = arg;
+
+	dupes_flush();
+	dupes_fill(D, D->pooled, D->count);
+}
+
+static void bench_dupecheck(void)
+{
+	static const int sizes[] = { 16, 128, 384 };
+	struct dupes D;
+	int s, i;
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		memset(&D, 0, sizeof(D));
+		D.count  = sizes[s];
+		D.pooled = D.count < POOL ? D.count : POOL;
+		for (i = 0; i < D.pooled; ++i)
+			D.pool[i] = station_pbuf(i);
+
+		D.dpc = dupecheck_new(3600);
+		measure("dupecheck_pbuf new", D.count, dupes_run, dupes_reset, &D, D.pooled);
+		measure("dupecheck_pbuf hit", D.count, dupes_run, NULL, &D, 0);
+		dupes_flush();
+
+		if (D.nomem > 0)
+			fprintf(stderr, "micro-bench: dupecheck %d: %llu records did not fit\n",
+				D.count, (unsigned long long) D.nomem);
+		for (i = 0; i < D.pooled; ++i)
+			pbuf_put(D.pool[i]);
+	}
+}
+
+/* ---------------------------------------------------------------- */
+
+struct history {
+	historydb_t    *db;
+	struct pbuf_t  *pool[POOL];
+	int             pooled, count;
+	char          **keys;	/* the stations, then as many others */
+	int            *keylen;
+	uint64_t        nomem;
+};
+
+static void history_fill(struct history *H, int from, int to)
+{
+	struct pbuf_t *pb;
+	int i;
+
+	for (i = from; i < to; ++i) {
+		if ((pb = station_pbuf(i)) == NULL)
+			continue;
+		if (historydb_insert_(H->db, pb, 1) == NULL)
+			++H->nomem;
+		pbuf_put(pb);
+	}
+}
+
+static void history_insert(void *arg, uint64_t ops)
+{
+	struct history *H = arg;
+	uint64_t i;
+
+	for (i = 0; i < ops; ++i)
+		sink += historydb_insert_(H->db, H->pool[i % H->pooled], 1) != NULL;
+}
+
+/* All but the pool in the table, the pool goes in timed */
+static void history_reset(void *arg)
+{
+	struct history *H = arg;
+
+	historydb_atend();
+	memset(H->db->hash, 0, sizeof(H->db->hash));
+	history_fill(H, H->pooled, H->count);
+}
+
+static uint64_t history_lookups(struct history *H, int first, uint64_t ops)
+{
+	uint64_t i, found = 0;
+
+	for (i = 0; i < ops; ++i) {
+		const int k = first + i % H->count;
+		found += historydb_lookup(H->db, H->keys[k], H->keylen[k]) != NULL;
+	}
+	return found;
+}
+
+static void history_lookup_hit(void *arg, uint64_t ops)
+{
+	sink += history_lookups(arg, 0, ops);
+}
+
+static void history_lookup_miss(void *arg, uint64_t ops)
+{
+	struct history *H = arg;
+	sink += history_lookups(H, H->count, ops);
+}
+
+static int bench_historydb(void)
+{
+	static const int sizes[] = { 128, 1024, 3072 };
+	struct history H;
+	int s, i, errors = 0;
+
+	memset(&H, 0, sizeof(H));
+	H.db = historydb_new();
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		H.count  = sizes[s];
+		H.pooled = H.count < POOL ? H.count : POOL;
+		H.nomem  = 0;
+		H.keys   = calloc(H.count * 2, sizeof(char *));
+		H.keylen = calloc(H.count * 2, sizeof(int));
+		for (i = 0; i < H.count; ++i) {
+			H.keys[i]           = station_call(i, 'X');
+			H.keys[H.count + i] = station_call(i, 'Y');
+		}
+		for (i = 0; i < H.count * 2; ++i)
+			H.keylen[i] = strlen(H.keys[i]);
+		for (i = 0; i < H.pooled; ++i)
+			H.pool[i] = station_pbuf(i);
+
+		measure("historydb_insert_ new", H.count, history_insert, history_reset, &H, H.pooled);
+		history_reset(&H);
+		history_insert(&H, H.pooled);
+		measure("historydb_insert_ known", H.count, history_insert, NULL, &H, 0);
+		measure("historydb_lookup hit", H.count, history_lookup_hit, NULL, &H, 0);
+		measure("historydb_lookup miss", H.count, history_lookup_miss, NULL, &H, 0);
+
+		if (history_lookups(&H, 0, H.count) != H.count - H.nomem ||
+		    history_lookups(&H, H.count, H.count) != 0) {
+			fprintf(stderr, "micro-bench: historydb %d: lookups do not find the stations\n",
+				H.count);
+			++errors;
+		}
+		if (H.nomem > 0)
+			fprintf(stderr, "micro-bench: historydb %d: %llu inserts did not fit\n",
+				H.count, (unsigned long long) H.nomem);
+		historydb_atend();
+		memset(H.db->hash, 0, sizeof(H.db->hash));
+		for (i = 0; i < H.pooled; ++i)
+			pbuf_put(H.pool[i]);
+		for (i = 0; i < H.count * 2; ++i)
+			free(H.keys[i]);
+		free(H.keys);
+		free(H.keylen);
+	}
+	return errors;
+}
+/* ---------------------------------------------------------------- */
+
+struct packets {
+	struct pbuf_t  *pbs[64];
+	int             count;
+	struct filter_t *filter;
+};
+
+static void parse_run(void *arg, uint64_t ops)
+{
+	struct packets *P = arg;
+	uint64_t i;
+	int r = 0;
+
+	for (i = 0; i < ops; ++i)
+		r += parse_aprs(P->pbs[i % P->count], NULL);
+	sink += r;
+}
+
+/* The corpus, and checks that it parses as it should */
+static int corpus_packets(struct packets *all)
+{
+	int i, errors = 0;
+
+	all->count = 0;
+	for (i = 0; corpus[i].tnc2; ++i) {
+		struct pbuf_t *pb = make_pbuf(corpus[i].tnc2);
+		if (pb == NULL || (pb->packettype & corpus[i].type) != corpus[i].type ||
+		    ((corpus[i].type & (T_POSITION | T_OBJECT | T_ITEM)) &&
+		     !(pb->flags & F_HASPOS))) {
+			fprintf(stderr, "micro-bench: %s packet does not parse as one: %s\n",
+				corpus[i].kind, corpus[i].tnc2);
+			++errors;
+		}
+		if (pb != NULL)
+			all->pbs[all->count++] = pb;
+	}
+	return errors;
+}
+
+static void bench_parse(struct packets *all)
+{
+	struct packets P;
+	char name[64];
+	int i, k;
+
+	for (i = 0; corpus[i].tnc2; ++i) {
+		if (i > 0 && strcmp(corpus[i].kind, corpus[i-1].kind) == 0)
+			continue;
+		P.count = 0;
+		for (k = i; corpus[k].tnc2; ++k)
+			if (strcmp(corpus[k].kind, corpus[i].kind) == 0)
+				P.pbs[P.count++] = make_pbuf(corpus[k].tnc2);
+		snprintf(name, sizeof(name), "parse_aprs %s", corpus[i].kind);
+		measure(name, P.count, parse_run, NULL, &P, 0);
+		for (k = 0; k < P.count; ++k)
+			pbuf_put(P.pbs[k]);
+	}
+	measure("parse_aprs all", all->count, parse_run, NULL, all, 0);
+}
+
+/* ---------------------------------------------------------------- */
+
+static void filter_run(void *arg, uint64_t ops)
+{
+	struct packets *P = arg;
+	uint64_t i;
+	int r = 0;
+
+	for (i = 0; i < ops; ++i)
+		r += filter_process(P->pbs[i % P->count], P->filter, NULL);
+	sink += r;
+}
+
+static void bench_filter(struct packets *all)
+{
+	char buf[400];
+	int i, r, n;
+
+	all->filter = NULL;
+	filter_parse(&all->filter, "r/60.17/24.94/50");
+	filter_parse(&all->filter, "r/61.50/23.76/30");
+	measure("filter_process range", all->count, filter_run, NULL, all, 0);
+	filter_free(all->filter);
+
+	all->filter = NULL;
+	for (i = 0; i < 100; ) {
+		n = sprintf(buf, "b");
+		for (r = 0; r < 20 && i < 100; ++r, ++i)
+			n += sprintf(buf+n, "/OH%dX%02d-%d", i % 10, i / 10, i % 16);
+		filter_parse(&all->filter, buf);
+	}
+	filter_parse(&all->filter, "b/OH2ABC*/SM5*");
+	measure("filter_process budlist", all->count, filter_run, NULL, all, 0);
+	filter_free(all->filter);
+
+	all->filter = NULL;
+	for (i = 0; digi_filters[i]; ++i)
+		filter_parse(&all->filter, digi_filters[i]);
+	measure("filter_process digi", all->count, filter_run, NULL, all, 0);
+	filter_free(all->filter);
+}
+
+/* ---------------------------------------------------------------- */
+
+#define CELLBATCH 32
+
+static void cells_run(void *arg, uint64_t ops)
+{
+	cellarena_t *ca = arg;
+	void *p[CELLBATCH];
+	uint64_t i;
+	int k;
+
+	for (i = 0; i < ops; i += CELLBATCH) {
+		for (k = 0; k < CELLBATCH; ++k)
+			p[k] = cellmalloc(ca);
+		for (k = CELLBATCH; k-- > 0; )
+			if (p[k] != NULL)
+				cellfree(ca, p[k]);
+	}
+}
+
+static void malloc_run(void *arg, uint64_t ops)
+{
+	void *p[CELLBATCH];
+	uint64_t i;
+	int k;
+
+	for (i = 0; i < ops; i += CELLBATCH) {
+		for (k = 0; k < CELLBATCH; ++k)
+			p[k] = malloc(128);
+		for (k = CELLBATCH; k-- > 0; )
+			free(p[k]);
+	}
+}
+
+static void bench_cells(void)
+{
+	cellarena_t *lifo = cellinit("micro-bench-lifo", 128, 8,
+				     CELLMALLOC_POLICY_LIFO | CELLMALLOC_POLICY_NOMUTEX, 4, 0);
+	cellarena_t *fifo = cellinit("micro-bench-fifo", 128, 8,
+				     CELLMALLOC_POLICY_FIFO, 32, 0);
+
+	measure("cellmalloc+free lifo", CELLBATCH, cells_run, NULL, lifo, 0);
+	measure("cellmalloc+free fifo", CELLBATCH, cells_run, NULL, fifo, 0);
+	measure("malloc+free", CELLBATCH, malloc_run, NULL, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct packets all;
+	int i, errors;
+
+	while ((i = getopt(argc, argv, "jt:r:")) != -1) {
+		switch (i) {
+		case 'j': opt_json = 1; break;
+		case 't': opt_ms   = atoi(optarg); break;
+		case 'r': opt_runs = atoi(optarg); break;
+		default:
+			fprintf(stderr, "Usage:  micro-bench [-j] [-t ms] [-r runs] [case ...]\n");
+			return 1;
+		}
+	}
+	if (opt_ms < 1)
+		opt_ms = 1;
+	if (opt_runs < 1)
+		opt_runs = 1;
+	selection  = argv + optind;
+	selections = argc - optind;
+
+	timetick();
+	filter_init();
+	pbuf_init();
+	dupecheck_init();
+#ifndef DISABLE_IGATE
+	historydb_init();
+#endif
+
+	errors = corpus_packets(&all);
+	header();
+	bench_keyhash();
+	bench_dupecheck();
+#ifndef DISABLE_IGATE
+	errors += bench_historydb();
+#endif
+	bench_parse(&all);
+	bench_filter(&all);
+	bench_cells();
+	if (opt_json)
+		printf("\n ]}\n");
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+#  micro-compare.sh -- two micro-bench result files side by side
+#
+#  Joins the cases of both runs on name and size, and prints the
+#  median ns/op before and after, and the change in per cent.
+#  Cases that are in one file only are listed with a "-".
+#
+#  Usage:  micro-compare.sh before.tsv after.tsv
+#
+#	bench/micro-bench -t 200 -r 5 > before.tsv
+#	  ... rebuild ...
+#	bench/micro-bench -t 200 -r 5 > after.tsv
+#	bench/micro-compare.sh before.tsv after.tsv
+#
+
+if [ $# -ne 2 ]; then
+	echo "Usage: $0 before.tsv after.tsv" 1>&2
+	exit 64
+fi
+
+awk -F'\t' '
+	/^#/ { next }
+	NF < 3 { next }
+	{
+		name = $1; sub(/ +$/, "", name)
+		key = name "\t" $2
+		if (FILENAME == ARGV[1]) {
+			before[key] = $3
+		} else {
+			after[key] = $3
+		}
+		if (!(key in seen)) {
+			seen[key] = 1
+			order[n++] = key
+		}
+	}
+	END {
+		printf("%-24s %6s %11s %11s %8s\n", "# name", "size", "before", "after", "change")
+		for (i = 0; i < n; ++i) {
+			key = order[i]
+			split(key, k, "\t")
+			b = (key in before) ? before[key] : "-"
+			a = (key in after)  ? after[key]  : "-"
+			if (b != "-" && a != "-" && b > 0)
+				c = sprintf("%+.1f%%", (a - b) * 100.0 / b)
+			else
+				c = "-"
+			printf("%-24s %6s %11s %11s %8s\n", k[1], k[2], b, a, c)
+		}
+	}
+' "$1" "$2"
@@ -0,0 +1,153 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  range-bench:  unit vector range test  vs.  haversine distance
+ *
+ *  Draws random position pairs and radii, and compares the range
+ *  filter decision of filter_range_test() with the float haversine
+ *  formula the filters used before, and with a double precision
+ *  haversine as the reference.  Decisions may differ only when the
+ *  distance is within a hair of the radius.  Then both are timed.
+ *
+ *  Usage:  range-bench [count]
+ */
+
+#include "aprx.h"
+#include <time.h>
+
+struct pair {
+	float lat1, lon1, coslat1;
+	float lat2, lon2, coslat2;
+	double xyz1[3], xyz2[3];
+	float km;
+	double cosdist;
+};
+
+/* The old filter.c code, verbatim */
+static float haversine_float(float lat1, float coslat1, float lon1, float lat2, float coslat2, float lon2)
+{
+	float sindlat2 = sinf((lat1 - lat2) * 0.5);
+	float sindlon2 = sinf((lon1 - lon2) * 0.5);
+
+	float a = (sindlat2 * sindlat2 +
+		   coslat1 * coslat2 * sindlon2 * sindlon2);
+
+	float c = 2.0 * atan2f( sqrtf(a), sqrtf(1.0 - a));
+
+	return ((111.2 * 180.0 / M_PI) * c);
+}
+
+static double haversine_double(double lat1, double lon1, double lat2, double lon2)
+{
+	double sindlat2 = sin((lat1 - lat2) * 0.5);
+	double sindlon2 = sin((lon1 - lon2) * 0.5);
+	double a = (sindlat2 * sindlat2 +
+		    cos(lat1) * cos(lat2) * sindlon2 * sindlon2);
+	return (111.2 * 180.0 / M_PI) * 2.0 * atan2(sqrt(a), sqrt(1.0 - a));
+}
+
+static int old_test(const struct pair *p)
+{
+	float r = haversine_float(p->lat1, p->coslat1, p->lon1, p->lat2, p->coslat2, p->lon2);
+	if (p->km < 0.0)
+		return (r > -p->km);
+	return (r < p->km);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double frand(void)
+{
+	return (double)random() / (double)RAND_MAX;
+}
+
+int main(int argc, char **argv)
+{
+	int count = 1000000;
+	int i, k, rounds = 10;
+	int diff_old = 0, diff_new = 0, far_diff = 0;
+	volatile int sink = 0;
+	double t0, t_old, t_new;
+	struct pair *pairs;
+
+	if (argc > 1)
+		count = atoi(argv[1]);
+	if (count < 1)
+		count = 1;
+	pairs = malloc(sizeof(*pairs) * count);
+	srandom(4711);
+
+	for (i = 0; i < count; ++i) {
+		struct pair *p = &pairs[i];
+		p->lat1 = (frand() * 180.0 - 90.0) * (M_PI / 180.0);
+		p->lon1 = (frand() * 360.0 - 180.0) * (M_PI / 180.0);
+		// Mostly near-by stations, some across the globe
+		if (i % 8 == 0) {
+			p->lat2 = (frand() * 180.0 - 90.0) * (M_PI / 180.0);
+			p->lon2 = (frand() * 360.0 - 180.0) * (M_PI / 180.0);
+		} else {
+			p->lat2 = p->lat1 + (frand() - 0.5) * 0.05;
+			p->lon2 = p->lon1 + (frand() - 0.5) * 0.05;
+		}
+		p->coslat1 = cosf(p->lat1);
+		p->coslat2 = cosf(p->lat2);
+		filter_pos_vector(p->lat1, p->lon1, p->xyz1);
+		filter_pos_vector(p->lat2, p->lon2, p->xyz2);
+		p->km = 0.1 + frand() * ((i % 8 == 0) ? 20000.0 : 200.0);
+		if (i % 5 == 0)
+			p->km = -p->km;
+		p->cosdist = filter_range_cosdist(p->km);
+	}
+
+	for (i = 0; i < count; ++i) {
+		const struct pair *p = &pairs[i];
+		double r  = haversine_double(p->lat1, p->lon1, p->lat2, p->lon2);
+		int    ref = (p->km < 0.0) ? (r > -p->km) : (r < p->km);
+		int    o  = old_test(p);
+		int    n  = filter_range_test(p->xyz1, p->xyz2, p->km, p->cosdist);
+		if (o != ref) ++diff_old;
+		if (n != ref) {
+			++diff_new;
+			// Allow disagreement within 1 m of the boundary only
+			if (fabs(r - fabs(p->km)) > 0.001) {
+				++far_diff;
+				printf("  mismatch: r=%.4f km  radius=%.4f km\n", r, p->km);
+			}
+		}
+	}
+	printf("range-bench: %d pairs, decisions differing from double haversine: old %d, new %d (%d not at boundary)\n",
+	       count, diff_old, diff_new, far_diff);
+
+	t0 = now_ns();
+	for (k = 0; k < rounds; ++k)
+		for (i = 0; i < count; ++i)
+			sink += old_test(&pairs[i]);
+	t_old = now_ns() - t0;
+
+	t0 = now_ns();
+	for (k = 0; k < rounds; ++k)
+		for (i = 0; i < count; ++i) {
+			const struct pair *p = &pairs[i];
+			sink += filter_range_test(p->xyz1, p->xyz2, p->km, p->cosdist);
+		}
+	t_new = now_ns() - t0;
+
+	printf("range-bench: haversine %.2f ns/test   unit vector %.2f ns/test   (%.1fx)\n",
+	       t_old / ((double)count * rounds), t_new / ((double)count * rounds),
+	       t_old / t_new);
+
+	free(pairs);
+	return far_diff ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  regex-bench:  digipeater regex-filter sets
+ *
+ *  Builds a regexset of typical  regex-filter  patterns, checks on
+ *  a corpus of field values that regexset_match() gives the same
+ *  verdict as running every regexec() in turn, and times both.
+ *
+ *  Usage:  regex-bench [rounds]
+ */
+
+#include "aprx.h"
+#include <time.h>
+
+static const char *patterns[] = {
+	"^N0CALL",
+	"^NOCALL",
+	"^MYCALL",
+	"^TCPIP",
+	"^RFONLY$",
+	"-15$",
+	"CWOP",
+	"^OH[0-9]TEST",
+	"^(WIDE|TRACE)[3-7]-[0-9]$",
+	"^[A-Z]{1,2}[0-9][A-Z]{1,3}-1[0-4]$",
+	"^SV1.*",
+	"(.)\\1\\1",		// back-reference: kept alone
+	"ab|cd)",		// unbalanced: kept alone
+	"[]x]y",
+	"[[:digit:]]{5}",
+	"q[^]a]z",
+	NULL
+};
+
+static const char *fields[] = {
+	"OH2MQK-1", "N0CALL", "NOCALL-5", "MYCALL", "TCPIP*", "RFONLY",
+	"RFONLYX", "OH2ABC-15", "OH2ABC-5", "CWOP-1", "XCWOPX", "OH2TEST",
+	"OH2TESTX", "OHXTEST", "WIDE3-1", "WIDE2-1", "TRACE7-7", "WIDE3-10",
+	"SM5ABC-12", "SM5ABC-15", "K1AB-10", "SV1ABC", "SV2ABC", "AAA",
+	"OHHH2", "ab", "cd)", "ab|cd)", "]y", "xy", "x]y", "12345",
+	"1234", "qbz", "q]z", "qaz", "", "-", "$", "^", "WIDE1-1*",
+	"APRS", "APRX29", "ABC*", "!6010.00N/02455.00E>text 12345",
+	">status CWOP", "@092345z6010.00N/02455.00E_",
+	NULL
+};
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct regexset *make_set(int npatterns)
+{
+	struct regexset *set = NULL;
+	int i;
+
+	for (i = 0; i < npatterns && patterns[i] != NULL; ++i) {
+		regex_t *re = calloc(1, sizeof(*re));
+		if (regcomp(re, patterns[i], REG_EXTENDED | REG_NOSUB) != 0) {
+			printf("regex-bench: regcomp('%s') failed\n", patterns[i]);
+			free(re);
+			continue;
+		}
+		regexset_add(&set, patterns[i], re);
+	}
+	regexset_compile(set);
+	return set;
+}
+
+int main(int argc, char **argv)
+{
+	int rounds = 20000;
+	int i, k, n, mismatches = 0;
+	volatile int sink = 0;
+
+	if (argc > 1)
+		rounds = atoi(argv[1]);
+	if (rounds < 1)
+		rounds = 1;
+
+	// Verdicts with every prefix of the pattern list
+	for (n = 1; patterns[n-1] != NULL; ++n) {
+		struct regexset *set = make_set(n);
+		for (i = 0; fields[i] != NULL; ++i) {
+			int a = regexset_match(set, fields[i]);
+			int b = regexset_match_each(set, fields[i]);
+			if (a != b) {
+				++mismatches;
+				printf("  mismatch: %d patterns, field '%s': set %d, each %d\n",
+				       n, fields[i], a, b);
+			}
+		}
+		regexset_free(set);
+	}
+	printf("regex-bench: equivalence %d mismatches\n", mismatches);
+
+	for (n = 4; n <= 16; n += 4) {
+		struct regexset *set = make_set(n);
+		int nfields = 0;
+		double t0, t_each, t_set;
+		for (i = 0; fields[i] != NULL; ++i)
+			++nfields;
+
+		t0 = now_ns();
+		for (k = 0; k < rounds; ++k)
+			for (i = 0; i < nfields; ++i)
+				sink += regexset_match_each(set, fields[i]);
+		t_each = now_ns() - t0;
+
+		t0 = now_ns();
+		for (k = 0; k < rounds; ++k)
+			for (i = 0; i < nfields; ++i)
+				sink += regexset_match(set, fields[i]);
+		t_set = now_ns() - t0;
+
+		printf("patterns %2d   regexec loop %8.1f ns/field   regexset %8.1f ns/field   (%.1fx)\n",
+		       n, t_each / ((double)rounds * nfields),
+		       t_set / ((double)rounds * nfields), t_each / t_set);
+		regexset_free(set);
+	}
+
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,756 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  replay-bench:  the whole receive pipeline, without radios
+ *
+ *  Sets up aprx from a generated configuration:  a null-device
+ *  interface, a digipeater on it relaying RF and APRS-IS traffic,
+ *  and an <aprsis> connection to a sink that runs in this program
+ *  and counts the uplinked lines.  Then replays traffic through the
+ *  same calls the main loop makes:  KISS frames go to kiss_pullkiss()
+ *  on the interface's port, and APRS-IS lines to igate_from_aprsis().
+ *  Digipeated frames end up at the null-device transmitter.
+ *
+ *  The traffic is a recorded KISS byte stream (-k), an rflog file
+ *  (-l, the RF and APRSIS receive lines of it), or by default a
+ *  generated mix of positions, duplicates and APRS-IS messages to
+ *  the heard stations.  It goes as fast as possible, or with -p at
+ *  the pace of the rflog timestamps (generated traffic is 100/s).
+ *  As fast as possible, aprx's clock still follows the timestamps,
+ *  so dupe records expire and rate limits refill as in real time.
+ *
+ *  With -a the APRS-IS server is an outside one, like aprsis-sim,
+ *  and what it sends is Tx-igated too.
+ *
+ *  Reported are packets per second, CPU time and malloc() calls of
+ *  each stage, CPU time of the APRS-IS thread, what was uplinked and
+ *  transmitted, and the drop counters.  A frame not digipeated for
+ *  the want of a dupe record fails the run.  The first APRS-IS
+ *  connect is some 10 seconds after the start.
+ *
+ *  Usage:  replay-bench [-p] [-n packets] [-a host:port]
+ *			 [-k kiss-stream | -l rflog]
+ */
+
+#include "aprx.h"
+#include <time.h>
+
+#define STAGE_RF      0	/* kiss_pullkiss() .. digipeat, igate queue */
+#define STAGE_IS      1	/* igate_from_aprsis(), also of the server */
+#define STAGE_TIMERS  2	/* dupecheck, digipeater, historydb polls  */
+#define STAGES        3
+
+static const char *stage_names[STAGES] = { "kiss rx", "aprsis rx", "timers" };
+
+struct event {
+	int64_t  t_ns;		/* offset from the first one          */
+	int      is_aprsis;	/* APRS-IS line, else KISS bytes      */
+	int      frames;	/* KISS frames in it, -1 = not known  */
+	int      len;
+	uint8_t *data;
+};
+
+static struct event *events;
+static int events_count, events_size;
+
+static int64_t  stage_cpu[STAGES];
+static uint64_t stage_allocs[STAGES];
+
+#ifdef __GLIBC__
+/* malloc() calls of the main thread, by stage */
+static __thread int alloc_stage = -1;
+
+extern int64_t bench_tick_skew_ns; /* aprx-nomain.o, see timetick() */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+void *malloc(size_t size)
+{
+	if (alloc_stage >= 0)
+		++stage_allocs[alloc_stage];
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	if (alloc_stage >= 0)
+		++stage_allocs[alloc_stage];
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+	if (alloc_stage >= 0)
+		++stage_allocs[alloc_stage];
+	return __libc_realloc(p, size);
+}
+#define ALLOC_STAGE(s)  (alloc_stage = (s))
+#else
+#define ALLOC_STAGE(s)  do { } while (0)
+#endif
+
+static int64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t cpu_ns(clockid_t clk)
+{
+	struct timespec ts;
+	if (clock_gettime(clk, &ts) < 0)
+		return -1;
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct event *event_new(int64_t t_ns, int is_aprsis, int len)
+{
+	struct event *E;
+
+	if (events_count >= events_size) {
+		events_size = events_size ? events_size * 2 : 1024;
+		events = realloc(events, events_size * sizeof(*events));
+	}
+	E = &events[events_count++];
+	E->t_ns      = t_ns;
+	E->is_aprsis = is_aprsis;
+	E->frames    = is_aprsis ? 0 : 1;
+	E->len       = len;
+	E->data      = malloc(len + 1);
+	return E;
+}
+
+/* AX.25 frame out of a TNC2 line, 0 when it is not one */
+static int make_ax25(uint8_t *ax, const char *tnc2)
+{
+	char hdr[200], *src, *dst, *via, *rest;
+	const char *c = strchr(tnc2, ':');
+	int n, len;
+
+	if (c == NULL || c - tnc2 >= sizeof(hdr) || strlen(c + 1) > 256)
+		return 0;
+	memcpy(hdr, tnc2, c - tnc2);
+	hdr[c - tnc2] = 0;
+	src  = strtok(hdr, ">");
+	rest = strtok(NULL, "");
+	if (src == NULL || rest == NULL)
+		return 0;
+	dst  = strtok(rest, ",");
+	parse_ax25addr(ax + 7, src, 0x60);
+	parse_ax25addr(ax,     dst, 0xE0);
+	n = 14;
+	while ((via = strtok(NULL, ",")) != NULL && n < 70) {
+		parse_ax25addr(ax + n, via, 0x60);
+		n += 7;
+	}
+	ax[n-1] |= 0x01;
+	ax[n++] = 0x03;
+	ax[n++] = 0xF0;
+	len = strlen(c + 1);
+	memcpy(ax + n, c + 1, len);
+	return n + len;
+}
+
+/* An RF frame event, as a KISS frame on TNC 0 */
+static void add_rf(int64_t t_ns, const char *tnc2)
+{
+	uint8_t ax[400];
+	struct event *E;
+	int i, n, axlen = make_ax25(ax, tnc2);
+
+	if (axlen == 0)
+		return;
+	E = event_new(t_ns, 0, 2 * axlen + 4);
+	n = 0;
+	E->data[n++] = KISS_FEND;
+	E->data[n++] = 0x00;
+	for (i = 0; i < axlen; ++i) {
+		if (ax[i] == KISS_FEND) {
+			E->data[n++] = KISS_FESC; E->data[n++] = KISS_TFEND;
+		} else if (ax[i] == KISS_FESC) {
+			E->data[n++] = KISS_FESC; E->data[n++] = KISS_TFESC;
+		} else
+			E->data[n++] = ax[i];
+	}
+	E->data[n++] = KISS_FEND;
+	E->len = n;
+}
+
+static void add_is(int64_t t_ns, const char *line)
+{
+	int len = strlen(line);
+	struct event *E = event_new(t_ns, 1, len);
+	memcpy(E->data, line, len + 1);
+}
+
+static void station_call(char *buf, int s)
+{
+	sprintf(buf, "OH%dR%02d", 1 + s % 9, (s / 9) % 100);
+}
+
+/*
+ *  Ten packets in a cycle:  seven positions from 900 stations with
+ *  varied paths, a repeat of one of them, an APRS-IS position that
+ *  is not gated, and an APRS-IS message to a heard station.
+ */
+static void make_events(int count)
+{
+	static const char *paths[] = { ",WIDE1-1,WIDE2-1", ",WIDE2-2", "", ",OH2RDP*,WIDE2-1" };
+	char line[300], call[16];
+	int i, k, s;
+
+	for (i = 0; i < count; ++i) {
+		const int64_t t = i * 10000000LL;
+		k = i % 10;
+		s = (i / 10 * 7 + k) % 900;
+		station_call(call, s);
+		if (k < 7) {
+			sprintf(line, "%s>APRS%s:!%02d%02d.%02dN/%03d%02d.%02dE>replay %d",
+				call, paths[i % 4], 59 + s % 8, i % 60, k * 11,
+				22 + s % 7, (i / 60) % 60, s % 100, i);
+			add_rf(t, line);
+		} else if (k == 7) {
+			const int j = events_count - 3;
+			struct event *E = event_new(t, 0, events[j].len);
+			memcpy(E->data, events[j].data, E->len);
+		} else if (k == 8) {
+			sprintf(line, "SM%dIS%02d>APRS,TCPIP*,qAC,T2BENCH:!5920.00N/01800.00E-is %d",
+				i % 10, (i / 10) % 100, i);
+			add_is(t, line);
+		} else {
+			station_call(call, (s + 895) % 900);
+			sprintf(line, "OH2ABC>APRS,TCPIP*,qAC,T2BENCH::%-9s:message %d{%d",
+				call, i, i % 1000);
+			add_is(t, line);
+		}
+	}
+}
+
+static int read_kiss(const char *fname)
+{
+	FILE *fp = fopen(fname, "r");
+	uint8_t buf[512];
+	int n;
+
+	if (fp == NULL) {
+		perror(fname);
+		return -1;
+	}
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		struct event *E = event_new(0, 0, n);
+		memcpy(E->data, buf, n);
+		E->frames = -1;
+	}
+	fclose(fp);
+	return 0;
+}
+
+/* Undo the <0xNN> of rflog() */
+static void unescape(char *s)
+{
+	char *d = s;
+	unsigned int c;
+
+	while (*s) {
+		if (s[0] == '<' && s[1] == '0' && s[2] == 'x' && s[3] && s[4] && s[5] == '>' &&
+		    sscanf(s + 3, "%2x", &c) == 1) {
+			*d++ = c;
+			s += 6;
+		} else
+			*d++ = *s++;
+	}
+	*d = 0;
+}
+
+/* The receive lines of an rflog, discarded ones excluded */
+static int read_rflog(const char *fname)
+{
+	FILE *fp = fopen(fname, "r");
+	char line[2000], port[32], dir;
+	struct tm tm;
+	int64_t t, t0 = -1;
+	int ms, pos;
+
+	if (fp == NULL) {
+		perror(fname);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *text;
+
+		memset(&tm, 0, sizeof(tm));
+		if (sscanf(line, "%d-%d-%d %d:%d:%d.%d %31s %c %n",
+			   &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+			   &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &ms,
+			   port, &dir, &pos) < 9 || dir != 'R')
+			continue;
+		text = line + pos;
+		text[strcspn(text, "\r\n")] = 0;
+		if (*text == '*' || *text == '#' || *text == 0)
+			continue;
+		unescape(text);
+
+		tm.tm_year -= 1900;
+		tm.tm_mon  -= 1;
+		t = (int64_t) timegm(&tm) * 1000000000LL + ms * 1000000LL;
+		if (t0 < 0)
+			t0 = t;
+		if (strcmp(port, "APRSIS") == 0)
+			add_is(t - t0, text);
+		else
+			add_rf(t - t0, text);
+	}
+	fclose(fp);
+	return 0;
+}
+
+
+/*
+ *  The APRS-IS sink:  a server greeting, a logresp to the login,
+ *  and then just counting the lines.
+ */
+static int sink_listen_fd = -1;
+static int sink_port;
+static char *server_host, *server_port;	/* -a, instead of the sink */
+static volatile int sink_logins;
+static volatile uint64_t sink_lines;
+
+static void *sink_main(void *arg)
+{
+	static const char greeting[] = "# replay-bench sink\r\n";
+	static const char logresp[]  = "# logresp OH2XYZ-1 unverified, server BENCH\r\n";
+	char buf[8192];
+	int fd, n, i, login;
+
+	while ((fd = accept(sink_listen_fd, NULL, NULL)) >= 0) {
+		login = 0;
+		if (write(fd, greeting, sizeof(greeting) - 1) < 0) {
+			close(fd);
+			continue;
+		}
+		while ((n = read(fd, buf, sizeof(buf))) > 0) {
+			for (i = 0; i < n; ++i) {
+				if (buf[i] != '\n')
+					continue;
+				if (login) {
+					++sink_lines;
+				} else {
+					login = 1;
+					if (write(fd, logresp, sizeof(logresp) - 1) > 0)
+						++sink_logins;
+				}
+			}
+		}
+		close(fd);
+	}
+	return NULL;
+}
+
+static int sink_start(void)
+{
+#if defined(HAVE_PTHREAD_CREATE) && defined(ENABLE_PTHREAD)
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof(sin);
+	pthread_t t;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family      = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sink_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (sink_listen_fd < 0 ||
+	    bind(sink_listen_fd, (struct sockaddr *) &sin, sizeof(sin)) < 0 ||
+	    listen(sink_listen_fd, 2) < 0 ||
+	    getsockname(sink_listen_fd, (struct sockaddr *) &sin, &sinlen) < 0) {
+		perror("sink");
+		return -1;
+	}
+	sink_port = ntohs(sin.sin_port);
+	return pthread_create(&t, NULL, sink_main, NULL) == 0 ? 0 : -1;
+#else
+	return -1;		/* The APRS-IS side is not measured */
+#endif
+}
+
+
+static int setup(const char *dir)
+{
+	char fname[300];
+	FILE *fp;
+
+	snprintf(fname, sizeof(fname), "%s/aprx.conf", dir);
+	fp = fopen(fname, "w");
+	if (fp == NULL) {
+		perror(fname);
+		return -1;
+	}
+	fprintf(fp, "mycall OH2XYZ-1\n");
+	if (server_host)
+		fprintf(fp, "<aprsis>\n"
+			"  passcode -1\n"
+			"  server %s %s\n"
+			"</aprsis>\n", server_host, server_port);
+	else if (sink_port > 0)
+		fprintf(fp, "<aprsis>\n"
+			"  passcode -1\n"
+			"  server 127.0.0.1 %d\n"
+			"</aprsis>\n", sink_port);
+	fprintf(fp, "<logging>\n"
+		"  erlangfile %s/aprx.state\n"
+		"  aprxlog %s/aprx.log\n"
+		"</logging>\n"
+		"<interface>\n"
+		"  null-device $mycall\n"
+		"</interface>\n"
+		"<digipeater>\n"
+		"  transmitter $mycall\n"
+		"  ratelimit 9000000 9000000\n"
+		"  srcratelimit 9000000 9000000\n"
+		"  <source>\n"
+		"    source $mycall\n"
+		"    ratelimit 9000000 9000000\n"
+		"  </source>\n"
+		"  <source>\n"
+		"    source APRSIS\n"
+		"    relay-type third-party\n"
+		"    ratelimit 9000000 9000000\n"
+		"  </source>\n"
+		"</digipeater>\n", dir, dir);
+	fclose(fp);
+
+	interface_init();
+	erlang_init("NONE");
+	ttyreader_init();
+	dupecheck_init();
+#ifndef DISABLE_IGATE
+	aprsis_init();
+#endif
+	filter_init();
+	crc_init();
+	pbuf_init();
+	if (readconfig(fname))
+		return -1;
+	erlang_start(1);
+#ifndef DISABLE_IGATE
+	historydb_init();
+	aprsis_start();
+#endif
+	return 0;
+}
+
+static void timers(void)
+{
+	static struct aprxpolls app = APRXPOLLS_INIT;
+	const int64_t c0 = thread_cpu_ns();
+
+	ALLOC_STAGE(STAGE_TIMERS);
+	timetick();
+	aprxpolls_reset(&app);
+	tv_timeradd_millis(&app.next_timeout, &tick, 30000);
+	dupecheck_prepoll(&app);
+	digipeater_prepoll(&app);
+#ifndef DISABLE_IGATE
+	historydb_prepoll(&app);
+#endif
+	dupecheck_postpoll(&app);
+	digipeater_postpoll(&app);
+#ifndef DISABLE_IGATE
+	historydb_postpoll(&app);
+#endif
+	ALLOC_STAGE(-1);
+	stage_cpu[STAGE_TIMERS] += thread_cpu_ns() - c0;
+}
+
+static void feed(struct serialport *S, const struct event *E)
+{
+	const int stage = E->is_aprsis ? STAGE_IS : STAGE_RF;
+	const int64_t c0 = thread_cpu_ns();
+
+	ALLOC_STAGE(stage);
+	rx_frame_ns = monotonic_ns();
+	if (E->is_aprsis) {
+#ifndef DISABLE_IGATE
+		igate_from_aprsis((const char *) E->data, E->len);
+#endif
+	} else {
+		memcpy(S->rdbuf, E->data, E->len);
+		S->rdlen    = E->len;
+		S->rdcursor = 0;
+		kiss_pullkiss(S);
+	}
+	rx_frame_ns = 0;
+	ALLOC_STAGE(-1);
+	stage_cpu[stage] += thread_cpu_ns() - c0;
+}
+
+static void sleep_ns(int64_t ns)
+{
+	struct timespec ts;
+	ts.tv_sec  = ns / 1000000000LL;
+	ts.tv_nsec = ns % 1000000000LL;
+	nanosleep(&ts, NULL);
+}
+
+/* Wait up to 'ns', and take in what the APRS-IS thread passes over */
+static void idle(int64_t ns)
+{
+	static struct aprxpolls app = APRXPOLLS_INIT;
+	int64_t c0;
+	int k;
+
+	aprxpolls_reset(&app);
+#ifndef DISABLE_IGATE
+	aprsis_prepoll(&app);
+#endif
+	if (app.pollcount == 0) {
+		sleep_ns(ns);
+		return;
+	}
+	for (k = 0; k < 64; ++k) {
+		if (poll(app.polls, app.pollcount, k ? 0 : (int) (ns / 1000000)) <= 0)
+			break;
+		c0 = thread_cpu_ns();
+		ALLOC_STAGE(STAGE_IS);
+		timetick();
+#ifndef DISABLE_IGATE
+		aprsis_postpoll(&app);
+#endif
+		ALLOC_STAGE(-1);
+		stage_cpu[STAGE_IS] += thread_cpu_ns() - c0;
+	}
+}
+
+static int aprsis_connected(void)
+{
+	if (server_host)
+		return metrics_values[METRIC_APRSIS_CONNECTED] != 0;
+	return sink_logins > 0;
+}
+
+static uint64_t hist_count(int h, uint64_t *sum)
+{
+	const uint64_t *v = metrics_values + METRIC_HIST_BASE(h);
+	*sum = v[1];
+	return v[0];
+}
+
+static void print_path(const char *what, int h)
+{
+	uint64_t sum, n = hist_count(h, &sum);
+	if (n > 0)
+		printf("  %-22s %8llu   mean %.1f us\n", what,
+		       (unsigned long long) n, sum / 1000.0 / n);
+}
+
+int main(int argc, char **argv)
+{
+	const char *kissfile = NULL, *rflogfile_ = NULL;
+	char dir[] = "/tmp/replay-bench.XXXXXX";
+	struct aprx_interface *aif;
+	struct serialport *S;
+	int64_t t0, wall, proc0, is0 = -1, is_cpu = -1, waited;
+	clockid_t is_clk;
+	uint64_t lines0, lines, sum;
+	long long rf_frames = 0;
+	int i, kind, count = 50000, paced = 0, packets = 0, bad = 0;
+
+	while ((i = getopt(argc, argv, "pn:a:k:l:")) != -1) {
+		switch (i) {
+		case 'p': paced = 1; break;
+		case 'n': count = atoi(optarg); break;
+		case 'a':
+			server_host = strdup(optarg);
+			server_port = strchr(server_host, ':');
+			if (server_port == NULL)
+				goto usage;
+			*server_port++ = 0;
+			break;
+		case 'k': kissfile = optarg; break;
+		case 'l': rflogfile_ = optarg; break;
+		default:
+		usage:
+			fprintf(stderr, "Usage:  replay-bench [-p] [-n packets] [-a host:port]\n"
+				"\t\t     [-k kiss-stream | -l rflog]\n");
+			return 1;
+		}
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+	signal(SIGPIPE, SIG_IGN);
+	timetick();
+
+	if (kissfile)
+		i = read_kiss(kissfile);
+	else if (rflogfile_)
+		i = read_rflog(rflogfile_);
+	else
+		i = (make_events(count), 0);
+	if (i < 0)
+		return 1;
+
+	if (mkdtemp(dir) == NULL) {
+		perror(dir);
+		return 1;
+	}
+	if (server_host == NULL && sink_start() < 0)
+		printf("No APRS-IS sink, the uplink is not measured\n");
+	if (setup(dir) < 0) {
+		fprintf(stderr, "replay-bench: setup failed\n");
+		return 1;
+	}
+	aif = find_interface_by_callsign("OH2XYZ-1");
+	if (aif == NULL || aif->tty == NULL) {
+		fprintf(stderr, "replay-bench: no null-device interface\n");
+		return 1;
+	}
+	S = aif->tty;
+
+	if (sink_port > 0 || server_host) {
+		printf("Waiting for the APRS-IS connection..\n");
+		for (waited = 0; !aprsis_connected() && waited < 20000; waited += 100) {
+			idle(100000000LL);
+			timers();
+		}
+		if (!aprsis_connected())
+			printf("APRS-IS did not connect, the uplink is not measured\n");
+#if defined(HAVE_PTHREAD_CREATE) && defined(ENABLE_PTHREAD)
+		else if (pthread_getcpuclockid(aprsis_thread, &is_clk) == 0)
+			is0 = cpu_ns(is_clk);
+#endif
+		/* Let the login exchange settle */
+		idle(200000000LL);
+	}
+	memset(stage_cpu, 0, sizeof(stage_cpu));
+	memset(stage_allocs, 0, sizeof(stage_allocs));
+	memset(metrics_values, 0, METRIC_VALUES * sizeof(uint64_t));
+	lines0 = sink_lines;
+
+	t0    = monotonic_ns();
+	proc0 = cpu_ns(CLOCK_PROCESS_CPUTIME_ID);
+	for (i = 0; i < events_count; ++i) {
+		const struct event *E = &events[i];
+
+		if (paced) {
+			int64_t ahead;
+			while ((ahead = E->t_ns - (monotonic_ns() - t0)) > 0) {
+				idle(ahead < 10000000LL ? ahead : 10000000LL);
+				timers();
+			}
+		} else {
+			/* The tick goes at the pace of the timestamps, so
+			   that dupe records expire and rate limits refill
+			   as they would.  A long gap is run in 10 s steps
+			   with the timers, as the poll loop would see it,
+			   not as a time jump. */
+			int64_t ahead;
+			while ((ahead = E->t_ns - (monotonic_ns() - t0) -
+					bench_tick_skew_ns) > 1000000LL) {
+				if (ahead > 10000000000LL) {
+					bench_tick_skew_ns += 10000000000LL;
+					timers();
+				} else {
+					bench_tick_skew_ns += ahead;
+					timetick();
+				}
+			}
+		}
+		feed(S, E);
+		if (E->frames > 0)
+			rf_frames += E->frames;
+		if ((i & 31) == 31) {
+			idle(0);
+			timers();
+		}
+	}
+	timers();
+	wall = monotonic_ns() - t0;
+	proc0 = cpu_ns(CLOCK_PROCESS_CPUTIME_ID) - proc0;
+
+	/* Let the APRS-IS thread catch up */
+	lines = sink_lines;
+	for (waited = 0; sink_logins > 0 && waited < 5000; waited += 300) {
+		idle(300000000LL);
+		if (sink_lines == lines)
+			break;
+		lines = sink_lines;
+	}
+#if defined(HAVE_PTHREAD_CREATE) && defined(ENABLE_PTHREAD)
+	if (is0 >= 0)
+		is_cpu = cpu_ns(is_clk) - is0;
+#endif
+
+	packets = metrics_values[METRIC_RX_FRAMES];
+	for (i = 0; i < events_count; ++i)
+		if (events[i].is_aprsis)
+			++packets;
+
+	printf("%d packets (%llu KISS frames, %d APRS-IS lines) in %.3f s%s:  %.0f packets/s\n",
+	       packets, (unsigned long long) metrics_values[METRIC_RX_FRAMES],
+	       packets - (int) metrics_values[METRIC_RX_FRAMES],
+	       wall / 1e9, paced ? " paced" : "", packets / (wall / 1e9));
+	printf("  %-14s %10s %10s %10s %10s\n", "stage", "cpu ms", "us/packet", "mallocs", "per packet");
+	for (i = 0; i < STAGES; ++i) {
+		int n = i == STAGE_RF ? (int) metrics_values[METRIC_RX_FRAMES] :
+			i == STAGE_IS ? packets - (int) metrics_values[METRIC_RX_FRAMES] :
+			packets;
+		if (n <= 0)
+			n = 1;
+#ifdef __GLIBC__
+		printf("  %-14s %10.1f %10.2f %10llu %10.2f\n", stage_names[i],
+		       stage_cpu[i] / 1e6, stage_cpu[i] / 1e3 / n,
+		       (unsigned long long) stage_allocs[i], (double) stage_allocs[i] / n);
+#else
+		printf("  %-14s %10.1f %10.2f %10s %10s\n", stage_names[i],
+		       stage_cpu[i] / 1e6, stage_cpu[i] / 1e3 / n, "-", "-");
+#endif
+	}
+	if (is_cpu >= 0)
+		printf("  %-14s %10.1f\n", "aprsis thread", is_cpu / 1e6);
+	printf("  %-14s %10.1f\n", "process", proc0 / 1e6);
+
+	if (sink_logins > 0)
+		printf("  %-22s %8llu\n", "uplinked to APRS-IS",
+		       (unsigned long long) (sink_lines - lines0));
+	if (server_host)
+		printf("  %-22s %8llu\n", "lines from the server",
+		       (unsigned long long) hist_count(METRIC_HIST_IGATE_FROM_APRSIS, &sum));
+	print_path("digipeated RF to RF", METRIC_HIST_PATH_RF_RF);
+	print_path("viscous RF to RF", METRIC_HIST_PATH_RF_RF_VISCOUS);
+	print_path("gated APRS-IS to RF", METRIC_HIST_PATH_IS_RF);
+	print_path("gated RF to APRS-IS", METRIC_HIST_PATH_RF_IS);
+	for (i = 0; i < METRIC_SCALARS; ++i) {
+		const char *name = metrics_name(i, &kind);
+		if (kind == METRIC_KIND_COUNTER && i != METRIC_RX_FRAMES && metrics_values[i] > 0)
+			printf("  %-22s %8llu\n", name, (unsigned long long) metrics_values[i]);
+	}
+
+	/* Every generated or rflog frame must have made it to kissprocess() */
+	if (kissfile == NULL && rf_frames != (long long) metrics_values[METRIC_RX_FRAMES]) {
+		printf("MISMATCH: %lld frames replayed, %llu received\n", rf_frames,
+		       (unsigned long long) metrics_values[METRIC_RX_FRAMES]);
+		++bad;
+	}
+	/* .. and none lost for the want of a dupe record */
+	if (metrics_values[METRIC_DIGI_DROP_NOMEM] > 0) {
+		printf("NOMEM: %llu frames not digipeated, no dupecheck cell for them\n",
+		       (unsigned long long) metrics_values[METRIC_DIGI_DROP_NOMEM]);
+		++bad;
+	}
+
+	{
+		char fname[300];
+		snprintf(fname, sizeof(fname), "%s/aprx.conf", dir);  unlink(fname);
+		snprintf(fname, sizeof(fname), "%s/aprx.state", dir); unlink(fname);
+		snprintf(fname, sizeof(fname), "%s/aprx.log", dir);   unlink(fname);
+		rmdir(dir);
+	}
+	return bad;
+}
@@ -0,0 +1,682 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+/*
+ *  tnc-sim:  virtual KISS TNCs on ptys for end-to-end digipeater tests
+ *
+ *  Makes N pseudo-TNCs, writes an aprx configuration that has them as
+ *  serial-devices and digipeats from all of them to each of them, and
+ *  (with -x) runs aprx on it.  Then it injects frames on the TNCs in
+ *  turn at a given rate, and reads back what aprx transmits:
+ *
+ *	-m modes	the line types of the TNCs in turn, of
+ *			kiss, smack, flexnet and bpq   (smack)
+ *	-e pct		of frames get a flipped bit after their CRC
+ *	-D pct		of frames are heard again on the next TNC
+ *			-G ms later, as if another digi repeated them
+ *	-V secs		viscous-delay of the digipeater sources
+ *
+ *  Every frame carries "seq N", and every transmission of it is
+ *  matched to the injection:  the report has the RF-in to RF-out
+ *  latency, frames aprx did not digipeat or digipeated twice, the
+ *  corrupted frames that got through, and what became of the dupes.
+ *  -o writes the transmissions out, one per line.  The drop counters
+ *  of aprx come from its metrics-http listener at the end.
+ *
+ *  Without -x the configuration is printed, and aprx should be
+ *  started on it within the -W warm-up seconds.
+ *
+ *  Usage:  tnc-sim [-x aprx-binary] [-c tncs] [-m modes] [-n frames]
+ *		    [-r frames/s] [-e pct] [-D pct] [-G ms] [-V secs]
+ *		    [-W secs] [-o capture-file]
+ */
+
+#define _XOPEN_SOURCE 600	/* posix_openpt() */
+#define _DEFAULT_SOURCE 1
+
+#include "aprx.h"
+#include <time.h>
+#include <sys/wait.h>
+
+#define SIM_TNCS  16
+
+struct sim_tnc {
+	int       fd;		/* pty master, the radio side        */
+	int       slave;	/* kept open, in raw mode            */
+	LineType  linetype;
+	char      name[64];
+	int       rdlen;
+	int       rdesc;
+	uint8_t   rdbuf[2100];
+	uint64_t  injected, captured, bad_crc, other;
+};
+
+struct sim_seq {
+	int64_t   sent_ns;
+	int16_t   tnc;		/* injected on                       */
+	int16_t   dupe_tnc;	/* heard again on, or -1             */
+	uint8_t   corrupt;
+	uint8_t   dupe_sent;
+	uint32_t  txmask;	/* transmitted on these TNCs         */
+	int       txcount;
+};
+
+static struct sim_tnc  tncs[SIM_TNCS];
+static int             tnc_count = 2;
+static struct sim_seq *seqs;
+static int             seq_count, seq_sent, modes_set;
+static volatile int    sim_die;
+
+static double      opt_rate = 10, opt_corrupt, opt_dupes;
+static int         opt_gap = 200, opt_viscous, opt_warmup = 2;
+static int         metrics_port;
+static FILE       *capture_fp;
+
+static int64_t    *lat;		/* first transmission per seq and TNC */
+static int         lat_count;
+static uint64_t    st_repeats, st_corrupt_tx, st_unknown;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sig_die(int sig)
+{
+	sim_die = 1;
+}
+
+static const char *mode_name(LineType lt)
+{
+	switch (lt) {
+	case LINETYPE_KISSSMACK:	return "smack";
+	case LINETYPE_KISSFLEXNET:	return "flexnet";
+	case LINETYPE_KISSBPQCRC:	return "bpqcrc";
+	default:			return "kiss";
+	}
+}
+
+static int parse_modes(const char *s)
+{
+	char buf[200], *m;
+	LineType modes[SIM_TNCS];
+	int n = 0, i;
+
+	snprintf(buf, sizeof(buf), "%s", s);
+	for (m = strtok(buf, ","); m != NULL && n < SIM_TNCS; m = strtok(NULL, ",")) {
+		if (strcmp(m, "kiss") == 0)
+			modes[n++] = LINETYPE_KISS;
+		else if (strcmp(m, "smack") == 0 || strcmp(m, "crc16") == 0)
+			modes[n++] = LINETYPE_KISSSMACK;
+		else if (strcmp(m, "flexnet") == 0)
+			modes[n++] = LINETYPE_KISSFLEXNET;
+		else if (strcmp(m, "bpq") == 0 || strcmp(m, "bpqcrc") == 0)
+			modes[n++] = LINETYPE_KISSBPQCRC;
+		else {
+			fprintf(stderr, "tnc-sim: unknown mode '%s'\n", m);
+			return -1;
+		}
+	}
+	if (n == 0)
+		return -1;
+	for (i = 0; i < SIM_TNCS; ++i)
+		tncs[i].linetype = modes[i % n];
+	modes_set = 1;
+	return 0;
+}
+
+static int open_tnc(struct sim_tnc *T)
+{
+	struct termios tio;
+	const char *name;
+
+	T->fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (T->fd < 0 || grantpt(T->fd) < 0 || unlockpt(T->fd) < 0 ||
+	    (name = ptsname(T->fd)) == NULL) {
+		perror("tnc-sim: posix_openpt");
+		return -1;
+	}
+	snprintf(T->name, sizeof(T->name), "%s", name);
+
+	/* Raw from the start, nothing echoes back before aprx opens it */
+	T->slave = open(T->name, O_RDWR | O_NOCTTY);
+	if (T->slave < 0 || tcgetattr(T->slave, &tio) < 0) {
+		perror(T->name);
+		return -1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(T->slave, TCSANOW, &tio);
+	fd_nonblockingmode(T->fd);
+	return 0;
+}
+
+/* A free port for the metrics of aprx */
+static int free_port(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int fd = socket(AF_INET, SOCK_STREAM, 0), port = 0;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family      = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd >= 0 && bind(fd, (struct sockaddr *) &sin, sizeof(sin)) == 0 &&
+	    getsockname(fd, (struct sockaddr *) &sin, &len) == 0)
+		port = ntohs(sin.sin_port);
+	if (fd >= 0)
+		close(fd);
+	return port;
+}
+
+static int write_config(const char *fname, const char *dir)
+{
+	FILE *fp = fopen(fname, "w");
+	int i, k;
+
+	if (fp == NULL) {
+		perror(fname);
+		return -1;
+	}
+	fprintf(fp, "mycall OH2SIM\n"
+		"<logging>\n"
+		"  pidfile %s/aprx.pid\n"
+		"  erlangfile %s/aprx.state\n"
+		"  aprxlog %s/aprx.log\n"
+		"  metrics-http 127.0.0.1 %d\n"
+		"</logging>\n", dir, dir, dir, metrics_port);
+	for (i = 0; i < tnc_count; ++i)
+		fprintf(fp, "<interface>\n"
+			"  serial-device %s 9600 8n1 %s\n"
+			"  callsign OH2SIM-%d\n"
+			"  tx-ok true\n"
+			"</interface>\n", tncs[i].name, mode_name(tncs[i].linetype), i + 1);
+	/* Each TNC transmits what was heard on any of them */
+	for (i = 0; i < tnc_count; ++i) {
+		fprintf(fp, "<digipeater>\n"
+			"  transmitter OH2SIM-%d\n"
+			"  ratelimit 9000000 9000000\n"
+			"  srcratelimit 9000000 9000000\n", i + 1);
+		for (k = 0; k < tnc_count; ++k) {
+			fprintf(fp, "  <source>\n"
+				"    source OH2SIM-%d\n"
+				"    ratelimit 9000000 9000000\n", k + 1);
+			if (opt_viscous > 0)
+				fprintf(fp, "    viscous-delay %d\n", opt_viscous);
+			fprintf(fp, "  </source>\n");
+		}
+		fprintf(fp, "</digipeater>\n");
+	}
+	fclose(fp);
+	return 0;
+}
+
+/* The AX.25 frame of a seq:  a position from one of 100 stations */
+static int make_ax25(uint8_t *ax, int seq)
+{
+	char src[16], info[100];
+	int n = 14, len;
+
+	snprintf(src, sizeof(src), "OH%dT%02d", 1 + seq % 9, (seq / 9) % 100);
+	parse_ax25addr(ax + 7, src, 0x60);
+	parse_ax25addr(ax,     "APRS", 0xE0);
+	parse_ax25addr(ax + n, "WIDE1-1", 0x60);
+	n += 7;
+	ax[n-1] |= 0x01;
+	ax[n++] = 0x03;
+	ax[n++] = 0xF0;
+	len = snprintf(info, sizeof(info), "!6%03d.%02dN/02%03d.%02dE-seq %d",
+		       seq % 60, seq % 100, seq % 180, (seq / 7) % 100, seq);
+	memcpy(ax + n, info, len);
+	return n + len;
+}
+
+static int kiss_escape(uint8_t *out, const uint8_t *raw, int len)
+{
+	int i, n = 0;
+
+	out[n++] = KISS_FEND;
+	for (i = 0; i < len; ++i) {
+		if (raw[i] == KISS_FEND) {
+			out[n++] = KISS_FESC;
+			out[n++] = KISS_TFEND;
+		} else if (raw[i] == KISS_FESC) {
+			out[n++] = KISS_FESC;
+			out[n++] = KISS_TFESC;
+		} else
+			out[n++] = raw[i];
+	}
+	out[n++] = KISS_FEND;
+	return n;
+}
+
+static int kiss_unescape(uint8_t *raw, const uint8_t *kiss, int len)
+{
+	int i, n = 0;
+
+	for (i = 1; i < len - 1; ++i) {
+		if (kiss[i] == KISS_FESC && i + 1 < len - 1) {
+			++i;
+			raw[n++] = kiss[i] == KISS_TFEND ? KISS_FEND : KISS_FESC;
+		} else
+			raw[n++] = kiss[i];
+	}
+	return n;
+}
+
+/*
+ *  The KISS frame of a seq for a TNC.  A corrupted one gets a bit
+ *  flipped in the AX.25 frame after its CRC is made, like a TNC
+ *  that passes on bad data, or a damaged serial line.
+ */
+static int sim_frame(uint8_t *out, int space, const struct sim_tnc *T,
+		     int seq, int corrupt)
+{
+	uint8_t ax[400], raw[800];
+	int axlen = make_ax25(ax, seq), len, i, x;
+
+	switch (T->linetype) {
+	case LINETYPE_KISSSMACK:
+		len = kissencoder(out, space, LINETYPE_KISSSMACK, ax, axlen, 0x80);
+		break;
+	case LINETYPE_KISSFLEXNET:
+		len = kissencoder(out, space, LINETYPE_KISSFLEXNET, ax, axlen, 0x20);
+		break;
+	case LINETYPE_KISSBPQCRC:
+		for (x = 0, i = 0; i < axlen; ++i)
+			x ^= ax[i];
+		ax[axlen++] = x;
+		/* Fall through */
+	default:
+		len = kissencoder(out, space, LINETYPE_KISS, ax, axlen, 0x00);
+		break;
+	}
+	if (corrupt && len > 0) {
+		const int rawlen = kiss_unescape(raw, out, len);
+		const int bit = random() % ((axlen - 1) * 8);
+		raw[1 + bit / 8] ^= 1 << (bit % 8);
+		len = kiss_escape(out, raw, rawlen);
+	}
+	return len;
+}
+
+static void inject(int seq, int tnc, int64_t t)
+{
+	struct sim_tnc *T = &tncs[tnc];
+	uint8_t buf[1000];
+	int len = sim_frame(buf, sizeof(buf), T, seq, seq < seq_count && seqs[seq].corrupt && seqs[seq].tnc == tnc);
+
+	if (len > 0 && write(T->fd, buf, len) == len)
+		++T->injected;
+	else
+		fprintf(stderr, "tnc-sim: write to %s failed\n", T->name);
+}
+
+/* A frame that aprx transmitted on a TNC */
+static void captured(struct sim_tnc *T, uint8_t *rd, int len, int64_t t)
+{
+	char tnc2[600];
+	const char *s;
+	int frameaddrlen, tnc2addrlen, is_aprs = 0, ui_pid, n, seq;
+	struct sim_seq *Q;
+	const int tnc = T - tncs;
+
+	if (len < 1)
+		return;
+	if (T->linetype == LINETYPE_KISSSMACK && (rd[0] & 0x80)) {
+		if (check_crc_16(rd, len) != 0) {
+			++T->bad_crc;
+			return;
+		}
+		len -= 2;
+	} else if (T->linetype == LINETYPE_KISSFLEXNET && (rd[0] & 0x20)) {
+		if (calc_crc_flex(rd, len) != 0x7070) {
+			++T->bad_crc;
+			return;
+		}
+		len -= 2;
+	}
+	/* Data frames on port 0, and not the SMACK probe */
+	if ((rd[0] & 0x0F) != 0 || len < 1 + 16) {
+		++T->other;
+		return;
+	}
+	++T->captured;
+
+	n = ax25_format_to_tnc(rd + 1, len - 1, tnc2, sizeof(tnc2),
+			       &frameaddrlen, &tnc2addrlen, &is_aprs, &ui_pid);
+	if (n <= 0 || (s = strstr(tnc2, "-seq ")) == NULL ||
+	    (seq = atoi(s + 5)) < 0 || seq >= seq_sent) {
+		++st_unknown;
+		return;
+	}
+	Q = &seqs[seq];
+	if (capture_fp)
+		fprintf(capture_fp, "%.3f %d %s\n", (t - Q->sent_ns) / 1e6, tnc, tnc2);
+	if (Q->corrupt)
+		++st_corrupt_tx;
+	++Q->txcount;
+	if (Q->txmask & (1 << tnc)) {
+		++st_repeats;
+		return;
+	}
+	Q->txmask |= 1 << tnc;
+	lat[lat_count++] = t - Q->sent_ns;
+}
+
+static void tnc_read(struct sim_tnc *T, int64_t t)
+{
+	uint8_t buf[4096];
+	int n = read(T->fd, buf, sizeof(buf)), i;
+
+	for (i = 0; i < n; ++i) {
+		const int c = buf[i];
+		if (c == KISS_FEND) {
+			if (T->rdlen > 0)
+				captured(T, T->rdbuf, T->rdlen, t);
+			T->rdlen = 0;
+			T->rdesc = 0;
+			continue;
+		}
+		if (T->rdesc) {
+			T->rdesc = 0;
+			if (T->rdlen < sizeof(T->rdbuf))
+				T->rdbuf[T->rdlen++] = c == KISS_TFEND ? KISS_FEND : KISS_FESC;
+		} else if (c == KISS_FESC) {
+			T->rdesc = 1;
+		} else if (T->rdlen < sizeof(T->rdbuf)) {
+			T->rdbuf[T->rdlen++] = c;
+		}
+	}
+}
+
+/* Wait for the transmissions until 'until', or until a fd is ready */
+static void sim_poll(int64_t until)
+{
+	struct pollfd pfds[SIM_TNCS];
+	int64_t t = now_ns();
+	int i, ms = (until - t) / 1000000;
+
+	if (ms < 0)
+		ms = 0;
+	for (i = 0; i < tnc_count; ++i) {
+		pfds[i].fd     = tncs[i].fd;
+		pfds[i].events = POLLIN;
+	}
+	if (poll(pfds, tnc_count, ms) <= 0)
+		return;
+	t = now_ns();
+	for (i = 0; i < tnc_count; ++i)
+		if (pfds[i].revents & POLLIN)
+			tnc_read(&tncs[i], t);
+}
+
+/* The drop counters of aprx's receive and digipeater paths, and of
+   the KISS TX queues */
+static void aprx_drops(void)
+{
+	struct sockaddr_in sin;
+	static char buf[65536];
+	const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+	char *l;
+	int fd = socket(AF_INET, SOCK_STREAM, 0), len = 0, n;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family      = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port        = htons(metrics_port);
+	if (fd < 0 || connect(fd, (struct sockaddr *) &sin, sizeof(sin)) < 0 ||
+	    write(fd, req, sizeof(req) - 1) != sizeof(req) - 1) {
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	while (len < sizeof(buf) - 1 &&
+	       (n = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+		len += n;
+	close(fd);
+	buf[len] = 0;
+
+	for (l = strtok(buf, "\r\n"); l != NULL; l = strtok(NULL, "\r\n")) {
+		if ((strncmp(l, "aprx_rx_drop", 12) != 0 &&
+		     strncmp(l, "aprx_digi_drop", 14) != 0 &&
+		     strncmp(l, "aprx_kiss_txq_drops", 19) != 0) ||
+		    strcmp(strrchr(l, ' '), " 0") == 0)
+			continue;
+		printf("  aprx       %s\n", l + 5);
+	}
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+	const int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+static void report(int64_t elapsed)
+{
+	uint64_t expected = 0, got = 0, missing = 0, corrupt = 0;
+	uint64_t dupes = 0, dupe_tx = 0, dupe_silenced = 0;
+	int i, crc_lines = 1;
+
+	for (i = 0; i < seq_sent; ++i) {
+		const struct sim_seq *Q = &seqs[i];
+		int k, nt = 0;
+		for (k = 0; k < tnc_count; ++k)
+			nt += (Q->txmask >> k) & 1;
+		if (Q->corrupt) {
+			++corrupt;
+			continue;
+		}
+		expected += tnc_count;
+		got      += nt;
+		if (nt < tnc_count)
+			++missing;
+		if (Q->dupe_tnc >= 0 && Q->dupe_sent) {
+			++dupes;
+			if (Q->txcount > nt)
+				dupe_tx += Q->txcount - nt;
+			if (!(Q->txmask & (1 << Q->dupe_tnc)))
+				++dupe_silenced;
+		}
+	}
+	for (i = 0; i < tnc_count; ++i)
+		if (tncs[i].linetype == LINETYPE_KISS)
+			crc_lines = 0;
+
+	printf("tnc-sim: %d TNCs, %d frames in %.1f s, viscous-delay %d\n",
+	       tnc_count, seq_sent, elapsed / 1e9, opt_viscous);
+	for (i = 0; i < tnc_count; ++i) {
+		const struct sim_tnc *T = &tncs[i];
+		printf("  tnc %d %-12s %-8s injected %6llu  captured %6llu  bad crc %llu  other %llu\n",
+		       i, T->name, mode_name(T->linetype),
+		       (unsigned long long) T->injected, (unsigned long long) T->captured,
+		       (unsigned long long) T->bad_crc, (unsigned long long) T->other);
+	}
+	printf("  digipeats  %8llu of %llu  frames not on every TNC %llu, repeated %llu, unknown %llu\n",
+	       (unsigned long long) got, (unsigned long long) expected,
+	       (unsigned long long) missing, (unsigned long long) st_repeats,
+	       (unsigned long long) st_unknown);
+	printf("  corrupted  %8llu injected, %llu transmissions of them%s\n",
+	       (unsigned long long) corrupt, (unsigned long long) st_corrupt_tx,
+	       crc_lines ? "" : " (plain KISS has no CRC)");
+	if (dupes > 0)
+		printf("  dupes      %8llu heard again, %llu transmissions more, %llu not sent on the TNC that heard it again\n",
+		       (unsigned long long) dupes, (unsigned long long) dupe_tx,
+		       (unsigned long long) dupe_silenced);
+	if (lat_count > 0) {
+		double sum = 0;
+		qsort(lat, lat_count, sizeof(lat[0]), cmp_i64);
+		for (i = 0; i < lat_count; ++i)
+			sum += lat[i];
+		printf("  latency ms min %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f  mean %.3f\n",
+		       lat[0] / 1e6, lat[lat_count / 2] / 1e6,
+		       lat[(int) (lat_count * 0.90)] / 1e6, lat[(int) (lat_count * 0.99)] / 1e6,
+		       lat[lat_count - 1] / 1e6, sum / lat_count / 1e6);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *aprx_bin = NULL, *capture = NULL;
+	char dir[] = "/tmp/tnc-sim.XXXXXX", fname[200], logname[200];
+	int64_t t0, t, next, end;
+	int i, frames = 1000, dq = 0, status, rc = 0;
+	pid_t pid = -1;
+
+	while ((i = getopt(argc, argv, "x:c:m:n:r:e:D:G:V:W:o:")) != -1) {
+		switch (i) {
+		case 'x': aprx_bin = optarg; break;
+		case 'c': tnc_count = atoi(optarg); break;
+		case 'm':
+			if (parse_modes(optarg) < 0)
+				return 1;
+			break;
+		case 'n': frames = atoi(optarg); break;
+		case 'r': opt_rate = atof(optarg); break;
+		case 'e': opt_corrupt = atof(optarg); break;
+		case 'D': opt_dupes = atof(optarg); break;
+		case 'G': opt_gap = atoi(optarg); break;
+		case 'V': opt_viscous = atoi(optarg); break;
+		case 'W': opt_warmup = atoi(optarg); break;
+		case 'o': capture = optarg; break;
+		default:
+			fprintf(stderr, "Usage:  tnc-sim [-x aprx-binary] [-c tncs] [-m modes] [-n frames]\n"
+				"\t\t[-r frames/s] [-e pct] [-D pct] [-G ms] [-V secs]\n"
+				"\t\t[-W secs] [-o capture-file]\n");
+			return 1;
+		}
+	}
+	if (tnc_count < 1 || tnc_count > SIM_TNCS || frames < 1 || opt_rate <= 0) {
+		fprintf(stderr, "tnc-sim: 1..%d TNCs, and some frames at some rate\n", SIM_TNCS);
+		return 1;
+	}
+	if (opt_dupes > 0 && tnc_count < 2) {
+		fprintf(stderr, "tnc-sim: dupes need two TNCs\n");
+		return 1;
+	}
+	if (!modes_set)
+		parse_modes("smack");
+
+	setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT,  sig_die);
+	signal(SIGTERM, sig_die);
+	crc_init();
+	srandom(getpid());
+
+	if (capture != NULL && (capture_fp = fopen(capture, "w")) == NULL) {
+		perror(capture);
+		return 1;
+	}
+	metrics_port = free_port();
+	if (mkdtemp(dir) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+	for (i = 0; i < tnc_count; ++i)
+		if (open_tnc(&tncs[i]) < 0)
+			return 1;
+	snprintf(fname, sizeof(fname), "%s/aprx.conf", dir);
+	if (write_config(fname, dir) < 0)
+		return 1;
+
+	seq_count = frames;
+	seqs = calloc(seq_count, sizeof(*seqs));
+	lat  = calloc((size_t) seq_count * tnc_count, sizeof(*lat));
+	for (i = 0; i < seq_count; ++i) {
+		struct sim_seq *Q = &seqs[i];
+		Q->tnc      = i % tnc_count;
+		Q->corrupt  = random() % 10000 < opt_corrupt * 100;
+		Q->dupe_tnc = (!Q->corrupt && random() % 10000 < opt_dupes * 100)
+			? (Q->tnc + 1) % tnc_count : -1;
+	}
+
+	if (aprx_bin != NULL) {
+		snprintf(logname, sizeof(logname), "%s/aprx.out", dir);
+		pid = fork();
+		if (pid == 0) {
+			int fd = open(logname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd >= 0) {
+				dup2(fd, 1);
+				dup2(fd, 2);
+			}
+			execl(aprx_bin, aprx_bin, "-i", "-f", fname, (char *) NULL);
+			perror(aprx_bin);
+			_exit(1);
+		}
+		printf("tnc-sim: aprx pid %d on %s, its output in %s\n", (int) pid, fname, logname);
+	} else {
+		printf("tnc-sim: start  aprx -i -f %s  now\n", fname);
+	}
+
+	/* Let aprx open the TNCs, and take what it sends at the start */
+	end = now_ns() + opt_warmup * 1000000000LL;
+	while (!sim_die && (t = now_ns()) < end)
+		sim_poll(end);
+	for (i = 0; i < tnc_count; ++i)
+		tncs[i].captured = tncs[i].other = 0;
+
+	t0 = next = now_ns();
+	while (!sim_die && (seq_sent < seq_count || dq < seq_sent)) {
+		t = now_ns();
+		if (seq_sent < seq_count && next <= t) {
+			struct sim_seq *Q = &seqs[seq_sent];
+			Q->sent_ns = t;
+			++seq_sent;
+			inject(seq_sent - 1, Q->tnc, t);
+			next += (int64_t) (1e9 / opt_rate);
+		}
+		/* The dupes go in the order of their originals */
+		while (dq < seq_sent &&
+		       (seqs[dq].dupe_tnc < 0 || seqs[dq].sent_ns + opt_gap * 1000000LL <= t)) {
+			if (seqs[dq].dupe_tnc >= 0) {
+				inject(dq, seqs[dq].dupe_tnc, t);
+				seqs[dq].dupe_sent = 1;
+			}
+			++dq;
+		}
+		if (seq_sent < seq_count)
+			sim_poll(next);
+		else if (dq < seq_sent)
+			sim_poll(seqs[dq].sent_ns + opt_gap * 1000000LL);
+	}
+
+	/* What is still on its way, and in the viscous queues */
+	end = now_ns() + (opt_viscous + 3) * 1000000000LL;
+	while (!sim_die && now_ns() < end)
+		sim_poll(end);
+
+	report(now_ns() - t0);
+	aprx_drops();
+
+	if (pid > 0) {
+		if (waitpid(pid, &status, WNOHANG) == 0) {
+			kill(pid, SIGTERM);
+			waitpid(pid, &status, 0);
+		} else {
+			printf("tnc-sim: aprx had exited before the end\n");
+			rc = 1;
+		}
+		if (WIFSIGNALED(status) && WTERMSIG(status) != SIGTERM) {
+			printf("tnc-sim: aprx died on signal %d\n", WTERMSIG(status));
+			rc = 1;
+		}
+	}
+	if (capture_fp)
+		fclose(capture_fp);
+	for (i = 0; i < tnc_count; ++i) {
+		if (tncs[i].injected > 0 && tncs[i].captured == 0)
+			rc = 1;
+		close(tncs[i].fd);
+		close(tncs[i].slave);
+	}
+	return rc;
+}
@@ -0,0 +1,120 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+#include "aprx.h"
+
+/*
+ *  Packed 64-bit callsign keys, see callsign.h for the layout.
+ *
+ *  These are used as keys on tables that are consulted on every
+ *  received packet: historydb, dupecheck, filter callsign sets,
+ *  interface callsigns and aliases, erlang lines.  Comparing two
+ *  keys is one integer compare instead of a strcmp().
+ */
+
+static inline int is_ax25char(const int c)
+{
+	return (('A' <= c && c <= 'Z') || ('0' <= c && c <= '9'));
+}
+
+/* Text form for anything up to CALLSIGNLEN_MAX 7-bit chars */
+static callkey_t callkey_textform(const char *s, const int len)
+{
+	callkey_t k = CALLKEY_TEXTFORM;
+	int i;
+
+	if (len > CALLSIGNLEN_MAX)
+		return CALLKEY_NONE;
+	for (i = 0; i < len; ++i) {
+		const unsigned int c = (uint8_t)s[i];
+		if (c == 0 || c > 127)
+			return CALLKEY_NONE;
+		k |= ((callkey_t)c) << (7 * i);
+	}
+	return k;
+}
+
+callkey_t callkey_from_text(const char *s, int len)
+{
+	callkey_t k = 0;
+	int i, ssid = 0;
+
+	if (len <= 0)
+		return CALLKEY_NONE;
+
+	// AX.25 canonical form ?  "CALL" or "CALL-n" with n = 1..15
+	for (i = 0; i < len && i < 6; ++i) {
+		if (!is_ax25char(s[i]))
+			break;
+		k |= ((callkey_t)(uint8_t)s[i]) << (8 * i);
+	}
+	if (i == 0)
+		return callkey_textform(s, len);
+	if (i < len) {
+		const char *p = s + i;
+		const int   n = len - i;
+		if (*p != '-')
+			return callkey_textform(s, len);
+		if (n == 2 && '1' <= p[1] && p[1] <= '9') {
+			ssid = p[1] - '0';
+		} else if (n == 3 && p[1] == '1' && '0' <= p[2] && p[2] <= '5') {
+			ssid = 10 + p[2] - '0';
+		} else {
+			return callkey_textform(s, len);
+		}
+	}
+	for (; i < 6; ++i)
+		k |= ((callkey_t)' ') << (8 * i);
+
+	return k | (((callkey_t)ssid) << 48);
+}
+
+callkey_t callkey_from_text_uc(const char *s, int len)
+{
+	char buf[CALLSIGNLEN_MAX];
+	int i;
+
+	if (len <= 0 || len > CALLSIGNLEN_MAX)
+		return CALLKEY_NONE;
+	for (i = 0; i < len; ++i) {
+		char c = s[i];
+		if ('a' <= c && c <= 'z')
+			c -= ('a' - 'A');
+		buf[i] = c;
+	}
+	return callkey_from_text(buf, len);
+}
+
+/* The AX.25 address field bytes are ASCII shifted up by one bit,
+   the 7th byte carries SSID, and H-bit and address-end bits that
+   are ignored here.  Only frames that ax25_to_tnc2_fmtaddress()
+   would accept produce a key. */
+callkey_t callkey_from_ax25(const uint8_t *ax25)
+{
+	callkey_t k = 0;
+	int i, seen_space = 0;
+
+	for (i = 0; i < 6; ++i) {
+		const int c = ax25[i] >> 1;
+		if (ax25[i] & 1)
+			return CALLKEY_NONE; // Bad address-end flag
+		if (c == ' ' || c == 0) {
+			seen_space = 1;
+			k |= ((callkey_t)' ') << (8 * i);
+			continue;
+		}
+		if (seen_space || !is_ax25char(c))
+			return CALLKEY_NONE;
+		k |= ((callkey_t)c) << (8 * i);
+	}
+	if ((ax25[0] >> 1) == ' ' || ax25[0] == 0)
+		return CALLKEY_NONE; // Empty callsign
+
+	return k | (((callkey_t)((ax25[6] >> 1) & 0x0F)) << 48);
+}
@@ -0,0 +1,59 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+#ifndef CALLSIGN_H
+#define CALLSIGN_H
+
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+/*
+ *  Packed callsign keys.
+ *
+ *  A callsign in AX.25 sense is at most 6 characters of [A-Z0-9]
+ *  plus a SSID of 0..15.  Those fit in 52 bits:
+ *
+ *     bits  0..47  six characters, space padded, 8 bits each
+ *     bits 48..51  SSID
+ *
+ *  Names that are not valid AX.25 callsigns (APRS-IS logins,
+ *  object and item names, lower case text, ...) of at most
+ *  CALLSIGNLEN_MAX (9) 7-bit characters are stored with bit 63 set:
+ *
+ *     bits  0..62  nine characters, 7 bits each, NUL padded
+ *     bit  63      "text form" marker
+ *
+ *  Every text string maps to exactly one key, thus two keys are
+ *  equal only when the source strings are equal.  Text "OH2MQK-0"
+ *  is not AX.25 canonical (AX.25 decoder never prints "-0"), and
+ *  it is stored in text form.
+ *
+ *  Key value 0 (CALLKEY_NONE) means "not encodable" -- too long,
+ *  empty, or 8-bit content.  Users must fall back to string
+ *  comparisons with those.
+ */
+
+typedef uint64_t callkey_t;
+
+#define CALLKEY_NONE     ((callkey_t)0)
+#define CALLKEY_TEXTFORM (((callkey_t)1) << 63)
+
+extern callkey_t callkey_from_text(const char *s, int len);
+extern callkey_t callkey_from_text_uc(const char *s, int len); /* folds a-z to A-Z */
+extern callkey_t callkey_from_ax25(const uint8_t *ax25);       /* 7 byte address field */
+
+/* Bucket hash of a key, fold it further as needed. */
+static inline uint32_t callkey_hash(const callkey_t k)
+{
+	uint64_t h = k * 0x9E3779B97F4A7C15ULL; /* Fibonacci hashing */
+	return (uint32_t)(h >> 32);
+}
+
+#endif
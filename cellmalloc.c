@@ -79,6 +79,11 @@ int new_cellblock(cellarena_t *ca)
 	int i;
 	char *cb;
 
+#ifdef MEMDEBUG
+	/* At the limit, before making a block that could not be tracked */
+	if (ca->cellblocks_count >= CELLBLOCKS_MAX) return -1;
+#endif
+
 #ifdef MEMDEBUG /* External backing-store files, unique ones for each cellblock,
 		   which at Linux names memory blocks in  /proc/nnn/smaps "file"
 		   with this filename.. */
@@ -117,7 +122,6 @@ int new_cellblock(cellarena_t *ca)
 	  return -1;
 
 #ifdef MEMDEBUG
-	if (ca->cellblocks_count >= CELLBLOCKS_MAX) return -1;
 	ca->cellblocks[ca->cellblocks_count++] = cb;
 #endif
 
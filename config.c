@@ -282,6 +282,19 @@ static int logging_config(struct configfile *cf)
 	
 			erlanglogfile = strdup(param1);
 	
+		} else if (strcmp(name, "metrics-http") == 0) {
+			if (debug)
+				printf("%s:%d: INFO: METRICS-HTTP = '%s' '%s'\n",
+				       cf->name, cf->linenum, param1, str);
+			if (*str == 0) {
+				printf("%s:%d: ERROR: metrics-http needs an address and a port, like: 127.0.0.1 9101\n",
+				       cf->name, cf->linenum);
+				has_fault = 1;
+			} else {
+				config_SKIPTEXT(str, NULL);
+				openmetrics_config(param1, str);
+			}
+
 		} else if (strcmp(name, "erlang-log1min") == 0) {
 			if (debug)
 				printf("%s:%d: INFO: ERLANG-LOG1MIN\n",
@@ -10,6 +10,11 @@
 
 #include "aprx.h"
 
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(DISABLE_CRC_CLMUL)
+#include <wmmintrin.h>
+#define CRC_HAVE_CLMUL 1
+#endif
+
 
 /*
 	3 different CRC algorithms:
@@ -138,10 +143,8 @@ const uint16_t crc16_table[] = {
 	0x8201, 0x42c0, 0x4380, 0x8341,	0x4100, 0x81c1, 0x8081,	0x4040
 };
 
-uint16_t calc_crc_16(const uint8_t *buf, int n)
+static uint16_t crc16_bytewise(uint16_t crc, const uint8_t *buf, int n)
 {
-	uint16_t crc = 0;
-
 	while (--n >= 0) {
 		crc = (((crc >> 8) & 0xff) ^
 		       crc16_table[(crc ^ *buf++) & 0xFF]);
@@ -193,7 +196,7 @@ const uint16_t crc_ccitt_table[256] = {
         0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
 };
 
-uint16_t calc_crc_ccitt(uint16_t crc, const uint8_t *buffer, int len)
+static uint16_t crc_ccitt_bytewise(uint16_t crc, const uint8_t *buffer, int len)
 {
         while (len--) {
 		uint8_t c = *buffer++;
@@ -258,10 +261,8 @@ const uint16_t crc_flex_table[] = {
 	0x7440, 0x65c9, 0x5752, 0x46db, 0x3264, 0x23ed, 0x1176, 0x00ff
 };
 
-uint16_t calc_crc_flex(const uint8_t *cp, int size)
+static uint16_t crc_flex_bytewise(uint16_t crc, const uint8_t *cp, int size)
 {
-	uint16_t crc = 0xffff;
-
 	while (size--) {
 	  uint8_t c = *cp++;
 	  crc = (crc << 8) ^ crc_flex_table[((crc >> 8) ^ c) & 0xff];
@@ -284,3 +285,248 @@ int check_crc_flex(const uint8_t *cp, int size)
 	return 0;
 }
 #endif
+
+
+/*
+ *  Faster engines
+ *
+ *  Slicing-by-8:  eight bytes per round with eight 256 entry tables.
+ *  The tables are made at crc_init() by running the byte-wise code
+ *  above, thus they are right by construction also for the FLEXNET
+ *  CRC, which is not a textbook polynomial CRC (it runs the reflected
+ *  CCITT table MSB first, with a constant term).
+ *
+ *	G[k][x] = state after byte x followed by k zero bytes
+ *
+ *  Carry-less multiply (x86-64 PCLMULQDQ):  CRC-16 and CRC-CCITT are
+ *  true reflected CRCs, and longer buffers are folded 16 bytes per
+ *  round with x^191 and x^127 modulo the polynomial.  The remaining
+ *  128 bits and the tail go through the slicing code.  Chosen at run
+ *  time when the CPU has it.
+ */
+
+struct crc_slices {
+	uint16_t        G[8][256];
+	uint16_t        c8;	/* bytewise(0, 8 zero bytes) */
+	const uint16_t *T;	/* byte table for the tail */
+};
+
+static struct crc_slices crc16_slices;
+static struct crc_slices crc_ccitt_slices;
+static struct crc_slices crc_flex_slices;
+static int      crc_ready;
+
+typedef uint16_t (*crc_engine_t)(uint16_t crc, const uint8_t *buf, int len);
+
+static crc_engine_t crc16_engine      = crc16_bytewise;
+static crc_engine_t crc_ccitt_engine  = crc_ccitt_bytewise;
+static crc_engine_t crc_flex_engine   = crc_flex_bytewise;
+
+/* Reflected CRC, state injected at low byte */
+static inline uint16_t crc_slice8_lsb(const struct crc_slices *S, uint16_t crc,
+				      const uint8_t *buf, int len)
+{
+	while (len >= 8) {
+		crc ^= buf[0] | (buf[1] << 8);
+		crc = S->G[7][crc & 0xff] ^ S->G[6][crc >> 8] ^
+		      S->G[5][buf[2]] ^ S->G[4][buf[3]] ^ S->G[3][buf[4]] ^
+		      S->G[2][buf[5]] ^ S->G[1][buf[6]] ^ S->G[0][buf[7]] ^ S->c8;
+		buf += 8;
+		len -= 8;
+	}
+	for (; len > 0; --len)
+		crc = (crc >> 8) ^ S->T[(crc ^ *buf++) & 0xff];
+	return crc;
+}
+
+/* MSB first CRC, state injected at high byte */
+static inline uint16_t crc_slice8_msb(const struct crc_slices *S, uint16_t crc,
+				      const uint8_t *buf, int len)
+{
+	while (len >= 8) {
+		crc ^= (buf[0] << 8) | buf[1];
+		crc = S->G[7][crc >> 8] ^ S->G[6][crc & 0xff] ^
+		      S->G[5][buf[2]] ^ S->G[4][buf[3]] ^ S->G[3][buf[4]] ^
+		      S->G[2][buf[5]] ^ S->G[1][buf[6]] ^ S->G[0][buf[7]] ^ S->c8;
+		buf += 8;
+		len -= 8;
+	}
+	for (; len > 0; --len)
+		crc = (uint16_t)(crc << 8) ^ S->T[((crc >> 8) ^ *buf++) & 0xff];
+	return crc;
+}
+
+static uint16_t crc16_slice8(uint16_t crc, const uint8_t *buf, int len)
+{
+	return crc_slice8_lsb(&crc16_slices, crc, buf, len);
+}
+
+static uint16_t crc_ccitt_slice8(uint16_t crc, const uint8_t *buf, int len)
+{
+	return crc_slice8_lsb(&crc_ccitt_slices, crc, buf, len);
+}
+
+static uint16_t crc_flex_slice8(uint16_t crc, const uint8_t *buf, int len)
+{
+	return crc_slice8_msb(&crc_flex_slices, crc, buf, len);
+}
+
+/* The FLEXNET table has a constant term (T[0] != 0), so the slices
+   hold only the linear part, and the constant of a whole 8 byte
+   round is added back as c8.  For the true CRCs both are zero. */
+static void crc_make_slices(struct crc_slices *S, crc_engine_t bytewise,
+			    const uint16_t *T)
+{
+	uint8_t  block[8];
+	uint16_t zero[8];
+	int k, x;
+
+	memset(block, 0, sizeof(block));
+	for (k = 0; k < 8; ++k)
+		zero[k] = bytewise(0, block, k + 1);
+
+	for (x = 0; x < 256; ++x) {
+		block[0] = x;
+		for (k = 0; k < 8; ++k)
+			S->G[k][x] = bytewise(0, block, k + 1) ^ zero[k];
+	}
+	S->c8 = zero[7];
+	S->T  = T;
+}
+
+#ifdef CRC_HAVE_CLMUL
+
+static uint64_t crc16_fold_k[2], crc_ccitt_fold_k[2];
+
+/* x^n mod P, P given with its x^16 term */
+static uint32_t crc_xpow_mod(int n, const uint32_t poly)
+{
+	uint32_t r = 1;
+	while (n-- > 0) {
+		r <<= 1;
+		if (r & 0x10000)
+			r ^= poly;
+	}
+	return r;
+}
+
+/* Polynomial of degree < 16 in reflected 64 bit form: x^d at bit 63-d */
+static uint64_t crc_reflect64(const uint32_t r)
+{
+	uint64_t k = 0;
+	int d;
+	for (d = 0; d < 16; ++d)
+		if (r & (1U << d))
+			k |= 1ULL << (63 - d);
+	return k;
+}
+
+__attribute__((target("pclmul,sse2")))
+static uint16_t crc_fold_lsb(const uint64_t *k, const struct crc_slices *S,
+			     uint16_t crc, const uint8_t *buf, int len)
+{
+	const __m128i kk = _mm_set_epi64x(k[1], k[0]);
+	uint8_t  tmp[16];
+	__m128i  a;
+
+	if (len < 32)
+		return crc_slice8_lsb(S, crc, buf, len);
+
+	a = _mm_loadu_si128((const __m128i *)buf);
+	a = _mm_xor_si128(a, _mm_cvtsi32_si128(crc));
+	buf += 16;
+	len -= 16;
+	while (len >= 16) {
+		const __m128i b  = _mm_loadu_si128((const __m128i *)buf);
+		const __m128i lo = _mm_clmulepi64_si128(a, kk, 0x00);
+		const __m128i hi = _mm_clmulepi64_si128(a, kk, 0x11);
+		a = _mm_xor_si128(_mm_xor_si128(lo, hi), b);
+		buf += 16;
+		len -= 16;
+	}
+	_mm_storeu_si128((__m128i *)tmp, a);
+	crc = crc_slice8_lsb(S, 0, tmp, 16);
+	return crc_slice8_lsb(S, crc, buf, len);
+}
+
+static uint16_t crc16_clmul(uint16_t crc, const uint8_t *buf, int len)
+{
+	return crc_fold_lsb(crc16_fold_k, &crc16_slices, crc, buf, len);
+}
+
+static uint16_t crc_ccitt_clmul(uint16_t crc, const uint8_t *buf, int len)
+{
+	return crc_fold_lsb(crc_ccitt_fold_k, &crc_ccitt_slices, crc, buf, len);
+}
+
+static int crc_cpu_has_clmul(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul");
+}
+#endif
+
+void crc_init(void)
+{
+	if (crc_ready)
+		return;
+	crc_make_slices(&crc16_slices,     crc16_bytewise,     crc16_table);
+	crc_make_slices(&crc_ccitt_slices, crc_ccitt_bytewise, crc_ccitt_table);
+	crc_make_slices(&crc_flex_slices,  crc_flex_bytewise,  crc_flex_table);
+#ifdef CRC_HAVE_CLMUL
+	// Reflected polynomials 0xA001 and 0x8408 are these in normal order:
+	crc16_fold_k[0]     = crc_reflect64(crc_xpow_mod(191, 0x18005));
+	crc16_fold_k[1]     = crc_reflect64(crc_xpow_mod(127, 0x18005));
+	crc_ccitt_fold_k[0] = crc_reflect64(crc_xpow_mod(191, 0x11021));
+	crc_ccitt_fold_k[1] = crc_reflect64(crc_xpow_mod(127, 0x11021));
+#endif
+	crc_ready = 1;
+	crc_set_engine(CRC_ENGINE_BEST);
+}
+
+/* Returns the engine in use, it can be less than what was asked */
+int crc_set_engine(int engine)
+{
+	if (!crc_ready)
+		crc_init();
+
+#ifdef CRC_HAVE_CLMUL
+	if (engine >= CRC_ENGINE_CLMUL && crc_cpu_has_clmul()) {
+		crc16_engine     = crc16_clmul;
+		crc_ccitt_engine = crc_ccitt_clmul;
+		crc_flex_engine  = crc_flex_slice8;
+		return CRC_ENGINE_CLMUL;
+	}
+#endif
+	if (engine >= CRC_ENGINE_SLICE8) {
+		crc16_engine     = crc16_slice8;
+		crc_ccitt_engine = crc_ccitt_slice8;
+		crc_flex_engine  = crc_flex_slice8;
+		return CRC_ENGINE_SLICE8;
+	}
+	crc16_engine     = crc16_bytewise;
+	crc_ccitt_engine = crc_ccitt_bytewise;
+	crc_flex_engine  = crc_flex_bytewise;
+	return CRC_ENGINE_BYTEWISE;
+}
+
+uint16_t calc_crc_16(const uint8_t *buf, int n)
+{
+	if (!crc_ready)
+		crc_init();
+	return crc16_engine(0, buf, n);
+}
+
+uint16_t calc_crc_ccitt(uint16_t crc, const uint8_t *buf, int len)
+{
+	if (!crc_ready)
+		crc_init();
+	return crc_ccitt_engine(crc, buf, len);
+}
+
+uint16_t calc_crc_flex(const uint8_t *cp, int size)
+{
+	if (!crc_ready)
+		crc_init();
+	return crc_flex_engine(0xffff, cp, size);
+}
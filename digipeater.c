@@ -128,28 +128,16 @@ static int regex_filter_add(struct configfile *cf,
 
 	switch (groupcode) {
 		case 0:
-			src->sourceregscount += 1;
-			src->sourceregs = realloc(src->sourceregs,
-						src->sourceregscount * sizeof(void *));
-			src->sourceregs[src->sourceregscount - 1] = rep;
+			regexset_add(&src->sourceregs, param1, rep);
 			break;
 		case 1:
-			src->destinationregscount += 1;
-			src->destinationregs = realloc(src->destinationregs,
-						src->destinationregscount * sizeof(void *));
-			src->destinationregs[src->destinationregscount - 1] = rep;
+			regexset_add(&src->destinationregs, param1, rep);
 			break;
 		case 2:
-			src->viaregscount += 1;
-			src->viaregs = realloc(src->viaregs,
-					src->viaregscount * sizeof(void *));
-			src->viaregs[src->viaregscount - 1] = rep;
+			regexset_add(&src->viaregs, param1, rep);
 			break;
 		case 3:
-			src->dataregscount += 1;
-			src->dataregs = realloc(src->dataregs,
-						src->dataregscount * sizeof(void *));
-			src->dataregs[src->dataregscount - 1] = rep;
+			regexset_add(&src->dataregs, param1, rep);
 			break;
 	}
 	return 0; // OK state
@@ -183,8 +171,17 @@ static int match_tracewide(const char *via, const struct tracewide *twp)
 static int match_aliases(const char *via, struct aprx_interface *txif)
 {
 	int i;
+	const callkey_t key = callkey_from_text(via, strlen(via));
+
+	if (key == CALLKEY_NONE || txif->aliaskeys == NULL) {
+		for (i = 0; i < txif->aliascount; ++i) {
+			if (strcmp(via, txif->aliases[i]) == 0)
+				return 1;
+		}
+		return 0;
+	}
 	for (i = 0; i < txif->aliascount; ++i) {
-		if (strcmp(via, txif->aliases[i]) == 0)
+		if (key == txif->aliaskeys[i])
 			return 1;
 	}
 	return 0;
@@ -307,8 +304,19 @@ static int match_transmitter(const char *viafield,
 		const int lastviachar)
 {
 	struct aprx_interface *aif = src->parent->transmitter;
-	int tlen = strlen(aif->callsign);
+	int tlen, vlen;
+
+	if (aif->callkey != CALLKEY_NONE) {
+		vlen = strlen(viafield);
+		if (lastviachar != 0) {
+			if (vlen == 0 || viafield[vlen-1] != lastviachar)
+				return 0;
+			--vlen;
+		}
+		return (callkey_from_text(viafield, vlen) == aif->callkey);
+	}
 
+	tlen = strlen(aif->callsign);
 	if (memcmp(viafield, aif->callsign, tlen) == 0) {
 		if (viafield[tlen] == lastviachar)
 			return 1;
@@ -317,56 +325,365 @@ static int match_transmitter(const char *viafield,
 	return 0;
 }
 
+/*
+ *  Via hop classification.
+ *
+ *  Every via hop of every packet is compared against the transmitter
+ *  callsign, the transmitter aliases, and the four trace/wide key
+ *  lists (source specific and digipeater-wide ones).  At the end of
+ *  <digipeater> configuration these are put into one hash table per
+ *  <source>, keyed by packed callsign key.  A hop is then classified
+ *  by looking up its whole text, its text without the H-bit star,
+ *  and the text before each "n-" / trailing "n" of it.  For the usual
+ *  "WIDE2-1" that is three probes into one table instead of a memcmp()
+ *  against each key and a strcmp() against each alias.
+ *
+ *  Should any key not fit in a callkey_t, the table is marked
+ *  'linear' and the original match_*() functions are used.
+ *
+ *  The via fields of a frame are classified on their AX.25 form,
+ *  classify_hop_key(), without making text of them:  the key of the
+ *  whole field, and the keys of the texts before "n-" / trailing "n"
+ *  come from callkey_from_ax25() by masking.  The text form is made
+ *  only for via regex filters, the TRACE/WIDE hop counting, and the
+ *  debug output.
+ */
+
+#define HOPF_ALIAS     0x01 // transmitter alias
+#define HOPF_MYCALL    0x02 // transmitter callsign
+
+#define TWRANK_NONE    0xFFFFFFFFU
+
+// Trace/wide lists in the order they are tried
+#define TWLIST_SRC_TRACE  0
+#define TWLIST_DIGI_TRACE 1
+#define TWLIST_SRC_WIDE   2
+#define TWLIST_DIGI_WIDE  3
+
+struct digi_hopent {
+	callkey_t key;
+	uint32_t  twrank; // (list << 16) | keyindex of first trace/wide key
+	int       flags;
+};
+
+struct digi_hoptable {
+	int    linear;
+	int    mask;
+	struct digi_hopent *slots;
+};
+
+struct hopclass {
+	int mycall_h;   // transmitter callsign with H-bit star
+	int mycall;     // transmitter callsign without star
+	int alias;      // transmitter alias
+	int twlist;     // TWLIST_*, or -1
+	int twlen;      // matched trace/wide key length
+};
+
+static struct digi_hopent *hoptable_slot(const struct digi_hoptable *ht, const callkey_t key)
+{
+	int i = callkey_hash(key) & ht->mask;
+	while (ht->slots[i].key != CALLKEY_NONE) {
+		if (ht->slots[i].key == key)
+			return &ht->slots[i];
+		i = (i + 1) & ht->mask;
+	}
+	return &ht->slots[i];
+}
+
+static int hoptable_insert(struct digi_hoptable *ht, const char *s, const uint32_t twrank, const int flags)
+{
+	struct digi_hopent *he;
+	const int len = strlen(s);
+	const callkey_t key = callkey_from_text(s, len);
+
+	if (key == CALLKEY_NONE)
+		return -1;
+	// Texts that classify_hop_key() would not make out of a via field
+	if (strchr(s, '*') != NULL || (len > 0 && s[len-1] == '-'))
+		return -1;
+	he = hoptable_slot(ht, key);
+	if (he->key == CALLKEY_NONE) {
+		he->key    = key;
+		he->twrank = TWRANK_NONE;
+	}
+	if (twrank < he->twrank)
+		he->twrank = twrank;
+	he->flags |= flags;
+	return 0;
+}
+
+static struct digi_hoptable *hoptable_build(const struct digipeater_source *src)
+{
+	const struct digipeater *digi = src->parent;
+	const struct aprx_interface *txif = digi->transmitter;
+	const struct tracewide *lists[4];
+	struct digi_hoptable *ht = calloc(1, sizeof(*ht));
+	int i, l, n, size;
+
+	lists[TWLIST_SRC_TRACE]  = src->src_trace;
+	lists[TWLIST_DIGI_TRACE] = digi->trace;
+	lists[TWLIST_SRC_WIDE]   = src->src_wide;
+	lists[TWLIST_DIGI_WIDE]  = digi->wide;
+
+	n = 1 + txif->aliascount;
+	for (l = 0; l < 4; ++l)
+		if (lists[l] != NULL)
+			n += lists[l]->nkeys;
+	for (size = 16; size < 2*n; size <<= 1)
+		;
+	ht->mask  = size - 1;
+	ht->slots = calloc(size, sizeof(*ht->slots));
+
+	if (hoptable_insert(ht, txif->callsign, TWRANK_NONE, HOPF_MYCALL))
+		ht->linear = 1;
+	for (i = 0; i < txif->aliascount; ++i)
+		if (hoptable_insert(ht, txif->aliases[i], TWRANK_NONE, HOPF_ALIAS))
+			ht->linear = 1;
+	for (l = 0; l < 4; ++l) {
+		if (lists[l] == NULL) continue;
+		for (i = 0; i < lists[l]->nkeys; ++i)
+			if (lists[l]->keylens[i] == 0 ||
+			    hoptable_insert(ht, lists[l]->keys[i], (l << 16) | i, 0))
+				ht->linear = 1;
+	}
+	if (debug > 1)
+		printf(" .. hop table of %d keys in %d slots%s\n",
+		       n, size, ht->linear ? ", using linear match" : "");
+	return ht;
+}
+
+static void hoptable_free(struct digi_hoptable *ht)
+{
+	if (ht == NULL) return;
+	free(ht->slots);
+	free(ht);
+}
+
+static const struct digi_hopent *hoptable_lookup(const struct digi_hoptable *ht, const char *s, const int len)
+{
+	const struct digi_hopent *he;
+	const callkey_t key = callkey_from_text(s, len);
+
+	if (key == CALLKEY_NONE)
+		return NULL;
+	he = hoptable_slot(ht, key);
+	return (he->key == CALLKEY_NONE) ? NULL : he;
+}
+
+static void classify_hop_linear(const char *viafield,
+		const struct digipeater_source *src,
+		struct hopclass *hc)
+{
+	const struct digipeater *digi = src->parent;
+
+	hc->mycall_h = match_transmitter(viafield, src, '*');
+	hc->mycall   = match_transmitter(viafield, src, 0);
+	hc->alias    = match_aliases(viafield, digi->transmitter);
+	hc->twlist   = -1;
+	if ((hc->twlen = match_tracewide(viafield, src->src_trace))) {
+		hc->twlist = TWLIST_SRC_TRACE;
+	} else if ((hc->twlen = match_tracewide(viafield, digi->trace))) {
+		hc->twlist = TWLIST_DIGI_TRACE;
+	} else if ((hc->twlen = match_tracewide(viafield, src->src_wide))) {
+		hc->twlist = TWLIST_SRC_WIDE;
+	} else if ((hc->twlen = match_tracewide(viafield, digi->wide))) {
+		hc->twlist = TWLIST_DIGI_WIDE;
+	}
+}
+
+static void classify_hop(const char *viafield,
+		const struct digipeater_source *src,
+		struct hopclass *hc)
+{
+	const struct digi_hoptable *ht = src->hoptable;
+	const struct digi_hopent *he;
+	const int vlen = strlen(viafield);
+	uint32_t twrank = TWRANK_NONE;
+	int i;
+
+	if (ht == NULL || ht->linear) {
+		classify_hop_linear(viafield, src, hc);
+		return;
+	}
+	memset(hc, 0, sizeof(*hc));
+	hc->twlist = -1;
+
+	// Whole field: callsign, alias, or a bare trace/wide key
+	he = hoptable_lookup(ht, viafield, vlen);
+	if (he != NULL) {
+		hc->mycall = (he->flags & HOPF_MYCALL) != 0;
+		hc->alias  = (he->flags & HOPF_ALIAS)  != 0;
+		if (he->twrank != TWRANK_NONE) {
+			twrank    = he->twrank;
+			hc->twlen = vlen;
+		}
+	}
+	// Field with H-bit star
+	if (vlen > 1 && viafield[vlen-1] == '*') {
+		he = hoptable_lookup(ht, viafield, vlen-1);
+		if (he != NULL)
+			hc->mycall_h = (he->flags & HOPF_MYCALL) != 0;
+	}
+	// Trace/wide key followed by "n-" or by trailing "n"
+	for (i = 1; i < vlen; ++i) {
+		if (viafield[i] < '1' || viafield[i] > '7')
+			continue;
+		if (viafield[i+1] != '-' && viafield[i+1] != 0)
+			continue;
+		he = hoptable_lookup(ht, viafield, i);
+		if (he != NULL && he->twrank < twrank) {
+			twrank    = he->twrank;
+			hc->twlen = i;
+		}
+	}
+	if (twrank != TWRANK_NONE)
+		hc->twlist = twrank >> 16;
+	else
+		hc->twlen = 0;
+}
+
+#define CALLKEY_CHARS(k) ((k) & 0xFFFFFFFFFFFFULL)
+#define CALLKEY6(s) ((callkey_t)(s)[0]       | (callkey_t)(s)[1] << 8  | \
+		     (callkey_t)(s)[2] << 16 | (callkey_t)(s)[3] << 24 | \
+		     (callkey_t)(s)[4] << 32 | (callkey_t)(s)[5] << 40)
+
+// Key of the first 'len' characters of an AX.25 key, SSID 0
+static inline callkey_t callkey_prefix(const callkey_t key, const int len)
+{
+	const callkey_t spaces = CALLKEY6("      ");
+	const callkey_t mask   = (((callkey_t)1) << (8 * len)) - 1;
+	return (key & mask) | (spaces & ~mask & CALLKEY_CHARS(~(callkey_t)0));
+}
+
+// Callsign length of an AX.25 key
+static inline int callkey_chars(const callkey_t key)
+{
+	int n = 0;
+	while (n < 6 && ((key >> (8 * n)) & 0xFF) != ' ')
+		++n;
+	return n;
+}
+
+/*
+ *  classify_hop() on the AX.25 key of a via field, for a hop table
+ *  that is not 'linear'.  The same lookups as of the text:
+ *
+ *	"CALL-n"	whole field, when it has no H-bit
+ *	"CALL"		without the star, when it has
+ *	"WIDE"		of "WIDE2-1", or of "WIDE2" without star
+ *	"CALL-1"	of "CALL-1n" without star
+ *
+ *  A "CALL-" of "CALL-n" can only match a key that ends in '-', and
+ *  hoptable_insert() keeps those out of non-linear tables.
+ */
+static void classify_hop_key(const callkey_t key, const int hbit,
+		const struct digipeater_source *src,
+		struct hopclass *hc)
+{
+	const struct digi_hoptable *ht = src->hoptable;
+	const struct digi_hopent *he;
+	const int ssid = (int) (key >> 48) & 0x0F;
+	const int clen = callkey_chars(key);
+	const int last = (int) (key >> (8 * (clen - 1))) & 0xFF;
+	uint32_t twrank = TWRANK_NONE;
+
+	memset(hc, 0, sizeof(*hc));
+	hc->twlist = -1;
+
+	he = hoptable_slot(ht, key);
+	if (he->key == CALLKEY_NONE)
+		he = NULL;
+	if (he != NULL && hbit) {
+		hc->mycall_h = (he->flags & HOPF_MYCALL) != 0;
+	} else if (he != NULL) {
+		hc->mycall = (he->flags & HOPF_MYCALL) != 0;
+		hc->alias  = (he->flags & HOPF_ALIAS)  != 0;
+		if (he->twrank != TWRANK_NONE) {
+			twrank    = he->twrank;
+			hc->twlen = clen + (ssid >= 10 ? 3 : ssid ? 2 : 0);
+		}
+	}
+	if (clen > 1 && '1' <= last && last <= '7' && (ssid != 0 || !hbit)) {
+		he = hoptable_slot(ht, callkey_prefix(key, clen - 1));
+		if (he->key != CALLKEY_NONE && he->twrank < twrank) {
+			twrank    = he->twrank;
+			hc->twlen = clen - 1;
+		}
+	}
+	if (ssid >= 11 && !hbit) {
+		he = hoptable_slot(ht, CALLKEY_CHARS(key) | (((callkey_t)1) << 48));
+		if (he->key != CALLKEY_NONE && he->twrank < twrank) {
+			twrank    = he->twrank;
+			hc->twlen = clen + 2;
+		}
+	}
+	if (twrank != TWRANK_NONE)
+		hc->twlist = twrank >> 16;
+	else
+		hc->twlen = 0;
+}
+
+// Text of a via field that has a key, as ax25_to_tnc2_fmtaddress()
+// and the H-bit star would make it
+static void hop_text(char *buf, const callkey_t key, const int hbit)
+{
+	const int ssid = (int) (key >> 48) & 0x0F;
+	const int clen = callkey_chars(key);
+	int i;
+
+	for (i = 0; i < clen; ++i)
+		*buf++ = (key >> (8 * i)) & 0xFF;
+	if (ssid) {
+		*buf++ = '-';
+		if (ssid >= 10)
+			*buf++ = '1';
+		*buf++ = '0' + ssid % 10;
+	}
+	if (hbit)
+		*buf++ = '*';
+	*buf = 0;
+}
+
+// The fixed part of try_reject_filters() on a via field key
+static int try_reject_via_key(const callkey_t key)
+{
+	const callkey_t chars = CALLKEY_CHARS(key);
+
+	return (chars == CALLKEY6("MYCALL") ||
+		chars == CALLKEY6("N0CALL") ||
+		chars == CALLKEY6("NOCALL"));
+}
+
 static int try_reject_filters(const int  fieldtype,
 		const char *field,
 		struct digipeater_source *src)
 {
-	int i;
-	int stat = 0;
 	switch (fieldtype) {
 		case 0: // Source
-			for (i = 0; i < src->sourceregscount; ++i) {
-				stat = regexec(src->sourceregs[i],
-						field, 0, NULL, 0);
-				if (stat == 0)
-					return 1;       /* MATCH! */
-			}
+			if (regexset_match(src->sourceregs, field))
+				return 1;       /* MATCH! */
 			if (memcmp("MYCALL",field,6)==0) return 1;
 			if (memcmp("N0CALL",field,6)==0) return 1;
 			if (memcmp("NOCALL",field,6)==0) return 1;
 			break;
 		case 1: // Destination
-
-			for (i = 0; i < src->destinationregscount; ++i) {
-				int stat = regexec(src->destinationregs[i],
-						field, 0, NULL, 0);
-				if (stat == 0)
-					return 1;       /* MATCH! */
-			}
+			if (regexset_match(src->destinationregs, field))
+				return 1;       /* MATCH! */
 			if (memcmp("MYCALL",field,6)==0) return 1;
 			if (memcmp("N0CALL",field,6)==0) return 1;
 			if (memcmp("NOCALL",field,6)==0) return 1;
 			break;
 		case 2: // Via
-
-			for (i = 0; i < src->viaregscount; ++i) {
-				int stat = regexec(src->viaregs[i],
-						field, 0, NULL, 0);
-				if (stat == 0)
-					return 1;       /* MATCH! */
-			}
+			if (regexset_match(src->viaregs, field))
+				return 1;       /* MATCH! */
 			if (memcmp("MYCALL",field,6)==0) return 1;
 			if (memcmp("N0CALL",field,6)==0) return 1;
 			if (memcmp("NOCALL",field,6)==0) return 1;
 			break;
 		case 3: // Data
-
-			for (i = 0; i < src->dataregscount; ++i) {
-				int stat = regexec(src->dataregs[i],
-						field, 0, NULL, 0);
-				if (stat == 0)
-					return 1;       /* MATCH! */
-			}
+			if (regexset_match(src->dataregs, field))
+				return 1;       /* MATCH! */
 			break;
 		default:
 			if (debug)
@@ -374,30 +691,28 @@ static int try_reject_filters(const int  fieldtype,
 						fieldtype);
 			return 1;
 	}
-	if (stat != 0 && stat != REG_NOMATCH) {
-		// Some odd reason for an error?
-
-	}
 	return 0;
 }
 
-/* Parse executed and requested WIDEn-N/TRACEn-N info */
-static int parse_tnc2_hops(struct digistate *state,
+/* Parse executed and requested WIDEn-N/TRACEn-N info
+   from the binary AX.25 address fields */
+static int parse_ax25_hops(struct digistate *state,
 		struct digipeater_source *src,
 		struct pbuf_t *pb)
 {
-	const char *p = pb->dstcall_end+1;
-	const char *s;
-	const struct digipeater *digi = src->parent;
-	const char *lastviastar;
+	const uint8_t *axaddr = pb->ax25addr + 2*AX25ADDRLEN;
+	const uint8_t *axend  = pb->ax25addr + pb->ax25addrlen;
+	const uint8_t *lasthbit = NULL;
+	const uint8_t *a;
 	char viafield[15]; // temp buffer for many uses
 	int have_fault = 0;
 	int viaindex = 1; // First via index will be 2..
 	int activeviacount = 0;
 	int len;
 	int digiok;
+	struct hopclass hc;
 
-	if (debug>1) printf(" hops count of buffer: %s\n",p);
+	if (debug>1) printf(" hops count of buffer: %s\n",pb->dstcall_end+1);
 
 	if (src->src_relaytype == DIGIRELAY_THIRDPARTY) {
 		state->v.hopsreq = 1; // Bonus for tx-igated 3rd-party frames
@@ -430,65 +745,54 @@ static int parse_tnc2_hops(struct digistate *state,
 		return 1; // Dest reject filters
 	}
 
-	// Where is the last via-field with a star on it?
-	len = pb->info_start - p; if (len < 0) len=0;
-	lastviastar = memrchr(p, len, '*');
+	// Where is the last via-field with H-bit on it?
+	for (a = axaddr; a < axend; a += AX25ADDRLEN)
+		if (a[AX25ADDRLEN-1] & AX25HBIT)
+			lasthbit = a;
 
 	// Loop over VIA fields to see if we need to digipeat anything.
-	while (p < pb->info_start && !have_fault) {
-		len = 0;
-
-		if (*p == ':') {
-			// A round may stop at ':' found at the end of the processed field,
-			// then next round finds it at the start of the field.
-			break;
-		}
-
-		// Scan for a VIA field ...
-		for (s = p; s < pb->info_start; ++s) {
-			if (*s == ',' || *s == ':') {
-				// ... until comma or double-colon.
+	for (; axaddr < axend && !have_fault; axaddr += AX25ADDRLEN) {
+		const callkey_t key = callkey_from_ax25(axaddr);
+		// Some digipeaters set the H-bit only on the last field they
+		// processed, but this digi code logic needs it at every VIA
+		// field up to the last one where it is set.
+		const int hbit = (lasthbit != NULL && axaddr <= lasthbit);
+		// Text form of the field only when something needs to see it.
+		// A field with a key has no lower case, so no q-construct.
+		const int textform = (key == CALLKEY_NONE || debug > 1 ||
+				      src->viaregs != NULL ||
+				      src->hoptable == NULL || src->hoptable->linear);
+
+		*viafield = 0;
+		if (textform) {
+			// ax25_format_to_tnc() has validated these already
+			if (ax25_to_tnc2_fmtaddress(viafield, axaddr, 0) < 0) {
+				have_fault = 1;
 				break;
 			}
-		}
-		// [p..s) is now one VIA field.
-		if (s == p && *p != ':') {  // BAD!
-			have_fault = 1;
-			if (debug>1) printf(" S==P ");
-			break;
-		}
-		if (*p == 'q') break; // APRSIS q-constructs..
-		++viaindex;
-
-		// Pick-up a viafield to separate buffer for processing
-		len = s-p;
-		if (len >= sizeof(viafield)) len = sizeof(viafield)-2;
-		memcpy(viafield, p, len);
-		viafield[len] = 0;
-		if (*s == ',') ++s;
-		p = s;
-
-		// Only last via field with H-bit is indicated at TNC2 format,
-		// but this digi code logic needs it at every VIA field where
-		// it is set.  Therefore this crooked way to add it to picked
-		// up fields.
-		if (strchr(viafield,'*') == NULL) {
-			// If it exists somewhere, and we are not yet at it..
-			if (lastviastar != NULL && p < lastviastar)
+			if (*viafield == 'q') break; // APRSIS q-constructs..
+			if (hbit)
 				strcat(viafield,"*"); // we do know that there is space for this.
 		}
+		++viaindex;
 
 		if (debug>1) printf(" - ViaField[%d]: '%s'\n", viaindex, viafield);
 
 		// VIA-field picked up, now analyze it..
 
-		if (try_reject_filters(2, viafield, src)) {
+		if (textform ? try_reject_filters(2, viafield, src)
+			     : try_reject_via_key(key)) {
 			if (debug>1) printf(" - Via filters reject\n");
 			return 1; // via reject filters
 		}
 
+		if (textform)
+			classify_hop(viafield, src, &hc);
+		else
+			classify_hop_key(key, hbit, src, &hc);
+
 		// Transmitter callsign match with H-flag set.
-		if (match_transmitter(viafield, src, '*')) {
+		if (hc.mycall_h) {
 			if (debug>1) printf(" - Tx match reject\n");
 			// Oops, LOOP!  I have transmit this in past
 			// (according to my transmitter callsign present
@@ -498,7 +802,7 @@ static int parse_tnc2_hops(struct digistate *state,
 
 		// If there is no '*' meaning this has not been
 		// processed, then this is active field..
-		if (strchr(viafield, '*') == NULL)
+		if (!hbit)
 			++activeviacount;
 
 		digiok = 0;
@@ -506,9 +810,7 @@ static int parse_tnc2_hops(struct digistate *state,
 		// If first active field (without '*') matches
 		// transmitter or alias, then this digi is accepted
 		// regardless if it is APRS or some other protocol.
-		if (activeviacount == 1 &&
-				(match_transmitter(viafield, src, 0) ||
-				 match_aliases(viafield, digi->transmitter))) {
+		if (activeviacount == 1 && (hc.mycall || hc.alias)) {
 			if (debug>1) printf(" - Tx match accept!\n");
 			state->v.hopsreq  += 1;
 			state->v.tracereq += 1;
@@ -518,25 +820,28 @@ static int parse_tnc2_hops(struct digistate *state,
 		// .. otherwise following rules are applied only to APRS packets.
 		if (pb->is_aprs) {
 
-			if ((len = match_tracewide(viafield, src->src_trace))) {
+			if (hc.twlist >= 0 && !textform)
+				hop_text(viafield, key, hbit);
+			len = hc.twlen;
+			if (hc.twlist == TWLIST_SRC_TRACE) {
 				// Match source specific list of trace aliases
 				if (debug>1) printf("Trace (src specific)\n");
 				have_fault = count_single_tnc2_tracewide(&state->v, viafield, 1, len, viaindex);
 				if (!have_fault)
 					digiok = 1;
-			} else if ((len = match_tracewide(viafield, digi->trace))) {
+			} else if (hc.twlist == TWLIST_DIGI_TRACE) {
 				// Match digipeater-wide list of trace aliases
 				if (debug>1) printf("Trace (global)\n");
 				have_fault = count_single_tnc2_tracewide(&state->v, viafield, 1, len, viaindex);
 				if (!have_fault)
 					digiok = 1;
-			} else if ((len = match_tracewide(viafield, src->src_wide))) {
+			} else if (hc.twlist == TWLIST_SRC_WIDE) {
 				// Match source specific list of non-trace aliases
 				if (debug>1) printf("Trace (src-specific, non-trace)\n");
 				have_fault = count_single_tnc2_tracewide(&state->v, viafield, 0, len, viaindex);
 				if (!have_fault)
 					digiok = 1;
-			} else if ((len = match_tracewide(viafield, digi->wide))) {
+			} else if (hc.twlist == TWLIST_DIGI_WIDE) {
 				// Match digipeater-wide list of non-trace aliases
 				if (debug>1) printf("Trace (global, non-trace)\n");
 				have_fault = count_single_tnc2_tracewide(&state->v, viafield, 0, len, viaindex);
@@ -545,7 +850,7 @@ static int parse_tnc2_hops(struct digistate *state,
 			} else {
 				// No match on trace or wide, but if there was earlier
 				// match on interface or alias, then it set "digiok" for us.
-				state->v.digidone += (int) (strchr(viafield,'*') != NULL);
+				state->v.digidone += hbit;
 				if (debug>1) printf("Trace (non-alias) digi=%d\n",state->v.digidone);
 			}
 		}
@@ -586,6 +891,7 @@ static void free_tracewide(struct tracewide *twp)
 static void free_source(struct digipeater_source *src)
 {
 	if (src == NULL) return;
+	hoptable_free(src->hoptable);
 	free(src);
 }
 
@@ -932,13 +1238,13 @@ static struct digipeater_source *digipeater_config_source(struct configfile *cf)
 		source->tokenbucket   = source->tbf_limit;
 
 		// RE pattern reject filters
-		source->sourceregscount      = regexsrc.sourceregscount;
+		regexset_compile(regexsrc.sourceregs);
+		regexset_compile(regexsrc.destinationregs);
+		regexset_compile(regexsrc.viaregs);
+		regexset_compile(regexsrc.dataregs);
 		source->sourceregs           = regexsrc.sourceregs;
-		source->destinationregscount = regexsrc.destinationregscount;
 		source->destinationregs      = regexsrc.destinationregs;
-		source->viaregscount         = regexsrc.viaregscount;
 		source->viaregs              = regexsrc.viaregs;
-		source->dataregscount        = regexsrc.dataregscount;
 		source->dataregs             = regexsrc.dataregs;
 
 	} else {
@@ -946,7 +1252,10 @@ static struct digipeater_source *digipeater_config_source(struct configfile *cf)
 		free_tracewide(source_trace);
 		free_tracewide(source_wide);
 		// filters_free(filters);
-		// free regexsrc's allocations
+		regexset_free(regexsrc.sourceregs);
+		regexset_free(regexsrc.destinationregs);
+		regexset_free(regexsrc.viaregs);
+		regexset_free(regexsrc.dataregs);
 		if (debug)
 			printf("Seen errors at <digipeater><source> definition.\n");
 	}
@@ -1174,6 +1483,9 @@ int digipeater_config(struct configfile *cf)
 		digi->sourcecount   = sourcecount;
 		digi->sources       = sources;
 
+		for ( i = 0; i < sourcecount; ++i )
+			sources[i]->hoptable = hoptable_build(sources[i]);
+
 		digis = realloc( digis, sizeof(void*) * (digi_count+1));
 		digis[digi_count] = digi;
 		++digi_count;
@@ -1217,7 +1529,7 @@ static int decrement_ssid(uint8_t *ax25addr)
 
 static void digipeater_receive_backend(struct digipeater_source *src, struct pbuf_t *pb)
 {
-	int len, viaindex;
+	int viaindex;
 	struct digistate state;
 	struct viastate  viastate;
 	struct digipeater *digi = src->parent;
@@ -1233,10 +1545,11 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 	//     verified)
 
 	// Parse executed and requested WIDEn-N/TRACEn-N info
-	if (parse_tnc2_hops(&state, src, pb)) {
+	if (parse_ax25_hops(&state, src, pb)) {
 		// A fault was observed! -- tests include "not this transmitter"
 		if (debug>1)
 			printf("Parse_tnc2_hops rejected this.");
+		metric_add(METRIC_DIGI_DROP_HOPS, 1);
 		return;
 	}
 
@@ -1253,6 +1566,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 				// Source relaytype is DIRECTONLY, and this was not
 				// likely directly heard...
 				if (debug>1) printf("DIRECTONLY -mode, and packet is probably not direct heard.");
+				metric_add(METRIC_DIGI_DROP_FILTER, 1);
 				return;
 			}
 		}
@@ -1261,6 +1575,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 		if (try_reject_filters(3, pb->info_start, src)) {
 			if (debug>1)
 				printf(" - Data body regexp filters reject\n");
+			metric_add(METRIC_DIGI_DROP_FILTER, 1);
 			return; // data body regexp reject filters
 		}
 
@@ -1274,6 +1589,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 	// packets...
 	if (state.v.hopsreq <= state.v.hopsdone) {
 		if (debug>1) printf(" No remaining hops to execute.\n");
+		metric_add(METRIC_DIGI_DROP_HOPS, 1);
 		return;
 	}
 	if (state.v.hopsreq   > digi->trace->maxreq  ||
@@ -1287,6 +1603,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 		if (debug) printf(" Packet exceeds digipeat limits\n");
 		if (!state.v.probably_heard_direct) {
 			if (debug) printf(".. discard.\n");
+			metric_add(METRIC_DIGI_DROP_HOPS, 1);
 			return;
 		} else {
 			state.v.fixall = 1;
@@ -1329,17 +1646,13 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 	viaindex = 1; // First via field is number 2
 	*viafield = 0; // clear that buffer for starters
 	for (; axaddr < e; axaddr += AX25ADDRLEN, ++viaindex) {
-		ax25_to_tnc2_fmtaddress(viafield, axaddr, 0);
-		// if (debug>1) {
-		//   printf(" via: %s", viafield);
-		// }
-
 		// Initial parsing said that things are seriously wrong..
 		// .. and we will digipeat the packet with all H-bits set.
 		if (state.v.fixall) axaddr[AX25ADDRLEN-1] |= AX25HBIT;
 
-		if (!(axaddr[AX25ADDRLEN-1] & AX25HBIT)) // No "Has Been Digipeated" bit set
+		if (!(axaddr[AX25ADDRLEN-1] & AX25HBIT)) { // No "Has Been Digipeated" bit set
 			break; // this doesn't happen in "fixall" mode
+		}
 	}
 
 	switch (src->src_relaytype) {
@@ -1360,10 +1673,32 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 		//                label telling that the message originated on other band
 
 		// 7) WIDEn-N treatment (as well as transmitter matching digi)
+		const callkey_t key = callkey_from_ax25(axaddr);
+		const int textform = (key == CALLKEY_NONE || debug ||
+				      digi->transmitter->callkey == CALLKEY_NONE ||
+				      src->hoptable == NULL || src->hoptable->linear);
+		int is_transmitter;
+		struct hopclass hc;
+
+		// Text form only for the field of interest, and only
+		// when something needs to see it
+		if (textform)
+			ax25_to_tnc2_fmtaddress(viafield, axaddr, 0);
+
+		is_transmitter =
+			(digi->transmitter->callkey != CALLKEY_NONE) ?
+			(key == digi->transmitter->callkey) :
+			(strcmp(viafield,digi->transmitter->callsign) == 0);
+
+		if (textform)
+			classify_hop(viafield, src, &hc);
+		else
+			classify_hop_key(key, 0, src, &hc);
+
 		if (pb->digi_like_aprs) {
-			if (strcmp(viafield,digi->transmitter->callsign) == 0 ||
+			if (is_transmitter ||
 					// Match on the transmitter callsign without the star...
-					match_aliases(viafield, digi->transmitter)) {
+					hc.alias) {
 				// .. or match transmitter interface alias.
 
 				// Treat it as a TRACE request.
@@ -1373,19 +1708,17 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 				memcpy(axaddr, digi->transmitter->ax25call, AX25ADDRLEN);
 				axaddr[AX25ADDRLEN-1] |= (AX25HBIT | aterm); // Set H-bit
 
-			} else if ((len = match_tracewide(viafield, src->src_trace))) {
-				count_single_tnc2_tracewide(&viastate, viafield, 1, len, viaindex);
-			} else if ((len = match_tracewide(viafield, digi->trace))) {
-				count_single_tnc2_tracewide(&viastate, viafield, 1, len, viaindex);
-			} else if ((len = match_tracewide(viafield, src->src_wide))) {
-				count_single_tnc2_tracewide(&viastate, viafield, 0, len, viaindex);
-			} else if ((len = match_tracewide(viafield, digi->wide))) {
-				count_single_tnc2_tracewide(&viastate, viafield, 0, len, viaindex);
+			} else if (hc.twlist >= 0) {
+				const int istrace = (hc.twlist == TWLIST_SRC_TRACE ||
+						     hc.twlist == TWLIST_DIGI_TRACE);
+				if (!textform)
+					hop_text(viafield, key, 0);
+				count_single_tnc2_tracewide(&viastate, viafield, istrace, hc.twlen, viaindex);
 			}
 
 		} else { // Not "digi_as_aprs" rules
 
-			if (strcmp(viafield,digi->transmitter->callsign) == 0) {
+			if (is_transmitter) {
 				// Match on the transmitter callsign without the star.
 				// Treat it as a TRACE request.
 				int aterm = axaddr[AX25ADDRLEN-1] & AX25ATERM; // save old address termination bit
@@ -1393,7 +1726,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 				memcpy(axaddr, digi->transmitter->ax25call, AX25ADDRLEN);
 				axaddr[AX25ADDRLEN-1] |= (AX25HBIT | aterm); // Set H-bit
 
-			} else if (match_aliases(viafield, digi->transmitter)) {
+			} else if (hc.alias) {
 				// Match on the aliases.
 				// Treat it as a TRACE request.
 				int aterm = axaddr[AX25ADDRLEN-1] & AX25ATERM; // save old address termination bit
@@ -1411,6 +1744,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 			int newssid;
 			if (state.ax25addrlen >= AX25ADDRMAXLEN) {
 				if (debug) printf(" TRACE overgrows the VIA fields! Discard.\n");
+				metric_add(METRIC_DIGI_DROP_HOPS, 1);
 				return;
 			}
 
@@ -1465,6 +1799,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 		if (hcell != NULL) {
 			if (hcell->tokenbucket < 1.0) {
 				if (debug) printf("TRANSMITTER SOURCE CALLSIGN RATELIMIT DISCARD.\n");
+				metric_add(METRIC_DIGI_DROP_RATELIMIT, 1);
 				return;
 			}
 			hcell->tokenbucket -= 1.0;
@@ -1474,6 +1809,7 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 		// Now we do token bucket filtering -- rate limiting
 		if (digi->tokenbucket < 1.0) {
 			if (debug) printf("TRANSMITTER RATELIMIT DISCARD.\n");
+			metric_add(METRIC_DIGI_DROP_RATELIMIT, 1);
 			return;
 		}
 		digi->tokenbucket -= 1.0;
@@ -1515,10 +1851,23 @@ static void digipeater_receive_backend(struct digipeater_source *src, struct pbu
 		}
 	}
 
+	// Time from the read() of the frame to here, by the path it took
+	if (pb->rx_ns != 0) {
+		int path = METRIC_HIST_PATH_RF_RF;
+		if (src->src_if->iftype == IFTYPE_APRSIS)
+			path = METRIC_HIST_PATH_IS_RF;
+		else if (src->viscous_delay > 0)
+			path = METRIC_HIST_PATH_RF_RF_VISCOUS;
+		metric_observe(path, monotonic_ns() - pb->rx_ns);
+	}
+
+	APRX_PROBE4(digi__tx, digi->transmitter->callsign, src->src_if->callsign,
+		    pb->data, pb->packet_len);
+
 	// Feed to interface_transmit_ax25() with new header and body
-	interface_transmit_ax25( digi->transmitter,
+	interface_transmit_ax25_ts( digi->transmitter,
 			state.ax25addr, state.ax25addrlen,
-			(const char*)pb->ax25data, pb->ax25datalen );
+			(const char*)pb->ax25data, pb->ax25datalen, pb->rx_ns );
 	if (debug>1) printf("Done.\n");
 }
 
@@ -1538,6 +1887,7 @@ void digipeater_receive( struct digipeater_source *src,
 
 	if (src->tokenbucket < 1.0) {
 		if (debug) printf("SOURCE RATELIMIT DISCARD\n");
+		metric_add(METRIC_DIGI_DROP_RATELIMIT, 1);
 		return;
 	}
 	src->tokenbucket -= 1.0;
@@ -1558,6 +1908,7 @@ void digipeater_receive( struct digipeater_source *src,
 		if (dupe == NULL) {  // Oops.. allocation error!
 			if (debug)
 				printf("digipeater_receive() - dupecheck_pbuf() allocation error, packet discarded\n");
+			metric_add(METRIC_DIGI_DROP_NOMEM, 1);
 			return;
 		}
 
@@ -1579,6 +1930,7 @@ void digipeater_receive( struct digipeater_source *src,
 				// N:th direct packet, duplicate.
 				// Drop this direct packet.
 				if (debug>1) printf(".. discarded\n");
+				metric_add(METRIC_DIGI_DROP_DUPE, 1);
 				return;
 			}
 
@@ -1589,6 +1941,7 @@ void digipeater_receive( struct digipeater_source *src,
 				// handling did process it sometime in past.
 				// Drop this direct packet.
 				if (debug>1) printf(".. discarded\n");
+				metric_add(METRIC_DIGI_DROP_DUPE, 1);
 				return;
 			}
 
@@ -1620,6 +1973,7 @@ void digipeater_receive( struct digipeater_source *src,
 				if (debug>1)
 					printf("Seen this packet %d times. Discarding it.\n",
 							dupe->delayed_seen + dupe->seen);
+				metric_add(METRIC_DIGI_DROP_DUPE, 1);
 				return;
 			}
 
@@ -1648,6 +2002,7 @@ void digipeater_receive( struct digipeater_source *src,
 
 				}
 				if (debug>1) printf(".. discarded\n");
+				metric_add(METRIC_DIGI_DROP_DUPE, 1);
 				return;
 			}
 
@@ -1667,6 +2022,8 @@ void digipeater_receive( struct digipeater_source *src,
 
 			if (debug) printf("%ld ENTER VISCOUS QUEUE: len=%d pbuf=%p\n",
 					tick.tv_sec, src->viscous_queue_size, pb);
+			APRX_PROBE3(viscous__enqueue, src->src_if->callsign,
+				    pb->data, src->viscous_queue_size);
 			return; // Put on viscous queue
 
 		} 
@@ -1709,6 +2066,7 @@ static void digipeater_resettime(void *arg)
 int  digipeater_prepoll(struct aprxpolls *app)
 {
 	int d, s;
+	long viscous = 0;
 
 	if (tokenbucket_timer.tv_sec == 0) {
 		tokenbucket_timer = tick; // init this..
@@ -1748,6 +2106,7 @@ int  digipeater_prepoll(struct aprxpolls *app)
 			// Delay is non-zero, perhaps there is work?
 			if (src->viscous_queue_size == 0) // Empty queue
 				continue;
+			viscous += src->viscous_queue_size;
 			// First entry expires first
 			tv.tv_sec = src->viscous_queue[0]->t + src->viscous_delay;
 			tv.tv_usec = 0;
@@ -1757,6 +2116,7 @@ int  digipeater_prepoll(struct aprxpolls *app)
 			}
 		}
 	}
+	metric_set(METRIC_DIGI_VISCOUS, viscous);
 
 	return 0;
 }
@@ -1794,6 +2154,8 @@ int  digipeater_postpoll(struct aprxpolls *app)
 				if ((t - tick.tv_sec) <= 0) {
 					if (debug)printf("%ld LEAVE VISCOUS QUEUE: dupe=%p pbuf=%p\n",
 							tick.tv_sec, dupe, dupe->pbuf);
+					APRX_PROBE2(viscous__release, src->src_if->callsign,
+						    dupe->pbuf != NULL);
 					if (dupe->pbuf != NULL) {
 						// We send the pbuf from viscous queue, if it still is
 						// present in the dupe record.  (For example direct sourced
@@ -1876,6 +2238,46 @@ static void sourcecalltick(struct digipeater *digi)
 }
 #endif
 
+/*
+ *  digipeater_openmetrics()  -- token buckets of transmitters and
+ *  their sources, see openmetrics.c
+ */
+void digipeater_openmetrics(struct ombuf *ob)
+{
+	static const char *const what[4] = {
+		"digi_tokens", "digi_tokens_limit",
+		"digi_source_tokens", "digi_source_tokens_limit"
+	};
+	int w, d, s;
+
+	for (w = 0; w < 4; ++w) {
+		ombuf_printf(ob, "# TYPE aprx_%s gauge\n", what[w]);
+		for (d = 0; d < digi_count; ++d) {
+			struct digipeater *digi = digis[d];
+			const char *tx = digi->transmitter->callsign;
+
+			if (w < 2) {
+				ombuf_printf(ob, "aprx_%s{transmitter=\"", what[w]);
+				ombuf_label(ob, tx, strlen(tx));
+				ombuf_printf(ob, "\"} %.2f\n",
+					     w == 0 ? digi->tokenbucket : digi->tbf_limit);
+				continue;
+			}
+			for (s = 0; s < digi->sourcecount; ++s) {
+				struct digipeater_source *src = digi->sources[s];
+				const char *sc = src->src_if->callsign;
+
+				ombuf_printf(ob, "aprx_%s{transmitter=\"", what[w]);
+				ombuf_label(ob, tx, strlen(tx));
+				ombuf_printf(ob, "\",source=\"");
+				ombuf_label(ob, sc, strlen(sc));
+				ombuf_printf(ob, "\"} %.2f\n",
+					     w == 2 ? src->tokenbucket : src->tbf_limit);
+			}
+		}
+	}
+}
+
 // An utility function that exists at GNU Libc..
 
 #if !defined(HAVE_MEMRCHR) && !defined(_FOR_VALGRIND_)
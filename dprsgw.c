@@ -685,7 +685,7 @@ static void dprsgw_nmea_igate( const struct aprx_interface *aif,
           if (aif != NULL) {
             igate_to_aprsis( aif->callsign, 0, (const char *)tnc2buf, tnc2addrlen, tnc2buflen, 0, 0);
           // Bytes have been counted previously, now count meaningful packet
-            erlang_add(aif->callsign, ERLANG_RX, 0, 1);
+            interface_erlang_add(aif, ERLANG_RX, 0, 1);
           }
 
           char *heads[2];
@@ -745,7 +745,7 @@ static void dprsgw_rxigate( struct serialport *S )
 	    // Acceptable packet, Rx-iGate it!
 	    igate_to_aprsis( aif->callsign, 0, (const char *)tnc2addr, tnc2addrlen, tnc2bodylen, 0, 0);
           // Bytes have been counted previously, now count meaningful packet
-            erlang_add( aif->callsign, ERLANG_RX, 0, 1 );
+            interface_erlang_add(aif, ERLANG_RX, 0, 1 );
 
 	    heads[0] = (char*)tnc2addr;
 	    s = heads[0];
@@ -860,7 +860,7 @@ int dprsgw_pulldprs( struct serialport *S )
 	int i;
 
         // Account all received bytes, this may or may not be a packet
-        erlang_add(aif->callsign, ERLANG_RX, S->rdlinelen, 0);
+        interface_erlang_add(aif, ERLANG_RX, S->rdlinelen, 0);
 
 
 	if (S->dprsgw == NULL)
@@ -49,7 +49,10 @@ void dupecheck_init(void)
 				    duperecord_size,
 				    duperecord_align,
 				    CELLMALLOC_POLICY_LIFO | CELLMALLOC_POLICY_NOMUTEX,
-				    4 /* 4 kB at the time */,
+				    // 128 records at the time: the arena has at
+				    // most 40 blocks, and that has to hold 30
+				    // seconds of a busy channel, some 5000 records
+				    (128 * duperecord_size + 1023) / 1024,
 				    0 /* minfree */);
 #endif
 }
@@ -172,6 +175,49 @@ static void dupecheck_cleanup(void)
 	//       cleancount, dupecheck_cellgauge );
 }
 
+/*
+ *	Canonic address is "SRC>DEST".  Pack both callsigns into keys
+ *	so that the address compare is two integer compares; when
+ *	either one does not pack, both keys are CALLKEY_NONE and the
+ *	address is hashed and compared as a string.
+ */
+static uint32_t dupecheck_addrhash(const char *addr, const int addrlen,
+				   callkey_t *srckeyp, callkey_t *dstkeyp)
+{
+	const char *gt = memchr(addr, '>', addrlen);
+	callkey_t srckey = CALLKEY_NONE, dstkey = CALLKEY_NONE;
+
+	if (gt != NULL) {
+		srckey = callkey_from_text(addr, gt - addr);
+		dstkey = callkey_from_text(gt+1, addrlen - (gt+1 - addr));
+	}
+	if (srckey == CALLKEY_NONE || dstkey == CALLKEY_NONE) {
+		*srckeyp = *dstkeyp = CALLKEY_NONE;
+		return keyhash(addr, addrlen, 0);
+	}
+	*srckeyp = srckey;
+	*dstkeyp = dstkey;
+	return callkey_hash(srckey) ^ (callkey_hash(dstkey) * 31);
+}
+
+static inline int dupecheck_samerecord(const dupe_record_t *dp,
+				       const callkey_t srckey, const callkey_t dstkey,
+				       const char *addr, const int addrlen,
+				       const char *data, const int datalen)
+{
+	if (dp->plen != datalen)
+		return 0;
+	if (srckey != CALLKEY_NONE) {
+		if (dp->srckey != srckey || dp->dstkey != dstkey)
+			return 0;
+	} else if (dp->srckey != CALLKEY_NONE ||
+		   dp->alen != addrlen ||
+		   memcmp(addr, dp->addresses, addrlen) != 0) {
+		return 0;
+	}
+	return (memcmp(data, dp->packet, datalen) == 0);
+}
+
 /*
  *	Check a single packet for duplicates in APRS sense
  *	The addr/alen must be in TNC2 monitor format, data/dlen
@@ -189,6 +235,7 @@ dupe_record_t *dupecheck_aprs(dupecheck_t *dpc,
 	int addrlen;  // length of the address part
 	int datalen;  // length of the payload
 	uint32_t hash, idx;
+	callkey_t srckey, dstkey;
 	dupe_record_t **dpp, *dp;
 
 	// 1) collect canonic rep of the address (SRC,DEST, no VIAs)
@@ -219,7 +266,7 @@ dupe_record_t *dupecheck_aprs(dupecheck_t *dpc,
 
 	// 2) calculate checksum (from disjoint memory areas)
 
-	hash = keyhash(addr, addrlen, 0);
+	hash = dupecheck_addrhash(addr, addrlen, &srckey, &dstkey);
 	hash = keyhash(data, datalen, hash);
 	idx  = hash;
 
@@ -243,12 +290,12 @@ dupe_record_t *dupecheck_aprs(dupecheck_t *dpc,
 		}
 		if (dp->hash == hash) {
 			// HASH match!  And not too old!
-			if (dp->alen == addrlen &&
-			    dp->plen == datalen &&
-			    memcmp(addr, dp->addresses, addrlen) == 0 &&
-			    memcmp(data, dp->packet,    datalen) == 0) {
+			if (dupecheck_samerecord(dp, srckey, dstkey,
+						 addr, addrlen, data, datalen)) {
 				// PACKET MATCH!
+				metric_add(METRIC_DUPECHECK_HITS, 1);
 				dp->seen += 1;
+				APRX_PROBE3(dupecheck__hit, hash, dp->seen + dp->delayed_seen, 0);
 				return dp;
 			}
 			// no packet match.. check next
@@ -266,11 +313,14 @@ dupe_record_t *dupecheck_aprs(dupecheck_t *dpc,
 
 	memcpy(dp->addresses, addr, addrlen);
 	memcpy(dp->packet,    data, datalen);
+	dp->srckey = srckey;
+	dp->dstkey = dstkey;
 
 	dp->seen  = 1;  // First observation gets number 1
 	dp->hash  = hash;
 	dp->t     = tick.tv_sec;
 	dp->t_exp = tick.tv_sec + dpc->storetime;
+	APRX_PROBE2(dupecheck__miss, hash, 0);
 	return NULL;
 }
 
@@ -283,6 +333,7 @@ dupe_record_t *dupecheck_pbuf(dupecheck_t *dpc, struct pbuf_t *pb, const int vis
 {
 	int i;
 	uint32_t hash, idx;
+	callkey_t srckey, dstkey;
 	dupe_record_t **dpp, *dp;
 	const char *addr = pb->data;
 	int   alen = pb->dstcall_end - addr;
@@ -363,7 +414,7 @@ dupe_record_t *dupecheck_pbuf(dupecheck_t *dpc, struct pbuf_t *pb, const int vis
 	  printf("'\n");
 	} */
 
-	hash = keyhash(addr, addrlen, 0);
+	hash = dupecheck_addrhash(addr, addrlen, &srckey, &dstkey);
 	hash = keyhash(data, datalen, hash);
 	idx  = hash;
 
@@ -396,15 +447,15 @@ dupe_record_t *dupecheck_pbuf(dupecheck_t *dpc, struct pbuf_t *pb, const int vis
 		}
 		if (dp->hash == hash) {
 			// HASH match!  And not too old!
-			if (dp->alen == addrlen &&
-			    dp->plen == datalen &&
-			    memcmp(addr, dp->addresses, addrlen) == 0 &&
-			    memcmp(data, dp->packet,    datalen) == 0) {
+			if (dupecheck_samerecord(dp, srckey, dstkey,
+						 addr, addrlen, data, datalen)) {
 				// PACKET MATCH!
+				metric_add(METRIC_DUPECHECK_HITS, 1);
 				if (viscous_delay > 0)
 				  dp->delayed_seen += 1;
 				else
 				  dp->seen += 1;
+				APRX_PROBE3(dupecheck__hit, hash, dp->seen + dp->delayed_seen, viscous_delay);
 				return dp;
 			}
 			// no packet match.. check next
@@ -424,6 +475,8 @@ dupe_record_t *dupecheck_pbuf(dupecheck_t *dpc, struct pbuf_t *pb, const int vis
 
 	memcpy(dp->addresses, addr, addrlen);
 	memcpy(dp->packet,    data, datalen);
+	dp->srckey = srckey;
+	dp->dstkey = dstkey;
 
 	dp->pbuf  = pbuf_get(pb); // increments refcount
 	if (viscous_delay > 0) {  // First observation gets number 1
@@ -438,6 +491,7 @@ dupe_record_t *dupecheck_pbuf(dupecheck_t *dpc, struct pbuf_t *pb, const int vis
 	dp->hash  = hash;
 	dp->t     = tick.tv_sec;
 	dp->t_exp = tick.tv_sec + dpc->storetime;
+	APRX_PROBE2(dupecheck__miss, hash, viscous_delay);
 
 	return dp;
 }
@@ -463,7 +517,9 @@ int dupecheck_prepoll(struct aprxpolls *app)
 
 	if (dupecheck_cleanup_nexttime.tv_sec == 0) dupecheck_cleanup_nexttime = tick;
 
-	if (tv_timercmp(&dupecheck_cleanup_nexttime, &app->next_timeout) > 0)
+	metric_set(METRIC_DUPECHECK_CELLS, dupecheck_cellgauge);
+
+	if (tv_timercmp(&dupecheck_cleanup_nexttime, &app->next_timeout) < 0)
 		app->next_timeout = dupecheck_cleanup_nexttime;
 
 	return 0;		/* No poll descriptors, only time.. */
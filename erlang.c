@@ -20,23 +20,28 @@
    intervals, and reports them on verbout.. */
 
 
-/* #define USE_ONE_MINUTE_INTERVAL 1 */
+/* Ring sizes of the series, see APRXERL_*_COUNT */
+#define ERLANG_RING(n) ((n) > 0 ? (n) + 1 : 0)
 
+static const uint32_t erlang_series_period[ERLANG_SERIES_MAX] = {
+	60, 600, 3600
+};
+static const uint32_t erlang_series_slots[ERLANG_SERIES_MAX] = {
+	ERLANG_RING(APRXERL_1M_COUNT),
+	ERLANG_RING(APRXERL_10M_COUNT),
+	ERLANG_RING(APRXERL_60M_COUNT)
+};
 
-static struct timeval erlang_time_end_1min;
-static float erlang_time_ival_1min = 1.0;
-
-static struct timeval erlang_time_end_10min;
-static float erlang_time_ival_10min = 1.0;
+static struct timeval erlang_period_end[ERLANG_SERIES_MAX];
+static float erlang_time_ival[ERLANG_SERIES_MAX] = { 1.0, 1.0, 1.0 };
 
-#ifdef ERLANGSTORAGE
-static struct timeval erlang_time_end_60min;
-static float erlang_time_ival_60min = 1.0;
-#endif
+/* Period in progress of each series, and its ring slot.
+   Every line is advanced to these together, thus accounting
+   needs no per-line time arithmetic. */
+static int64_t erlang_cur_period[ERLANG_SERIES_MAX];
+static int     erlang_cur_slot[ERLANG_SERIES_MAX];
 
-#ifdef ERLANGSTORAGE
-static const char *erlangtitle = "APRX SNMP + Erlang dataset\n";
-#endif
+static int64_t erlang_wallclock;	/* time(NULL) of this poll round */
 
 int erlangsyslog;		/* if set, will log via syslog(3)  */
 int erlanglog1min;		/* if set, will log also "ERLANG1" interval  */
@@ -46,241 +51,390 @@ const char *erlang_backingstore = VARRUN "/aprx.state";
 
 #ifdef ERLANGSTORAGE
 static int erlang_file_fd = -1;
-static int erlang_mmap_size;
+static size_t erlang_mmap_size;
+static int erlang_metrics_attached;
+
+/* Address space for the largest store.  The file is mapped at its
+   start every time, so ErlangHead and the metrics region stay put. */
+#define ERLANG_MMAP_RESERVE	((size_t)64 << 20)
+static void *erlang_reserve;
 #endif
 
-static void *erlang_mmap;
+static void *erlang_mmap;	/* the file, or malloc()ed store */
 
 struct erlanghead *ErlangHead;
 struct erlangline **ErlangLines;
 int ErlangLinesCount;
 int erlang_data_is_nonshared;	/* In embedded target.. */
 
-struct erlang_file {
-	struct erlanghead head;
-	struct erlangline lines[1];
-};
+/* Packed keys of ErlangLines[] names, kept privately so that
+   the shared file layout stays unchanged. */
+static callkey_t *ErlangKeys;
+static int        ErlangKeysCount;
 
-static void erlang_backingstore_startops(void)
+/* Bumped when ErlangLines[] is loaded anew, see erlang_add_h() */
+static int        erlang_generation = 1;
+
+
+/* Header of the store that this program writes.  The metrics
+   region is there only in a file, see metrics.c */
+static void erlang_head_init(struct erlanghead *H, int with_metrics)
 {
-	ErlangHead->server_pid = getpid();
-	ErlangHead->start_time = time(NULL);
+	uint32_t ring = 0;
+	int s;
+
+	memset(H, 0, sizeof(*H));
+	memcpy(H->magic, ERLANG_STORE_MAGIC, sizeof(H->magic));
+	H->version       = ERLANG_STORE_VERSION;
+	H->head_size     = sizeof(struct erlanghead);
+	if (with_metrics) {
+		H->metrics_offset = H->head_size;
+		H->metrics_size   = metrics_region_size();
+		H->head_size     += H->metrics_size;
+	}
+	H->linehead_size = sizeof(struct erlangline);
+	H->series_count  = ERLANG_SERIES_MAX;
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s) {
+		H->series_period[s] = erlang_series_period[s];
+		H->series_slots[s]  = erlang_series_slots[s];
+		ring += erlang_series_slots[s];
+	}
+	H->line_size = H->linehead_size + ring * ERLANG_COLUMNS * sizeof(uint32_t);
+}
 
-	if (!mycall)
-		strncpy(ErlangHead->mycall, "N0CALL",
-			sizeof(ErlangHead->mycall));
-	else
-		strncpy(ErlangHead->mycall, mycall,
-			sizeof(ErlangHead->mycall));
-	ErlangHead->mycall[sizeof(ErlangHead->mycall) - 1] = 0;	/* NUL terminate */
+#ifdef ERLANGSTORAGE
+/* Is the header sane for a store of 'size' bytes ?  A writer
+   wants also the same geometry as what it would create. */
+static int erlang_head_ok(const struct erlanghead *H, uint64_t size, int writer)
+{
+	uint64_t ring = 0;
+	int s;
+
+	if (size < sizeof(*H) ||
+	    memcmp(H->magic, ERLANG_STORE_MAGIC, sizeof(H->magic)) != 0 ||
+	    H->version != ERLANG_STORE_VERSION ||
+	    H->series_count != ERLANG_SERIES_MAX)
+		return 0;
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s) {
+		if (H->series_slots[s] > 0 && H->series_period[s] == 0)
+			return 0;
+		ring += H->series_slots[s];
+	}
+	if (H->head_size < sizeof(struct erlanghead) ||
+	    H->linehead_size < sizeof(struct erlangline) ||
+	    H->linehead_size + ring * ERLANG_COLUMNS * sizeof(uint32_t) > H->line_size ||
+	    H->head_size + (uint64_t)H->linecount * H->line_size > size)
+		return 0;
+	if (H->metrics_size > 0 &&
+	    (H->metrics_offset < sizeof(struct erlanghead) ||
+	     (uint64_t)H->metrics_offset + H->metrics_size > H->head_size))
+		return 0;
+	if (writer) {
+		struct erlanghead W;
+		erlang_head_init(&W, 1);
+		if (H->head_size != W.head_size ||
+		    H->metrics_offset != W.metrics_offset ||
+		    H->metrics_size != W.metrics_size ||
+		    H->line_size != W.line_size ||
+		    H->linehead_size != W.linehead_size ||
+		    memcmp(H->series_period, W.series_period, sizeof(W.series_period)) != 0 ||
+		    memcmp(H->series_slots, W.series_slots, sizeof(W.series_slots)) != 0)
+			return 0;
+	}
+	return 1;
 }
+#endif
 
-static int erlang_backingstore_grow(int do_create, int add_count)
+/* Point ErlangLines[] at the lines of the store */
+static void erlang_lines_index(void)
 {
-	struct erlang_file *EF;
+	char *base = (char *) ErlangHead + ErlangHead->head_size;
 	int i;
-#ifdef ERLANGSTORAGE
-	struct stat st;
-	char buf[256];
-	int new_size, pagesize = sysconf(_SC_PAGE_SIZE);
-	int doing_init = 0;
 
-	if (erlang_data_is_nonshared)
-		goto embedded_only;
-
-	if (erlang_file_fd < 0) {
-		goto embedded_only;
-	}
-
-	fstat(erlang_file_fd, &st);
-	lseek(erlang_file_fd, 0, SEEK_END);
+	ErlangLinesCount = ErlangHead->linecount;
+	ErlangLines = realloc(ErlangLines,
+			      (ErlangLinesCount + 1) * sizeof(void *));
+	for (i = 0; i < ErlangLinesCount; ++i)
+		ErlangLines[i] = (struct erlangline *)
+			(base + (size_t) i * ErlangHead->line_size);
+}
 
-	new_size = st.st_size;
+/* Column 'col' ring of the series on line E */
+static uint32_t *erlang_ring(const struct erlangline *E, int series, int col)
+{
+	size_t off = ErlangHead->linehead_size;
+	int s;
 
-	if (new_size % pagesize) {
-		new_size /= pagesize;
-		++new_size;
-		new_size *= pagesize;
-	}
-	if (new_size == 0) {
-		new_size = pagesize;
-		doing_init = 1;
-	}
-	/* new_size expanded to be exact page size multiple.  */
-
-	/* If the new size is larger than the file size..
-	   .. and at least one page size (e.g. 4 kB) .. */
-
-	if (new_size > st.st_size) {
-		/* .. then we fill in the file to given size.  */
-		int i, rc, l;
-		i = st.st_size;
-		memset(buf, 0, sizeof(buf));
-		lseek(erlang_file_fd, 0, SEEK_END);
-		while (i < new_size) {
-			l = sizeof(buf);
-			if (new_size - i < l)
-				l = new_size - i;
-			rc = write(erlang_file_fd, buf, l);
-			if (rc < 0 && errno == EINTR)
-				continue;
-			if (rc != l)
-				break;
-			i += rc;
-		}
-	}
+	for (s = 0; s < series; ++s)
+		off += ErlangHead->series_slots[s] * ERLANG_COLUMNS * sizeof(uint32_t);
+	off += ErlangHead->series_slots[series] * col * sizeof(uint32_t);
+	return (uint32_t *) ((char *) E + off);
+}
 
-      redo_open:;
+/*
+ *  erlang_column()  -- ring of one counter, index it with erlang_slot()
+ */
+const uint32_t *erlang_column(const struct erlangline *E, int series, int col)
+{
+	return erlang_ring(E, series, col);
+}
 
-	if (erlang_mmap) {
-		msync(erlang_mmap, erlang_mmap_size, MS_SYNC);
-		munmap(erlang_mmap, erlang_mmap_size);
-		erlang_mmap = NULL;
-		erlang_mmap_size = 0;
-		ErlangHead = NULL;
-	}
+int erlang_slots(int series)
+{
+	if (!ErlangHead || series < 0 || series >= ERLANG_SERIES_MAX)
+		return 0;
+	return ErlangHead->series_slots[series];
+}
 
-	/* Some (early Linux) systems mmap() offset on IO pointer... */
-	lseek(erlang_file_fd, 0, SEEK_SET);
-	fstat(erlang_file_fd, &st);
+/*
+ *  erlang_slot()  -- ring slot of the period 'age' periods before the
+ *		      one in progress (age 0), or -1 when there is no
+ *		      data on it.
+ */
+int erlang_slot(const struct erlangline *E, int series, int age)
+{
+	const int slots = erlang_slots(series);
+	int64_t p;
+
+	if (age < 0 || age >= slots || E->period[series] == 0)
+		return -1;
+	p = E->period[series] - age;
+	if (p < E->created / (int64_t) ErlangHead->series_period[series])
+		return -1;
+	return p % slots;
+}
 
-	erlang_mmap_size = st.st_size;
-	erlang_mmap =
-		mmap(NULL, erlang_mmap_size,
-		     PROT_READ | (do_create ? PROT_WRITE : 0), MAP_SHARED,
-		     erlang_file_fd, 0);
-	if (erlang_mmap == MAP_FAILED) {
-		erlang_mmap = NULL;
-		syslog(LOG_ERR,
-		       "Erlang-file mmap() failed, fd=%d, errno=%d: %s",
-		       erlang_file_fd, errno, strerror(errno));
-	}
-	if (erlang_mmap) {
-
-		int rc, l;
-		EF = erlang_mmap;
-
-		ErlangHead = &EF->head;
-
-		if (EF->head.version != ERLANGLINE_STRUCT_VERSION ||
-		    EF->head.last_update == 0) {
-			if (doing_init) {
-				/* Not initialized ? */
-				memset(erlang_mmap, 0, erlang_mmap_size);
-
-				strcpy(EF->head.title, erlangtitle);
-				EF->head.version =
-					ERLANGLINE_STRUCT_VERSION;
-				EF->head.linecount = 0;
-				EF->head.last_update = tick.tv_sec;
-				ErlangLinesCount = 0;
-			} else {
-				/* Wrong head magic, and not doing block init..  */
-				munmap(erlang_mmap, erlang_mmap_size);
-				erlang_mmap = NULL;
-				erlang_mmap_size = 0;
-				syslog(LOG_ERR,
-				       "Erlang-file has bad magic in it, not opening! Not modifying!");
-				close(erlang_file_fd);
-				erlang_file_fd = -1;
+/*
+ *  erlang_metrics_region()  -- metrics.c region of the store, if any
+ */
+const void *erlang_metrics_region(uint32_t *sizep)
+{
+	const void *region;
+
+	if (!ErlangHead || ErlangHead->metrics_size == 0)
+		return NULL;
+	region = (const char *) ErlangHead + ErlangHead->metrics_offset;
+	if (!metrics_region_ok(region, ErlangHead->metrics_size))
+		return NULL;
+	if (sizep)
+		*sizep = ErlangHead->metrics_size;
+	return region;
+}
 
-				goto embedded_only;	/* BAD BAD ! */
-			}
-		}
+/* Wall clock start of that period */
+int64_t erlang_period_start(const struct erlangline *E, int series, int age)
+{
+	return (E->period[series] - age) * ErlangHead->series_period[series];
+}
 
-		if (EF->head.linecount != ErlangLinesCount
-		    || add_count > 0) {
-			/* must resize.. */
-			int new_count = EF->head.linecount + add_count;
-			new_size =
-				sizeof(struct erlang_file) +
-				sizeof(struct erlangline) * (new_count -
-							     1);
-
-			if (new_size % pagesize) {
-				new_size /= pagesize;
-				++new_size;
-				new_size *= pagesize;
-			}
 
-			i = st.st_size;
-			memset(buf, 0, sizeof(buf));
-			lseek(erlang_file_fd, 0, SEEK_END);	/* append on the file.. */
-			while (i < new_size) {
-				l = sizeof(buf);
-				if (new_size - i < l)
-					l = new_size - i;
-				rc = write(erlang_file_fd, buf, l);
-				if (rc < 0 && errno == EINTR)
-					continue;
-				if (rc != l)
-					break;
-				i += rc;
-			}
+/* Move line's series forward to period P, clearing the slots of
+   the periods in between.  Clock going backwards is ignored, the
+   counts go to the latest period until it catches up. */
+static void erlang_line_advance(struct erlangline *E, int s, int64_t p)
+{
+	const int slots = ErlangHead->series_slots[s];
+	int64_t q;
+	int c;
 
-			if (i < new_size) {
-				munmap(erlang_mmap, erlang_mmap_size);
-				erlang_mmap = NULL;
+	if (slots == 0 || p <= E->period[s])
+		return;
+	q = E->period[s] + 1;
+	if (p - q >= slots)
+		q = p - slots + 1;
+	for (c = 0; c < ERLANG_COLUMNS; ++c) {
+		uint32_t *ring = erlang_ring(E, s, c);
+		int64_t k;
+		for (k = q; k <= p; ++k)
+			ring[k % slots] = 0;
+	}
+	E->period[s] = p;
+}
 
-				goto embedded_only;	/* BAD BAD ! */
-			}
+/* New period P on series S for all lines.  A store written before
+   the wall clock was stepped back may be ahead of P, then its
+   latest period is taken as the current one. */
+static void erlang_sync(int s, int64_t p)
+{
+	int i;
 
-			add_count = 0;
-			if (do_create)
-				EF->head.linecount = new_count;
-			ErlangLinesCount = new_count;
+	if (erlang_series_slots[s] == 0)
+		return;
+	if (p > erlang_cur_period[s])
+		erlang_cur_period[s] = p;
+	for (i = 0; i < ErlangLinesCount; ++i)
+		if (ErlangLines[i]->period[s] > erlang_cur_period[s])
+			erlang_cur_period[s] = ErlangLines[i]->period[s];
+	for (i = 0; i < ErlangLinesCount; ++i)
+		erlang_line_advance(ErlangLines[i], s, erlang_cur_period[s]);
+	erlang_cur_slot[s] = erlang_cur_period[s] % erlang_series_slots[s];
+}
 
-			goto redo_open;	/* redo mapping */
-		}
+static void erlang_sync_all(void)
+{
+	int s;
 
-		/* Ok, successfull open, correct linecount */
-		ErlangLines =
-			(void *) realloc((void *) ErlangLines,
-					 (ErlangLinesCount +
-					  1) * sizeof(void *));
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s)
+		erlang_sync(s, erlang_wallclock / erlang_series_period[s]);
+}
 
-		for (i = 0; i < ErlangLinesCount; ++i) {
-			ErlangLines[i] = &EF->lines[i];
-		}
 
+static void erlang_backingstore_startops(void)
+{
+	ErlangHead->server_pid = getpid();
+	ErlangHead->start_time = time(NULL);
 
+	if (!mycall)
+		strncpy(ErlangHead->mycall, "N0CALL",
+			sizeof(ErlangHead->mycall));
+	else
+		strncpy(ErlangHead->mycall, mycall,
+			sizeof(ErlangHead->mycall));
+	ErlangHead->mycall[sizeof(ErlangHead->mycall) - 1] = 0;	/* NUL terminate */
+}
 
-		return 0;	/* OK ! */
+#ifdef ERLANGSTORAGE
+/* (Re)map the whole backing file.  A writer initializes an empty
+   file, and one of an older format.
+
+   The new mapping replaces the previous one at the same address,
+   within erlang_reserve.  The APRS-IS thread may be updating metrics
+   through it meanwhile: the pages are the same file pages before and
+   after, and MAP_FIXED swaps them in one step.  Remaps happen only
+   when lines are added. */
+static int erlang_backingstore_map(int do_create)
+{
+	struct erlanghead H;
+	struct stat st;
+	void *p;
+
+	erlang_mmap = NULL;
+	erlang_mmap_size = 0;
+	ErlangHead = NULL;
+
+	if (erlang_reserve == NULL) {
+		p = mmap(NULL, ERLANG_MMAP_RESERVE, PROT_NONE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (p == MAP_FAILED) {
+			syslog(LOG_ERR, "Erlang-file address space reservation failed, errno=%d: %s",
+			       errno, strerror(errno));
+			return -1;
+		}
+		erlang_reserve = p;
 	}
 
-      embedded_only:;
-#endif				/* ... ERLANGSTORAGE ... */
-
-	erlang_data_is_nonshared = 1;
+	if (fstat(erlang_file_fd, &st) < 0)
+		return -1;
 
-	if (add_count > 0 || !erlang_mmap) {
-		ErlangLinesCount += add_count;
-		erlang_mmap = realloc(erlang_mmap, sizeof(*EF) +
-				      (ErlangLinesCount +
-				       1) * sizeof(struct erlangline));
+	if (do_create) {
+		memset(&H, 0, sizeof(H));
+		if (st.st_size > 0 &&
+		    pread(erlang_file_fd, &H, sizeof(H), 0) < (ssize_t) sizeof(H.magic))
+			return -1;
+		if (st.st_size == 0 || !erlang_head_ok(&H, st.st_size, 1)) {
+			if (st.st_size > 0 && memcmp(H.magic, "APRX", 4) != 0) {
+				syslog(LOG_ERR,
+				       "Erlang-file has bad magic in it, not opening! Not modifying!");
+				return -1;
+			}
+			if (st.st_size > 0)
+				syslog(LOG_INFO, "Erlang-file of other format, re-initializing it");
+			erlang_head_init(&H, 1);
+			if (ftruncate(erlang_file_fd, 0) < 0 ||
+			    ftruncate(erlang_file_fd, H.head_size) < 0 ||
+			    pwrite(erlang_file_fd, &H, sizeof(H), 0) != sizeof(H)) {
+				syslog(LOG_ERR, "Erlang-file init failed, errno=%d: %s",
+				       errno, strerror(errno));
+				return -1;
+			}
+			st.st_size = H.head_size;
+		}
 	}
 
-	EF = erlang_mmap;
-	ErlangHead = &EF->head;
+	if ((size_t) st.st_size > ERLANG_MMAP_RESERVE) {
+		syslog(LOG_ERR, "Erlang-file of %ld bytes is over the limit of %ld, not opening!",
+		       (long) st.st_size, (long) ERLANG_MMAP_RESERVE);
+		return -1;
+	}
+	p = mmap(erlang_reserve, st.st_size,
+		 PROT_READ | (do_create ? PROT_WRITE : 0), MAP_SHARED | MAP_FIXED,
+		 erlang_file_fd, 0);
+	if (p == MAP_FAILED) {
+		syslog(LOG_ERR,
+		       "Erlang-file mmap() failed, fd=%d, errno=%d: %s",
+		       erlang_file_fd, errno, strerror(errno));
+		return -1;
+	}
+	if (!erlang_head_ok(p, st.st_size, do_create)) {
+		syslog(LOG_ERR, "Erlang-file has bad header in it, not opening!");
+		return -1;
+	}
+	erlang_mmap = p;
+	erlang_mmap_size = st.st_size;
+	ErlangHead = erlang_mmap;
+	erlang_lines_index();
+
+	if (do_create) {
+		void *region = (char *) ErlangHead + ErlangHead->metrics_offset;
+		if (!erlang_metrics_attached) {
+			/* First open by this process, start from scratch */
+			memset(region, 0, ErlangHead->metrics_size);
+			metrics_region_init(region);
+			erlang_metrics_attached = 1;
+		}
+		metrics_attach(region);
+	}
+	return 0;
+}
+#endif
 
-	/* Ok, successfull open, correct linecount */
-	ErlangLines =
-		(void *) realloc((void *) ErlangLines,
-				 (ErlangLinesCount + 1) * sizeof(void *));
+/* Append 'add_count' zeroed lines to the store */
+static int erlang_backingstore_grow(int add_count)
+{
+	const uint32_t count = ErlangHead->linecount + add_count;
+	const size_t new_size = ErlangHead->head_size +
+		(size_t) count * ErlangHead->line_size;
 
-	for (i = 0; i < ErlangLinesCount; ++i) {
-		ErlangLines[i] = &EF->lines[i];
+#ifdef ERLANGSTORAGE
+	if (!erlang_data_is_nonshared) {
+		if (new_size > ERLANG_MMAP_RESERVE)
+			return -1;	/* see erlang_backingstore_map() */
+		if (ftruncate(erlang_file_fd, new_size) < 0) {
+			syslog(LOG_ERR, "Erlang-file grow failed, errno=%d: %s",
+			       errno, strerror(errno));
+			return -1;
+		}
+		if (erlang_backingstore_map(1) < 0)
+			return -1;
+		ErlangHead->linecount = count;
+		erlang_lines_index();
+		return 0;
+	}
+#endif
+	{
+		const size_t old_size = ErlangHead->head_size +
+			(size_t) ErlangHead->linecount * ErlangHead->line_size;
+		void *p = realloc(erlang_mmap, new_size);
+		if (!p)
+			return -1;
+		memset((char *) p + old_size, 0, new_size - old_size);
+		erlang_mmap = p;
+		ErlangHead = p;
+		ErlangHead->linecount = count;
+		erlang_lines_index();
 	}
-
 	return 0;
 }
 
 static int erlang_backingstore_open(int do_create)
 {
+	ErlangKeysCount = -1;	/* The store may come back with other names */
+	++erlang_generation;
 #ifdef ERLANGSTORAGE
+	if (erlang_data_is_nonshared)
+		return 0;	/* Already fell back to memory */
 	if (!erlang_backingstore) {
 		syslog(LOG_ERR, "erlang_backingstore not defined!");
-		erlang_data_is_nonshared = 1;
 	}
 	if (erlang_file_fd < 0 && erlang_backingstore) {
 		erlang_file_fd = open(erlang_backingstore, do_create ? O_RDWR : O_RDONLY, 0644);	/* Presume: it exists! */
@@ -289,24 +443,37 @@ static int erlang_backingstore_open(int do_create)
 				open(erlang_backingstore,
 				     O_RDWR | O_CREAT | O_EXCL, 0644);
 		}
+		if (erlang_file_fd < 0)
+			syslog(LOG_ERR,
+			       "Open of '%s' for erlang_backingstore file failed!  errno=%d: %s",
+			       erlang_backingstore, errno, strerror(errno));
 	}
-	if (erlang_file_fd < 0) {
-		syslog(LOG_ERR,
-		       "Open of '%s' for erlang_backingstore file failed!  errno=%d: %s",
-		       erlang_backingstore, errno, strerror(errno));
-		erlang_data_is_nonshared = 1;
-	} else {
-		erlang_data_is_nonshared = 0;
+	if (erlang_file_fd >= 0) {
+		if (erlang_backingstore_map(do_create) == 0)
+			return 0;
+		close(erlang_file_fd);
+		erlang_file_fd = -1;
 	}
+	if (!do_create)
+		return -1;	/* Nothing to report from */
 #endif
-	return erlang_backingstore_grow(do_create, 0);	/* Just open */
+
+	/* Embedded, or no usable file: keep the store in memory */
+	if (!erlang_mmap) {
+		erlang_mmap = calloc(1, sizeof(struct erlanghead));
+		erlang_head_init(erlang_mmap, 0);
+	}
+	erlang_data_is_nonshared = 1;
+	ErlangHead = erlang_mmap;
+	erlang_lines_index();
+	return 0;
 }
 
 
 static struct erlangline *erlang_findline(const char *portname,
 					  int bytes_per_minute)
 {
-	int i;
+	int i, s;
 	struct erlangline *E;
 	if (portname == NULL) return NULL;
 
@@ -318,8 +485,19 @@ static struct erlangline *erlang_findline(const char *portname,
 
 	E = NULL;
 	if (ErlangLines) {
+		const callkey_t key = callkey_from_text(portname, strlen(portname));
+		if (ErlangKeysCount != ErlangLinesCount) {
+			/* Lines were added, or the store was reloaded */
+			ErlangKeys = realloc(ErlangKeys, sizeof(callkey_t) * (ErlangLinesCount+1));
+			for (i = 0; i < ErlangLinesCount; ++i)
+				ErlangKeys[i] = callkey_from_text(ErlangLines[i]->name,
+								  strlen(ErlangLines[i]->name));
+			ErlangKeysCount = ErlangLinesCount;
+		}
 		for (i = 0; i < ErlangLinesCount; ++i) {
-			if (strcmp(portname, ErlangLines[i]->name) == 0) {
+			if ((key != CALLKEY_NONE) ?
+			    (ErlangKeys[i] == key) :
+			    (strcmp(portname, ErlangLines[i]->name) == 0)) {
 				/* HOO-RAY!  It is this one! */
 				E = ErlangLines[i];
 				break;
@@ -332,35 +510,20 @@ static struct erlangline *erlang_findline(const char *portname,
 	if (!E) {
 
 		/* Allocate a new one */
-		erlang_backingstore_grow(1, 1);
-		if (!ErlangLines)
+		if (!ErlangHead || erlang_backingstore_grow(1) < 0)
 			return NULL;	/* D'uh! */
 
 		E = ErlangLines[ErlangLinesCount - 1];	/* Last one is the lattest.. */
 
-		memset(E, 0, sizeof(*E));
+		memset(E, 0, ErlangHead->line_size);
 		strncpy(E->name, portname, sizeof(E->name) - 1);
 		E->name[sizeof(E->name) - 1] = 0;
 
 		E->erlang_capa = bytes_per_minute;
 		E->index = ErlangLinesCount - 1;
-
-#ifdef ERLANGSTORAGE
-		E->e1_cursor = 0;
-		E->e1_max  = APRXERL_1M_COUNT;
-		E->e10_cursor = 0;
-		E->e10_max = APRXERL_10M_COUNT;
-		E->e60_cursor = 0;
-		E->e60_max = APRXERL_60M_COUNT;
-#else
-#if (USE_ONE_MINUTE_DATA == 1)
-		E->e1_cursor = 0;
-		E->e1_max  = APRXERL_1M_COUNT;
-#else
-		E->e10_cursor = 0;
-		E->e10_max = APRXERL_10M_COUNT;
-#endif
-#endif
+		E->created = erlang_wallclock;
+		for (s = 0; s < ERLANG_SERIES_MAX; ++s)
+			E->period[s] = erlang_cur_period[s];
 	}
 	return E;
 }
@@ -368,24 +531,23 @@ static struct erlangline *erlang_findline(const char *portname,
 
 static void erlang_timer_init(void *dummy)
 {
+	int s;
 
 	/* Time intervals will end at next even
-	   1 minute/10 minutes/60 minutes,
-	   although said interval will be shorter than full. */
-
-	erlang_time_end_1min.tv_sec = tick.tv_sec + 60 - (tick.tv_sec % 60);
-        erlang_time_end_1min.tv_usec = 0;
-	erlang_time_ival_1min = (float) (60 - tick.tv_sec % 60) / 60.0;
-
-	erlang_time_end_10min.tv_sec = tick.tv_sec + 600 - (tick.tv_sec % 600);
-	erlang_time_end_10min.tv_usec = 0;
-	erlang_time_ival_10min = (float) (600 - tick.tv_sec % 600) / 600.0;
-
-#ifdef ERLANGSTORAGE
-	erlang_time_end_60min.tv_sec = tick.tv_sec + 3600 - (tick.tv_sec % 3600);
-	erlang_time_end_60min.tv_usec = 0;
-	erlang_time_ival_60min = (float) (3600 - tick.tv_sec % 3600) / 3600.0;
-#endif
+	   1 minute/10 minutes/60 minutes of wall clock,
+	   although said interval will be shorter than full.
+	   The timers run on the monotonic tick. */
+
+	erlang_wallclock = time(NULL);
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s) {
+		const int period = erlang_series_period[s];
+		const int left   = period - erlang_wallclock % period;
+
+		erlang_period_end[s].tv_sec  = tick.tv_sec + left;
+		erlang_period_end[s].tv_usec = 0;
+		erlang_time_ival[s] = (float) left / period;
+	}
+	erlang_sync_all();
 }
 
 
@@ -397,8 +559,71 @@ void erlang_set(const char *portname, int bytes_per_minute)
 	erlang_findline(portname, bytes_per_minute);
 }
 
+/* All counter sets of a line */
+static void erlang_account(struct erlangline *E, ErlangMode erl, int bytes, int packets)
+{
+	int c, s;
+
+	switch (erl) {
+	case ERLANG_RX:
+		c = ERLANG_COL_BYTES_RX;
+		break;
+	case ERLANG_DROP:
+		c = ERLANG_COL_BYTES_RXDROP;
+		break;
+	case ERLANG_TX:
+	default:
+		c = ERLANG_COL_BYTES_TX;
+		break;
+	}
+	/* ERLANG_COL_PACKETS_* follows its ERLANG_COL_BYTES_* */
+
+	E->last_update = erlang_wallclock;
+	E->SNMP[c]     += bytes;
+	E->SNMP[c + 1] += packets;
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s) {
+		if (ErlangHead->series_slots[s] == 0)
+			continue;
+		erlang_ring(E, s, c)[erlang_cur_slot[s]]     += bytes;
+		erlang_ring(E, s, c + 1)[erlang_cur_slot[s]] += packets;
+	}
+}
+
+/*
+ *  erlang_add_h()  -- account on a cached line handle
+ *
+ *  The handle keeps the ErlangLines[] index of the portname.  Lines
+ *  are only appended, but the line array is remapped as it grows,
+ *  so an index is kept, not a pointer.  When the backing store is
+ *  (re)opened, the set of lines may change, and erlang_generation
+ *  makes every handle look the name up again.
+ */
+void erlang_add_h(struct erlanghandle *h, const char *portname,
+		  ErlangMode erl, int bytes, int packets)
+{
+	struct erlangline *E;
+
+	if (h->generation == erlang_generation && h->index < ErlangLinesCount) {
+		E = ErlangLines[h->index];
+	} else {
+		if (!portname) return;
+		E = erlang_findline(portname, (int) ((1200.0 * 60) / 8.2));
+		if (!E)
+			return;
+		h->index      = E->index;
+		h->generation = erlang_generation;
+	}
+
+	if (debug > 1)
+	  printf("erlang_add(%s, %s, %d, %d)\n", E->name,
+		 (erl == ERLANG_RX ? "RX":(erl == ERLANG_TX ? "TX": "DROP")),
+		 bytes, packets);
+
+	erlang_account(E, erl, bytes, packets);
+}
+
 /*
- *  erlang_add()
+ *  erlang_add()  -- account by port name, looks it up every time
  */
 void erlang_add(const char *portname, ErlangMode erl, int bytes, int packets)
 {
@@ -415,96 +640,7 @@ void erlang_add(const char *portname, ErlangMode erl, int bytes, int packets)
 	if (!E)
 		return;
 
-	if (erl == ERLANG_RX) {
-		E->SNMP.bytes_rx += bytes;
-		E->SNMP.packets_rx += packets;
-		E->SNMP.update = tick.tv_sec;
-		E->last_update = tick.tv_sec;
-
-#ifdef ERLANGSTORAGE
-		E->erl1m.bytes_rx += bytes;
-		E->erl1m.packets_rx += packets;
-		E->erl1m.update = tick.tv_sec;
-
-		E->erl10m.bytes_rx += bytes;
-		E->erl10m.packets_rx += packets;
-		E->erl10m.update = tick.tv_sec;
-
-		E->erl60m.bytes_rx += bytes;
-		E->erl60m.packets_rx += packets;
-		E->erl60m.update = tick.tv_sec;
-#else
-#if (USE_ONE_MINUTE_STORAGE == 1)
-		E->erl1m.bytes_rx += bytes;
-		E->erl1m.packets_rx += packets;
-		E->erl1m.update = tick.tv_sec;
-#else
-		E->erl10m.bytes_rx += bytes;
-		E->erl10m.packets_rx += packets;
-		E->erl10m.update = tick.tv_sec;
-#endif
-#endif
-	}
-	if (erl == ERLANG_TX) {
-		E->SNMP.bytes_tx += bytes;
-		E->SNMP.packets_tx += packets;
-		E->SNMP.update = tick.tv_sec;
-		E->last_update = tick.tv_sec;
-
-#ifdef ERLANGSTORAGE
-		E->erl1m.bytes_tx += bytes;
-		E->erl1m.packets_tx += packets;
-		E->erl1m.update = tick.tv_sec;
-
-		E->erl10m.bytes_tx += bytes;
-		E->erl10m.packets_tx += packets;
-		E->erl10m.update = tick.tv_sec;
-
-		E->erl60m.bytes_tx += bytes;
-		E->erl60m.packets_tx += packets;
-		E->erl60m.update = tick.tv_sec;
-#else
-#if (USE_ONE_MINUTE_STORAGE == 1)
-		E->erl1m.bytes_tx += bytes;
-		E->erl1m.packets_tx += packets;
-		E->erl1m.update = tick.tv_sec;
-#else
-		E->erl10m.bytes_tx += bytes;
-		E->erl10m.packets_tx += packets;
-		E->erl10m.update = tick.tv_sec;
-#endif
-#endif
-	}
-	if (erl == ERLANG_DROP) {
-		E->SNMP.bytes_rxdrop += bytes;
-		E->SNMP.packets_rxdrop += packets;
-		E->SNMP.update = tick.tv_sec;
-		E->last_update = tick.tv_sec;
-
-#ifdef ERLANGSTORAGE
-		E->erl1m.bytes_rxdrop += bytes;
-		E->erl1m.packets_rxdrop += packets;
-		E->erl1m.update = tick.tv_sec;
-
-		E->erl10m.bytes_rxdrop += bytes;
-		E->erl10m.packets_rxdrop += packets;
-		E->erl10m.update = tick.tv_sec;
-
-		E->erl60m.bytes_rxdrop += bytes;
-		E->erl60m.packets_rxdrop += packets;
-		E->erl60m.update = tick.tv_sec;
-#else
-#if (USE_ONE_MINUTE_STORAGE == 1)
-		E->erl1m.bytes_rxdrop += bytes;
-		E->erl1m.packets_rxdrop += packets;
-		E->erl1m.update = tick.tv_sec;
-#else
-		E->erl10m.bytes_rxdrop += bytes;
-		E->erl10m.packets_rxdrop += packets;
-		E->erl10m.update = tick.tv_sec;
-#endif
-#endif
-	}
+	erlang_account(E, erl, bytes, packets);
 }
 
 
@@ -513,7 +649,8 @@ void erlang_add(const char *portname, ErlangMode erl, int bytes, int packets)
  */
 static void erlang_time_end(void)
 {
-	int i;
+	static const int minutes[ERLANG_SERIES_MAX] = { 1, 10, 60 };
+	int i, s;
 	char msgbuf[500];
 	char logtime[40];
 	FILE *fp = NULL;
@@ -524,170 +661,173 @@ static void erlang_time_end(void)
 	}
 
 	printtime(logtime, sizeof(logtime));
+	erlang_wallclock = time(NULL);
 
-	if (tv_timercmp(&tick, &erlang_time_end_1min) >= 0) {
-		erlang_time_end_1min.tv_sec += 60;
-#if (defined(ERLANGSTORAGE) || (USE_ONE_MINUTE_STORAGE == 1))
-		for (i = 0; i < ErlangLinesCount; ++i) {
-			struct erlangline *E = ErlangLines[i];
-			E->last_update = tick.tv_sec;
-
-			if (erlanglog1min) {
-				sprintf(msgbuf,
-					"ERLANG%-2d %s Rx %6ld %3ld Dp %6ld %3ld Tx %6ld %3ld : %5.3f %5.3f %5.3f",
-					1, E->name, 
-					E->erl1m.bytes_rx,
-					E->erl1m.packets_rx,
-					E->erl1m.bytes_rxdrop,
-					E->erl1m.packets_rxdrop,
-					E->erl1m.bytes_tx, E->erl1m.packets_tx,
-					((float) E->erl1m.bytes_rx /
-					 (float) E->erlang_capa *
-					 erlang_time_ival_1min),
-					((float) E->erl1m.bytes_rxdrop /
-					 (float) E->erlang_capa *
-					 erlang_time_ival_1min),
-					((float)E->erl1m.bytes_tx /
-					 (float)E->erlang_capa *
-					 erlang_time_ival_1min)
-					);
-				if (fp)
-					fprintf(fp, "%s %s\n", logtime,
-						msgbuf);
-				else if (erlangout)
-					printf("%ld\t%s\n", tick.tv_sec, msgbuf);
-				if (erlangsyslog)
-					syslog(LOG_INFO, "%ld %s", tick.tv_sec,
-					       msgbuf);
-			}
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s) {
+		const int period = erlang_series_period[s];
+		const int k = erlang_cur_slot[s];
 
-			E->erl1m.update = tick.tv_sec;
-			E->e1[E->e1_cursor] = E->erl1m;
-			++E->e1_cursor;
-			if (E->e1_cursor >= E->e1_max)
-				E->e1_cursor = 0;
+		if (tv_timercmp(&tick, &erlang_period_end[s]) < 0)
+			continue;
+		erlang_period_end[s].tv_sec += period;
+		if (!ErlangHead || ErlangHead->series_slots[s] == 0)
+			continue;
 
-			memset(&E->erl1m, 0, sizeof(E->erl1m));
-			E->erl1m.update = tick.tv_sec;
-		}
-		erlang_time_ival_1min = 1.0;
-#endif
-	}
-	if (tv_timercmp(&tick, &erlang_time_end_10min) >= 0) {
-		erlang_time_end_10min.tv_sec += 600;
-#if (defined(ERLANGSTORAGE) || (USE_ONE_MINUTE_STORAGE == 0))
 		for (i = 0; i < ErlangLinesCount; ++i) {
 			struct erlangline *E = ErlangLines[i];
-			E->last_update = tick.tv_sec;
+			const float capa = (float) E->erlang_capa * minutes[s] *
+				erlang_time_ival[s];
+
+			if (s == ERLANG_SERIES_1MIN && !erlanglog1min)
+				continue;
 			sprintf(msgbuf,
 				"ERLANG%-2d %s Rx %6ld %3ld Dp %6ld %3ld Tx %6ld %3ld : %5.3f %5.3f %5.3f",
-				10, E->name, 
-				E->erl10m.bytes_rx, E->erl10m.packets_rx,
-				E->erl10m.bytes_rxdrop,
-				E->erl10m.packets_rxdrop,
-				E->erl10m.bytes_tx, E->erl10m.packets_tx,
-				((float) E->erl10m.bytes_rx /
-				 ((float) E->erlang_capa * 10.0 *
-				  erlang_time_ival_10min)),
-				((float) E->erl10m.bytes_rxdrop /
-				 ((float) E->erlang_capa * 10.0 *
-				  erlang_time_ival_10min)),
-				((float)E->erl10m.bytes_tx /
-				 ((float)E->erlang_capa * 10.0 *
-				  erlang_time_ival_10min))
-				);
+				minutes[s], E->name,
+				(long) erlang_ring(E, s, ERLANG_COL_BYTES_RX)[k],
+				(long) erlang_ring(E, s, ERLANG_COL_PACKETS_RX)[k],
+				(long) erlang_ring(E, s, ERLANG_COL_BYTES_RXDROP)[k],
+				(long) erlang_ring(E, s, ERLANG_COL_PACKETS_RXDROP)[k],
+				(long) erlang_ring(E, s, ERLANG_COL_BYTES_TX)[k],
+				(long) erlang_ring(E, s, ERLANG_COL_PACKETS_TX)[k],
+				erlang_ring(E, s, ERLANG_COL_BYTES_RX)[k] / capa,
+				erlang_ring(E, s, ERLANG_COL_BYTES_RXDROP)[k] / capa,
+				erlang_ring(E, s, ERLANG_COL_BYTES_TX)[k] / capa);
 			if (fp)
 				fprintf(fp, "%s %s\n", logtime, msgbuf);
 			else if (erlangout)
 				printf("%ld\t%s\n", tick.tv_sec, msgbuf);
 			if (erlangsyslog)
 				syslog(LOG_INFO, "%ld %s", tick.tv_sec, msgbuf);
-
-			E->erl10m.update = tick.tv_sec;
-			E->e10[E->e10_cursor] = E->erl10m;
-			++E->e10_cursor;
-			if (E->e10_cursor >= E->e10_max)
-				E->e10_cursor = 0;
-			memset(&E->erl10m, 0, sizeof(E->erl10m));
-			E->erl10m.update = tick.tv_sec;
 		}
-		erlang_time_ival_10min = 1.0;
-#endif
+
+		/* The timer runs on monotonic time, round to the
+		   nearest wall clock period boundary. */
+		erlang_sync(s, (erlang_wallclock + period / 2) / period);
+		erlang_time_ival[s] = 1.0;
 	}
-#ifdef ERLANGSTORAGE
-	if (tv_timercmp(&tick, &erlang_time_end_60min) >= 0) {
-		erlang_time_end_60min.tv_sec += 3600;
-		for (i = 0; i < ErlangLinesCount; ++i) {
-			struct erlangline *E = ErlangLines[i];
-			/* E->last_update = now.tv_sec; -- the 10 minute step does also this */
-			sprintf(msgbuf,
-				"ERLANG%-2d %s Rx %6ld %3ld Dp %6ld %3ld Tx %6ld %3ld : %5.3f %5.3f %5.3f",
-				60, E->name, 
-				E->erl60m.bytes_rx, E->erl60m.packets_rx,
-				E->erl60m.bytes_rxdrop,
-				E->erl60m.packets_rxdrop,
-				E->erl60m.bytes_tx,  E->erl60m.packets_tx,
-				((float) E->erl60m.bytes_rx /
-				 ((float) E->erlang_capa * 60.0 *
-				  erlang_time_ival_60min)),
-				((float) E->erl60m.bytes_rxdrop /
-				 ((float) E->erlang_capa * 60.0 *
-				  erlang_time_ival_60min)),
-				((float)E->erl60m.bytes_tx /
-				 ((float)E->erlang_capa * 60.0 *
-				  erlang_time_ival_60min))
-				);
-			if (fp)
-				fprintf(fp, "%s %s\n", logtime, msgbuf);
-			else if (erlangout)
-				printf("%ld\t%s\n", tick.tv_sec, msgbuf);
-			if (erlangsyslog)
-				syslog(LOG_INFO, "%ld %s", tick.tv_sec, msgbuf);
+	if (ErlangHead && !erlang_data_is_nonshared)
+		ErlangHead->last_update = erlang_wallclock;
 
-			E->erl60m.update = tick.tv_sec;
-			E->e60[E->e60_cursor] = E->erl60m;
-			++E->e60_cursor;
-			if (E->e60_cursor >= E->e60_max)
-				E->e60_cursor = 0;
+	if (fp)
+		fclose(fp);
+}
+
+/*
+ *  erlang_logline()  -- a non-ERLANG statistics line to the same
+ *			 places where erlang lines go
+ */
+void erlang_logline(const char *msgbuf)
+{
+	char logtime[40];
+	FILE *fp = NULL;
+
+	if (erlanglogfile)
+		fp = fopen(erlanglogfile, "a");
+	printtime(logtime, sizeof(logtime));
 
-			memset(&E->erl60m, 0, sizeof(E->erl60m));
-			E->erl60m.update = tick.tv_sec;
-		}
-		erlang_time_ival_60min = 1.0;
-	}
-#endif
+	if (fp)
+		fprintf(fp, "%s %s\n", logtime, msgbuf);
+	else if (erlangout)
+		printf("%ld\t%s\n", tick.tv_sec, msgbuf);
+	if (erlangsyslog)
+		syslog(LOG_INFO, "%ld %s", tick.tv_sec, msgbuf);
 	if (fp)
 		fclose(fp);
 }
 
+
+/*
+ *  latencyhist_add()  -- one sample into log2 microsecond buckets
+ */
+void latencyhist_add(struct latencyhist *h, int64_t ns)
+{
+	int64_t us;
+	int b = 0;
+
+	if (ns < 0)
+		ns = 0;
+	for (us = ns / 1000; us > 0 && b < LATENCYHIST_BUCKETS - 1; us >>= 1)
+		++b;
+	h->bucket[b] += 1;
+	h->count     += 1;
+	h->sum_ns    += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+/* Upper bound of the bucket holding the given fraction of samples, us */
+static long latencyhist_pct(const struct latencyhist *h, double frac)
+{
+	uint32_t want = (uint32_t)(h->count * frac + 0.999), n = 0;
+	int b;
+
+	for (b = 0; b < LATENCYHIST_BUCKETS; ++b) {
+		n += h->bucket[b];
+		if (n >= want)
+			break;
+	}
+	return 1L << (b < LATENCYHIST_BUCKETS ? b : LATENCYHIST_BUCKETS - 1);
+}
+
+/*
+ *  latencyhist_format()  -- summary and non-empty buckets as text:
+ *
+ *	n=42 avg=1.234ms p50<1024us p90<2048us p99<4096us max=3.456ms h=10:3,11:30,12:9
+ *
+ *  where "h=B:count" is bucket B = [ 2^(B-1), 2^B ) microseconds.
+ */
+int latencyhist_format(const struct latencyhist *h, char *buf, int buflen)
+{
+	int len, b;
+
+	if (h->count == 0)
+		return snprintf(buf, buflen, "n=0");
+
+	len = snprintf(buf, buflen,
+		       "n=%u avg=%.3fms p50<%ldus p90<%ldus p99<%ldus max=%.3fms h=",
+		       h->count, h->sum_ns / 1e6 / h->count,
+		       latencyhist_pct(h, 0.50), latencyhist_pct(h, 0.90),
+		       latencyhist_pct(h, 0.99), h->max_ns / 1e6);
+	for (b = 0; b < LATENCYHIST_BUCKETS && len < buflen; ++b) {
+		if (h->bucket[b] == 0)
+			continue;
+		len += snprintf(buf + len, buflen - len, "%s%d:%u",
+				(buf[len-1] == '=') ? "" : ",", b, h->bucket[b]);
+	}
+	return len;
+}
+
 int erlang_prepoll(struct aprxpolls *app)
 {
+	int s;
+
         if (time_reset) {
         	if (debug) printf("erlang_timer_init() to be called\n");
         	erlang_timer_init(NULL);
         }
+	erlang_wallclock = time(NULL);
 
-	if (tv_timercmp(&app->next_timeout, &erlang_time_end_1min) > 0)
-		app->next_timeout = erlang_time_end_1min;
-	if (tv_timercmp(&app->next_timeout, &erlang_time_end_10min) > 0)
-		app->next_timeout = erlang_time_end_10min;
-#ifdef ERLANGSTORAGE
-	if (tv_timercmp(&app->next_timeout, &erlang_time_end_60min) > 0)
-		app->next_timeout = erlang_time_end_60min;
-#endif
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s) {
+		if (erlang_series_slots[s] == 0)
+			continue;
+		if (tv_timercmp(&app->next_timeout, &erlang_period_end[s]) > 0)
+			app->next_timeout = erlang_period_end[s];
+	}
 	return 0;
 }
 
 int erlang_postpoll(struct aprxpolls *app)
 {
-	if (tv_timercmp(&tick, &erlang_time_end_1min) >= 0 ||
-	    tv_timercmp(&tick, &erlang_time_end_10min) >= 0
-#ifdef ERLANGSTORAGE
-	    || tv_timercmp(&tick, &erlang_time_end_60min) >= 0
-#endif
-	    )
-		erlang_time_end();
-
+	int s;
+
+	for (s = 0; s < ERLANG_SERIES_MAX; ++s) {
+		if (erlang_series_slots[s] == 0)
+			continue;
+		if (tv_timercmp(&tick, &erlang_period_end[s]) >= 0) {
+			erlang_time_end();
+			break;
+		}
+	}
 	return 0;
 }
 
@@ -699,7 +839,11 @@ void erlang_init(const char *syslog_facility_name)
 
 void erlang_start(int do_create)
 {
-	erlang_backingstore_open(do_create);
+	erlang_wallclock = time(NULL);
+	if (erlang_backingstore_open(do_create) < 0)
+		return;
+	if (do_create)
+		erlang_sync_all();	/* catch up with the time it was down */
 	if (do_create > 1)
 		erlang_backingstore_startops();
 }
@@ -111,11 +111,21 @@ exclusion then the packet is not passed no matter any other filter definitions.
 /* values above are chosen for 4 byte alignment.. */
 
 struct filter_refcallsign_t {
+	callkey_t key;  /* packed callsign, CALLKEY_NONE on wild-cards */
 	char	callsign[CALLSIGNLEN_MAX+1]; /* size: 10.. */
 	int8_t	reflen; /* length and flags */
 };
+struct filter_prog_t;
+struct filter_callset_t;
+struct filter_rangeset_t;
+struct filter_foldset_t;
+
 struct filter_head_t {
 	struct filter_t *next;
+	struct filter_prog_t *prog; /* compiled program, on list head only */
+	struct filter_callset_t *callset; /* lookup tables of refcallsigns */
+	struct filter_rangeset_t *rangeset; /* a, r group of a program */
+	struct filter_foldset_t *foldset; /* b p u d t clauses of a program */
 	const char *text; /* filter text as is		*/
 	float   f_latN, f_lonE;
 	union {
@@ -127,6 +137,8 @@ struct filter_head_t {
 	  float   f_dist; /* for R filter */
 	} u2;
 	time_t  hist_age;
+	double	f_xyz[3];  /* range center as unit vector (r, m, f, T) */
+	double	f_cosdist; /* cos of range radius angle   (r, m, f, T) */
 
 	char	type;	  /* 1 char			*/
 	int16_t	negation; /* boolean flag		*/
@@ -153,6 +165,38 @@ struct filter_t {
 	char textbuf[FILT_TEXTBUFSIZE];
 };
 
+/*
+ *  filter_parse() compiles the filter list into a program.  Clauses
+ *  that can reject a packet (negated ones) come first, and every
+ *  clause carries the packet-type and flag prerequisites that it can
+ *  not match without.  Clauses with identical prerequisites are
+ *  placed adjacently, and the head of each such group carries the
+ *  group size, so one AND skips the whole group -- e.g. all the
+ *  position filters on a packet without a position.
+ *
+ *  The a/ and r/ clauses of a position group become one op, that
+ *  tests the boxes and then the range unit vectors in one loop each.
+ *  Likewise the b/, p/, u/, d/ and t/ clauses that can only reject,
+ *  and those that can only accept, become one op per pass, with one
+ *  callset lookup per address field and one packet-type mask test.
+ */
+
+typedef int (*filter_fn_t)(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb);
+
+struct filter_op_t {
+	filter_fn_t      fn;
+	struct filter_t *f;
+	int              types;	    /* any of these T_* bits, or 0 */
+	uint16_t         flags;	    /* all of these F_* bits	    */
+	int16_t          groupsize; /* >0 on head of a group       */
+};
+
+struct filter_prog_t {
+	int	rejects;	/* ops[0..rejects-1] may reject */
+	int	count;
+	struct filter_op_t ops[1];
+};
+
 #define QC_C	0x001 /* Q-filter flag bits */
 #define QC_X	0x002
 #define QC_U	0x004
@@ -716,6 +760,211 @@ void filter_postprocess_dupefilter(struct pbuf_t *pbuf, historydb_t *historydb)
 
 /* ================================================================ */
 
+/*
+ *	Callsign-set lookup tables.  Built at filter compile time from
+ *	the refcallsigns[] of b, d, g, o, p, u filters:
+ *
+ *	- exact entries go to an open addressing hash of packed
+ *	  upper-case keys  (entries that do not pack are scanned)
+ *	- prefix and wildcard entries go to a trie of upper-cased
+ *	  characters, one node per character
+ *
+ *	Several entries may match the same key; the linear scan result
+ *	is the first one in refcallsigns[] order, so the tables keep
+ *	entry indexes, and the smallest matching index wins.
+ */
+
+struct filter_callset_slot_t {
+	callkey_t key;
+	int	  idx;
+};
+
+struct filter_trienode_t {
+	int	child;	 /* first child node, or -1 */
+	int	sibling; /* next sibling node, or -1 */
+	int	idx;	 /* entry ending here, or -1 */
+	char	c;
+};
+
+struct filter_callset_t {
+	int	hashmask;	 /* hash size - 1, or -1 when no hash */
+	struct filter_callset_slot_t *hash;
+	int	nodecount;	 /* node 0 is the root */
+	struct filter_trienode_t *nodes;
+	int	scancount;	 /* exact entries that do not pack */
+	int    *scan;
+};
+
+static inline int filter_ucase(const int c)
+{
+	return ('a' <= c && c <= 'z') ? (c - ('a' - 'A')) : c;
+}
+
+static void filter_callset_free(struct filter_callset_t *cs)
+{
+	if (cs == NULL)
+		return;
+	free(cs->hash);
+	free(cs->nodes);
+	free(cs->scan);
+	free(cs);
+}
+
+static void filter_callset_trie_add(struct filter_callset_t *cs, const char *s, const int len, const int idx)
+{
+	int node = 0, i;
+
+	for (i = 0; i < len; ++i) {
+		const char c = filter_ucase((uint8_t)s[i]);
+		int child = cs->nodes[node].child;
+		while (child >= 0 && cs->nodes[child].c != c)
+			child = cs->nodes[child].sibling;
+		if (child < 0) {
+			child = cs->nodecount++;
+			cs->nodes[child].c       = c;
+			cs->nodes[child].child   = -1;
+			cs->nodes[child].idx     = -1;
+			cs->nodes[child].sibling = cs->nodes[node].child;
+			cs->nodes[node].child    = child;
+		}
+		node = child;
+	}
+	if (cs->nodes[node].idx < 0 || cs->nodes[node].idx > idx)
+		cs->nodes[node].idx = idx;
+}
+
+/* Build lookup tables for n refcallsigns, prefixonly is set for p/ */
+static struct filter_callset_t *filter_callset_make(const struct filter_refcallsign_t *r, const int n,
+						    const int prefixonly)
+{
+	struct filter_callset_t *cs = calloc(1, sizeof(*cs));
+	int i, nexact = 0, nchars = 0, size;
+
+	if (cs == NULL)
+		return NULL;
+
+	for (i = 0; i < n; ++i) {
+		const int len = r[i].reflen & LengthMask;
+		if (len == 0)
+			continue; /* never matches */
+		if (!prefixonly && !(r[i].reflen & WildCard))
+			++nexact;
+		else
+			nchars += len;
+	}
+
+	cs->hashmask = -1;
+	cs->nodes = calloc(nchars + 1, sizeof(*cs->nodes));
+	cs->scan  = calloc(nexact + 1, sizeof(int));
+	for (size = 4; size < nexact * 2; size <<= 1)
+		;
+	if (nexact > 0) {
+		cs->hash = calloc(size, sizeof(*cs->hash));
+		cs->hashmask = size - 1;
+	}
+	if (cs->nodes == NULL || cs->scan == NULL || (nexact > 0 && cs->hash == NULL)) {
+		filter_callset_free(cs);
+		return NULL;
+	}
+	cs->nodes[0].child = cs->nodes[0].sibling = cs->nodes[0].idx = -1;
+	cs->nodecount = 1;
+
+	for (i = 0; i < n; ++i) {
+		const int len = r[i].reflen & LengthMask;
+		if (len == 0)
+			continue;
+		if (prefixonly || (r[i].reflen & WildCard)) {
+			filter_callset_trie_add(cs, r[i].callsign, len, i);
+		} else if (r[i].key == CALLKEY_NONE) {
+			cs->scan[cs->scancount++] = i;
+		} else {
+			int h = callkey_hash(r[i].key) & cs->hashmask;
+			while (cs->hash[h].key != CALLKEY_NONE && cs->hash[h].key != r[i].key)
+				h = (h + 1) & cs->hashmask;
+			if (cs->hash[h].key == CALLKEY_NONE) { /* first one wins */
+				cs->hash[h].key = r[i].key;
+				cs->hash[h].idx = i;
+			}
+		}
+	}
+	return cs;
+}
+
+/* Build lookup tables for a callsign-set filter */
+static struct filter_callset_t *filter_callset_build(const struct filter_t *f, const int prefixonly)
+{
+	return filter_callset_make(f->h.u5.refcallsigns, f->h.u3.numnames, prefixonly);
+}
+
+/*
+ *  The clauses of one verdict, folded into one op, see
+ *  filter_foldset_build().  The p/ entries go to the source set as
+ *  wild-cards, a prefix match is what they are.
+ */
+struct filter_foldset_t {
+	int	verdict; /* 2 for the rejecting ones, else 1 */
+	int	types;	 /* t/ packet types */
+	struct filter_callset_t *src, *dst, *via;   /* b/ and p/, u/, d/ */
+	struct filter_refcallsign_t *srcrefs, *dstrefs, *viarefs;
+	struct filter_refcallsign_t refs[1];
+};
+
+static void filter_foldset_free(struct filter_foldset_t *fs)
+{
+	if (fs == NULL)
+		return;
+	filter_callset_free(fs->src);
+	filter_callset_free(fs->dst);
+	filter_callset_free(fs->via);
+	free(fs);
+}
+
+/* Smallest matching entry index, or -1 */
+static int filter_callset_lookup(const struct filter_callset_t *cs, const struct filter_refcallsign_t *r,
+				 const char *key, const int keylen)
+{
+	int best = -1, node = 0, i;
+
+	if (cs->hashmask >= 0 || cs->scancount > 0) {
+		const callkey_t ckey = callkey_from_text_uc(key, keylen);
+		if (ckey != CALLKEY_NONE) {
+			if (cs->hashmask >= 0) {
+				int h = callkey_hash(ckey) & cs->hashmask;
+				while (cs->hash[h].key != CALLKEY_NONE) {
+					if (cs->hash[h].key == ckey) {
+						best = cs->hash[h].idx;
+						break;
+					}
+					h = (h + 1) & cs->hashmask;
+				}
+			}
+		} else {
+			/* Only entries that do not pack either can be equal */
+			for (i = 0; i < cs->scancount; ++i) {
+				const int j = cs->scan[i];
+				if ((r[j].reflen & LengthMask) == keylen &&
+				    strncasecmp(key, r[j].callsign, keylen) == 0) {
+					best = j;
+					break;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < keylen; ++i) {
+		const char c = filter_ucase((uint8_t)key[i]);
+		int child = cs->nodes[node].child;
+		while (child >= 0 && cs->nodes[child].c != c)
+			child = cs->nodes[child].sibling;
+		if (child < 0)
+			break;
+		node = child;
+		if (cs->nodes[node].idx >= 0 && (best < 0 || cs->nodes[node].idx < best))
+			best = cs->nodes[node].idx;
+	}
+	return best;
+}
+
 /*
  *	filter_match_on_callsignset()  matches prefixes, or exact keys
  *	on filters of types:  b, d, e, o, p, u
@@ -723,13 +972,23 @@ void filter_postprocess_dupefilter(struct pbuf_t *pbuf, historydb_t *historydb)
  *
  */
 
-static int filter_match_on_callsignset(struct filter_refcallsign_t *ref, int keylen, struct filter_t *f, const MatchEnum wildok)
+static int filter_match_on_callsignset(const char *r1, int keylen, struct filter_t *f, const MatchEnum wildok)
 {
 	int i;
 	struct filter_refcallsign_t *r  = f->h.u5.refcallsigns;
-	const char                  *r1 = (const void*)ref->callsign;
+	/* Exact length entries are compared on packed upper-case keys,
+	   the key is made when the first such entry is met */
+	callkey_t                    key = CALLKEY_NONE;
+	int                      havekey = 0;
+
+	if (debug) printf(" filter_match_on_callsignset(ref='%.*s', keylen=%d, filter='%s')\n", keylen, r1, keylen, f->h.text);
 
-	if (debug) printf(" filter_match_on_callsignset(ref='%s', keylen=%d, filter='%s')\n", ref->callsign, keylen, f->h.text);
+	if (f->h.callset != NULL && wildok != MatchExact) {
+		i = filter_callset_lookup(f->h.callset, r, r1, keylen);
+		if (i < 0)
+			return 0;
+		return ( r[i].reflen & NegationFlag ? 2 : 1 );
+	}
 
 	for (i = 0; i < f->h.u3.numnames; ++i) {
 		const int reflen = r[i].reflen;
@@ -744,7 +1003,13 @@ static int filter_match_on_callsignset(struct filter_refcallsign_t *ref, int key
 			if (len != keylen)
 				continue; /* no match */
 			/* length OK, compare content */
-			if (strncasecmp( r1, r2, len ) != 0) continue;
+			if (!havekey) {
+				key = callkey_from_text_uc(r1, keylen);
+				havekey = 1;
+			}
+			if (key != CALLKEY_NONE && r[i].key != CALLKEY_NONE) {
+				if (key != r[i].key) continue;
+			} else if (strncasecmp( r1, r2, len ) != 0) continue;
 			/* So it was an exact match
 			** Precisely speaking..  we should check that there is
 			** no WildCard flag, or such.  But then this match
@@ -767,14 +1032,22 @@ static int filter_match_on_callsignset(struct filter_refcallsign_t *ref, int key
 				continue;
 			}
 
-			if (strncasecmp( r1, r2, len ) != 0) continue;
+			if (!(reflen & WildCard)) {
+				if (len != keylen)
+					continue; /* exact match only */
+				if (!havekey) {
+					key = callkey_from_text_uc(r1, keylen);
+					havekey = 1;
+				}
+				if (key != CALLKEY_NONE && r[i].key != CALLKEY_NONE) {
+					if (key != r[i].key) continue;
+					return ( reflen & NegationFlag ? 2 : 1 );
+				}
+			}
 
-			if (reflen & WildCard)
-				return ( reflen & NegationFlag ? 2 : 1 );
+			if (strncasecmp( r1, r2, len ) != 0) continue;
 
-			if (len == keylen)
-				return ( reflen & NegationFlag ? 2 : 1 );
-			break;
+			return ( reflen & NegationFlag ? 2 : 1 );
 		default:
 			break;
 		}
@@ -871,6 +1144,8 @@ static int filter_parse_one_callsignset(struct filter_t **ffp, struct filter_t *
 		refbuf[refcount].reflen = strlen(prefixbuf);
 		if (wildcard)
 			refbuf[refcount].reflen |= WildCard;
+		else
+			refbuf[refcount].key = callkey_from_text_uc(prefixbuf, strlen(prefixbuf));
 		if (f0->h.negation)
 			refbuf[refcount].reflen |= NegationFlag;
 		++refcount;
@@ -881,7 +1156,7 @@ static int filter_parse_one_callsignset(struct filter_t **ffp, struct filter_t *
 		char *s;
 		ff->h.u3.numnames = refcount;
 		i = strlen(ff->h.text) + strlen(filt0)+2;
-		if (i <= FILT_TEXTBUFSIZE) {
+		if (i <= FILT_TEXTBUFSIZE && ff->h.text == ff->textbuf) {
 			/* Fits in our built-in buffer block - like previous..
 			** Append on existing buffer
 			*/
@@ -890,7 +1165,7 @@ static int filter_parse_one_callsignset(struct filter_t **ffp, struct filter_t *
 		} else {
 			/* It does not fit anymore.. */
 			s = malloc(i); /* alloc a new one */
-			sprintf(s, "%s %s", p, filt0); /* .. and catenate. */
+			sprintf(s, "%s %s", ff->h.text, filt0); /* .. and catenate. */
 			p = ff->h.text;
 			if (ff->h.text != ff->textbuf) /* possibly free old */
 				free((void*)p);
@@ -981,7 +1256,7 @@ int filter_parse_one_s(struct filter_t *f0, struct filter_t **ffp, const char *f
 }
 
 
-int filter_parse(struct filter_t **ffp, const char *filt)
+static int filter_parse_clause(struct filter_t **ffp, const char *filt)
 {
 	struct filter_t f0;
 	int i;
@@ -1141,7 +1416,10 @@ int filter_parse(struct filter_t **ffp, const char *filt)
 
 		f0.h.u5.refcallsign.callsign[CALLSIGNLEN_MAX] = 0;
 		f0.h.u5.refcallsign.reflen = strlen(f0.h.u5.refcallsign.callsign);
+		f0.h.u5.refcallsign.key    = callkey_from_text(f0.h.u5.refcallsign.callsign,
+							       f0.h.u5.refcallsign.reflen);
 		f0.h.u3.numnames = 0; /* reusing this as "position-cache valid" flag */
+		f0.h.f_cosdist = filter_range_cosdist(f0.h.u2.f_dist);
 
 		// hlog(LOG_DEBUG, "Filter: %s -> F xxx %.3f", filt0, f0.h.u2.f_dist);
 
@@ -1184,6 +1462,8 @@ int filter_parse(struct filter_t **ffp, const char *filt)
 		  return -1;
 		}
 		f0.h.u3.numnames = 0; /* reusing this as "position-cache valid" flag */
+		filter_pos_vector(f0.h.f_latN, f0.h.f_lonE, f0.h.f_xyz);
+		f0.h.f_cosdist = filter_range_cosdist(f0.h.u2.f_dist);
 
 		// hlog(LOG_DEBUG, "Filter: %s -> M %.3f", filt0, f0.h.u2.f_dist);
 		break;
@@ -1315,6 +1595,8 @@ int filter_parse(struct filter_t **ffp, const char *filt)
 		f0.h.f_lonE = filter_lon2rad(f0.h.f_lonE);
 
 		f0.h.u1.f_coslat = cosf( f0.h.f_latN ); /* Store pre-calculated COS of LAT */
+		filter_pos_vector(f0.h.f_latN, f0.h.f_lonE, f0.h.f_xyz);
+		f0.h.f_cosdist = filter_range_cosdist(f0.h.u2.f_dist);
 		break;
 
 	case 's':
@@ -1409,6 +1691,9 @@ int filter_parse(struct filter_t **ffp, const char *filt)
 			}
 			f0.h.u5.refcallsign.callsign[CALLSIGNLEN_MAX] = 0;
 			f0.h.u5.refcallsign.reflen = strlen(f0.h.u5.refcallsign.callsign);
+			f0.h.u5.refcallsign.key    = callkey_from_text(f0.h.u5.refcallsign.callsign,
+								       f0.h.u5.refcallsign.reflen);
+			f0.h.f_cosdist = filter_range_cosdist(f0.h.u2.f_dist);
 			f0.h.type = 'T'; /* two variants... */
 		}
 
@@ -1467,6 +1752,16 @@ int filter_parse(struct filter_t **ffp, const char *filt)
 	return 0;
 }
 
+int filter_parse(struct filter_t **ffp, const char *filt)
+{
+	int rc = filter_parse_clause(ffp, filt);
+
+	/* Recompile even when an earlier clause got extended */
+	if (rc == 0)
+		filter_compile(*ffp);
+	return rc;
+}
+
 /* Discard the defined filter chain */
 void filter_free(struct filter_t *f)
 {
@@ -1474,6 +1769,11 @@ void filter_free(struct filter_t *f)
 
 	for ( ; f ; f = fnext ) {
 		fnext = f->h.next;
+		if (f->h.prog)
+			free(f->h.prog);
+		filter_callset_free(f->h.callset);
+		free(f->h.rangeset);
+		filter_foldset_free(f->h.foldset);
 		/* If not pointer to internal string, free it.. */
 #ifndef _FOR_VALGRIND_
 		if (f->h.text != f->textbuf)
@@ -1525,17 +1825,44 @@ function maidenhead_km_distance($This, $That) {
 
 */
 
-static float maidenhead_km_distance(float lat1, float coslat1, float lon1, float lat2, float coslat2, float lon2)
-{
-	float sindlat2 = sinf((lat1 - lat2) * 0.5);
-	float sindlon2 = sinf((lon1 - lon2) * 0.5);
+/*
+ *  The range filters do not compute the distance.  Positions are
+ *  turned into unit vectors once, when a packet is parsed and when
+ *  a filter gets its center, and the filter radius into cos() of
+ *  the radius angle.  Then "within range" is:
+ *
+ *	dot(center, position) > cos(radius / R)
+ *
+ *  The R is the same 111.2 km/degree as in the formula above.
+ *  Vectors are kept in double, a float dot product can not resolve
+ *  the 0.1 km minimum radius.
+ */
 
-	float a = (sindlat2 * sindlat2 +
-		   coslat1 * coslat2 * sindlon2 * sindlon2);
+#define FILTER_KM_PER_RADIAN (111.2 * 180.0 / M_PI)
+
+void filter_pos_vector(const float lat, const float lon, double xyz[3])
+{
+	const double coslat = cos(lat);
+	xyz[0] = coslat * cos(lon);
+	xyz[1] = coslat * sin(lon);
+	xyz[2] = sin(lat);
+}
 
-	float c = 2.0 * atan2f( sqrtf(a), sqrtf(1.0 - a));
+double filter_range_cosdist(const float km)
+{
+	const double angle = fabs(km) / FILTER_KM_PER_RADIAN;
+	if (angle >= M_PI)
+		return -2.0; /* the whole globe is within range */
+	return cos(angle);
+}
 
-	return ((111.2 * 180.0 / M_PI) * c);
+/* Negative km means "outside of the range" */
+int filter_range_test(const double xyz1[3], const double xyz2[3], const float km, const double cosdist)
+{
+	const double dot = xyz1[0]*xyz2[0] + xyz1[1]*xyz2[1] + xyz1[2]*xyz2[2];
+	if (km < 0.0)
+		return (dot < cosdist);
+	return (dot > cosdist);
 }
 
 
@@ -1545,7 +1872,7 @@ static float maidenhead_km_distance(float lat1, float coslat1, float lon1, float
  *
  */
 
-static int filter_process_one_a(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_a(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* a/latN/lonW/latS/lonE  	Area filter
 
@@ -1580,7 +1907,7 @@ static int filter_process_one_a(struct pbuf_t *pb, struct filter_t *f)
 	return 0;
 }
 
-static int filter_process_one_b(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_b(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* b/call1/call2...  	Budlist filter
 
@@ -1591,19 +1918,15 @@ static int filter_process_one_b(struct pbuf_t *pb, struct filter_t *f)
 	   Up to 2500 invocations per second.
 	*/
 
-	struct filter_refcallsign_t ref;
 	int i = pb->srccall_end - pb->data;
 
 	if (i > CALLSIGNLEN_MAX) i = CALLSIGNLEN_MAX;
 
 	/* source address  "addr">... */
-        memset( &ref, 0, sizeof(ref) ); // clear it all
-	memcpy( ref.callsign, pb->data, i);
-
-	return filter_match_on_callsignset(&ref, i, f, MatchWild);
+	return filter_match_on_callsignset(pb->data, i, f, MatchWild);
 }
 
-static int filter_process_one_d(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_d(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* d/digi1/digi2...  	Digipeater filter
 
@@ -1614,7 +1937,6 @@ static int filter_process_one_d(struct pbuf_t *pb, struct filter_t *f)
 	   25-35 instances in APRS-IS core at any given time.
 	   Up to 1300 invocations per second.
 	*/
-	struct filter_refcallsign_t ref;
 	const char *d = pb->srccall_end + 1 + pb->dstcall_len + 1; /* viacall start */
 	const char *q = pb->qconst_start-1;
 	int rc, i, j = 0;
@@ -1637,12 +1959,9 @@ static int filter_process_one_d(struct pbuf_t *pb, struct filter_t *f)
 		// hlog(LOG_INFO, "d:  -> (%d,%d) '%.*s'", (int)(d-pb->data), i, i, d);
 
 		// digipeater address  ",addr,"
-        memset( &ref, 0, sizeof(ref) ); // clear it all
-		memcpy( ref.callsign, d, i);
-
 		if (i > CALLSIGNLEN_MAX) i = CALLSIGNLEN_MAX;
 
-		rc = filter_match_on_callsignset(&ref, i, f, MatchWild);
+		rc = filter_match_on_callsignset(d, i, f, MatchWild);
 		if (rc) {
 			return (rc);
 		}
@@ -1652,7 +1971,7 @@ static int filter_process_one_d(struct pbuf_t *pb, struct filter_t *f)
 }
 
 #if 0
-static int filter_process_one_e(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_e(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* e/call1/call1/...  	Entry station filter
 
@@ -1665,7 +1984,6 @@ static int filter_process_one_e(struct pbuf_t *pb, struct filter_t *f)
 	   Up to 200 invocations per second.
 	*/
 
-	struct filter_refcallsign_t ref;
 	const char *e = pb->qconst_start+4;
 	int         i = pb->entrycall_len;
 
@@ -1673,14 +1991,19 @@ static int filter_process_one_e(struct pbuf_t *pb, struct filter_t *f)
 		return 0; /* Bad Entry-station callsign */
 
 	/* entry station address  "qA*,addr," */
-	memset( &ref, 0, sizeof(ref) ); // clear it all
-	memcpy( ref.callsign, e, i);
-
-	return filter_match_on_callsignset(&ref, i, f, MatchWild);
+	return filter_match_on_callsignset(e, i, f, MatchWild);
 }
 #endif
 
 #ifndef DISABLE_IGATE
+/* f and t filters look up their reference callsign with key packed at parse time */
+static history_cell_t *filter_history_lookup(historydb_t *historydb, const struct filter_refcallsign_t *ref)
+{
+	if (ref->key != CALLKEY_NONE)
+		return historydb_lookup_key( historydb, ref->key );
+	return historydb_lookup( historydb, ref->callsign, ref->reflen );
+}
+
 static int filter_process_one_f(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* f/call/dist  	Friend Range filter
@@ -1706,10 +2029,6 @@ static int filter_process_one_f(struct pbuf_t *pb, struct filter_t *f, historydb
 
 	history_cell_t *history;
 
-	float r;
-	float lat1, lon1, coslat1;
-	float lat2, lon2, coslat2;
-
 	const char *callsign = f->h.u5.refcallsign.callsign;
 	int i                = f->h.u5.refcallsign.reflen;
 
@@ -1720,7 +2039,7 @@ static int filter_process_one_f(struct pbuf_t *pb, struct filter_t *f, historydb
 
 	/* find friend's last location packet */
 	if (f->h.hist_age < tick.tv_sec) {
-		history = historydb_lookup( historydb, callsign, i );
+		history = filter_history_lookup( historydb, &f->h.u5.refcallsign );
 		f->h.hist_age = tick.tv_sec + hist_lookup_interval;
 		if (!history) {
 		  if (debug) printf("f-filter: no history lookup result (%.*s) -> return 0\n", i, callsign );
@@ -1730,38 +2049,21 @@ static int filter_process_one_f(struct pbuf_t *pb, struct filter_t *f, historydb
 		f->h.f_latN   = history->lat;
 		f->h.f_lonE   = history->lon;
 		f->h.u1.f_coslat = history->coslat;
+		memcpy(f->h.f_xyz, history->pos_xyz, sizeof(f->h.f_xyz));
 	}
 	if (!f->h.u3.numnames) {
 	  if (debug) printf("f-filter: no history lookup result (numnames == 0) -> return 0\n");
 	  return 0; /* histdb lookup cache invalid */
 	}
 
-	lat1    = f->h.f_latN;
-	lon1    = f->h.f_lonE;
-	coslat1 = f->h.u1.f_coslat;
-
-	lat2    = pb->lat;
-	lon2    = pb->lng;
-	coslat2 = pb->cos_lat;
-
-	r = maidenhead_km_distance(lat1, coslat1, lon1, lat2, coslat2, lon2);
-	if (debug) printf("f-filter: r=%.1f km\n", r);
-
-	if (f->h.u2.f_dist < 0.0) {
-		// Test for _outside_ the range
-		if (r > -f->h.u2.f_dist)  /* Range is more than given limit */
-			return (f->h.negation) ? 2 : 1;
-	} else {
-		// Test for _inside_ the range
-		if (r < f->h.u2.f_dist)  /* Range is less than given limit */
-			return (f->h.negation) ? 2 : 1;
-	}
+	if (filter_range_test(f->h.f_xyz, pb->pos_xyz, f->h.u2.f_dist, f->h.f_cosdist))
+		return (f->h.negation) ? 2 : 1;
 
 	return 0;
 }
 #endif
 
-static int filter_process_one_g(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_g(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* g/call1/call2...  	Group Messaging filter
 
@@ -1770,22 +2072,18 @@ static int filter_process_one_g(struct pbuf_t *pb, struct filter_t *f)
 
 	*/
 
-	struct filter_refcallsign_t ref;
 	int i = pb->dstname_len;
 
 	if (i > CALLSIGNLEN_MAX) i = CALLSIGNLEN_MAX;
 
 	/* source address  "addr">... */
-        memset( &ref, 0, sizeof(ref) ); // clear it all
-	memcpy( ref.callsign, pb->dstname, i);
-
-	return filter_match_on_callsignset(&ref, i, f, MatchWild);
+	return filter_match_on_callsignset(pb->dstname, i, f, MatchWild);
 }
 
 
 
 #if 0  // No M filter implementation, but there is M filter parse producing R filter..
-static int filter_process_one_m(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_m(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* m/dist  	My Range filter
 
@@ -1807,32 +2105,17 @@ static int filter_process_one_m(struct pbuf_t *pb, struct filter_t *f)
            At Aprx: Implemented using Range filter, and prepared at parse time..
 	*/
 
-	float lat2, lon2, coslat2;
-	float r;
-
 	if (!(pb->flags & F_HASPOS)) /* packet with a position.. (msgs with RECEIVER's position) */
 		return 0;
 
-	lat2    = pb->lat;
-	lon2    = pb->lng;
-	coslat2 = pb->cos_lat;
-
-	r = maidenhead_km_distance(myloc_lat, myloc_coslat, myloc_lon, lat2, coslat2, lon2);
-	if (f->h.u2.f_dist < 0.0) {
-		// Test for _outside_ the range
-		if (r > -f->h.u2.f_dist)  /* Range is more than given limit */
-			return (f->h.negation) ? 2 : 1;
-	} else {
-		// Test for _inside_ the range
-		if (r < f->h.u2.f_dist)  /* Range is less than given limit */
-			return (f->h.negation) ? 2 : 1;
-	}
+	if (filter_range_test(f->h.f_xyz, pb->pos_xyz, f->h.u2.f_dist, f->h.f_cosdist))
+		return (f->h.negation) ? 2 : 1;
 
 	return 0;
 }
 #endif
 
-static int filter_process_one_o(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_o(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* o/obj1/obj2...  	Object filter
 	   Pass all objects with the exact name of obj1, obj2, ...
@@ -1844,7 +2127,6 @@ static int filter_process_one_o(struct pbuf_t *pb, struct filter_t *f)
 	   .. 2 cases in entire APRS-IS core at any time.
 	   About 50-70 invocations per second at peak.
 	*/
-	struct filter_refcallsign_t ref;
 	int i;
 	// const char *s;
 
@@ -1862,13 +2144,10 @@ static int filter_process_one_o(struct pbuf_t *pb, struct filter_t *f)
         }
 
 	/* object name */
-	memset( &ref, 0, sizeof(ref) ); // clear it all
-	memcpy( ref.callsign, pb->srcname, i); // copy the interesting part
-
-	return filter_match_on_callsignset(&ref, i, f, MatchWild);
+	return filter_match_on_callsignset(pb->srcname, i, f, MatchWild);
 }
 
-static int filter_process_one_p(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_p(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 
 	/* p/aa/bb/cc...  	Prefix filter
@@ -1880,20 +2159,16 @@ static int filter_process_one_p(struct pbuf_t *pb, struct filter_t *f)
 	   Up to 3500 invocations per second at peak.
 	*/
 
-	struct filter_refcallsign_t ref;
 	int i = pb->srccall_end - pb->data;
 
 	if (i > CALLSIGNLEN_MAX) i = CALLSIGNLEN_MAX;
 
 	/* source address  "addr">... */
-	memset( &ref, 0, sizeof(ref) ); // clear it all
-	memcpy( ref.callsign, pb->data, i);
-
-	return filter_match_on_callsignset(&ref, i, f, MatchPrefix);
+	return filter_match_on_callsignset(pb->data, i, f, MatchPrefix);
 }
 
 #if 0
-static int filter_process_one_q(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_q(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* q/con/ana  	q Contruct filter
 
@@ -1969,7 +2244,7 @@ static int filter_process_one_q(struct pbuf_t *pb, struct filter_t *f)
 }
 #endif
 
-static int filter_process_one_r(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_r(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* r/lat/lon/dist  	Range filter
 
@@ -1986,39 +2261,19 @@ static int filter_process_one_r(struct pbuf_t *pb, struct filter_t *f)
 	   Up to 5200 invocations per second at peak.
 	*/
 
-	float lat1    = f->h.f_latN;
-	float lon1    = f->h.f_lonE;
-	float coslat1 = f->h.u1.f_coslat;
-	float r;
-
-	float lat2, lon2, coslat2;
-
 	if (!(pb->flags & F_HASPOS)) {
 	  /* packet with a position..
 	     (msgs with RECEIVER's position) */
 		return 0;
 	}
 
-	lat2    = pb->lat;
-	lon2    = pb->lng;
-	coslat2 = pb->cos_lat;
-
-	r = maidenhead_km_distance(lat1, coslat1, lon1, lat2, coslat2, lon2);
-
-	if (f->h.u2.f_dist < 0.0) {
-		// Test for _outside_ the range
-		if (r > -f->h.u2.f_dist)  /* Range is more than given limit */
-			return (f->h.negation) ? 2 : 1;
-	} else {
-		// Test for _inside_ the range
-		if (r < f->h.u2.f_dist)  /* Range is less than given limit */
-			return (f->h.negation) ? 2 : 1;
-	}
+	if (filter_range_test(f->h.f_xyz, pb->pos_xyz, f->h.u2.f_dist, f->h.f_cosdist))
+		return (f->h.negation) ? 2 : 1;
 
 	return 0;
 }
 
-static int filter_process_one_s(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_s(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* s/pri/alt/over  	Symbol filter
 
@@ -2132,12 +2387,7 @@ static int filter_process_one_t(struct pbuf_t *pb, struct filter_t *f, historydb
 	if (rc && f->h.type == 'T') { /* Within a range of callsign ?
 				       * Rather rare..  perhaps 2-3 in APRS-IS.
 				       */
-		float range, r;
-		float lat1, lon1, coslat1;
-		float lat2, lon2, coslat2;
 #ifndef DISABLE_IGATE
-		const char *callsign    = f->h.u5.refcallsign.callsign;
-		const int   callsignlen = f->h.u5.refcallsign.reflen;
 		history_cell_t *history;
 #endif
 
@@ -2146,15 +2396,13 @@ static int filter_process_one_t(struct pbuf_t *pb, struct filter_t *f, historydb
 		if (!(pb->flags & F_HASPOS)) /* packet with a position.. (msgs with RECEIVER's position) */
 			return 0; /* No positional data.. */
 
-		range = f->h.u2.f_dist;
-
 		/* So..  Now we have a callsign, and we have range.
 		   Lets find callsign's location, and range to that item..
 		   .. 60-100 lookups per second. */
 
 #ifndef DISABLE_IGATE
 		if (f->h.hist_age < tick.tv_sec) {
-			history = historydb_lookup( historydb, callsign, callsignlen );
+			history = filter_history_lookup( historydb, &f->h.u5.refcallsign );
 
 			/* hlog( LOG_DEBUG, "Type filter with callsign range used! call='%s', range=%.1f position %sfound",
 			//       callsign, range, i ? "" : "not ");
@@ -2167,29 +2415,13 @@ static int filter_process_one_t(struct pbuf_t *pb, struct filter_t *f, historydb
 			f->h.f_latN   = history->lat;
 			f->h.f_lonE   = history->lon;
 			f->h.u1.f_coslat = history->coslat;
+			memcpy(f->h.f_xyz, history->pos_xyz, sizeof(f->h.f_xyz));
 		}
 #endif
 		if (!f->h.u3.numnames) return 0; /* No valid data at range center position cache */
 
-		lat1    = f->h.f_latN;
-		lon1    = f->h.f_lonE;
-		coslat1 = f->h.u1.f_coslat;
-
-		lat2    = pb->lat;
-		lon2    = pb->lng;
-		coslat2 = pb->cos_lat;
-
-		r = maidenhead_km_distance(lat1, coslat1, lon1, lat2, coslat2, lon2);
-
-		if (range < 0.0) {
-			// Test for _outside_ the range
-			if (r > -range)  /* Range is more than given limit */
-				return (f->h.negation) ? 2 : 1;
-		} else {
-			// Test for _inside_ the range
-			if (r < range)  /* Range is less than given limit */
-				return (f->h.negation) ? 2 : 1;
-		}
+		if (filter_range_test(f->h.f_xyz, pb->pos_xyz, f->h.u2.f_dist, f->h.f_cosdist))
+			return (f->h.negation) ? 2 : 1;
 
 		return 0; /* unimplemented! */
 	}
@@ -2197,7 +2429,7 @@ static int filter_process_one_t(struct pbuf_t *pb, struct filter_t *f, historydb
 	return (f->h.negation ? (rc+rc) : rc);
 }
 
-static int filter_process_one_u(struct pbuf_t *pb, struct filter_t *f)
+static int filter_process_one_u(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	/* u/unproto1/unproto2/...  	Unproto filter
 
@@ -2208,7 +2440,6 @@ static int filter_process_one_u(struct pbuf_t *pb, struct filter_t *f)
 	   Seen hardly ever in APRS-IS core, some rare instances in Tier-2.
 	*/
 
-	struct filter_refcallsign_t ref;
 	const char *d = pb->srccall_end+1;
 	int i;
 
@@ -2221,10 +2452,7 @@ static int filter_process_one_u(struct pbuf_t *pb, struct filter_t *f)
 	*/
 
 	/* destination address  ">addr," */
-	memset( &ref, 0, sizeof(ref) ); // clear it all
-	memcpy( ref.callsign,   d, i);
-
-	return filter_match_on_callsignset(&ref, i, f, MatchWild);
+	return filter_match_on_callsignset(d, i, f, MatchWild);
 }
 
 static int filter_process_one(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
@@ -2237,22 +2465,22 @@ static int filter_process_one(struct pbuf_t *pb, struct filter_t *f, historydb_t
 
 	case 'a':
 	case 'A':
-		rc = filter_process_one_a(pb, f);
+		rc = filter_process_one_a(pb, f, historydb);
 		break;
 
 	case 'b':
 	case 'B':
-		rc = filter_process_one_b(pb, f);
+		rc = filter_process_one_b(pb, f, historydb);
 		break;
 	case 'd':
 	case 'D':
-		rc = filter_process_one_d(pb, f);
+		rc = filter_process_one_d(pb, f, historydb);
 		break;
 
 #if 0
 	case 'e':
 	case 'E':
-		rc = filter_process_one_e(pb, f);
+		rc = filter_process_one_e(pb, f, historydb);
 		break;
 #endif
 
@@ -2264,38 +2492,38 @@ static int filter_process_one(struct pbuf_t *pb, struct filter_t *f, historydb_t
 #endif
         case 'g':
         case 'G':
-		rc = filter_process_one_g(pb, f);
+		rc = filter_process_one_g(pb, f, historydb);
 		break;
 
 #if 0 // these are compiled as R filters, no M filters exist internally
 	case 'm':
 	case 'M':
-		rc = filter_process_one_m(pb, f);
+		rc = filter_process_one_m(pb, f, historydb);
 		break;
 #endif
 	case 'o':
 	case 'O':
-		rc = filter_process_one_o(pb, f);
+		rc = filter_process_one_o(pb, f, historydb);
 		break;
 
 	case 'p':
 	case 'P':
-		rc = filter_process_one_p(pb, f);
+		rc = filter_process_one_p(pb, f, historydb);
 		break;
 #if 0
 	case 'q':
 	case 'Q':
-		rc = filter_process_one_q(pb, f);
+		rc = filter_process_one_q(pb, f, historydb);
 		break;
 #endif
 	case 'r':
 	case 'R':
-		rc = filter_process_one_r(pb, f);
+		rc = filter_process_one_r(pb, f, historydb);
 		break;
 
 	case 's':
 	case 'S':
-		rc = filter_process_one_s(pb, f);
+		rc = filter_process_one_s(pb, f, historydb);
 		break;
 
 	case 't':
@@ -2305,7 +2533,7 @@ static int filter_process_one(struct pbuf_t *pb, struct filter_t *f, historydb_t
 
 	case 'u':
 	case 'U':
-		rc = filter_process_one_u(pb, f);
+		rc = filter_process_one_u(pb, f, historydb);
 		break;
 
 	default:
@@ -2317,7 +2545,598 @@ static int filter_process_one(struct pbuf_t *pb, struct filter_t *f, historydb_t
 	return rc;
 }
 
+static int filter_is_callsignset(const int type)
+{
+	return (strchr("bBdDgGoOpPuU", type) != NULL);
+}
+
+static filter_fn_t filter_op_fn(const int type)
+{
+	switch (type) {
+	case 'a': case 'A':	return filter_process_one_a;
+	case 'b': case 'B':	return filter_process_one_b;
+	case 'd': case 'D':	return filter_process_one_d;
+#ifndef DISABLE_IGATE
+	case 'f': case 'F':	return filter_process_one_f;
+#endif
+	case 'g': case 'G':	return filter_process_one_g;
+	case 'o': case 'O':	return filter_process_one_o;
+	case 'p': case 'P':	return filter_process_one_p;
+	case 'r': case 'R':	return filter_process_one_r;
+	case 's': case 'S':	return filter_process_one_s;
+	case 't': case 'T':	return filter_process_one_t;
+	case 'u': case 'U':	return filter_process_one_u;
+	default:		return NULL;
+	}
+}
+
+/* Can this clause say "match, but don't pass" ? */
+static int filter_may_reject(const struct filter_t *f)
+{
+	int i;
+	if (f->h.negation)
+		return 1;
+	if (filter_is_callsignset(f->h.type)) {
+		/* Same type clauses are merged, some entries may be negated */
+		for (i = 0; i < f->h.u3.numnames; ++i)
+			if (f->h.u5.refcallsigns[i].reflen & NegationFlag)
+				return 1;
+	}
+	return 0;
+}
+
+/* Can some key match both entries ?  Prefixes are p/ entries and
+   wild-cards, the others match a key of their own length only. */
+static int filter_fold_overlap(const struct filter_refcallsign_t *a, const struct filter_refcallsign_t *b,
+			       const int prefixonly)
+{
+	const int alen = a->reflen & LengthMask, awild = prefixonly || (a->reflen & WildCard);
+	const int blen = b->reflen & LengthMask, bwild = prefixonly || (b->reflen & WildCard);
+
+	if (alen == 0 || blen == 0)
+		return 0; /* never match */
+	if (!awild && !bwild && alen != blen)
+		return 0;
+	if (!awild && bwild && alen < blen)
+		return 0;
+	if (awild && !bwild && blen < alen)
+		return 0;
+	return (strncasecmp(a->callsign, b->callsign, alen < blen ? alen : blen) == 0);
+}
+
+/* The only verdict of a clause that can be folded, 2 for "match,
+   but don't pass", 1 for "pass", or 0 when it can not be folded.
+   A callsign set with both kinds of entries is 3, if its negated
+   entries can be split off to the rejects: none of them may match
+   a key that an earlier, not negated entry matches.  Not d/, that
+   has the verdict of the first via that matches any entry. */
+static int filter_fold_verdict(const struct filter_t *f)
+{
+	const struct filter_refcallsign_t *r = f->h.u5.refcallsigns;
+	const int n = f->h.u3.numnames;
+	const int prefixonly = (f->h.type == 'p' || f->h.type == 'P');
+	int i, j, negated = 0;
+
+	switch (f->h.type) {
+	case 't':
+		return (f->h.negation ? 2 : 1);
+	case 'b': case 'B':
+	case 'd': case 'D':
+	case 'p': case 'P':
+	case 'u': case 'U':
+		if (n <= 0)
+			return 0;
+		for (i = 0; i < n; ++i)
+			if (r[i].reflen & NegationFlag)
+				++negated;
+		if (negated == 0)
+			return 1;
+		if (negated == n)
+			return 2;
+		if (f->h.type == 'd' || f->h.type == 'D')
+			return 0;
+		for (j = 1; j < n; ++j) {
+			if (!(r[j].reflen & NegationFlag))
+				continue;
+			for (i = 0; i < j; ++i)
+				if (!(r[i].reflen & NegationFlag) &&
+				    filter_fold_overlap(&r[i], &r[j], prefixonly))
+					return 0;
+		}
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+/* The entries of one verdict of the clauses of a list, split is set
+   when the mixed clauses are folded too. */
+static struct filter_foldset_t *filter_foldset_build(struct filter_t *head, const int verdict, const int split)
+{
+	struct filter_foldset_t *fs;
+	struct filter_refcallsign_t *r;
+	struct filter_t *f;
+	int nsrc = 0, ndst = 0, nvia = 0, *np, v, i;
+
+	for (f = head; f; f = f->h.next) {
+		v = filter_fold_verdict(f);
+		if (v != verdict && !(v == 3 && split))
+			continue;
+		switch (f->h.type) {
+		case 'b': case 'B':
+		case 'p': case 'P':	np = &nsrc; break;
+		case 'u': case 'U':	np = &ndst; break;
+		case 'd': case 'D':	np = &nvia; break;
+		default:		continue;
+		}
+		for (i = 0; i < f->h.u3.numnames; ++i)
+			if (((f->h.u5.refcallsigns[i].reflen & NegationFlag) ? 2 : 1) == verdict)
+				++*np;
+	}
+
+	fs = calloc(1, sizeof(*fs) + (nsrc + ndst + nvia) * sizeof(fs->refs[0]));
+	if (fs == NULL)
+		return NULL;
+	fs->verdict = verdict;
+	fs->srcrefs = fs->refs;
+	fs->dstrefs = fs->srcrefs + nsrc;
+	fs->viarefs = fs->dstrefs + ndst;
+
+	nsrc = ndst = nvia = 0;
+	for (f = head; f; f = f->h.next) {
+		v = filter_fold_verdict(f);
+		if (v != verdict && !(v == 3 && split))
+			continue;
+		switch (f->h.type) {
+		case 't':
+			fs->types |= f->h.u4.bitflags; /* same int promotion as in the filter */
+			continue;
+		case 'b': case 'B':
+		case 'p': case 'P':
+			r = fs->srcrefs; np = &nsrc;
+			break;
+		case 'u': case 'U':
+			r = fs->dstrefs; np = &ndst;
+			break;
+		default:
+			r = fs->viarefs; np = &nvia;
+			break;
+		}
+		for (i = 0; i < f->h.u3.numnames; ++i) {
+			const struct filter_refcallsign_t *e = &f->h.u5.refcallsigns[i];
+			if (((e->reflen & NegationFlag) ? 2 : 1) != verdict)
+				continue;
+			r[*np] = *e;
+			if (f->h.type == 'p' || f->h.type == 'P') {
+				r[*np].reflen |= WildCard;
+				r[*np].key     = CALLKEY_NONE;
+			}
+			++*np;
+		}
+	}
+
+	if (nsrc > 0)
+		fs->src = filter_callset_make(fs->srcrefs, nsrc, 0);
+	if (ndst > 0)
+		fs->dst = filter_callset_make(fs->dstrefs, ndst, 0);
+	if (nvia > 0)
+		fs->via = filter_callset_make(fs->viarefs, nvia, 0);
+	if ((nsrc > 0 && fs->src == NULL) ||
+	    (ndst > 0 && fs->dst == NULL) ||
+	    (nvia > 0 && fs->via == NULL)) {
+		filter_foldset_free(fs);
+		return NULL;
+	}
+	return fs;
+}
+
+/* One op for all the clauses of a filter_foldset_t, the address
+   fields are located as in filter_process_one_b(), _u() and _d().
+   Any match is the verdict of them all. */
+static int filter_process_folded(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
+{
+	const struct filter_foldset_t *fs = f->h.foldset;
+	int i, j;
+
+	if (pb->packettype & fs->types)
+		return fs->verdict;
+
+	if (fs->src != NULL) {
+		i = pb->srccall_end - pb->data;
+		if (i > CALLSIGNLEN_MAX) i = CALLSIGNLEN_MAX;
+		if (filter_callset_lookup(fs->src, fs->srcrefs, pb->data, i) >= 0)
+			return fs->verdict;
+	}
+	if (fs->dst != NULL) {
+		i = pb->dstcall_len;
+		if (i > CALLSIGNLEN_MAX) i = CALLSIGNLEN_MAX;
+		if (filter_callset_lookup(fs->dst, fs->dstrefs, pb->srccall_end+1, i) >= 0)
+			return fs->verdict;
+	}
+	if (fs->via != NULL) {
+		const char *d = pb->srccall_end + 1 + pb->dstcall_len + 1;
+		const char *q = pb->qconst_start-1;
+
+		for (j = 1; d < q && j <= 10; ++j) {
+			if (*d == ':') break;
+			if (*d == ',') ++d;
+			for (i = 0; i+d <= q && i <= CALLSIGNLEN_MAX; ++i) {
+				if ((d[i] == ',') || (d[i] == ':'))
+					break;
+			}
+			if (i > CALLSIGNLEN_MAX) i = CALLSIGNLEN_MAX;
+			if (filter_callset_lookup(fs->via, fs->viarefs, d, i) >= 0)
+				return fs->verdict;
+			d += i;
+		}
+	}
+	return 0;
+}
+
+static void filter_op_prereq(struct filter_op_t *op)
+{
+	const struct filter_t *f = op->f;
+
+	op->types = 0;
+	op->flags = 0;
+	switch (f->h.type) {
+	case 'a': case 'A':
+	case 'r': case 'R':
+	case 'f': case 'F':
+		op->flags = F_HASPOS;
+		break;
+	case 'o': case 'O':
+		op->types = T_OBJECT|T_ITEM;
+		break;
+	case 't':
+		op->types = f->h.u4.bitflags; /* same int promotion as in the filter */
+		break;
+	case 'T':
+		op->types = f->h.u4.bitflags;
+		op->flags = F_HASPOS;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Relative evaluation cost, cheap ones are tried first */
+static int filter_op_cost(const int type)
+{
+	switch (type) {
+	case 't':		return 0;
+	case 's': case 'S':	return 1;
+	case 'a': case 'A':	return 2;
+	case 'b': case 'B':
+	case 'g': case 'G':
+	case 'o': case 'O':
+	case 'p': case 'P':
+	case 'u': case 'U':	return 3;
+	case 'd': case 'D':	return 4;
+	case 'r': case 'R':	return 5;
+	default:		return 6; /* f, T: historydb lookups */
+	}
+}
+
+/* Order by prerequisites first (groups are contiguous), then
+   clauses without prerequisites, and by cost within them.
+   The folded rejects go before all, a reject ends it. */
+static inline int filter_op_order(const struct filter_op_t *op)
+{
+	const int hasreq = (op->types || op->flags);
+	if (op->fn == filter_process_folded) /* as a callset lookup */
+		return (op->f->h.foldset->verdict == 2) ? 0 : ((1 << 24) | 3);
+	return ( ((!hasreq) << 24) | (op->flags << 17) | (op->types ? 0x10000 : 0) |
+		 ((op->types & 0xFFF) << 4) | filter_op_cost(op->f->h.type) );
+}
+
+/* Stable sort of ops[] so that same prerequisites are adjacent,
+   then mark group heads. */
+static void filter_op_group(struct filter_op_t *ops, const int count)
+{
+	int i, j;
+	for (i = 1; i < count; ++i) {
+		struct filter_op_t t = ops[i];
+		const int key = filter_op_order(&t);
+		for (j = i; j > 0 && filter_op_order(&ops[j-1]) > key; --j)
+			ops[j] = ops[j-1];
+		ops[j] = t;
+	}
+	for (i = 0; i < count; i = j) {
+		for (j = i+1; j < count; ++j) {
+			ops[j].groupsize = 0;
+			if (ops[j].types != ops[i].types || ops[j].flags != ops[i].flags)
+				break;
+		}
+		ops[i].groupsize = (ops[i].types || ops[i].flags) ? (j - i) : 0;
+	}
+}
+
+/* The a/A and r/R clauses of a position group, see filter_op_ranges() */
+struct filter_range_t {
+	double	xyz[3];
+	double	cosdist;  /* both negated for "outside of the range" */
+	int	verdict;  /* 1, or 2 for a negated clause */
+};
+
+struct filter_box_t {
+	float	latN, latS, lonE, lonW;
+	int	outside;  /* A matches also outside the box */
+	int	verdict;
+};
+
+struct filter_rangeset_t {
+	int	nboxes;
+	int	nranges;
+	struct filter_box_t   *boxes;
+	struct filter_range_t  ranges[1];
+};
+
+static int filter_process_ranges(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
+{
+	const struct filter_rangeset_t *rs = f->h.rangeset;
+	const double x = pb->pos_xyz[0], y = pb->pos_xyz[1], z = pb->pos_xyz[2];
+	int i;
+
+	if (!(pb->flags & F_HASPOS))
+		return 0;
+
+	for (i = 0; i < rs->nboxes; ++i) {
+		const struct filter_box_t *B = &rs->boxes[i];
+		if (B->outside ||
+		    (pb->lat <= B->latN && pb->lat >= B->latS &&
+		     pb->lng <= B->lonE && pb->lng >= B->lonW))
+			return B->verdict;
+	}
+	for (i = 0; i < rs->nranges; ++i) {
+		const struct filter_range_t *R = &rs->ranges[i];
+		if (R->xyz[0]*x + R->xyz[1]*y + R->xyz[2]*z > R->cosdist)
+			return R->verdict;
+	}
+	return 0;
+}
+
+/* Replace the a/A, r/R clauses at the head of each position group
+   with one filter_process_ranges() op, returns the new op count.
+   The clauses of a group are all in the same pass, so the first
+   match is the result of them all. */
+static int filter_op_ranges(struct filter_op_t *ops, int count)
+{
+	struct filter_rangeset_t *rs;
+	int i, j, m, nb, nr;
+
+	for (i = 0; i < count; i += ops[i].groupsize ? ops[i].groupsize : 1) {
+		if (ops[i].flags != F_HASPOS || ops[i].types != 0)
+			continue;
+		nb = nr = 0;
+		for (m = 0; m < ops[i].groupsize; ++m) {
+			const char type = ops[i+m].f->h.type;
+			if (type == 'a' || type == 'A')
+				++nb;
+			else if (type == 'r' || type == 'R')
+				++nr;
+			else
+				break;	/* f/ last, by cost */
+		}
+		if (m < 2)
+			continue;
+
+		rs = calloc(1, sizeof(*rs) + nr * sizeof(rs->ranges[0]) + nb * sizeof(*rs->boxes));
+		if (rs == NULL)
+			continue; /* one op per clause will do */
+		rs->boxes = (struct filter_box_t *) &rs->ranges[nr > 0 ? nr : 1];
+		for (j = 0; j < m; ++j) {
+			const struct filter_t *f = ops[i+j].f;
+			const int verdict = f->h.negation ? 2 : 1;
+			if (f->h.type == 'a' || f->h.type == 'A') {
+				struct filter_box_t *B = &rs->boxes[rs->nboxes++];
+				B->latN    = f->h.f_latN;
+				B->latS    = f->h.u1.f_latS;
+				B->lonE    = f->h.f_lonE;
+				B->lonW    = f->h.u2.f_lonW;
+				B->outside = (f->h.type == 'A');
+				B->verdict = verdict;
+			} else {
+				/* dot < cos  is  -dot > -cos */
+				struct filter_range_t *R = &rs->ranges[rs->nranges++];
+				const double sign = f->h.u2.f_dist < 0.0 ? -1.0 : 1.0;
+				R->xyz[0]  = sign * f->h.f_xyz[0];
+				R->xyz[1]  = sign * f->h.f_xyz[1];
+				R->xyz[2]  = sign * f->h.f_xyz[2];
+				R->cosdist = sign * f->h.f_cosdist;
+				R->verdict = verdict;
+			}
+		}
+		ops[i].f->h.rangeset = rs;
+		ops[i].fn = filter_process_ranges;
+		memmove(&ops[i+1], &ops[i+m], (count - i - m) * sizeof(ops[0]));
+		ops[i].groupsize -= m - 1;
+		count -= m - 1;
+	}
+	return count;
+}
+
+void filter_compile(struct filter_t *head)
+{
+	struct filter_prog_t *prog;
+	struct filter_t *f, *fold[2] = { NULL, NULL };
+	int count = 0, nfold[2] = { 0, 0 }, nmixed = 0, split, n, pass, v;
+
+	if (head == NULL)
+		return;
+	if (head->h.prog) {
+		free(head->h.prog);
+		head->h.prog = NULL;
+	}
+	for (f = head; f; f = f->h.next) {
+		++count;
+		free(f->h.rangeset);
+		f->h.rangeset = NULL;
+		filter_foldset_free(f->h.foldset);
+		f->h.foldset = NULL;
+		v = filter_fold_verdict(f); /* 2, 3 only if filter_may_reject() */
+		if (v == 3) {
+			++nmixed;
+		} else if (v > 0) {
+			if (fold[v-1] == NULL)
+				fold[v-1] = f;
+			++nfold[v-1];
+		}
+		if (filter_is_callsignset(f->h.type)) {
+			filter_callset_free(f->h.callset);
+			f->h.callset = filter_callset_build(f, (f->h.type == 'p' ||
+								f->h.type == 'P'));
+		}
+	}
+
+	prog = calloc(1, sizeof(*prog) + sizeof(prog->ops[0]) * count);
+	if (prog == NULL)
+		return; /* filter_process() walks the chain instead */
+
+	/* Fold the clauses of each pass into the first one of them,
+	   the rejecting ones are in pass 1.  The mixed ones are split
+	   when both passes have a clause to hold the set. */
+	split = (nmixed > 0 && nfold[0] > 0 && nfold[1] > 0);
+	for (pass = 0; pass < 2; ++pass) {
+		if (nfold[pass] + (split ? nmixed : 0) >= 2)
+			fold[pass]->h.foldset = filter_foldset_build(head, pass+1, split);
+		if (fold[pass] != NULL && fold[pass]->h.foldset == NULL)
+			fold[pass] = NULL; /* one op per clause will do */
+	}
+	if (split && (fold[0] == NULL || fold[1] == NULL)) {
+		for (pass = 0; pass < 2; ++pass) {
+			if (fold[pass] != NULL) {
+				filter_foldset_free(fold[pass]->h.foldset);
+				fold[pass]->h.foldset = NULL;
+				fold[pass] = NULL;
+			}
+		}
+		split = 0;
+	}
+
+	n = 0;
+	for (pass = 1; pass >= 0; --pass) {
+		const int first = n;
+		for (f = head; f; f = f->h.next) {
+			struct filter_op_t *op;
+			if (filter_may_reject(f) != pass)
+				continue;
+			op = &prog->ops[n];
+			op->f  = f;
+			v = filter_fold_verdict(f);
+			if ((fold[pass] != NULL && v == pass+1) || (split && v == 3)) {
+				if (f == fold[pass]) {
+					op->fn = filter_process_folded;
+					++n;
+				}
+				continue;
+			}
+			op->fn = filter_op_fn(f->h.type);
+			if (op->fn == NULL)
+				continue; /* unknown types never match */
+			filter_op_prereq(op);
+			++n;
+		}
+		filter_op_group(prog->ops + first, n - first);
+		n = first + filter_op_ranges(prog->ops + first, n - first);
+		if (pass)
+			prog->rejects = n;
+	}
+	prog->count = n;
+	head->h.prog = prog;
+
+	if (debug > 1) {
+		int i;
+		printf("filter_compile(): %d clauses, %d rejecting\n", n, prog->rejects);
+		for (i = 0; i < n; ++i)
+			printf("  %2d: types=0x%04x flags=0x%02x group=%d  '%s'\n",
+			       i, prog->ops[i].types & 0xFFFF, prog->ops[i].flags,
+			       prog->ops[i].groupsize, prog->ops[i].f->h.text);
+	}
+}
+
+static inline int filter_op_skip(const struct filter_op_t *op, const struct pbuf_t *pb)
+{
+	return ( (op->flags & ~pb->flags) ||
+		 (op->types && !(op->types & pb->packettype)) );
+}
+
+static int filter_process_(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
+{
+	const struct filter_prog_t *prog;
+	const struct filter_op_t *op, *end;
+	int seen_accept = 0;
+
+	if (f == NULL)
+		return 0;
+	prog = f->h.prog;
+	if (prog == NULL)
+		return filter_process_chain(pb, f, historydb);
+
+	/* Anything that says "don't pass" wins, check those first */
+	op  = prog->ops;
+	end = prog->ops + prog->rejects;
+	while (op < end) {
+		int rc;
+		if (op->groupsize && filter_op_skip(op, pb)) {
+			op += op->groupsize;
+			continue;
+		}
+		rc = op->fn(pb, op->f, historydb);
+		if (rc == 2)
+			return -1;
+		if (rc == 1)
+			seen_accept = 1;
+		++op;
+	}
+	if (seen_accept)
+		return 1;
+
+	/* The rest can only accept, first one is enough */
+	end = prog->ops + prog->count;
+	while (op < end) {
+		if (op->groupsize && filter_op_skip(op, pb)) {
+			op += op->groupsize;
+			continue;
+		}
+		if (op->fn(pb, op->f, historydb) == 1)
+			return 1;
+		++op;
+	}
+	return 0;
+}
+
 int filter_process(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
+{
+	const int rc = filter_process_(pb, f, historydb);
+
+	APRX_PROBE3(filter, pb->data, pb->packet_len, rc);
+	return rc;
+}
+
+/* Undo filter_compile(): without the program and the callsign-set
+   lookup tables, filter_process() walks the chain, and scans the
+   callsign sets entry by entry.  The reference in filter-bench. */
+void filter_uncompile(struct filter_t *head)
+{
+	struct filter_t *f;
+
+	if (head == NULL)
+		return;
+	free(head->h.prog);
+	head->h.prog = NULL;
+	for (f = head; f; f = f->h.next) {
+		filter_callset_free(f->h.callset);
+		f->h.callset = NULL;
+		free(f->h.rangeset);
+		f->h.rangeset = NULL;
+		filter_foldset_free(f->h.foldset);
+		f->h.foldset = NULL;
+	}
+}
+
+/* The filter chain walk without a program, the reference semantics */
+int filter_process_chain(struct pbuf_t *pb, struct filter_t *f, historydb_t *historydb)
 {
 	int seen_accept = 0;
 
@@ -45,7 +45,9 @@ void historydb_init(void)
 				    historydb_cellsize,
 				    historydb_cellalign, 
 				    CELLMALLOC_POLICY_FIFO,
-				    32 /* 32 kB */,
+				    // 110 cells at the time, what 32 kB took
+				    // before the callsign keys grew them
+				    (110 * historydb_cellsize + 1023) / 1024,
 				    0 /* minfree */ );
 }
 
@@ -144,6 +146,28 @@ static int foldhash( const unsigned int h1 )
 	return (h2 % HISTORYDB_HASH_MODULO);
 }
 
+/* Keys are packed into 64-bit callkeys whenever possible, then the key
+   comparison is a single integer compare.  Rare unpackable keys (too
+   long object names, 8-bit content) use the string hash and memcmp(). */
+
+static unsigned int historydb_keyhash( const char *keybuf, const int keylen, callkey_t *ckeyp )
+{
+	const callkey_t ckey = callkey_from_text(keybuf, keylen);
+	*ckeyp = ckey;
+	if (ckey != CALLKEY_NONE)
+		return callkey_hash(ckey);
+	return keyhash(keybuf, keylen, 0);
+}
+
+static inline int historydb_samekey( const struct history_cell_t *cp, const callkey_t ckey, const char *keybuf, const int keylen )
+{
+	if (ckey != CALLKEY_NONE)
+		return (cp->ckey == ckey);
+	return ( cp->ckey == CALLKEY_NONE &&
+		 cp->keylen == keylen &&
+		 memcmp(cp->key, keybuf, keylen) == 0 );
+}
+
 
 /* insert... */
 
@@ -156,6 +180,7 @@ history_cell_t *historydb_insert_(historydb_t *db, const struct pbuf_t *pb, cons
 {
 	int i;
 	unsigned int h1;
+	callkey_t ckey;
 	int isdead = 0, keylen;
 	struct history_cell_t **hp, *cp, *cp1;
 
@@ -249,7 +274,7 @@ history_cell_t *historydb_insert_(historydb_t *db, const struct pbuf_t *pb, cons
 
 	++db->historydb_inserts;
 
-	h1 = keyhash(keybuf, keylen, 0);
+	h1 = historydb_keyhash(keybuf, keylen, &ckey);
 	i  = foldhash(h1);
 	if (debug > 1) printf(" key='%s' hash=%d", keybuf, i);
 
@@ -269,8 +294,7 @@ history_cell_t *historydb_insert_(historydb_t *db, const struct pbuf_t *pb, cons
 		       // Hash match, compare the key
 		    historydb_hashmatch(); // debug thing -- a profiling counter
 		    ++db->historydb_hashmatches;
-		    if ( cp->keylen == keylen &&
-			 (memcmp(cp->key, keybuf, keylen) == 0) ) {
+		    if ( historydb_samekey(cp, ckey, keybuf, keylen) ) {
 		  	// Key match!
 		    	historydb_keymatch(); // debug thing -- a profiling counter
 			++db->historydb_keymatches;
@@ -289,6 +313,7 @@ history_cell_t *historydb_insert_(historydb_t *db, const struct pbuf_t *pb, cons
 				  cp->lat         = pb->lat;
 				  cp->coslat      = pb->cos_lat;
 				  cp->lon         = pb->lng;
+				  memcpy(cp->pos_xyz, pb->pos_xyz, sizeof(cp->pos_xyz));
 				  cp->positiontime = pb->t;
 				}
 				cp->packettype  = pb->packettype;
@@ -317,15 +342,19 @@ history_cell_t *historydb_insert_(historydb_t *db, const struct pbuf_t *pb, cons
 	if (!cp1 && !isdead) {
 		// Not found on this chain, append it!
 		cp = historydb_alloc(db, pb->packet_len);
+		if (cp == NULL)
+		  return NULL; // The arena is full
 		cp->next = NULL;
 		memcpy(cp->key, keybuf, keylen);
 		cp->key[keylen] = 0; /* zero terminate */
 		cp->keylen = keylen;
+		cp->ckey  = ckey;
 		cp->hash1 = h1;
 
 		cp->lat         = pb->lat;
 		cp->coslat      = pb->cos_lat;
 		cp->lon         = pb->lng;
+		memcpy(cp->pos_xyz, pb->pos_xyz, sizeof(cp->pos_xyz));
 		cp->arrivaltime = pb->t;
 		cp->packettype  = pb->packettype;
 		cp->flags       = pb->flags;
@@ -361,6 +390,7 @@ history_cell_t *historydb_insert_heard(historydb_t *db, const struct pbuf_t *pb)
 {
 	int i;
 	unsigned int h1;
+	callkey_t ckey;
 	int keylen;
 	struct history_cell_t **hp, *cp, *cp1;
 
@@ -417,7 +447,7 @@ history_cell_t *historydb_insert_heard(historydb_t *db, const struct pbuf_t *pb)
 
 	++db->historydb_inserts;
 
-	h1 = keyhash(keybuf, keylen, 0);
+	h1 = historydb_keyhash(keybuf, keylen, &ckey);
 	i  = foldhash(h1);
 	if (debug > 1) printf(" key='%s' hash=%d", keybuf, i);
 
@@ -439,8 +469,7 @@ history_cell_t *historydb_insert_heard(historydb_t *db, const struct pbuf_t *pb)
 		    historydb_hashmatch(); // debug thing -- a profiling counter
 		    ++db->historydb_hashmatches;
 		    if (debug > 1) printf(" .. found matching hash");
-		    if ( cp->keylen == keylen &&
-			 (memcmp(cp->key, keybuf, keylen) == 0) ) {
+		    if ( historydb_samekey(cp, ckey, keybuf, keylen) ) {
 		  	// Key match!
 		        if (debug > 1) printf(" .. found matching key!\n");
 
@@ -455,6 +484,7 @@ history_cell_t *historydb_insert_heard(historydb_t *db, const struct pbuf_t *pb)
 			  cp->lat         = pb->lat;
 			  cp->coslat      = pb->cos_lat;
 			  cp->lon         = pb->lng;
+			  memcpy(cp->pos_xyz, pb->pos_xyz, sizeof(cp->pos_xyz));
 			  cp->positiontime = pb->t;
 			  cp->arrivaltime  = pb->t;
 			}
@@ -490,15 +520,19 @@ history_cell_t *historydb_insert_heard(historydb_t *db, const struct pbuf_t *pb)
 
 		// Not found on this chain, append it!
 		cp = historydb_alloc(db, pb->packet_len);
+		if (cp == NULL)
+		  return NULL; // The arena is full
 		cp->next = NULL;
 		memcpy(cp->key, keybuf, keylen);
 		cp->key[keylen] = 0; /* zero terminate */
 		cp->keylen = keylen;
+		cp->ckey  = ckey;
 		cp->hash1 = h1;
 
 		cp->lat         = pb->lat;
 		cp->coslat      = pb->cos_lat;
 		cp->lon         = pb->lng;
+		memcpy(cp->pos_xyz, pb->pos_xyz, sizeof(cp->pos_xyz));
 		cp->arrivaltime = pb->t;
 		cp->packettype  = pb->packettype;
 		cp->flags       = pb->flags;
@@ -525,10 +559,9 @@ history_cell_t *historydb_insert_heard(historydb_t *db, const struct pbuf_t *pb)
 
 /* lookup... */
 
-history_cell_t *historydb_lookup(historydb_t *db, const char *keybuf, const int keylen)
+static history_cell_t *historydb_lookup_(historydb_t *db, const unsigned int h1, const callkey_t ckey, const char *keybuf, const int keylen)
 {
 	int i;
-	unsigned int h1;
 	struct history_cell_t *cp;
 
 	// validity is 5 minutes shorter than expiration time..
@@ -536,7 +569,6 @@ history_cell_t *historydb_lookup(historydb_t *db, const char *keybuf, const int
 
 	++db->historydb_lookups;
 
-	h1 = keyhash(keybuf, keylen, 0);
 	i  = foldhash(h1);
 
 	cp = db->hash[i];
@@ -544,11 +576,10 @@ history_cell_t *historydb_lookup(historydb_t *db, const char *keybuf, const int
 	if (debug > 1) printf("historydb_lookup('%.*s') -> i=%d", keylen, keybuf, i);
 
 	for ( ; cp != NULL ; cp = cp->next ) {
-	  if ( (cp->hash1 == h1) &&
-	       // Hash match, compare the key
-	       (cp->keylen == keylen) ) {
+	  if (cp->hash1 == h1) {
+	    // Hash match, compare the key
 	    if (debug > 1) printf(" .. hash match");
-	    if (memcmp(cp->key, keybuf, keylen) == 0) {
+	    if (historydb_samekey(cp, ckey, keybuf, keylen)) {
 	      if (debug > 1) printf(" .. key match");
 	      // Key match!
 	      if (timecmp(cp->arrivaltime, validitytime) > 0) {
@@ -562,6 +593,22 @@ history_cell_t *historydb_lookup(historydb_t *db, const char *keybuf, const int
 	return NULL;
 }
 
+history_cell_t *historydb_lookup(historydb_t *db, const char *keybuf, const int keylen)
+{
+	callkey_t ckey;
+	unsigned int h1 = historydb_keyhash(keybuf, keylen, &ckey);
+
+	return historydb_lookup_(db, h1, ckey, keybuf, keylen);
+}
+
+/* Lookup with a key that was packed in advance, e.g. at filter parse time */
+history_cell_t *historydb_lookup_key(historydb_t *db, const callkey_t ckey)
+{
+	if (ckey == CALLKEY_NONE)
+		return NULL;
+	return historydb_lookup_(db, callkey_hash(ckey), ckey, "", 0);
+}
+
 
 
 /*
@@ -606,6 +653,12 @@ static time_t next_cleanup_time;
 
 int  historydb_prepoll(struct aprxpolls *app)
 {
+	long cells = 0;
+	int i;
+
+	for (i = 0; i < _dbs_count; ++i)
+		cells += _dbs[i]->historydb_cellgauge;
+	metric_set(METRIC_HISTORYDB_CELLS, cells);
 	return 0;
 }
 
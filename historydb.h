@@ -61,6 +61,8 @@ typedef struct history_cell_t {
 	char         key[CALLSIGNLEN_MAX+2];
 
 	float	lat, coslat, lon;
+	double	pos_xyz[3]; /* unit vector of the position */
+	callkey_t ckey;    /* packed key, CALLKEY_NONE if key[] is not packable */
 	uint32_t hash1;
 
 	char *packet;
@@ -97,5 +99,6 @@ extern history_cell_t *historydb_insert(historydb_t *db, const struct pbuf_t*);
 extern history_cell_t *historydb_insert_(historydb_t *, const struct pbuf_t *, const int);
 extern history_cell_t *historydb_insert_heard(historydb_t *db, const struct pbuf_t*);
 extern history_cell_t *historydb_lookup(historydb_t *db, const char *keybuf, const int keylen);
+extern history_cell_t *historydb_lookup_key(historydb_t *db, const callkey_t ckey);
 
 #endif
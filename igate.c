@@ -307,6 +307,11 @@ void igate_to_aprsis(const char *portname, const int tncid, const char *tnc2buf,
 	/* _NO_ ending CRLF, the APRSIS subsystem adds it. */
 
 	discard = aprsis_queue(tp, tnc2addrlen, qTYPE_IGATED, portname, t0, e - t0); /* Send it.. */
+	if (discard) {
+		metric_add(METRIC_IGATE_DROP_QUEUE, 1);
+		APRX_PROBE4(igate__drop, portname, tnc2buf, tnc2len, 1);
+	} else
+		APRX_PROBE3(igate__queue, portname, tnc2buf, tnc2len);
 	/* DEBUG OUTPUT TO STDOUT ! */
 	verblog(portname, 0, tp, tnc2len);
 
@@ -314,6 +319,8 @@ void igate_to_aprsis(const char *portname, const int tncid, const char *tnc2buf,
  discard:;
 
 		discard = -1;
+		metric_add(METRIC_IGATE_DROP_RULES, 1);
+		APRX_PROBE4(igate__drop, portname, tnc2buf, tnc2len, 0);
 	}
 
 	if (discard) {
@@ -65,7 +65,8 @@ int			top_interfaces_group;
 struct aprx_interface aprsis_interface = {
 	IFTYPE_APRSIS, 0, 0, 0, "APRSIS",
 	{'A'<<1,'P'<<1,'R'<<1,'S'<<1,'I'<<1,'S'<<1, 0x60},
-	0, NULL,
+	CALLKEY_NONE,
+	0, NULL, NULL,
 	0, 0, 0, // subif, txrefcount, tx_ok
         1, 1, 0, // telemeter-to-is, telemeter-to-rf, telemeter-newformat
         0, NULL,
@@ -165,7 +166,17 @@ static void interface_store(struct aprx_interface *aif)
 	  printf("interface_store() aif->callsign = '%s'\n", aif->callsign);
 
 	// Init the interface specific Erlang accounting
-	erlang_add(aif->callsign, ERLANG_RX, 0, 0);
+	interface_erlang_add(aif, ERLANG_RX, 0, 0);
+
+	// Packed keys of the callsign and the aliases for hot-path lookups
+	if (aif->callsign != NULL)
+	  aif->callkey = callkey_from_text_uc(aif->callsign, strlen(aif->callsign));
+	if (aif->aliascount > 0) {
+	  int i;
+	  aif->aliaskeys = calloc(aif->aliascount, sizeof(callkey_t));
+	  for (i = 0; i < aif->aliascount; ++i)
+	    aif->aliaskeys[i] = callkey_from_text(aif->aliases[i], strlen(aif->aliases[i]));
+	}
 
 	all_interfaces_count += 1;
 	all_interfaces = realloc(all_interfaces,
@@ -187,9 +198,16 @@ static void interface_store(struct aprx_interface *aif)
 struct aprx_interface *find_interface_by_callsign(const char *callsign)
 {
 	int i;
+	const callkey_t key = callkey_from_text_uc(callsign, strlen(callsign));
+
 	for (i = 0; i < all_interfaces_count; ++i) {
-	  if ((all_interfaces[i]->callsign != NULL) &&
-	      (strcasecmp(callsign, all_interfaces[i]->callsign) == 0)) {
+	  const struct aprx_interface *aif = all_interfaces[i];
+	  if (aif->callsign == NULL)
+	    continue;
+	  if (key != CALLKEY_NONE && aif->callkey != CALLKEY_NONE) {
+	    if (key == aif->callkey)
+	      return all_interfaces[i];
+	  } else if (strcasecmp(callsign, aif->callsign) == 0) {
 	    return all_interfaces[i];
 	  }
 	}
@@ -658,7 +676,8 @@ int interface_config(struct configfile *cf)
 		  }
 
                   if (!have_fault) {
-		    aif->iftype = IFTYPE_TCPIP;
+		    // Stays IFTYPE_NULL, the tty is not registered
+		    // for polling, it only carries the subinterface.
 		    aif->tty = ttyreader_new();
 		    aif->tty->interface[0] = aif;
 		    aif->tty->ttycallsign[0]  = mycall;
@@ -1005,6 +1024,7 @@ void interface_receive_ax25(const struct aprx_interface *aif,
 	int digi_like_aprs = is_aprs;
 
 	if (aif == NULL) return;         // Not a real interface for digi use
+	APRX_PROBE4(frame__rx, aif->callsign, tnc2buf, tnc2len, is_aprs);
 	if (aif->digisourcecount == 0) {
 		if (debug>1) printf("interface_receive_ax25() no receivers for source %s\n",aif->callsign);
 
@@ -1055,6 +1075,7 @@ void interface_receive_ax25(const struct aprx_interface *aif,
 		}
 
 		pb->source_if_group = aif->ifgroup;
+		pb->rx_ns = rx_frame_ns;
 
 		// If APRS packet, then parse for APRS meaning ...
 		if (is_aprs) {
@@ -1121,12 +1142,18 @@ void interface_receive_ax25(const struct aprx_interface *aif,
  *   - aif:    output interface
  *   - axaddr: ax.25 address
  *   - axdata: payload content, with control and PID bytes prefixing them
+ *   - rx_ns:  monotonic_ns() of the read() of a digipeated frame,
+ *             or 0 -- used to measure RX to TX latency
  */
 
 void interface_transmit_ax25(const struct aprx_interface *aif, uint8_t *axaddr, const int axaddrlen, const char *axdata, const int axdatalen)
+{
+	interface_transmit_ax25_ts(aif, axaddr, axaddrlen, axdata, axdatalen, 0);
+}
+
+void interface_transmit_ax25_ts(const struct aprx_interface *aif, uint8_t *axaddr, const int axaddrlen, const char *axdata, const int axdatalen, const int64_t rx_ns)
 {
 	int axlen = axaddrlen + axdatalen;
-	uint8_t *axbuf;
 
 	if (debug) {
 	  const char *callsign = "";
@@ -1151,10 +1178,8 @@ void interface_transmit_ax25(const struct aprx_interface *aif, uint8_t *axaddr,
                   printf("\n");
                 }
 
-		axbuf = alloca(axlen);
-		memcpy(axbuf, axaddr, axaddrlen);
-		memcpy(axbuf + axaddrlen, axdata, axdatalen);
-		kiss_kisswrite(aif->tty, aif->subif, axbuf, axlen);
+		kiss_kisswritev(aif->tty, aif->subif, axaddr, axaddrlen,
+				(const uint8_t *)axdata, axdatalen, rx_ns);
 		break;
 #ifdef PF_AX25	/* PF_AX25 exists -- highly likely a Linux system ! */
 	case IFTYPE_AX25:
@@ -1185,7 +1210,7 @@ void interface_transmit_ax25(const struct aprx_interface *aif, uint8_t *axaddr,
                 }
 
 		// Account the transmission anyway ;-)
-		erlang_add(aif->callsign, ERLANG_TX, axaddrlen+axdatalen + 10, 1);
+		interface_erlang_add(aif, ERLANG_TX, axaddrlen+axdatalen + 10, 1);
 		break;
 	default:
 		break;
@@ -1334,6 +1359,7 @@ void interface_receive_3rdparty( const struct aprx_interface *aif,
         }
 
         pb->source_if_group = 0; // 3rd-party frames are always from APRSIS
+        pb->rx_ns = rx_frame_ns;
 
 
         // This is APRS packet, parse for APRS meaning ...
@@ -1515,6 +1541,7 @@ void interface_receive_3rdparty( const struct aprx_interface *aif,
 	  }
 
 	  pb->source_if_group = 0; // 3rd-party frames are always from APRSIS
+	  pb->rx_ns = rx_frame_ns;
 	  srcif = aif->callsign ? aif->callsign : "??";
 
 	  // This is APRS packet, parse for APRS meaning ...
@@ -20,8 +20,16 @@
  *   http://www.concentric.net/~Ttwang/tech/inthash.htm
  *   http://isthe.com/chongo/tech/comp/fnv/
  *
- * Currently using FNV-1a
+ * Currently using a word-at-a-time multiply-xorshift hash, which
+ * consumes 8 bytes per step.  The FNV-1a is kept available as
+ * keyhash_fnv() / keyhashuc_fnv(), and compiling with -DKEYHASH_FNV
+ * makes keyhash() / keyhashuc() use it.
  *
+ * Both variants hold:  keyhashuc(s) == keyhash(uppercase(s))
+ * and chaining of hash(b, hash(a, 0)) over disjoint memory areas.
+ *
+ * A throughput and bucket distribution benchmark is compiled
+ * with -DKEYHASH_BENCH_MAIN  ("make keyhash-bench").
  */
 
 /*
@@ -33,18 +41,20 @@
 */
 
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include "keyhash.h"
 
 void keyhash_init(void) { }
 
-uint32_t __attribute__((pure)) keyhash(const void const *p, int len, uint32_t hash)
+#define FNV_32_PRIME     16777619U
+#define FNV_32_OFFSET  2166136261U
+
+uint32_t __attribute__((pure)) keyhash_fnv(const void *p, int len, uint32_t hash)
 {
 	const uint8_t *u = p;
 	int i;
-#define FNV_32_PRIME     16777619U
-#define FNV_32_OFFSET  2166136261U
 
 	if (hash == 0)
         	hash = (uint32_t)FNV_32_OFFSET;
@@ -64,7 +74,7 @@ uint32_t __attribute__((pure)) keyhash(const void const *p, int len, uint32_t ha
 /* The data material is known to contain ASCII, and if any value in there
  * is a lower case letter, it is first converted to upper case one.
 */
-uint32_t __attribute__((pure)) keyhashuc(const void const *p, int len, uint32_t hash)
+uint32_t __attribute__((pure)) keyhashuc_fnv(const void *p, int len, uint32_t hash)
 {
 	const uint8_t *u = p;
 	int i;
@@ -89,3 +99,253 @@ uint32_t __attribute__((pure)) keyhashuc(const void const *p, int len, uint32_t
 	}
 	return hash;
 }
+
+
+/*
+//  Word-at-a-time hash
+//
+//  Input is read as 64-bit words (memcpy() compiles into a plain
+//  unaligned load where that is allowed), each word is xor'ed into
+//  the state, and the state is multiplied and xor-shifted.  The tail
+//  of 1..7 bytes makes one more word, and the total length is mixed
+//  in at the end so that trailing NUL bytes are not lost.  Byte order of
+//  the load differs between hosts, so hash values are host specific
+//  -- they are only used on in-memory tables.
+*/
+
+#define KH_MUL    0x9E3779B97F4A7C15ULL
+#define KH_SEED   0x243F6A8885A308D3ULL
+#define KH_ONES   0x0101010101010101ULL
+#define KH_HIGHS  0x8080808080808080ULL
+
+static inline uint64_t kh_mix(uint64_t h, const uint64_t w)
+{
+	h ^= w;
+	h *= KH_MUL;
+	h ^= h >> 29;
+	return h;
+}
+
+static inline uint64_t kh_load(const uint8_t *u)
+{
+	uint64_t w;
+	memcpy(&w, u, sizeof(w));
+	return w;
+}
+
+/* Tail of 1..7 bytes at u[0..n-1].  On keys of at least 8 bytes
+   the last full word is re-read overlapping the previous one,
+   short keys are assembled a byte at the time. */
+static inline uint64_t kh_loadtail(const uint8_t *u, const int n, const int len)
+{
+	uint64_t w = 0;
+	int i;
+	if (len >= 8)
+		return kh_load(u + n - 8);
+	for (i = 0; i < n; ++i)
+		w |= ((uint64_t)u[i]) << (8 * i);
+	return w;
+}
+
+/* SWAR upper-casing: every byte in 'a'..'z' gets its 0x20 bit
+   cleared, bytes with high bit set are left alone. */
+static inline uint64_t kh_upcase(const uint64_t w)
+{
+	const uint64_t heptets = w & ~KH_HIGHS;
+	const uint64_t gt_z    = heptets + KH_ONES * (0x7F - 'z');
+	const uint64_t ge_a    = heptets + KH_ONES * (0x80 - 'a');
+	const uint64_t lower   = ge_a & ~gt_z & ~w & KH_HIGHS;
+	return w ^ (lower >> 2);
+}
+
+static inline uint64_t kh_start(const uint32_t hash)
+{
+	return (hash == 0) ? KH_SEED : (KH_SEED ^ ((uint64_t)hash << 16));
+}
+
+static inline uint32_t kh_final(uint64_t h, const int len)
+{
+	h = kh_mix(h, (uint64_t)len);
+	h ^= h >> 32;
+	return (uint32_t)h ? (uint32_t)h : 1; /* 0 means "start new" on chaining */
+}
+
+uint32_t __attribute__((pure)) keyhash_word(const void *p, int len, uint32_t hash)
+{
+	const uint8_t *u = p;
+	uint64_t h = kh_start(hash);
+	int n = len;
+
+	for (; n >= 8; n -= 8, u += 8)
+		h = kh_mix(h, kh_load(u));
+	if (n > 0)
+		h = kh_mix(h, kh_loadtail(u, n, len));
+
+	return kh_final(h, len);
+}
+
+uint32_t __attribute__((pure)) keyhashuc_word(const void *p, int len, uint32_t hash)
+{
+	const uint8_t *u = p;
+	uint64_t h = kh_start(hash);
+	int n = len;
+
+	for (; n >= 8; n -= 8, u += 8)
+		h = kh_mix(h, kh_upcase(kh_load(u)));
+	if (n > 0)
+		h = kh_mix(h, kh_upcase(kh_loadtail(u, n, len)));
+
+	return kh_final(h, len);
+}
+
+
+#ifdef KEYHASH_FNV
+uint32_t keyhash(const void *p, int len, uint32_t hash)
+{
+	return keyhash_fnv(p, len, hash);
+}
+uint32_t keyhashuc(const void *p, int len, uint32_t hash)
+{
+	return keyhashuc_fnv(p, len, hash);
+}
+#else
+uint32_t keyhash(const void *p, int len, uint32_t hash)
+{
+	return keyhash_word(p, len, hash);
+}
+uint32_t keyhashuc(const void *p, int len, uint32_t hash)
+{
+	return keyhashuc_word(p, len, hash);
+}
+#endif
+
+
+#ifdef KEYHASH_BENCH_MAIN
+/*
+ *  keyhash-bench [corpusfile ...]
+ *
+ *  Each line of a corpus file is one key; feed it e.g. a list of
+ *  callsigns, or TNC2 format packets from an rflog.  Without files
+ *  a synthetic callsign corpus is used.  Reports throughput and the
+ *  chi-square of bucket distribution on the dupecheck (16) and
+ *  historydb (128) table sizes, for both hash variants.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef unsigned int (*hashfn_t)(const void *, int, unsigned int);
+
+struct corpus {
+	char **keys;
+	int   *lens;
+	int    count;
+	long   bytes;
+};
+
+static void corpus_add(struct corpus *c, const char *s, int len)
+{
+	if ((c->count & 1023) == 0) {
+		c->keys = realloc(c->keys, sizeof(char*) * (c->count + 1024));
+		c->lens = realloc(c->lens, sizeof(int)   * (c->count + 1024));
+	}
+	c->keys[c->count] = malloc(len+1);
+	memcpy(c->keys[c->count], s, len);
+	c->keys[c->count][len] = 0;
+	c->lens[c->count] = len;
+	c->bytes += len;
+	++c->count;
+}
+
+static void corpus_synthetic(struct corpus *c)
+{
+	char buf[16];
+	int i;
+	srandom(1);
+	for (i = 0; i < 20000; ++i) {
+		int len = sprintf(buf, "%c%c%d%c%c%c",
+				  'A' + (int)(random() % 26), 'A' + (int)(random() % 26),
+				  (int)(random() % 10),
+				  'A' + (int)(random() % 26), 'A' + (int)(random() % 26),
+				  'A' + (int)(random() % 26));
+		if (random() & 1)
+			len += sprintf(buf+len, "-%d", 1 + (int)(random() % 15));
+		corpus_add(c, buf, len);
+	}
+}
+
+static double chisquare(const struct corpus *c, hashfn_t fn, int buckets, int historyfold)
+{
+	int *counts = calloc(buckets, sizeof(int));
+	double expect = (double)c->count / buckets, chi = 0.0;
+	int i;
+	for (i = 0; i < c->count; ++i) {
+		unsigned int h = fn(c->keys[i], c->lens[i], 0);
+		if (historyfold)
+			h = h ^ (h >> 7) ^ (h >> 14);
+		else {
+			h ^= (h >> 16); h ^= (h >> 8); h ^= (h >> 4);
+		}
+		++counts[h % buckets];
+	}
+	for (i = 0; i < buckets; ++i)
+		chi += (counts[i] - expect) * (counts[i] - expect) / expect;
+	free(counts);
+	return chi;
+}
+
+static void bench(const struct corpus *c, const char *name, hashfn_t fn)
+{
+	struct timespec t0, t1;
+	unsigned int sink = 0;
+	int rounds = 1 + (int)(50000000L / (c->bytes + 1));
+	int r, i;
+	double ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (r = 0; r < rounds; ++r)
+		for (i = 0; i < c->count; ++i)
+			sink ^= fn(c->keys[i], c->lens[i], 0);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	printf("%-14s %8.2f ns/key %8.1f MB/s  chi2(16)=%7.1f chi2(128)=%7.1f  [%x]\n",
+	       name, ns / ((double)rounds * c->count),
+	       ((double)rounds * c->bytes) / (ns / 1e3),
+	       chisquare(c, fn, 16, 0), chisquare(c, fn, 128, 1), sink & 0xF);
+}
+
+int main(int argc, char *argv[])
+{
+	struct corpus c;
+	char line[600];
+	int i;
+
+	memset(&c, 0, sizeof(c));
+	for (i = 1; i < argc; ++i) {
+		FILE *fp = fopen(argv[i], "r");
+		if (!fp) {
+			perror(argv[i]);
+			return 1;
+		}
+		while (fgets(line, sizeof(line), fp)) {
+			int len = strlen(line);
+			while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+				--len;
+			if (len > 0)
+				corpus_add(&c, line, len);
+		}
+		fclose(fp);
+	}
+	if (c.count == 0)
+		corpus_synthetic(&c);
+
+	printf("corpus: %d keys, %ld bytes (chi2 expected ~ buckets-1)\n", c.count, c.bytes);
+	bench(&c, "keyhash_fnv",    keyhash_fnv);
+	bench(&c, "keyhash_word",   keyhash_word);
+	bench(&c, "keyhashuc_fnv",  keyhashuc_fnv);
+	bench(&c, "keyhashuc_word", keyhashuc_word);
+	return 0;
+}
+#endif
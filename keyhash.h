@@ -14,4 +14,10 @@ extern void         keyhash_init(void);
 extern unsigned int keyhash(const void *s, int slen, unsigned int hash0);
 extern unsigned int keyhashuc(const void *s, int slen, unsigned int hash0);
 
+/* Explicit variants, keyhash() is one of these */
+extern unsigned int keyhash_fnv(const void *s, int slen, unsigned int hash0);
+extern unsigned int keyhashuc_fnv(const void *s, int slen, unsigned int hash0);
+extern unsigned int keyhash_word(const void *s, int slen, unsigned int hash0);
+extern unsigned int keyhashuc_word(const void *s, int slen, unsigned int hash0);
+
 #endif
@@ -86,11 +86,25 @@
 
 int kissencoder( void *kissbuf, int kissspace, LineType linetype,
 		 const void *pktbuf, int pktlen, int cmdbyte )
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *)pktbuf;
+	iov.iov_len  = pktlen;
+	return kissencoder_v( kissbuf, kissspace, linetype, &iov, 1, cmdbyte );
+}
+
+/*
+ * kissencoder_v():  kissencoder() on a packet given in pieces,
+ *		     like AX.25 address and data separately.
+ */
+
+int kissencoder_v( void *kissbuf, int kissspace, LineType linetype,
+		   const struct iovec *iov, int iovcnt, int cmdbyte )
 {
 	uint8_t *kb = kissbuf;
 	uint8_t *ke = kb + kissspace - 3;
-	const uint8_t *pkt = pktbuf;
-	int i;
+	int i, v;
 	uint16_t crc16;
 	uint16_t crcflex;
 
@@ -100,9 +114,21 @@ int kissencoder( void *kissbuf, int kissspace, LineType linetype,
 	/* Expect the KISS buffer to be at least ... 8 bytes.. */
 
 	*kb++ = KISS_FEND;
-	*kb++ = cmdbyte;
+	// SMACK on TNC id 4 has 0xC0 for the command byte, escape it too
+	if ((cmdbyte & 0xFF) == KISS_FEND) {
+		*kb++ = KISS_FESC;
+		*kb++ = KISS_TFEND;
+	} else {
+		*kb++ = cmdbyte;
+		if ((cmdbyte & 0xFF) == KISS_FESC)
+			*kb++ = KISS_TFESC;
+	}
+
+	for (v = 0; v < iovcnt; ++v) {
+	  const uint8_t *pkt = iov[v].iov_base;
+	  const int   pktlen = iov[v].iov_len;
 
-	for (i = 0; i < pktlen && kb < ke; ++i, ++pkt) {
+	  for (i = 0; i < pktlen && kb < ke; ++i, ++pkt) {
 		// Calc CRCs while encoding data..
 		int b = *pkt;
 		crc16 = ((crc16 >> 8) & 0xff) ^ crc16_table[(crc16 ^ b) & 0xFF];
@@ -116,6 +142,7 @@ int kissencoder( void *kissbuf, int kissspace, LineType linetype,
 			if (b == KISS_FESC)
 				*kb++ = KISS_TFESC;
 		}
+	  }
 	}
 	/* If caller is asking for SMACK format frame, then
 	   store calculated CRC on frame. - CRC-bytes must be KISS escaped! */
@@ -127,7 +154,9 @@ int kissencoder( void *kissbuf, int kissspace, LineType linetype,
 		if (linetype == LINETYPE_KISSSMACK) {
 		  crc = crc16;
 		} else if (linetype == LINETYPE_KISSFLEXNET) {
-		  crc = crcflex;
+		  // FLEXNET sends the high byte first, like Linux mkiss
+		  // does, and what calc_crc_flex() == 0x7070 expects.
+		  crc = ((crcflex >> 8) & 0xFF) | ((crcflex & 0xFF) << 8);
 		} else {
                   // Silence compiler warning, this branch is never reached..
                   crc = 0;
@@ -168,7 +197,7 @@ int kissencoder( void *kissbuf, int kissspace, LineType linetype,
 }
 
 
-static int kissprocess(struct serialport *S)
+static int kissprocess_(struct serialport *S)
 {
 	int i;
 	int cmdbyte = S->rdline[0];
@@ -208,7 +237,8 @@ static int kissprocess(struct serialport *S)
 			printf("\n");
 		}
 		rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-		erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+		erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+		metric_add(METRIC_RX_DROP_KISS_CMD, 1);
 		return -1;
 	}
 
@@ -232,7 +262,7 @@ static int kissprocess(struct serialport *S)
 	/* Are we expecting FLEXNET KISS ? */
 	if (S->linetype == LINETYPE_KISSFLEXNET && (cmdbyte & 0x20)) {
 		int crc;
-		tncid &= ~0x20; // FlexNet puts 0x20 as indication of CRC presence..
+		tncid &= ~0x02; // FlexNet puts 0x20 on CMD byte as indication of CRC presence..
 
 		if (S->ttycallsign[tncid] == NULL) {
 			/* D'OH!  received packet on multiplexer tncid without
@@ -243,7 +273,8 @@ static int kissprocess(struct serialport *S)
 				printf("\n");
 			}
 			rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-			erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			metric_add(METRIC_RX_DROP_KISS_TNCID, 1);
 			return -1;
 		}
 		crc = calc_crc_flex(S->rdline, S->rdlinelen);
@@ -256,7 +287,8 @@ static int kissprocess(struct serialport *S)
 				printf("\n");
 			}
 			rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-			erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);  // Account one packet
+			erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);  // Account one packet
+			metric_add(METRIC_RX_DROP_KISS_CRC, 1);
 			return -1;	// The CRC was invalid..
 		}
 		S->rdlinelen -= 2; // remove 2 bytes!
@@ -276,7 +308,8 @@ static int kissprocess(struct serialport *S)
 				printf("\n");
 			}
 			rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-			erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			metric_add(METRIC_RX_DROP_KISS_TNCID, 1);
 			return -1;
 		}
 
@@ -290,7 +323,8 @@ static int kissprocess(struct serialport *S)
 				printf("\n");
 			}
 			rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-			erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			metric_add(METRIC_RX_DROP_KISS_CRC, 1);
 			return -1;
 		}
 		S->rdlinelen -= 1;	/* remove the sum-byte from tail */
@@ -311,7 +345,8 @@ static int kissprocess(struct serialport *S)
 				printf("\n");
 			}
 			rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-			erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			metric_add(METRIC_RX_DROP_KISS_TNCID, 1);
 			return -1;
 		}
 
@@ -342,7 +377,8 @@ static int kissprocess(struct serialport *S)
 					printf("\n");
 				}
 				rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-				erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);  // Account one packet
+				erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);  // Account one packet
+				metric_add(METRIC_RX_DROP_KISS_CRC, 1);
 				return -1;	/* The CRC was invalid.. */
 			}
 
@@ -401,7 +437,8 @@ static int kissprocess(struct serialport *S)
 				printf("\n");
 			}
 			rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-			erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			metric_add(METRIC_RX_DROP_KISS_CMD, 1);
 			return -1;
 		}
 	}
@@ -417,7 +454,8 @@ static int kissprocess(struct serialport *S)
 				printf("\n");
 			}
 			rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-			erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+			metric_add(METRIC_RX_DROP_KISS_TNCID, 1);
 			return -1;
 		}
 	}
@@ -429,7 +467,8 @@ static int kissprocess(struct serialport *S)
 		/* Too short frame.. */
 		/* printf(" ..too short a frame for anything\n");  */
 		rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-		erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+		erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+		metric_add(METRIC_RX_DROP_SHORT, 1);
 		return -1;
 	}
 
@@ -445,7 +484,8 @@ static int kissprocess(struct serialport *S)
 	// Rx-IGate functionality.  Returns non-zero only when
 	// AX.25 header is OK, and packet is sane.
 
-	erlang_add(S->ttycallsign[tncid], ERLANG_RX, S->rdlinelen, 1);	/* Account one packet */
+	erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_RX, S->rdlinelen, 1);	/* Account one packet */
+	metric_add(METRIC_RX_FRAMES, 1);
 
 	if (ax25_to_tnc2(S->interface[tncid], S->ttycallsign[tncid], tncid,
 				cmdbyte, S->rdline + 1, S->rdlinelen - 1)) {
@@ -460,7 +500,8 @@ static int kissprocess(struct serialport *S)
 	} else {
 		// The packet is not valid per AX.25 header bit rules
 		rfloghex(S->ttyname, 'D', 1, S->rdline, S->rdlinelen);
-		erlang_add(S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+		erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_DROP, S->rdlinelen, 1);	/* Account one packet */
+		metric_add(METRIC_RX_DROP_AX25, 1);
 
 		if (aprxlogfile) {
 			// NOT replaced with aprxlog() -- because this is a bit more complicated..
@@ -483,129 +524,154 @@ static int kissprocess(struct serialport *S)
 
 
 /*
- * ttyreader_pullkiss()  --  pull KISS (or KISS+CRC) frame, and call KISS processor
+ * kiss_deframe()  --  pull KISS (or KISS+CRC) frames out of S->rdbuf,
+ *		       and call the frame processor on each of them.
+ *
+ * The input is not walked byte by byte.  FEND and FESC are located
+ * with memchr(), and the runs of plain data in between are copied to
+ * S->rdline in one go.  Only the byte after a FESC is looked at alone.
+ * Everything in S->rdbuf is consumed, partial frame stays in S->rdline.
  */
 
-int kiss_pullkiss(struct serialport *S)
+int kiss_deframe(struct serialport *S, int (*frameproc)(struct serialport *S))
 {
-	/* printf("ttyreader_pullkiss()  rdlen=%d rdcursor=%d, state=%d\n",
-	   S->rdlen, S->rdcursor, S->kissstate); fflush(stdout); */
-
-	/* At incoming call there is at least one byte in between
-	   S->rdcursor and S->rdlen  */
-
-	/* Phases:
-	   kissstate == 0: hunt for KISS_FEND, discard everything before it.
-	   kissstate != 0: reading has globbed up preceding KISS_FENDs
-	   ("HDLC flags") and the cursor is in front of a frame
-	 */
+	const uint8_t *p = S->rdbuf + S->rdcursor;
+	const uint8_t *e = S->rdbuf + S->rdlen;
+	const int maxlen = sizeof(S->rdline) - 3;
 
 	/* There are TNCs that use "shared flags" - only one FEND in between
 	   data frames. */
 
-	if (S->kissstate == KISSSTATE_SYNCHUNT) {
-		/* Hunt for KISS_FEND, discard everything until then! */
-		int c;
-		for (;;) {
-			c = ttyreader_getc(S);
-			if (c < 0)
-				return c;	/* Out of buffer, stay in state,
-						   return latter when there is some
-						   refill */
-			if (c == KISS_FEND)	/* Found the sync-byte !  change state! */
+	while (p < e) {
+		const uint8_t *fend, *fesc, *runend;
+		int c, n;
+
+		if (S->kissstate == KISSSTATE_SYNCHUNT) {
+			/* Hunt for KISS_FEND, discard everything until then! */
+			fend = memchr(p, KISS_FEND, e - p);
+			if (fend == NULL) {
+				p = e;
 				break;
+			}
+			p = fend + 1;
+			S->kissstate = KISSSTATE_COLLECTING;
+			S->rdlinelen = 0;
+			continue;
 		}
-		S->kissstate = KISSSTATE_COLLECTING;
-	}
 
+		if (S->kissstate == KISSSTATE_KISSFESC && *p != KISS_FEND) {
+			/* We have some char, state switches to normal collecting */
+			S->kissstate = KISSSTATE_COLLECTING;
+			c = *p++;
+			if (c == KISS_TFEND)
+				c = KISS_FEND;
+			else if (c == KISS_TFESC)
+				c = KISS_FESC;
+			else
+				continue;	/* Accepted chars after KISS_FESC
+						   are only TFEND and TFESC.
+						   Others must be discarded. */
+			if (S->rdlinelen >= maxlen)
+				goto toolong;
+			S->rdline[S->rdlinelen++] = c;
+			continue;
+		}
 
-	if (S->kissstate != KISSSTATE_SYNCHUNT) {
-		/* Normal processing mode */
-
-		int c;
-
-		for (;;) {
-			c = ttyreader_getc(S);
-			if (c < 0)
-				return c;	/* Out of input stream, exit now,
-						   come back latter.. */
-
-			/* printf(" %02X", c);
-			   if (c == KISS_FEND) { printf("\n");fflush(stdout); }  */
-
-			if (c == KISS_FEND) {
-				/* Found end-of-frame character -- or possibly beginning..
-				   This never exists in datastream except as itself. */
-
-				if (S->rdlinelen > 0) {
-					/* Non-zero sized frame  Process it away ! */
-					kissprocess(S);
-					S->kissstate =
-						KISSSTATE_COLLECTING;
-					S->rdlinelen = 0;
-				}
-
-				/* rdlinelen == 0 because we are receiving consequtive
-				   FENDs, or just processed our previous frame.  Treat
-				   them the same: discard this byte. */
-
-				continue;
+		/* Normal collection mode: plain data up to next FEND or FESC */
+		fend   = memchr(p, KISS_FEND, e - p);
+		runend = (fend != NULL) ? fend : e;
+		fesc   = memchr(p, KISS_FESC, runend - p);
+		if (fesc != NULL)
+			runend = fesc;
+
+		n = runend - p;
+		if (n > 0) {
+			if (S->rdlinelen + n > maxlen) {
+				p += maxlen - S->rdlinelen + 1;
+				goto toolong;
 			}
+			memcpy(S->rdline + S->rdlinelen, p, n);
+			S->rdlinelen += n;
+			p = runend;
+		}
+		if (p >= e)
+			break;
 
-			if (S->kissstate == KISSSTATE_KISSFESC) {
-
-				/* We have some char, state switches to normal collecting */
-				S->kissstate = KISSSTATE_COLLECTING;
-
-				if (c == KISS_TFEND)
-					c = KISS_FEND;
-				else if (c == KISS_TFESC)
-					c = KISS_FESC;
-				else
-					continue;	/* Accepted chars after KISS_FESC
-							   are only TFEND and TFESC.
-							   Others must be discarded. */
-
-			} else {	/* Normal collection mode */
-
-				if (c == KISS_FESC) {
-					S->kissstate = KISSSTATE_KISSFESC;
-					continue;	/* Back to top of the loop and continue.. */
-				}
+		if (*p == KISS_FESC) {
+			S->kissstate = KISSSTATE_KISSFESC;
+			++p;
+			continue;
+		}
 
-			}
+		/* Found end-of-frame character -- or possibly beginning..
+		   This never exists in datastream except as itself. */
+		++p;
+		S->kissstate = KISSSTATE_COLLECTING;
+		if (S->rdlinelen > 0) {
+			/* Non-zero sized frame  Process it away ! */
+			frameproc(S);
+			S->rdlinelen = 0;
+		}
+		/* rdlinelen == 0 because we are receiving consequtive
+		   FENDs, or just processed our previous frame.  Treat
+		   them the same: discard this byte. */
+		continue;
 
+	toolong:
+		/* Too long !  Way too long ! */
+		if (debug) {
+		  printf("%ld\tTTY %s: Too long frame to be KISS: ", tick.tv_sec, S->ttyname);
+		  hexdumpfp(stdout, S->rdline, S->rdlinelen, 1);
+		  printf("\n");
+		}
+		S->kissstate = KISSSTATE_SYNCHUNT;	/* Sigh.. discard it. */
+		S->rdlinelen = 0;
+	}
 
-			if (S->rdlinelen >= (sizeof(S->rdline) - 3)) {
-				/* Too long !  Way too long ! */
+	/* All consumed */
+	S->rdcursor = S->rdlen;
+	return -1;
+}
 
-				S->kissstate = KISSSTATE_SYNCHUNT;	/* Sigh.. discard it. */
-				S->rdlinelen = 0;
-				if (debug) {
-				  printf("%ld\tTTY %s: Too long frame to be KISS: ", tick.tv_sec, S->ttyname);
-				  hexdumpfp(stdout, S->rdline, S->rdlinelen, 1);
-				  printf("\n");
-				}
-				continue;
-			}
+/* kissprocess() with its run time into METRIC_HIST_KISS_RX */
+static int kissprocess(struct serialport *S)
+{
+	const int64_t t0 = monotonic_ns();
+	const int rc = kissprocess_(S);
 
-			/* Put it on record store: */
-			S->rdline[S->rdlinelen++] = c;
-		}		/* .. for(..) loop of data collecting */
+	metric_observe(METRIC_HIST_KISS_RX, monotonic_ns() - t0);
+	return rc;
+}
 
-	}
-	/* .. normal consumption mode ... */
-	return 0;
+int kiss_pullkiss(struct serialport *S)
+{
+	return kiss_deframe(S, kissprocess);
 }
 
 
 /*
- *  kiss_kisswrite()  -- write out buffered data
+ *  kiss_kisswritev()  -- encode a frame on the port transmit queue,
+ *			  and try to write it out right away.
+ *
+ *  The frame is KISS encoded straight from the address and data
+ *  pieces into its queue entry.  What the port does not take now
+ *  is written by ttyreader_linewrite() when poll() says POLLOUT.
+ *  When there are more than ttyreader_txq_limit bytes queued,
+ *  the new frame is dropped and counted.
+ *
+ *  A non-zero rx_ns is the read() time of the frame this one is a
+ *  digipeat of, the RX to TX latency is taken when it is written.
  */
-void kiss_kisswrite(struct serialport *S, const int tncid, const uint8_t *ax25raw, const int ax25rawlen)
+void kiss_kisswritev(struct serialport *S, const int tncid,
+		     const uint8_t *axaddr, const int axaddrlen,
+		     const uint8_t *axdata, const int axdatalen,
+		     const int64_t rx_ns)
 {
-	int i, len, ssid;
-	uint8_t kissbuf[2300];
+	int len, ssid, space;
+	LineType linetype = S->linetype;
+	struct kissframe *kf;
+	struct iovec iov[2];
+	const int ax25rawlen = axaddrlen + axdatalen;
 
 	if (debug) {
 	  printf("kiss_kisswrite(->%s, axlen=%d)\n", S->ttycallsign[tncid], ax25rawlen);
@@ -624,86 +690,84 @@ void kiss_kisswrite(struct serialport *S, const int tncid, const uint8_t *ax25ra
 		return;
 	}
 
-
-	if ((S->wrlen == 0) || (S->wrlen > 0 && S->wrcursor >= S->wrlen)) {
-		S->wrlen = S->wrcursor = 0;
-	} else {
-	  /* There is some data in between wrcursor and wrlen */
-	  len = S->wrlen - S->wrcursor;
-	  if (len > 0) {
-	    i = write(S->fd, S->wrbuf + S->wrcursor, len);
-	  } else
-	    i = 0;
-	  if (i > 0) {		/* wrote something */
-	    S->wrcursor += i;
-	    len = S->wrlen - S->wrcursor;
-	    if (len == 0) {
-	      S->wrcursor = S->wrlen = 0;	/* wrote all ! */
-	    } else {
-	      /* compact the buffer a bit */
-	      memcpy(S->wrbuf, S->wrbuf + S->wrcursor, len);
-	      S->wrcursor = 0;
-	      S->wrlen = len;
-	    }
-	  }
+	if (S->txq_bytes >= ttyreader_txq_limit) {
+		// No fit!
+		// Not an erlang ERLANG_DROP, that column is of received frames
+		S->txq_drops += 1;
+		if (S->metrics_port >= 0)
+			metric_add(METRIC_PORT_BASE(S->metrics_port) + METRIC_PORT_TXQ_DROPS, 1);
+		if (debug)
+		  printf(" .. KISS frame dropped, %d frames / %d bytes on TX queue, %ld drops\n",
+			 S->txq_count, S->txq_bytes, S->txq_drops);
+		return;
 	}
 
 	ssid = (tncid << 4);
 	switch (S->linetype) {
 	case LINETYPE_KISSFLEXNET:
-	  len = kissencoder( kissbuf, sizeof(kissbuf), S->linetype, ax25raw, ax25rawlen, ssid |= 0x20 );
+	  ssid |= 0x20;
 	  break;
 	case LINETYPE_KISSSMACK:
 	  if (S->smack_subids & (1 << tncid)) //if SMACK currently active
-	    len = kissencoder( kissbuf, sizeof(kissbuf), S->linetype, ax25raw, ax25rawlen, ssid |= 0x80 );
-	  else 
-	    len = kissencoder( kissbuf, sizeof(kissbuf), LINETYPE_KISS, ax25raw, ax25rawlen, ssid );
+	    ssid |= 0x80;
+	  else
+	    linetype = LINETYPE_KISS;
 	  break;
 	default:
-	  len = kissencoder( kissbuf, sizeof(kissbuf), S->linetype, ax25raw, ax25rawlen, ssid );
 	  break;
 	}
 
+	// Worst case: every byte escaped, plus FENDs, CMD and CRC
+	space = 2 * ax25rawlen + 12;
+	kf = malloc(sizeof(*kf) + space);
+	if (kf == NULL)
+		return;
+
+	iov[0].iov_base = (void *)axaddr;
+	iov[0].iov_len  = axaddrlen;
+	iov[1].iov_base = (void *)axdata;
+	iov[1].iov_len  = axdatalen;
+	len = kissencoder_v( kf->buf, space, linetype, iov, 2, ssid );
+
 	if (debug>2) {
 	  printf("ssid=%0x S->smack_subids=%0x\n",ssid,S->smack_subids);
 	  printf("kiss-encoded: ");
-	  hexdumpfp(stdout, kissbuf, len, 1);
+	  hexdumpfp(stdout, kf->buf, len, 1);
 	  printf("\n");
 	}
-
-	// Will the KISS encoded frame fit in the link buffer?
-	if ((S->wrlen + len) < sizeof(S->wrbuf)) {
-		memcpy(S->wrbuf + S->wrlen, kissbuf, len);
-		S->wrlen += len;
-		erlang_add(S->ttycallsign[tncid], ERLANG_TX, ax25rawlen, 1);
-
-		if (debug)
-		  printf(" .. put %d bytes of KISS frame on IO buffer\n",len);
-	} else {
-		// No fit!
-		if (debug)
-		  printf(" .. %d bytes of KISS frame did not fit on IO buffer\n",len);
+	if (len <= 0) {
+		free(kf);
 		return;
 	}
 
-	// Try to write it immediately
-	len = S->wrlen - S->wrcursor;
-	if (len > 0)
-	  i = write(S->fd, S->wrbuf + S->wrcursor, len);
+	kf->next   = NULL;
+	kf->len    = len;
+	kf->cursor = 0;
+	kf->tncid  = tncid;
+	kf->rx_ns  = rx_ns;
+	if (S->txq_tail != NULL)
+		S->txq_tail->next = kf;
 	else
-	  i = 0;
-	if (i > 0) {		/* wrote something */
-		S->wrcursor += i;
-		len = S->wrlen - S->wrcursor; /* all done? */
-		if (len == 0) {
-			S->wrcursor = S->wrlen = 0;	/* wrote all ! */
-		} else {
-			/* compact the buffer a bit */
-			memcpy(S->wrbuf, S->wrbuf + S->wrcursor, len);
-			S->wrcursor = 0;
-			S->wrlen = len;
-		}
-	}
+		S->txq_head = kf;
+	S->txq_tail   = kf;
+	S->txq_count += 1;
+	S->txq_bytes += len;
+	S->txq_frames += 1;
+	if (S->txq_count > S->txq_maxcount)
+		S->txq_maxcount = S->txq_count;
+
+	erlang_add_h(&S->erlang[tncid], S->ttycallsign[tncid], ERLANG_TX, ax25rawlen, 1);
+
+	if (debug)
+	  printf(" .. put %d bytes of KISS frame on TX queue, depth %d\n", len, S->txq_count);
+
+	// Try to write it immediately
+	ttyreader_linewrite(S);
+}
+
+void kiss_kisswrite(struct serialport *S, const int tncid, const uint8_t *ax25raw, const int ax25rawlen)
+{
+	kiss_kisswritev(S, tncid, ax25raw, ax25rawlen, NULL, 0, 0);
 }
 
 
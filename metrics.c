@@ -0,0 +1,337 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+#include "aprx.h"
+
+/*
+ *  Metrics: counters, gauges and latency histograms of the packet
+ *  paths, in a region of the erlang store file (see erlang.c) so that
+ *  aprx-stat can show them while aprx runs.
+ *
+ *  Every value has one writer thread, and the writer does a plain
+ *  add or store through  metrics_values,  see metric_add() et.al.
+ *  Until the store is open, and when it is not a file, the values
+ *  are kept in  metrics_local[].
+ *
+ *  The region is described by its own descriptors, aprx-stat does
+ *  not use the enums in aprx.h to read it.
+ *
+ *  Serial ports get their values in one of METRIC_PORTS slots, see
+ *  metrics_port_register().  The descriptors of a slot are named
+ *  after the port, "kiss_txq_drops:/dev/ttyUSB0", and appear in the
+ *  region when the port asks for its slot.
+ */
+
+static const struct {
+	const char *name;
+	int kind;
+} metric_table[METRIC_SCALARS + METRIC_HISTS] = {
+	{ "rx_frames",              METRIC_KIND_COUNTER },
+	{ "rx_drop_kiss_cmd",       METRIC_KIND_COUNTER },
+	{ "rx_drop_kiss_tncid",     METRIC_KIND_COUNTER },
+	{ "rx_drop_kiss_crc",       METRIC_KIND_COUNTER },
+	{ "rx_drop_short",          METRIC_KIND_COUNTER },
+	{ "rx_drop_ax25",           METRIC_KIND_COUNTER },
+	{ "igate_drop_rules",       METRIC_KIND_COUNTER },
+	{ "igate_drop_queue",       METRIC_KIND_COUNTER },
+	{ "digi_drop_ratelimit",    METRIC_KIND_COUNTER },
+	{ "digi_drop_dupe",         METRIC_KIND_COUNTER },
+	{ "digi_drop_hops",         METRIC_KIND_COUNTER },
+	{ "digi_drop_filter",       METRIC_KIND_COUNTER },
+	{ "digi_drop_nomem",        METRIC_KIND_COUNTER },
+	{ "aprsis_drop_wrbuf",      METRIC_KIND_COUNTER },
+	{ "aprsis_drop_stale",      METRIC_KIND_COUNTER },
+	{ "aprsis_connects",        METRIC_KIND_COUNTER },
+	{ "dupecheck_hits",         METRIC_KIND_COUNTER },
+	{ "aprsis_wrbuf_bytes",     METRIC_KIND_GAUGE },
+	{ "kiss_wrbuf_bytes",       METRIC_KIND_GAUGE },
+	{ "digi_viscous_packets",   METRIC_KIND_GAUGE },
+	{ "dupecheck_cells",        METRIC_KIND_GAUGE },
+	{ "historydb_cells",        METRIC_KIND_GAUGE },
+	{ "aprsis_connected",       METRIC_KIND_GAUGE },
+	/* METRIC_HIST_* */
+	{ "kiss_rx_process_ns",     METRIC_KIND_HISTOGRAM },
+	{ "igate_from_aprsis_ns",   METRIC_KIND_HISTOGRAM },
+	{ "digi_latency_ns",        METRIC_KIND_HISTOGRAM },
+	{ "path_rf_rf_ns",          METRIC_KIND_HISTOGRAM },
+	{ "path_rf_rf_viscous_ns",  METRIC_KIND_HISTOGRAM },
+	{ "path_is_rf_ns",          METRIC_KIND_HISTOGRAM },
+	{ "path_rf_is_ns",          METRIC_KIND_HISTOGRAM },
+};
+
+static const struct {
+	const char *name;
+	int kind;
+} metric_port_table[METRIC_PORT_VALUES] = {
+	{ "kiss_txq_drops",         METRIC_KIND_COUNTER },
+	{ "kiss_txq_frames",        METRIC_KIND_GAUGE },
+	{ "kiss_txq_max_frames",    METRIC_KIND_GAUGE },
+};
+
+#define METRIC_DESCS_FIXED (METRIC_SCALARS + METRIC_HISTS)
+#define METRIC_DESCS_MAX   (METRIC_DESCS_FIXED + METRIC_PORTS * METRIC_PORT_VALUES)
+
+static uint64_t metrics_local[METRIC_VALUES];
+uint64_t *metrics_values = metrics_local;
+
+static struct metrics_head *metrics_region;	/* once attached */
+static char metrics_ports[METRIC_PORTS][64];
+static int  metrics_ports_count;
+
+static uint32_t metrics_values_offset(void)
+{
+	uint32_t off = sizeof(struct metrics_head) +
+		METRIC_DESCS_MAX * sizeof(struct metrics_desc);
+	return (off + 7) & ~7;
+}
+
+uint32_t metrics_region_size(void)
+{
+	uint32_t size = metrics_values_offset() + METRIC_VALUES * sizeof(uint64_t);
+	return (size + 63) & ~63;
+}
+
+/* Descriptors of port slot 'p', the name is cut to fit and has no
+   characters that would need quoting in the JSON dump */
+static void metrics_port_desc(struct metrics_desc *D, int p)
+{
+	char *s;
+	int v;
+
+	for (v = 0; v < METRIC_PORT_VALUES; ++v, ++D) {
+		memset(D->name, 0, sizeof(D->name));
+		snprintf(D->name, sizeof(D->name), "%s:%s",
+			 metric_port_table[v].name, metrics_ports[p]);
+		for (s = D->name; *s; ++s)
+			if (*s == '"' || *s == '\\' || (unsigned char) *s < ' ')
+				*s = '_';
+		D->kind  = metric_port_table[v].kind;
+		D->value = METRIC_PORT_BASE(p) + v;
+	}
+}
+
+/*
+ *  metrics_region_init()  -- descriptors into a zeroed region
+ */
+void metrics_region_init(void *region)
+{
+	struct metrics_head *MH = region;
+	struct metrics_desc *D  = (struct metrics_desc *) (MH + 1);
+	int i;
+
+	for (i = 0; i < METRIC_SCALARS + METRIC_HISTS; ++i) {
+		strncpy(D[i].name, metric_table[i].name, sizeof(D[i].name) - 1);
+		D[i].kind = metric_table[i].kind;
+		if (i < METRIC_SCALARS) {
+			D[i].value = i;
+		} else {
+			D[i].value   = METRIC_HIST_BASE(i - METRIC_SCALARS);
+			D[i].buckets = METRIC_HIST_BUCKETS;
+			D[i].subbits = METRIC_HIST_SUBBITS;
+		}
+	}
+	for (i = 0; i < metrics_ports_count; ++i)
+		metrics_port_desc(D + METRIC_DESCS_FIXED + i * METRIC_PORT_VALUES, i);
+	MH->desc_size     = sizeof(struct metrics_desc);
+	MH->values_offset = metrics_values_offset();
+	MH->values_count  = METRIC_VALUES;
+#ifdef __GNUC__
+	__sync_synchronize();	/* descriptors before the count */
+#endif
+	MH->count = METRIC_DESCS_FIXED + metrics_ports_count * METRIC_PORT_VALUES;
+}
+
+/*
+ *  metrics_attach()  -- move the writers over to a region.
+ *
+ *  The first time it takes along what was counted until now, and
+ *  drops what a previous run left there.  Later ones are remaps
+ *  of the same file.
+ */
+void metrics_attach(void *region)
+{
+	uint64_t *values = (uint64_t *) ((char *) region + metrics_values_offset());
+
+	if (metrics_values == metrics_local)
+		memcpy(values, metrics_local, sizeof(metrics_local));
+	metrics_values = values;
+	metrics_region = region;
+}
+
+/* Name and kind of a metric_id, or of METRIC_SCALARS + metric_hist_id */
+const char *metrics_name(int i, int *kindp)
+{
+	*kindp = metric_table[i].kind;
+	return metric_table[i].name;
+}
+
+/*
+ *  metrics_port_register()  -- the value slot of a serial port, its
+ *  values are at METRIC_PORT_BASE(slot).  Returns -1 when all are
+ *  taken.
+ */
+int metrics_port_register(const char *name)
+{
+	int p;
+
+	if (metrics_ports_count >= METRIC_PORTS)
+		return -1;
+	p = metrics_ports_count++;
+	strncpy(metrics_ports[p], name, sizeof(metrics_ports[p]) - 1);
+
+	if (metrics_region) {
+		struct metrics_desc *D = (struct metrics_desc *) (metrics_region + 1);
+		metrics_port_desc(D + METRIC_DESCS_FIXED + p * METRIC_PORT_VALUES, p);
+#ifdef __GNUC__
+		__sync_synchronize();	/* descriptors before the count */
+#endif
+		metrics_region->count += METRIC_PORT_VALUES;
+	}
+	return p;
+}
+
+/* Port name of a slot, NULL when it is not in use */
+const char *metrics_port_name(int p)
+{
+	return p < metrics_ports_count ? metrics_ports[p] : NULL;
+}
+
+/* Name and kind of a metric_port_id */
+const char *metrics_port_value_name(int v, int *kindp)
+{
+	*kindp = metric_port_table[v].kind;
+	return metric_port_table[v].name;
+}
+
+/* Descriptors and values within 'size' bytes ? */
+int metrics_region_ok(const void *region, uint32_t size)
+{
+	const struct metrics_head *MH = region;
+	const struct metrics_desc *D;
+	uint32_t i;
+
+	if (size < sizeof(*MH) || MH->desc_size < sizeof(*D) ||
+	    MH->values_offset > size ||
+	    (uint64_t) MH->count * MH->desc_size + sizeof(*MH) > MH->values_offset ||
+	    (uint64_t) MH->values_count * sizeof(uint64_t) > size - MH->values_offset)
+		return 0;
+	for (i = 0; i < MH->count; ++i) {
+		D = (const void *) ((const char *) (MH + 1) + i * MH->desc_size);
+		if ((uint64_t) D->value + 1 +
+		    (D->kind == METRIC_KIND_HISTOGRAM ? D->buckets + 1 : 0) > MH->values_count)
+			return 0;
+		if (D->kind == METRIC_KIND_HISTOGRAM && D->subbits > 8)
+			return 0;
+	}
+	return 1;
+}
+
+/* Smallest value that goes to bucket 'idx', see metric_hist_index() */
+uint64_t metrics_bucket_low(int idx, int subbits)
+{
+	const int sub = 1 << subbits;
+	int e;
+
+	if (idx < sub)
+		return idx;
+	e = (idx >> subbits) + subbits - 1;
+	return ((uint64_t) (sub | (idx & (sub - 1)))) << (e - subbits);
+}
+
+/* Upper bound of the bucket holding the given fraction of samples */
+static uint64_t metrics_hist_pct(const uint64_t *v, int buckets, int subbits,
+				 double frac)
+{
+	uint64_t want = (uint64_t) (v[0] * frac + 0.999), n = 0;
+	int b;
+
+	for (b = 0; b < buckets - 1; ++b) {
+		n += v[2 + b];
+		if (n >= want)
+			break;
+	}
+	return metrics_bucket_low(b + 1, subbits);
+}
+
+/*
+ *  metrics_dump()  -- all of a region as text, or as a JSON object:
+ *
+ *	rx_frames 1234
+ *	kiss_rx_process_ns count=10 sum=123456 p50<12288 p90<16384 p99<20480
+ *	kiss_rx_process_ns[10240] 3
+ *
+ *  where "name[L] N" is a histogram bucket of N samples that are at
+ *  least L, and less than L of the next bucket.
+ */
+void metrics_dump(FILE *fp, const void *region, int json)
+{
+	const struct metrics_head *MH = region;
+	const uint64_t *values = (const void *) ((const char *) region + MH->values_offset);
+	const char *sep;
+	uint32_t i;
+	int b;
+
+	if (json)
+		fprintf(fp, "{");
+	for (i = 0; i < MH->count; ++i) {
+		const struct metrics_desc *D =
+			(const void *) ((const char *) (MH + 1) + i * MH->desc_size);
+		const uint64_t *v = values + D->value;
+		char name[sizeof(D->name) + 1];
+
+		memcpy(name, D->name, sizeof(D->name));
+		name[sizeof(D->name)] = 0;
+
+		if (D->kind != METRIC_KIND_HISTOGRAM) {
+			if (json)
+				fprintf(fp, "%s\n \"%s\": {\"type\": \"%s\", \"value\": %llu}",
+					i ? "," : "", name,
+					D->kind == METRIC_KIND_GAUGE ? "gauge" : "counter",
+					(unsigned long long) v[0]);
+			else
+				fprintf(fp, "%s %llu\n", name, (unsigned long long) v[0]);
+			continue;
+		}
+
+		if (json) {
+			fprintf(fp, "%s\n \"%s\": {\"type\": \"histogram\", \"count\": %llu, \"sum\": %llu, \"buckets\": [",
+				i ? "," : "", name,
+				(unsigned long long) v[0], (unsigned long long) v[1]);
+			sep = "";
+			for (b = 0; b < (int) D->buckets; ++b) {
+				if (v[2 + b] == 0)
+					continue;
+				fprintf(fp, "%s[%llu, %llu]", sep,
+					(unsigned long long) metrics_bucket_low(b, D->subbits),
+					(unsigned long long) v[2 + b]);
+				sep = ", ";
+			}
+			fprintf(fp, "]}");
+			continue;
+		}
+
+		fprintf(fp, "%s count=%llu sum=%llu", name,
+			(unsigned long long) v[0], (unsigned long long) v[1]);
+		if (v[0] > 0)
+			fprintf(fp, " p50<%llu p90<%llu p99<%llu",
+				(unsigned long long) metrics_hist_pct(v, D->buckets, D->subbits, 0.50),
+				(unsigned long long) metrics_hist_pct(v, D->buckets, D->subbits, 0.90),
+				(unsigned long long) metrics_hist_pct(v, D->buckets, D->subbits, 0.99));
+		fprintf(fp, "\n");
+		for (b = 0; b < (int) D->buckets; ++b) {
+			if (v[2 + b] == 0)
+				continue;
+			fprintf(fp, "%s[%llu] %llu\n", name,
+				(unsigned long long) metrics_bucket_low(b, D->subbits),
+				(unsigned long long) v[2 + b]);
+		}
+	}
+	if (json)
+		fprintf(fp, "\n}\n");
+}
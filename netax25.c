@@ -19,13 +19,17 @@
 
 #include <sys/ioctl.h>
 #include <net/if.h>
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>	/* sockaddr_ll, and the TPACKET_V3 ring */
 #include <netinet/if_ether.h>
 
 #include <netinet/in.h>
 
 #include <netax25/ax25.h>
 
+#include <sys/mman.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
 
 /*
  * Link-level device access
@@ -59,6 +63,7 @@ struct netax25_dev {
 	uint8_t         scan;
 	char		devname[IFNAMSIZ];
 	char		callsign[10];
+	struct erlanghandle erlang;
 	const struct aprx_interface *interface;
 };
 
@@ -66,6 +71,10 @@ struct netax25_dev {
 static struct netax25_dev **netax25_devs;
 static int                  netax25_devcount;
 
+/* netax25_devs[] by kernel ifindex, rebuilt at every device scan */
+static struct netax25_dev **netax25_byifindex;
+static int                  netax25_byifindex_size;
+
 
 
 /*
@@ -85,12 +94,36 @@ struct netax25_pty {
 	const char                  *callsign;
 	const struct aprx_interface *interface;
 	struct sockaddr_ax25         ax25addr;
+	struct erlanghandle          erlang;
 };
 
 
 static int rx_socket = -1;
 static int tx_socket = -1;
 
+/*
+ *  PACKET_MMAP TPACKET_V3 receive ring on the rx_socket.
+ *
+ *  The kernel fills the blocks, and hands a block over when it is
+ *  full or when it has been open for NETAX25_RING_TOV milliseconds.
+ *  One poll() wakeup then delivers every frame in the block, and
+ *  the frames are processed where the kernel put them.  Without
+ *  the ring (old kernel, or setup fails) it is recvfrom() per frame.
+ *
+ *  A frame waits in its block up to the TOV before aprx sees it, so
+ *  the frame's latency clock starts at the ring timestamp of the
+ *  frame, not at the wakeup.  At AX.25 rates a block carries one or
+ *  two frames anyway, so the shortest TOV costs no extra wakeups.
+ */
+#define NETAX25_RING_BLOCKSIZE	(1 << 16)
+#define NETAX25_RING_BLOCKS	8
+#define NETAX25_RING_FRAMESIZE	2048
+#define NETAX25_RING_TOV	1	/* ms, digipeat latency matters */
+#define NETAX25_RING_MAXAGE	(60 * 1000000000LL) /* ns, else the clock stepped */
+
+static uint8_t *rx_ring;	/* NULL = no ring, use recvfrom()  */
+static int      rx_ring_block;	/* next block to look at           */
+
 static struct netax25_pty **ax25rxports;
 static int                  ax25rxportscount;
 
@@ -297,12 +330,106 @@ static int is_ax25ttyport(const char *callsign)
 }
 
 
+/* Rebuild the ifindex table, and link devices to configured ports */
+static void netax25_devs_relink(void)
+{
+	struct netax25_dev *d;
+	int i, j;
+
+	// Index by ifindex for the receiver
+	for (i = 0; i < netax25_byifindex_size; ++i)
+	  netax25_byifindex[i] = NULL;
+	for (i = 0; i < netax25_devcount; ++i) {
+	  d = netax25_devs[i];
+	  if (d->ifindex < 0)
+	    continue;
+	  if (d->ifindex >= netax25_byifindex_size) {
+	    int n = d->ifindex + 8;
+	    netax25_byifindex = realloc(netax25_byifindex, sizeof(void*) * n);
+	    memset(netax25_byifindex + netax25_byifindex_size, 0,
+		   sizeof(void*) * (n - netax25_byifindex_size));
+	    netax25_byifindex_size = n;
+	  }
+	  netax25_byifindex[d->ifindex] = d;
+	}
+
+	// Link interfaces
+	for (i = 0; i < netax25_devcount; ++i) {
+	  d = netax25_devs[i];
+	  for (j = 0; j < ax25rxportscount; ++j) {
+	    if (strcmp(ax25rxports[j]->callsign,d->callsign) == 0) {
+	      d->interface = ax25rxports[j]->interface;
+	      ax25rxports[j]->ifindex = d->ifindex;
+	    }
+	  }
+	}
+}
+
+/* Add a device, or update the one with same ifindex */
+static struct netax25_dev *netax25_dev_update(const struct netax25_dev *ax25dev)
+{
+	struct netax25_dev *d;
+	int i;
+
+	for (i = 0; i < netax25_devcount; ++i) {
+	  d = netax25_devs[i];
+	  if (d->ifindex == ax25dev->ifindex) {
+	    d->scan = 1;  // The ifindex does not change during interface lifetime
+	    if (memcmp(d->ax25addr, ax25dev->ax25addr, 7) != 0) {
+	      // Callsign changed (axparms ?), forget old port link
+	      memcpy(d->ax25addr, ax25dev->ax25addr, 7);
+	      memcpy(d->callsign, ax25dev->callsign, sizeof(d->callsign));
+	      d->interface = NULL;
+	      d->rxok = !is_ax25ttyport(d->callsign);
+	      memset(&d->erlang, 0, sizeof(d->erlang));
+	    }
+	    memcpy(d->devname, ax25dev->devname, sizeof(d->devname));
+	    return d;
+	  }
+	}
+	// Not in known interfaces, add a new one..
+	d = malloc(sizeof(*d));
+	++netax25_devcount;
+	netax25_devs = realloc( netax25_devs,
+				sizeof(void*) * netax25_devcount );
+	netax25_devs[netax25_devcount-1] = d;
+	memcpy(d, ax25dev, sizeof(*d));
+	d->scan = 1;
+	d->rxok = !is_ax25ttyport(d->callsign);
+	if (debug) printf("netax25: device %s (ifindex %d) is %s\n",
+			  d->devname, d->ifindex, d->callsign);
+	return d;
+}
+
+/* Forget a device, and any port using it */
+static void netax25_dev_remove(const int ifindex)
+{
+	int i, j;
+
+	for (i = 0; i < netax25_devcount; ++i) {
+	  if (netax25_devs[i]->ifindex != ifindex)
+	    continue;
+	  if (debug) printf("netax25: device %s (ifindex %d) is gone\n",
+			    netax25_devs[i]->devname, ifindex);
+	  free(netax25_devs[i]);
+	  for (j = i+1; j < netax25_devcount; ++j) {
+	    netax25_devs[j-1] = netax25_devs[j];
+	  }
+	  --netax25_devcount;
+	  break;
+	}
+	for (j = 0; j < ax25rxportscount; ++j) {
+	  if (ax25rxports[j]->ifindex == ifindex)
+	    ax25rxports[j]->ifindex = -1;
+	}
+}
+
 static int scan_linux_devices(void) {
 	FILE *fp;
 	struct ifreq ifr;
 	char buffer[512], *s;
 	int fd;
-	struct netax25_dev ax25dev, *d;
+	struct netax25_dev ax25dev;
 	int i;
 
 	// Mark all devices ready for scanning
@@ -365,58 +492,125 @@ static int scan_linux_devices(void) {
 	  ax25dev.ifindex = ifr.ifr_ifindex;
 
 	  // Store/Update internal kernel interface index list
-
-	  d = NULL;
-	  for (i = 0; i < netax25_devcount; ++i) {
-	    d = netax25_devs[i];
-	    if (d->ifindex == ax25dev.ifindex) {
-	      d->scan = 1;  // The ifindex does not change during interface lifetime
-	      break;
-	    }
-	    d = NULL;
-	  }
-	  if (d == NULL) {
-	    // Not in known interfaces, add a new one..
-	    d = malloc(sizeof(*d));
-	    ++netax25_devcount;
-	    netax25_devs = realloc( netax25_devs,
-				    sizeof(void*) * netax25_devcount );
-	    netax25_devs[netax25_devcount-1] = d;
-	    memcpy(d, &ax25dev, sizeof(*d));
-	    d->scan = 1;
-	    d->rxok = !is_ax25ttyport(d->callsign);
-	  }
-
+	  netax25_dev_update(&ax25dev);
 	}
 	fclose(fp);
 	close(fd);
 	// Remove devices no longer known
-	for (i = 0; i < netax25_devcount; ++i) {
+	for (i = 0; i < netax25_devcount; ) {
 	  if (netax25_devs[i]->scan == 0) {
-	    int j;
 	    if (debug>1)printf("Compating netax25_devs[] i=%d callsign=%s\n",
 			       i, netax25_devs[i]->callsign);
-	    free(netax25_devs[i]);
-	    for (j = i+1; j < netax25_devcount; ++j) {
-	      netax25_devs[j-1] = netax25_devs[j];
-	    }
-	    --netax25_devcount;
+	    netax25_dev_remove(netax25_devs[i]->ifindex);
+	  } else {
+	    ++i;
 	  }
 	}
 
-	// Link interfaces
-	for (i = 0; i < netax25_devcount; ++i) {
-	  int j;
-	  struct netax25_dev *d = netax25_devs[i];
-	  for (j = 0; j < ax25rxportscount; ++j) {
-	    if (strcmp(ax25rxports[j]->callsign,d->callsign) == 0) {
-	      d->interface = ax25rxports[j]->interface;
-	      ax25rxports[j]->ifindex = d->ifindex;
-	    }
+	netax25_devs_relink();
+	return 0;
+}
+
+
+/*
+ *  rtnetlink link events:  the kernel tells when a device comes up,
+ *  goes down, changes its address, or goes away.  The device table
+ *  is updated from those right away, and /proc/net/dev is scanned
+ *  only at start, and when the event socket overflows (ENOBUFS) and
+ *  events may have been lost.  Without a netlink socket the old
+ *  60 second rescan is used.
+ */
+
+static int nl_socket = -1;
+static int nl_rescan;		/* events lost, full scan needed */
+
+static void netax25_netlink_open(void)
+{
+	struct sockaddr_nl snl;
+
+	nl_socket = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (nl_socket < 0) {
+	  if (debug) printf("netax25: no rtnetlink socket; errno=%d -- rescanning every 60 s\n", errno);
+	  return;
+	}
+	memset(&snl, 0, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	snl.nl_groups = RTMGRP_LINK;
+	if (bind(nl_socket, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+	  if (debug) printf("netax25: rtnetlink bind failed; errno=%d -- rescanning every 60 s\n", errno);
+	  close(nl_socket);
+	  nl_socket = -1;
+	  return;
+	}
+	fd_nonblockingmode(nl_socket);
+}
+
+static void netax25_netlink_link(const struct nlmsghdr *nh)
+{
+	const struct ifinfomsg *ifi = NLMSG_DATA(nh);
+	const struct rtattr *rta;
+	struct netax25_dev ax25dev;
+	int rtalen, have_addr = 0;
+
+	if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi)))
+	  return;
+
+	if (nh->nlmsg_type == RTM_DELLINK ||
+	    ifi->ifi_type != ARPHRD_AX25 || !(ifi->ifi_flags & IFF_UP)) {
+	  // Gone, down, or not AX.25 (anymore) -- no-op if not known
+	  netax25_dev_remove(ifi->ifi_index);
+	  return;
+	}
+
+	memset(&ax25dev, 0, sizeof(ax25dev));
+	ax25dev.ifindex = ifi->ifi_index;
+	rtalen = IFLA_PAYLOAD(nh);
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+	  if (rta->rta_type == IFLA_IFNAME) {
+	    strncpy(ax25dev.devname, RTA_DATA(rta), IFNAMSIZ-1);
+	  } else if (rta->rta_type == IFLA_ADDRESS && RTA_PAYLOAD(rta) >= 7) {
+	    memcpy(ax25dev.ax25addr, RTA_DATA(rta), 7);
+	    have_addr = 1;
 	  }
 	}
+	if (!have_addr)
+	  return;
+	ax25_to_tnc2_fmtaddress(ax25dev.callsign, ax25dev.ax25addr, 0); // in text
+	netax25_dev_update(&ax25dev);
+}
 
-	return 0;
+static void netax25_netlink_read(void)
+{
+	union {
+	  struct nlmsghdr nh;
+	  char buf[8192];
+	} u;
+	int len, changes = 0;
+
+	for (;;) {
+	  struct nlmsghdr *nh;
+
+	  len = recv(nl_socket, u.buf, sizeof(u.buf), 0);
+	  if (len < 0) {
+	    if (errno == ENOBUFS)
+	      nl_rescan = 1;	// Kernel dropped events
+	    break;
+	  }
+	  if (len == 0)
+	    break;
+	  for (nh = &u.nh; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+	    if (nh->nlmsg_type == RTM_NEWLINK || nh->nlmsg_type == RTM_DELLINK) {
+	      netax25_netlink_link(nh);
+	      ++changes;
+	    }
+	  }
+	}
+	if (nl_rescan) {
+	  nl_rescan = 0;
+	  scan_linux_devices();
+	} else if (changes) {
+	  netax25_devs_relink();
+	}
 }
 
 
@@ -464,6 +658,47 @@ static void netax25_addttyport(const char *callsign,
 }
 
 
+/* Returns 0 when the ring is in use */
+static int rxsock_ring_setup(const int fd)
+{
+	struct tpacket_req3 req;
+	int v = TPACKET_V3;
+	void *ring;
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &v, sizeof(v)) < 0) {
+	  if (debug) printf("netax25: no TPACKET_V3; errno=%d -- using recvfrom()\n", errno);
+	  return -1;
+	}
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size       = NETAX25_RING_BLOCKSIZE;
+	req.tp_block_nr         = NETAX25_RING_BLOCKS;
+	req.tp_frame_size       = NETAX25_RING_FRAMESIZE;
+	req.tp_frame_nr         = (NETAX25_RING_BLOCKSIZE / NETAX25_RING_FRAMESIZE) * NETAX25_RING_BLOCKS;
+	req.tp_retire_blk_tov   = NETAX25_RING_TOV;
+	req.tp_feature_req_word = 0;
+	if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+	  if (debug) printf("netax25: PACKET_RX_RING failed; errno=%d -- using recvfrom()\n", errno);
+	  v = TPACKET_V1;
+	  setsockopt(fd, SOL_PACKET, PACKET_VERSION, &v, sizeof(v));
+	  return -1;
+	}
+	ring = mmap(NULL, NETAX25_RING_BLOCKSIZE * NETAX25_RING_BLOCKS,
+		    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+	if (ring == MAP_FAILED) // MAP_LOCKED may be over RLIMIT_MEMLOCK
+	  ring = mmap(NULL, NETAX25_RING_BLOCKSIZE * NETAX25_RING_BLOCKS,
+		      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+	  if (debug) printf("netax25: RX ring mmap() failed; errno=%d -- using recvfrom()\n", errno);
+	  // The ring can not be removed from the socket, start over
+	  return -2;
+	}
+	rx_ring       = ring;
+	rx_ring_block = 0;
+	if (debug) printf("netax25: RX ring of %d x %d bytes\n",
+			  NETAX25_RING_BLOCKS, NETAX25_RING_BLOCKSIZE);
+	return 0;
+}
+
 /* Nothing much in early init */
 void netax25_init(void)
 {
@@ -481,6 +716,8 @@ void netax25_start(void)
 	if (!ax25rxports) return;	/* No configured receiver ports.
 					   No receiver socket creation. */
 
+	netax25_netlink_open();		/* Before the first device scan */
+
 	rx_protocol = ETH_P_AX25;	/* Choosing ETH_P_ALL would pick also
 					   outbound packets, but also all of
 					   the ethernet traffic..  ETH_P_AX25
@@ -510,6 +747,12 @@ void netax25_start(void)
 		return;
 	}
 
+	if (rxsock_ring_setup(rx_socket) == -2) {
+		// Ring is set up, but can not be mapped, start over
+		close(rx_socket);
+		rx_socket = socket(PF_PACKET, SOCK_RAW, htons(rx_protocol));
+	}
+
 	if (rx_socket >= 0)
 		fd_nonblockingmode(rx_socket);
 }
@@ -541,6 +784,13 @@ int netax25_prepoll(struct aprxpolls *app)
         	netax25_resettimer(&next_scantime);
         }
 
+	if (nl_socket >= 0) {
+		pfd = aprxpolls_new(app);
+		pfd->fd = nl_socket;
+		pfd->events = POLLIN;
+		pfd->revents = 0;
+	}
+
 	if (rx_socket >= 0) {
 		/* FD is open, lets mark it for poll read.. */
 		pfd = aprxpolls_new(app);
@@ -562,20 +812,12 @@ int netax25_prepoll(struct aprxpolls *app)
 	return 1;
 }
 
-static int rxsock_read( const int fd )
+/* One received frame, from recvfrom() or from the RX ring */
+static void rxsock_frame( const struct sockaddr_ll *sllp, uint8_t *rxbuf, const int rcvlen )
 {
-	struct sockaddr_ll sll;
-	socklen_t sllsize;
-	int rcvlen, ifindex, i;
+	const struct sockaddr_ll sll = *sllp;
+	int ifindex;
 	struct netax25_dev *netdev;
-	uint8_t rxbuf[3000];
-
-	sllsize = sizeof(sll);
-	rcvlen = recvfrom(fd, rxbuf, sizeof(rxbuf), 0, (struct sockaddr*)&sll, &sllsize);
-
-	if (rcvlen < 0) {
-		return 0;	/* No more at this time.. */
-	}
 
 /*
 struct sockaddr_ll
@@ -605,8 +847,8 @@ Leads with 00 byte, then AX.25 address..
 	    sll.sll_hatype   != SOCK_RAW          ||
 	    sll.sll_pkttype  != 0                 ||
 	    sll.sll_halen    != 0                 ||
-	    rxbuf[0]         != 0 ) {
-	  return 1; // Not of our interest
+	    rcvlen < 1 || rxbuf[0] != 0 ) {
+	  return; // Not of our interest
 	}
 	ifindex = sll.sll_ifindex;
 
@@ -645,20 +887,16 @@ Leads with 00 byte, then AX.25 address..
  	}
 
 	netdev = NULL;
-	for (i = 0; i < netax25_devcount; ++i) {
-	  if (netax25_devs[i]->ifindex == ifindex) {
-	    netdev = netax25_devs[i];
-	    break;
-	  }
-	}
+	if (ifindex >= 0 && ifindex < netax25_byifindex_size)
+	  netdev = netax25_byifindex[ifindex];
 	if (netdev == NULL) {
 	  // Not found from Ax.25 devices
 	  if (debug>1) printf(".. not from known AX.25 device\n");
-	  return 1;
+	  return;
 	}
         if (netdev->interface == NULL) {
 	  if (debug>1) printf(".. not from AX.25 device configured for receiving.\n");
-          return 1;
+          return;
         }
 
 	if (debug) printf("Received frame of %d bytes from %s: %s\n",
@@ -669,7 +907,7 @@ Leads with 00 byte, then AX.25 address..
 		if (debug > 1) {
 		  printf("%s is ttyport which we serve.\n",netdev->callsign);
 		}
-		return 1; // We drop our own packets, if we ever see them
+		return; // We drop our own packets, if we ever see them
 	}
 
 	/// Now: actual AX.25 frame reception,
@@ -679,7 +917,7 @@ Leads with 00 byte, then AX.25 address..
 	 * "+10" is a magic constant for trying
 	 * to estimate channel occupation overhead
 	 */
-	erlang_add(netdev->callsign, ERLANG_RX, rcvlen + 10, 1); // rxsock_read()
+	erlang_add_h(&netdev->erlang, netdev->callsign, ERLANG_RX, rcvlen + 10, 1); // rxsock_read()
 
 	// Send it to Rx-IGate, validates also AX.25 header bits,
 	// and returns non-zero only when things are OK for processing.
@@ -691,7 +929,7 @@ Leads with 00 byte, then AX.25 address..
 	} else {
 	  // The packet is not valid per AX.25 header bit rules
           rfloghex(netdev->callsign, 'D', 1, rxbuf, rcvlen);
-	  erlang_add(netdev->callsign, ERLANG_DROP, rcvlen+10, 1);	/* Account one packet */
+	  erlang_add_h(&netdev->erlang, netdev->callsign, ERLANG_DROP, rcvlen+10, 1);	/* Account one packet */
 
 	  if (aprxlogfile) {
 	    FILE *fp = fopen(aprxlogfile, "a");
@@ -707,9 +945,72 @@ Leads with 00 byte, then AX.25 address..
 	  }
 	}
 
+}
+
+
+static int rxsock_read( const int fd )
+{
+	struct sockaddr_ll sll;
+	socklen_t sllsize;
+	int rcvlen;
+	uint8_t rxbuf[3000];
+
+	sllsize = sizeof(sll);
+	rcvlen = recvfrom(fd, rxbuf, sizeof(rxbuf), 0, (struct sockaddr*)&sll, &sllsize);
+
+	if (rcvlen < 0) {
+		return 0;	/* No more at this time.. */
+	}
+	rxsock_frame(&sll, rxbuf, rcvlen);
 	return 1;
 }
 
+/* Process every block the kernel has handed over, return frame count */
+static int rxsock_ring_read(void)
+{
+	const int64_t now_ns = monotonic_ns();
+	int64_t realtime_ns;
+	struct timespec ts;
+	int frames = 0;
+
+	/* Ring timestamps are CLOCK_REALTIME, the latencies are monotonic */
+	clock_gettime(CLOCK_REALTIME, &ts);
+	realtime_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+	for (;;) {
+		struct tpacket_block_desc *bd = (struct tpacket_block_desc *)
+			(rx_ring + rx_ring_block * NETAX25_RING_BLOCKSIZE);
+		struct tpacket3_hdr *pkt;
+		int i, n;
+
+		if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+			break;	/* Kernel still owns it */
+
+		n   = bd->hdr.bh1.num_pkts;
+		pkt = (struct tpacket3_hdr *)((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+		for (i = 0; i < n; ++i) {
+			const struct sockaddr_ll *sll = (const struct sockaddr_ll *)
+				((uint8_t *)pkt + TPACKET_ALIGN(sizeof(*pkt)));
+			const int64_t age = realtime_ns -
+				((int64_t)pkt->tp_sec * 1000000000LL + pkt->tp_nsec);
+
+			if ((pkt->tp_status & TP_STATUS_TS_RAW_HARDWARE) ||
+			    age < 0 || age > NETAX25_RING_MAXAGE)
+				rx_frame_ns = now_ns; /* no usable timestamp */
+			else
+				rx_frame_ns = now_ns - age;
+			rxsock_frame(sll, (uint8_t *)pkt + pkt->tp_mac, pkt->tp_snaplen);
+			pkt = (struct tpacket3_hdr *)((uint8_t *)pkt + pkt->tp_next_offset);
+		}
+		frames += n;
+
+		/* Give the block back */
+		__atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+		rx_ring_block = (rx_ring_block + 1) % NETAX25_RING_BLOCKS;
+	}
+	return frames;
+}
+
 static void discard_read_fd( const int fd )
 {
 	char buf[2000];
@@ -726,7 +1027,7 @@ int netax25_postpoll(struct aprxpolls *app)
 
         assert(app->polls != NULL);
 
-        if (tv_timercmp(&tick, &next_scantime) > 0) {
+        if (nl_socket < 0 && tv_timercmp(&tick, &next_scantime) > 0) {
         	scan_linux_devices();
                 // Rescan every 60 seconds, on the dot.
                 tv_timeradd_seconds(&next_scantime, &next_scantime, 60);
@@ -738,10 +1039,19 @@ int netax25_postpoll(struct aprxpolls *app)
 		return 0;
 
 	for (i = 0; i < app->pollcount; ++i, ++pfd) {
+	  if ((pfd->fd == nl_socket) && (pfd->revents & POLLIN)) {
+	    /* device table changes, before frames from those devices */
+	    netax25_netlink_read();
+	  }
 	  if ((pfd->fd == rx_socket) &&
 	      (pfd->revents & (POLLIN | POLLPRI))) {
 	    /* something coming in.. */
-	    rxsock_read( rx_socket );
+	    rx_frame_ns = monotonic_ns();
+	    if (rx_ring != NULL)
+	      rxsock_ring_read();
+	    else
+	      rxsock_read( rx_socket );
+	    rx_frame_ns = 0;
 	  }
 	  for (j = 0; j < ax25ttyportscount; ++j) {
 	    if ((pfd->revents & (POLLIN | POLLPRI)) &&
@@ -807,6 +1117,7 @@ void netax25_sendto(const void *nax25p, const uint8_t *axaddr, const int axaddrl
 	i = sendmsg(tx_socket, &mh, 0);
 	if (debug>1)printf("netax25_sendto() the sendmsg len=%d rc=%d errno=%d\n", len, i, errno);
 
-	erlang_add(nax25->callsign, ERLANG_TX, axaddrlen+axdatalen + 10, 1);  // netax25_sendto()
+	erlang_add_h(&((struct netax25_pty *)nax25p)->erlang, nax25->callsign,
+		     ERLANG_TX, axaddrlen+axdatalen + 10, 1);  // netax25_sendto()
 }
 #endif
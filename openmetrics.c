@@ -0,0 +1,413 @@
+/* **************************************************************** *
+ *                                                                  *
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ * **************************************************************** */
+
+#include "aprx.h"
+
+/*
+ *  OpenMetrics (Prometheus) text exporter over HTTP.
+ *
+ *  A listening socket and a few client slots are on the main poll
+ *  loop.  All sockets are non-blocking:  a request is read as it
+ *  comes, and the answer is rendered into the slot's buffer a section
+ *  at a time, the next one when the client has taken the previous.
+ *  So one postpoll round renders at most one section, and a scrape
+ *  of many interfaces does not hold up the packet handling.  The
+ *  buffers are kept for the next scrape, so after the first ones
+ *  there are no more allocations.
+ *
+ *  Served are the metrics.c values, the KISS TX queues of each serial
+ *  port, the erlang SNMP counters of each interface, and the digipeater
+ *  token buckets.
+ *
+ *  In the <logging> section:
+ *	metrics-http  127.0.0.1  9101
+ */
+
+#define OM_CLIENTS     4
+#define OM_REQMAX      2048
+#define OM_IDLE_SECS   10
+
+struct om_client {
+	int    fd;
+	int    reqlen;
+	char   req[OM_REQMAX];
+	struct ombuf out;
+	int    outcur;		/* next byte to write, -1 = reading     */
+	int    section;		/* next to render, OM_SECTIONS = done   */
+	time_t deadline;	/* tick.tv_sec to give up               */
+};
+
+static const char *om_host;
+static const char *om_port;
+static int om_listen_fd = -1;
+static struct om_client om_clients[OM_CLIENTS];
+
+/* Where our pollfds begin in the aprxpolls, and what they are */
+static int om_pollfirst;
+static int om_pollcount;
+static int om_pollwho[1 + OM_CLIENTS];	/* -1 = listener, else client */
+
+
+/* Room for 'n' more bytes */
+static void ombuf_reserve(struct ombuf *ob, int n)
+{
+	while (ob->size - ob->len < n) {
+		ob->size = ob->size ? ob->size * 2 : 8192;
+		ob->buf  = realloc(ob->buf, ob->size);
+	}
+}
+
+/*
+ *  ombuf_printf()  -- append to a buffer that grows as needed
+ */
+void ombuf_printf(struct ombuf *ob, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	ombuf_reserve(ob, 256);
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(ob->buf + ob->len, ob->size - ob->len, fmt, ap);
+		va_end(ap);
+		if (n < 0)
+			return;
+		if (n < ob->size - ob->len)
+			break;
+		ombuf_reserve(ob, n + 1);
+	}
+	ob->len += n;
+}
+
+/* Label value with backslash, quote and newline escaped */
+void ombuf_label(struct ombuf *ob, const char *s, int maxlen)
+{
+	int i;
+
+	ombuf_reserve(ob, 2 * maxlen);
+	for (i = 0; i < maxlen && s[i] != 0; ++i) {
+		if (s[i] == '\\' || s[i] == '"' || s[i] == '\n')
+			ob->buf[ob->len++] = '\\';
+		ob->buf[ob->len++] = s[i] == '\n' ? 'n' : s[i];
+	}
+}
+
+
+static void om_render_metrics(struct ombuf *ob)
+{
+	int i, b, kind;
+
+	for (i = 0; i < METRIC_SCALARS + METRIC_HISTS; ++i) {
+		const char *name = metrics_name(i, &kind);
+
+		if (kind == METRIC_KIND_COUNTER) {
+			ombuf_printf(ob, "# TYPE aprx_%s counter\n"
+				     "aprx_%s_total %llu\n", name, name,
+				     (unsigned long long) metrics_values[i]);
+
+		} else if (kind == METRIC_KIND_GAUGE) {
+			ombuf_printf(ob, "# TYPE aprx_%s gauge\n"
+				     "aprx_%s %llu\n", name, name,
+				     (unsigned long long) metrics_values[i]);
+
+		} else {
+			/* Histogram buckets are by powers of two, that is,
+			   METRIC_HIST_SUB of our buckets in each.  As all
+			   values are whole nanoseconds, "less than L" is
+			   the same as "at most L-1". */
+			const uint64_t *v = metrics_values +
+				METRIC_HIST_BASE(i - METRIC_SCALARS);
+			uint64_t cum = 0;
+
+			ombuf_printf(ob, "# TYPE aprx_%s histogram\n", name);
+			for (b = 0; b < METRIC_HIST_BUCKETS; ++b) {
+				cum += v[2 + b];
+				if (((b + 1) % METRIC_HIST_SUB) != 0 ||
+				    b + 1 == METRIC_HIST_BUCKETS)
+					continue;
+				ombuf_printf(ob, "aprx_%s_bucket{le=\"%llu\"} %llu\n", name,
+					     (unsigned long long) metrics_bucket_low(b + 1, METRIC_HIST_SUBBITS) - 1,
+					     (unsigned long long) cum);
+			}
+			ombuf_printf(ob, "aprx_%s_bucket{le=\"+Inf\"} %llu\n"
+				     "aprx_%s_count %llu\n"
+				     "aprx_%s_sum %llu\n",
+				     name, (unsigned long long) v[0],
+				     name, (unsigned long long) v[0],
+				     name, (unsigned long long) v[1]);
+		}
+	}
+}
+
+static void om_render_ports(struct ombuf *ob)
+{
+	const char *port;
+	int p, v, kind;
+
+	for (v = 0; v < METRIC_PORT_VALUES; ++v) {
+		const char *name = metrics_port_value_name(v, &kind);
+
+		ombuf_printf(ob, "# TYPE aprx_%s %s\n", name,
+			     kind == METRIC_KIND_COUNTER ? "counter" : "gauge");
+		for (p = 0; (port = metrics_port_name(p)) != NULL; ++p) {
+			ombuf_printf(ob, "aprx_%s%s{port=\"", name,
+				     kind == METRIC_KIND_COUNTER ? "_total" : "");
+			ombuf_label(ob, port, strlen(port));
+			ombuf_printf(ob, "\"} %llu\n",
+				     (unsigned long long) metrics_values[METRIC_PORT_BASE(p) + v]);
+		}
+	}
+}
+
+/* One column of the erlang SNMP counters of every interface */
+static void om_render_erlang(struct ombuf *ob, int c)
+{
+	static const char *const colname[ERLANG_COLUMNS] = {
+		"rx_bytes", "rx_packets", "rx_drop_bytes",
+		"rx_drop_packets", "tx_bytes", "tx_packets"
+	};
+	int i;
+
+	ombuf_printf(ob, "# TYPE aprx_interface_%s counter\n", colname[c]);
+	for (i = 0; i < ErlangLinesCount; ++i) {
+		const struct erlangline *E = ErlangLines[i];
+		ombuf_printf(ob, "aprx_interface_%s_total{interface=\"", colname[c]);
+		ombuf_label(ob, E->name, sizeof(E->name));
+		ombuf_printf(ob, "\"} %llu\n", (unsigned long long) E->SNMP[c]);
+	}
+}
+
+/* The sections of an answer, in order */
+#define OM_SECTIONS	(ERLANG_COLUMNS + 4)
+
+static void om_render(struct ombuf *ob, int section)
+{
+	if (section == 0)
+		om_render_metrics(ob);
+	else if (section == 1)
+		om_render_ports(ob);
+	else if (section < 2 + ERLANG_COLUMNS)
+		om_render_erlang(ob, section - 2);
+	else if (section == 2 + ERLANG_COLUMNS)
+		digipeater_openmetrics(ob);
+	else
+		ombuf_printf(ob, "# EOF\n");
+}
+
+
+/* Answer to a complete request header in C->req.  HTTP/1.0 with
+   the connection closed at the end, so no Content-Length needed.
+   The header goes out with the first section, om_write() renders
+   the rest. */
+static void om_respond(struct om_client *C)
+{
+	C->out.len = 0;
+	if (strncmp(C->req, "GET /metrics ", 13) == 0 ||
+	    strncmp(C->req, "GET / ", 6) == 0) {
+		ombuf_printf(&C->out, "HTTP/1.0 200 OK\r\n"
+			     "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+			     "Connection: close\r\n"
+			     "\r\n");
+		om_render(&C->out, 0);
+		C->section = 1;
+	} else {
+		ombuf_printf(&C->out, "HTTP/1.0 404 Not Found\r\n"
+			     "Connection: close\r\n"
+			     "\r\n");
+		C->section = OM_SECTIONS;
+	}
+	C->outcur = 0;
+}
+
+static void om_close(struct om_client *C)
+{
+	close(C->fd);
+	C->fd = -1;
+}
+
+static void om_accept(void)
+{
+	struct om_client *C = NULL;
+	int fd, i;
+
+	fd = accept(om_listen_fd, NULL, NULL);
+	if (fd < 0)
+		return;
+	for (i = 0; i < OM_CLIENTS; ++i) {
+		if (om_clients[i].fd < 0) {
+			C = &om_clients[i];
+			break;
+		}
+	}
+	if (!C) {
+		/* All busy, they will retry */
+		close(fd);
+		return;
+	}
+	fd_nonblockingmode(fd);
+	C->fd       = fd;
+	C->reqlen   = 0;
+	C->outcur   = -1;
+	C->deadline = tick.tv_sec + OM_IDLE_SECS;
+}
+
+static void om_read(struct om_client *C)
+{
+	int i = read(C->fd, C->req + C->reqlen, sizeof(C->req) - 1 - C->reqlen);
+
+	if (i == 0 || (i < 0 && errno != EAGAIN && errno != EINTR)) {
+		om_close(C);
+		return;
+	}
+	if (i < 0)
+		return;
+	C->reqlen += i;
+	C->req[C->reqlen] = 0;
+	if (strstr(C->req, "\r\n\r\n") || strstr(C->req, "\n\n"))
+		om_respond(C);
+	else if (C->reqlen >= sizeof(C->req) - 1)
+		om_close(C);	/* Not a scraper */
+}
+
+static void om_write(struct om_client *C)
+{
+	int i = write(C->fd, C->out.buf + C->outcur, C->out.len - C->outcur);
+
+	if (i < 0) {
+		if (errno != EAGAIN && errno != EINTR)
+			om_close(C);
+		return;
+	}
+	C->outcur += i;
+	if (C->outcur < C->out.len)
+		return;
+	if (C->section >= OM_SECTIONS) {
+		om_close(C);
+		return;
+	}
+	/* Taken all, the next section into the same buffer */
+	C->out.len = 0;
+	C->outcur  = 0;
+	om_render(&C->out, C->section++);
+}
+
+
+/* A "metrics-http host port" in <logging> */
+void openmetrics_config(const char *host, const char *port)
+{
+	om_host = strdup(host);
+	om_port = strdup(port);
+}
+
+void openmetrics_start(void)
+{
+	struct addrinfo req, *ai = NULL;
+	int i, on = 1;
+
+	for (i = 0; i < OM_CLIENTS; ++i)
+		om_clients[i].fd = -1;
+
+	if (!om_port)
+		return;
+
+	memset(&req, 0, sizeof(req));
+	req.ai_socktype = SOCK_STREAM;
+	req.ai_protocol = IPPROTO_TCP;
+	req.ai_flags    = AI_PASSIVE;
+	i = getaddrinfo(*om_host ? om_host : NULL, om_port, &req, &ai);
+	if (i != 0 || ai == NULL) {
+		aprxlog("metrics-http: can not resolve %s port %s: %s",
+			om_host, om_port, gai_strerror(i));
+		return;
+	}
+	om_listen_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (om_listen_fd >= 0) {
+		setsockopt(om_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (bind(om_listen_fd, ai->ai_addr, ai->ai_addrlen) < 0 ||
+		    listen(om_listen_fd, OM_CLIENTS) < 0) {
+			close(om_listen_fd);
+			om_listen_fd = -1;
+		}
+	}
+	if (om_listen_fd < 0)
+		aprxlog("metrics-http: listen on %s port %s failed: %s",
+			om_host, om_port, strerror(errno));
+	else
+		fd_nonblockingmode(om_listen_fd);
+	freeaddrinfo(ai);
+}
+
+int openmetrics_prepoll(struct aprxpolls *app)
+{
+	struct pollfd *pfd;
+	struct timeval tv;
+	int i;
+
+	om_pollfirst = app->pollcount;
+	om_pollcount = 0;
+	if (om_listen_fd < 0)
+		return 0;
+
+	pfd = aprxpolls_new(app);
+	pfd->fd      = om_listen_fd;
+	pfd->events  = POLLIN;
+	pfd->revents = 0;
+	om_pollwho[om_pollcount++] = -1;
+
+	for (i = 0; i < OM_CLIENTS; ++i) {
+		struct om_client *C = &om_clients[i];
+		if (C->fd < 0)
+			continue;
+		if (time_reset)
+			C->deadline = tick.tv_sec + OM_IDLE_SECS;
+		if (C->deadline < tick.tv_sec) {
+			om_close(C);
+			continue;
+		}
+		tv.tv_sec  = C->deadline;
+		tv.tv_usec = 0;
+		if (tv_timercmp(&app->next_timeout, &tv) > 0)
+			app->next_timeout = tv;
+
+		pfd = aprxpolls_new(app);
+		pfd->fd      = C->fd;
+		pfd->events  = C->outcur < 0 ? POLLIN : POLLOUT;
+		pfd->revents = 0;
+		om_pollwho[om_pollcount++] = i;
+	}
+	return om_pollcount;
+}
+
+int openmetrics_postpoll(struct aprxpolls *app)
+{
+	int i;
+
+	for (i = 0; i < om_pollcount; ++i) {
+		const struct pollfd *pfd = &app->polls[om_pollfirst + i];
+		struct om_client *C;
+
+		if (pfd->revents == 0)
+			continue;
+		if (om_pollwho[i] < 0) {
+			om_accept();
+			continue;
+		}
+		C = &om_clients[om_pollwho[i]];
+		if (C->fd != pfd->fd)
+			continue;
+		if (pfd->revents & (POLLERR | POLLNVAL))
+			om_close(C);
+		else if (C->outcur < 0)
+			om_read(C);
+		else
+			om_write(C);
+	}
+	return 0;
+}
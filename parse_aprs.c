@@ -95,8 +95,9 @@ static int pbuf_fill_pos(struct pbuf_t *pb, const float lat, const float lng, co
 
 	/* Pre-calculations for A/R/F/M-filter tests */
 	pb->lat     = filter_lat2rad(lat);  /* deg-to-radians */
-	pb->cos_lat = cosf(pb->lat);        /* used in range filters */
+	pb->cos_lat = cosf(pb->lat);
 	pb->lng     = filter_lon2rad(lng);  /* deg-to-radians */
+	filter_pos_vector(pb->lat, pb->lng, pb->pos_xyz); /* used in range filters */
 	
 	pb->flags |= F_HASPOS;	/* the packet has positional data */
 
@@ -1075,7 +1076,7 @@ int parse_aprs_txgate(struct pbuf_t *pb, int look_inside_3rd_party, historydb_t
  *	Return 0 for parse failures, 1 for OK.
  */
 
-int parse_aprs(struct pbuf_t*const pb, historydb_t*const historydb)
+static int parse_aprs_(struct pbuf_t*const pb, historydb_t*const historydb)
 {
 	char packettype, poschar;
 	int paclen;
@@ -1276,6 +1277,7 @@ int parse_aprs(struct pbuf_t*const pb, historydb_t*const historydb)
 					pb->lat     = history->lat;
                                         pb->lng     = history->lon;
                                         pb->cos_lat = history->coslat;
+                                        memcpy(pb->pos_xyz, history->pos_xyz, sizeof(pb->pos_xyz));
 			    
                                         pb->flags  |= F_HASPOS;
                                 }
@@ -1368,6 +1370,14 @@ int parse_aprs(struct pbuf_t*const pb, historydb_t*const historydb)
 	return 0; // bad
 }
 
+int parse_aprs(struct pbuf_t*const pb, historydb_t*const historydb)
+{
+	const int rc = parse_aprs_(pb, historydb);
+
+	APRX_PROBE4(parse, pb->data, pb->packet_len, pb->packettype, rc);
+	return rc;
+}
+
 /*
  *      Parse an aprs text message (optional, only done to messages addressed to
  *      SERVER
@@ -28,7 +28,8 @@ static cellarena_t *pbuf_cells;
 
 // 2150 byte pbuf takes in an AX.25 packet of about 1kB in size,
 // and in APRS use there never should be larger than about 512 bytes.
-// A 16 kB arena fits in 7 of these humongous pbufs.
+// An arena block takes 7 of these humongous pbufs, as 16 kB did
+// before struct pbuf_t grew.
 
 const int pbufcell_size  = sizeof(struct pbuf_t) + 2150;
 const int pbufcell_align = __alignof__(struct pbuf_t);
@@ -42,7 +43,7 @@ void pbuf_init(void)
 			       pbufcell_size,
 			       pbufcell_align,
 			       CELLMALLOC_POLICY_LIFO,
-			       16, // 16 kB at the time
+			       (7 * pbufcell_size + 1023) / 1024,
 			       0   // minfree
 			       );
 #endif
@@ -73,6 +74,8 @@ static struct pbuf_t *pbuf_alloc( const int axlen,
 	  return NULL;
 	}
 	pb = cellmalloc(pbuf_cells);
+	if (pb == NULL)
+	  return NULL; // The arena is full
 	memset(pb, 0, pblen );
 #else
 	// No size limits with valgrind..
@@ -90,6 +90,7 @@ struct pbuf_t {
 	int16_t	 donecount;	// How many digipeat hops are already done?
 
 	time_t   t;		/* when the packet was received */
+	int64_t  rx_ns;		/* monotonic_ns() of the read(), 0 = unknown */
 	uint32_t seqnum;	/* ever increasing counter, dupecheck sets */
 	uint16_t packettype;	/* bitmask: one or more of T_* */
 	uint16_t flags;		/* bitmask: one or more of F_* */
@@ -112,6 +113,7 @@ struct pbuf_t {
 	float lat;	/* if the packet is PT_POSITION, latitude and longitude go here */
 	float lng;	/* .. in RADIAN */
 	float cos_lat;	/* cache of COS of LATitude for radial distance filter    */
+	double pos_xyz[3]; /* position as unit vector, for range filters */
 
 	char symbol[3]; /* 2(+1) chars of symbol, if any, NUL for not found */
 
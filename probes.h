@@ -0,0 +1,70 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+ *  USDT static tracepoints of the packet pipeline, for bpftrace and
+ *  perf.  With  ./configure --enable-usdt  (needs <sys/sdt.h>) each
+ *  one is a NOP instruction and an ELF note, the arguments are read
+ *  only when a tracer has attached.  Without it they compile away.
+ *
+ *	bpftrace -l 'usdt:/usr/sbin/aprx:*'
+ *	bpftrace -e 'usdt:/usr/sbin/aprx:aprx:dupecheck__hit
+ *			{ @seen[arg1] = count(); }'
+ *	perf buildid-cache --add /usr/sbin/aprx
+ *	perf record -e sdt_aprx:digi__tx -a
+ *
+ *  The probes, and their arguments:
+ *
+ *	frame__rx	 interface callsign, TNC2 text, its length,
+ *			 is_aprs -- every AX.25 frame an interface
+ *			 receives with a valid header
+ *	parse		 TNC2 text, its length, the T_* packettype bits,
+ *			 parse_aprs() result
+ *	filter		 TNC2 text, its length, filter_process() verdict:
+ *			 1 accept, 0 no match, -1 reject
+ *	dupecheck__hit	 dupe record hash, times seen (direct plus
+ *			 delayed), viscous delay
+ *	dupecheck__miss	 new dupe record hash, viscous delay
+ *	viscous__enqueue source interface callsign, TNC2 text, queue length
+ *	viscous__release source interface callsign, 1 if the packet goes
+ *			 on to the digipeater, 0 if a direct copy took it
+ *	digi__tx	 transmitter callsign, source interface callsign,
+ *			 TNC2 text as received, its length
+ *	igate__queue	 interface callsign, TNC2 text, its length
+ *	igate__drop	 interface callsign, TNC2 text, its length,
+ *			 0 by the igate rules, 1 the APRS-IS queue
+ *			 did not take it
+ *	aprsis__write	 APRS-IS server name, bytes written, bytes still
+ *			 in the write buffer
+ *
+ *  The TNC2 text of frame__rx and igate__* is not NUL terminated, read
+ *  it with  str(arg1, arg2).
+ */
+
+#ifdef ENABLE_USDT
+#include <sys/sdt.h>
+
+#define APRX_PROBE1(name, a1)			DTRACE_PROBE1(aprx, name, a1)
+#define APRX_PROBE2(name, a1, a2)		DTRACE_PROBE2(aprx, name, a1, a2)
+#define APRX_PROBE3(name, a1, a2, a3)		DTRACE_PROBE3(aprx, name, a1, a2, a3)
+#define APRX_PROBE4(name, a1, a2, a3, a4)	DTRACE_PROBE4(aprx, name, a1, a2, a3, a4)
+
+#else
+
+#define APRX_PROBE1(name, a1)			do {} while (0)
+#define APRX_PROBE2(name, a1, a2)		do {} while (0)
+#define APRX_PROBE3(name, a1, a2, a3)		do {} while (0)
+#define APRX_PROBE4(name, a1, a2, a3, a4)	do {} while (0)
+
+#endif
+
+#endif
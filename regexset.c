@@ -0,0 +1,281 @@
+/********************************************************************
+ *  APRX -- 2nd generation APRS iGate and digi with                 *
+ *          minimal requirement of esoteric facilities or           *
+ *          libraries of any kind beyond UNIX system libc.          *
+ *                                                                  *
+ * (c) Matti Aarnio - OH2MQK,  2007-2014                            *
+ *                                                                  *
+ ********************************************************************/
+
+#include "aprx.h"
+
+/*
+ *  Sets of reject regular expressions, one set per field class
+ *  of a digipeater <source>.
+ *
+ *  The question asked is only "does any of these match?", so the
+ *  patterns are compiled once more into:
+ *
+ *   - literal tests for patterns without any RE meta-characters,
+ *     optionally anchored with ^ and/or $:  "^N0CALL", "TCPIP",
+ *     "-15$" -- these are memcmp()/strstr(), no regexec() at all.
+ *
+ *   - one alternation  "(p1)|(p2)|...|(pN)"  of all the rest,
+ *     which regexec() evaluates in a single scan over the field.
+ *
+ *   - patterns that can not be safely wrapped in parenthesis
+ *     (back-references, unbalanced parens) are kept alone.
+ *
+ *  The original per pattern regex_t entries are kept for the
+ *  reference evaluation in regexset_match_each().
+ */
+
+#define RSLIT_ANYWHERE 0
+#define RSLIT_PREFIX   1
+#define RSLIT_SUFFIX   2
+#define RSLIT_EXACT    3
+
+struct regexset_lit {
+	int   kind;
+	int   len;
+	char *s;
+};
+
+struct regexset {
+	int       count;      // all patterns
+	char    **patterns;
+	regex_t **regs;
+
+	int       nlits;
+	struct regexset_lit *lits;
+
+	int       ncombined;  // patterns folded in 'combined'
+	regex_t   combined;
+
+	int       nsingles;
+	regex_t **singles;
+};
+
+void regexset_add(struct regexset **setp, const char *pattern, regex_t *re)
+{
+	struct regexset *set = *setp;
+	if (set == NULL) {
+		set = calloc(1, sizeof(*set));
+		*setp = set;
+	}
+	set->count += 1;
+	set->patterns = realloc(set->patterns, set->count * sizeof(char *));
+	set->regs     = realloc(set->regs,     set->count * sizeof(regex_t *));
+	set->patterns[set->count - 1] = strdup(pattern);
+	set->regs[set->count - 1]     = re;
+}
+
+/* Plain literal, with optional ^ and $ anchors ?
+   Bytes over 127 are left for the RE engine, it is locale aware. */
+static int regexset_literal(const char *p, struct regexset_lit *lit)
+{
+	int len = strlen(p);
+	int kind = RSLIT_ANYWHERE;
+	const char *s;
+
+	if (len > 0 && p[0] == '^') {
+		kind |= RSLIT_PREFIX;
+		++p; --len;
+	}
+	if (len > 0 && p[len-1] == '$') {
+		kind |= RSLIT_SUFFIX;
+		--len;
+	}
+	if (len == 0)
+		return 0;
+	for (s = p; s < p + len; ++s) {
+		const unsigned int c = (uint8_t)*s;
+		if (c > 127 || strchr(".[]()*+?{}|^$\\", c) != NULL)
+			return 0;
+	}
+	lit->kind = kind;
+	lit->len  = len;
+	lit->s    = malloc(len + 1);
+	memcpy(lit->s, p, len);
+	lit->s[len] = 0;
+	return 1;
+}
+
+/* Can the pattern be put inside "( ... )" of an alternation
+   without changing its meaning ? */
+static int regexset_wrappable(const char *p)
+{
+	int depth = 0;
+
+	for (; *p; ++p) {
+		if (*p == '\\') {
+			if ('1' <= p[1] && p[1] <= '9')
+				return 0; // back-reference, group numbers would shift
+			if (p[1] == 0)
+				return 0;
+			++p;
+			continue;
+		}
+		if (*p == '[') {
+			// Bracket expression,  "[]abc]" and "[^]abc]" have
+			// the leading ']' as a literal member.
+			++p;
+			if (*p == '^') ++p;
+			if (*p == ']') ++p;
+			while (*p && *p != ']') {
+				if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+					const char d = p[1];
+					p += 2;
+					while (*p && !(p[0] == d && p[1] == ']'))
+						++p;
+					if (*p) ++p;
+				}
+				if (*p) ++p;
+			}
+			if (*p == 0)
+				return 0;
+			continue;
+		}
+		if (*p == '(')
+			++depth;
+		else if (*p == ')' && --depth < 0)
+			return 0;
+	}
+	return (depth == 0);
+}
+
+int regexset_compile(struct regexset *set)
+{
+	int i, rc, len = 0;
+	char *alt, *s;
+	int  *wrap;
+
+	if (set == NULL)
+		return 0;
+
+	wrap = calloc(set->count, sizeof(int));
+	set->lits    = calloc(set->count, sizeof(*set->lits));
+	set->singles = calloc(set->count, sizeof(regex_t *));
+
+	for (i = 0; i < set->count; ++i) {
+		if (regexset_literal(set->patterns[i], &set->lits[set->nlits])) {
+			set->nlits += 1;
+		} else if (regexset_wrappable(set->patterns[i])) {
+			wrap[i] = 1;
+			set->ncombined += 1;
+			len += strlen(set->patterns[i]) + 3;
+		} else {
+			set->singles[set->nsingles++] = set->regs[i];
+		}
+	}
+
+	if (set->ncombined == 1) {
+		// No point in compiling it again
+		for (i = 0; i < set->count; ++i)
+			if (wrap[i])
+				set->singles[set->nsingles++] = set->regs[i];
+		set->ncombined = 0;
+	}
+
+	if (set->ncombined > 1) {
+		alt = s = malloc(len + 1);
+		for (i = 0; i < set->count; ++i) {
+			if (!wrap[i]) continue;
+			if (s != alt) *s++ = '|';
+			s += sprintf(s, "(%s)", set->patterns[i]);
+		}
+		rc = regcomp(&set->combined, alt, REG_EXTENDED | REG_NOSUB);
+		if (debug > 1)
+			printf("regexset: combined %d patterns: '%s' rc=%d\n",
+			       set->ncombined, alt, rc);
+		free(alt);
+		if (rc != 0) {
+			// Should not happen, but if it does, use them one by one
+			for (i = 0; i < set->count; ++i)
+				if (wrap[i])
+					set->singles[set->nsingles++] = set->regs[i];
+			set->ncombined = 0;
+		}
+	}
+
+	free(wrap);
+	return 0;
+}
+
+int regexset_match(const struct regexset *set, const char *field)
+{
+	int i, flen = -1;
+
+	if (set == NULL)
+		return 0;
+
+	for (i = 0; i < set->nlits; ++i) {
+		const struct regexset_lit *lit = &set->lits[i];
+		switch (lit->kind) {
+		case RSLIT_PREFIX:
+			if (strncmp(field, lit->s, lit->len) == 0)
+				return 1;
+			break;
+		case RSLIT_ANYWHERE:
+			if (strstr(field, lit->s) != NULL)
+				return 1;
+			break;
+		default: // SUFFIX and EXACT
+			if (flen < 0)
+				flen = strlen(field);
+			if (lit->kind == RSLIT_EXACT && flen != lit->len)
+				break;
+			if (flen >= lit->len &&
+			    memcmp(field + flen - lit->len, lit->s, lit->len) == 0)
+				return 1;
+			break;
+		}
+	}
+	if (set->ncombined > 0 &&
+	    regexec(&set->combined, field, 0, NULL, 0) == 0)
+		return 1;
+	for (i = 0; i < set->nsingles; ++i)
+		if (regexec(set->singles[i], field, 0, NULL, 0) == 0)
+			return 1;
+	return 0;
+}
+
+/* Reference: every configured regex_t, one at a time */
+int regexset_match_each(const struct regexset *set, const char *field)
+{
+	int i;
+
+	if (set == NULL)
+		return 0;
+	for (i = 0; i < set->count; ++i)
+		if (regexec(set->regs[i], field, 0, NULL, 0) == 0)
+			return 1;
+	return 0;
+}
+
+int regexset_count(const struct regexset *set)
+{
+	return (set == NULL) ? 0 : set->count;
+}
+
+void regexset_free(struct regexset *set)
+{
+	int i;
+
+	if (set == NULL)
+		return;
+	for (i = 0; i < set->count; ++i) {
+		free(set->patterns[i]);
+		regfree(set->regs[i]);
+		free(set->regs[i]);
+	}
+	for (i = 0; i < set->nlits; ++i)
+		free(set->lits[i].s);
+	if (set->ncombined > 0)
+		regfree(&set->combined);
+	free(set->patterns);
+	free(set->regs);
+	free(set->lits);
+	free(set->singles);
+	free(set);
+}
@@ -16,10 +16,9 @@ static int telemetry_interval = 20 * 60;     // every 20 minutes
 static int telemetry_labelinterval = 120*60; // every 2 hours
 static int telemetry_labelindex = 0;
 
-#if (defined(ERLANGSTORAGE) || (USE_ONE_MINUTE_STORAGE == 1))
+#if (USE_ONE_MINUTE_DATA == 1)
 static int telemetry_1min_steps = 20;
-#endif
-#if (defined(ERLANGSTORAGE) || (USE_ONE_MINUTE_STORAGE == 0))
+#else
 static int telemetry_10min_steps = 2;
 #endif
 
@@ -114,8 +113,35 @@ int telemetry_postpoll(struct aprxpolls *app) {
 	return 0;
 }
 
+/* Busiest (want_max) or the sum over the latest completed periods
+   of one counter column, a sequential walk back on its ring */
+static long telemetry_scan(const struct erlangline *E, int col, int want_max)
+{
+#if (USE_ONE_MINUTE_DATA == 1)
+	const int series = ERLANG_SERIES_1MIN;
+	const int steps  = telemetry_1min_steps;	// Up to 20 of 1 minute samples
+#else
+	const int series = ERLANG_SERIES_10MIN;
+	const int steps  = telemetry_10min_steps;	// Up to 2 of 10 minute samples
+#endif
+	const uint32_t *ring = erlang_column(E, series, col);
+	long v = 0;
+	int age, k;
+
+	for (age = 1; age <= steps; ++age) {
+		k = erlang_slot(E, series, age);
+		if (k < 0)
+			break;
+		if (!want_max)
+			v += ring[k];
+		else if (ring[k] > v)
+			v = ring[k];
+	}
+	return v;
+}
+
 static void telemetry_datatx(void) {
-	int  i, j, k, t;
+	int  i;
 	char buf[200], *s;
 	int  buflen;
 	char beaconaddr[60];
@@ -146,159 +172,34 @@ static void telemetry_datatx(void) {
 		s += sprintf(s, "T#%03d,", telemetry_seq);
 
 
-		// Raw Rx Erlang - plotting scale factor: 1/200
-		erlmax = 0;
 #if (USE_ONE_MINUTE_DATA == 1)
-		// Find busiest 1 minute
-		k = E->e1_cursor;
-		t = E->e1_max;
-		if (t > telemetry_1min_steps)
-			t = telemetry_1min_steps;	// Up to 10 of 1 minute samples
 		erlcapa = 1.0 / E->erlang_capa; // 1/capa of 1 minute
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e1_max - 1;
-			if (E->e1[k].bytes_rx > erlmax)
-				erlmax = E->e1[k].bytes_rx;
-		}
 #else
-		// Find busiest 10 minute
-		k = E->e10_cursor;
-		t = E->e10_max;
-		if (t > telemetry_10min_steps)
-			t = telemetry_10min_steps;	// Up to 1 of 10 minute samples
-		erlcapa = 0.1 / E->erlang_capa; // 1/capa of 10 minute 
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e10_max - 1;
-			if (E->e10[k].bytes_rx > erlmax)
-				erlmax = E->e10[k].bytes_rx;
-		}
+		erlcapa = 0.1 / E->erlang_capa; // 1/capa of 10 minute
 #endif
+
+		// Raw Rx Erlang - plotting scale factor: 1/200
+		erlmax = telemetry_scan(E, ERLANG_COL_BYTES_RX, 1);
 		f = (200.0 * erlcapa * erlmax);
 		s += sprintf(s, "%.1f,", f);
 
 		// Raw Tx Erlang - plotting scale factor: 1/200
-		erlmax = 0;
-#if (USE_ONE_MINUTE_DATA == 1)
-		// Find busiest 1 minute
-		k = E->e1_cursor;
-		t = E->e1_max;
-		if (t > telemetry_1min_steps)
-			t = telemetry_1min_steps;	// Up to 10 of 1 minute samples
-		erlcapa = 1.0 / E->erlang_capa; // 1/capa of 1 minute
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e1_max - 1;
-			if (E->e1[k].bytes_tx > erlmax)
-				erlmax = E->e1[k].bytes_tx;
-		}
-#else
-		// Find busiest 10 minute
-		k = E->e10_cursor;
-		t = E->e10_max;
-		if (t > telemetry_10min_steps)
-			t = telemetry_10min_steps;	// Up to 1 of 10 minute samples
-		erlcapa = 0.1 / E->erlang_capa; // 1/capa of 10  minute
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e10_max - 1;
-			if (E->e10[k].bytes_tx > erlmax)
-				erlmax = E->e10[k].bytes_tx;
-		}
-#endif
+		erlmax = telemetry_scan(E, ERLANG_COL_BYTES_TX, 1);
 		f = (200.0 * erlcapa * erlmax);
 		s += sprintf(s, "%.1f,", f);
 
-		erlmax = 0;
-#if (USE_ONE_MINUTE_DATA == 1)
-		// Sum of 1 minute packet counts
-		k = E->e1_cursor;
-		t = E->e1_max;
-		if (t > telemetry_1min_steps)
-			t = telemetry_1min_steps;	/* Up to 10 of 1 minute samples */
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e1_max - 1;
-			erlmax += E->e1[k].packets_rx;
-		}
-#else
-		// Sum of 10 minute packet counts
-		erlmax = 0;
-		k = E->e10_cursor;
-		t = E->e10_max;
-		if (t > telemetry_10min_steps)
-			t = telemetry_10min_steps;	// Up to 1 of 10 minute samples
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e10_max - 1;
-			erlmax += E->e10[k].packets_rx;
-		}
-#endif
+		// Sum of packet counts
+		erlmax = telemetry_scan(E, ERLANG_COL_PACKETS_RX, 0);
 		f = erlmax / telemetry_timescaler;
 		s += sprintf(s, "%.1f,", f);
 
-		erlmax = 0;
-#if (USE_ONE_MINUTE_DATA == 1)
-		// Sum of 1 minute packet drop counts
-		k = E->e1_cursor;
-		t = E->e1_max;
-		if (t > telemetry_1min_steps)
-			t = telemetry_1min_steps;	/* Up to 10 of 1 minute samples */
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e1_max - 1;
-			erlmax += E->e1[k].packets_rxdrop;
-		}
-#else
-		// Sum of 10 minute packet drop counts
-		k = E->e10_cursor;
-		t = E->e10_max;
-		if (t > telemetry_10min_steps)
-			t = telemetry_10min_steps;	// Up to 1 of 10 minute samples
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e10_max - 1;
-			erlmax += E->e10[k].packets_rxdrop;
-		}
-#endif
+		// Sum of packet drop counts
+		erlmax = telemetry_scan(E, ERLANG_COL_PACKETS_RXDROP, 0);
 		f = erlmax / telemetry_timescaler;
 		s += sprintf(s, "%.1f,", f);
 
-		erlmax = 0;
-#if (USE_ONE_MINUTE_DATA == 1)
-		// Sum of 1 minute packet tx counts
-		k = E->e1_cursor;
-		t = E->e1_max;
-		if (t > telemetry_1min_steps)
-			t = telemetry_1min_steps;	/* Up to 10 of 1 minute samples */
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e1_max - 1;
-			erlmax += E->e1[k].packets_tx;
-		}
-#else
-		// Sum of 10 minute packet tx counts
-		k = E->e10_cursor;
-		t = E->e10_max;
-		if (t > telemetry_10min_steps)
-			t = telemetry_10min_steps;	// Up to 1 of 10 minute samples
-		for (j = 0; j < t; ++j) {
-			--k;
-			if (k < 0)
-				k = E->e10_max - 1;
-			erlmax += E->e10[k].packets_tx;
-		}
-#endif
+		// Sum of packet tx counts
+		erlmax = telemetry_scan(E, ERLANG_COL_PACKETS_TX, 0);
 		f = erlmax / telemetry_timescaler;
 		s += sprintf(s, "%.1f,", f);
 
@@ -15,6 +15,11 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
 
 
 /* The ttyreader does read TTY ports into a big buffer, and then from there
@@ -26,8 +31,15 @@ static int ttycount;		/* How many are defined ? */
 
 #define TTY_OPEN_RETRY_DELAY_SECS 30
 
-static int poll_millis;         /* milliseconds (0 = none.)             */
-static struct timeval poll_millis_tv;
+/* Ports in the order their pollfds were added at the last prepoll,
+   they are contiguous in the aprxpolls array from pollports_first */
+static struct serialport **pollports;
+static int pollports_first, pollports_count, pollports_size;
+static struct timeval latency_log_tv; /* next RX-to-TX latency log time */
+
+int ttyreader_txq_limit = 65536; /* bytes of KISS frames queued per port */
+
+#define TTY_WRITEV_MAX 16
 
 
 void hexdumpfp(FILE *fp, const uint8_t *buf, const int len, int axaddr)
@@ -103,7 +115,7 @@ static int ttyreader_pulltnc2(struct serialport *S)
 	if (p != NULL)
 	  addrlen = (int)(p - S->rdline);
 
-	erlang_add(S->ttycallsign[0], ERLANG_RX, S->rdlinelen, 1);	/* Account one packet */
+	erlang_add_h(&S->erlang[0], S->ttycallsign[0], ERLANG_RX, S->rdlinelen, 1);	/* Account one packet */
 
 	/* Send the frame to internal AX.25 network */
 	/* netax25_sendax25_tnc2(S->rdline, S->rdlinelen); */
@@ -237,35 +249,103 @@ static int ttyreader_pulltext(struct serialport *S)
 
 /*
  *  ttyreader_linewrite()  -- write out buffered data
+ *
+ *  The raw byte buffer (init strings, KISS polls and probes) and the
+ *  queued KISS frames go out with one writev().  A frame that was
+ *  written partially goes first, so nothing gets in the middle of it.
  */
+/* Frame written out in full, account latency of digipeats */
+static void ttyreader_txq_done(struct serialport *S, struct kissframe *kf)
+{
+	S->txq_head   = kf->next;
+	S->txq_count -= 1;
+	S->txq_bytes -= kf->len;
+	if (kf->rx_ns != 0 && S->interface[kf->tncid] != NULL) {
+		const int64_t ns = monotonic_ns() - kf->rx_ns;
+		latencyhist_add(&S->interface[kf->tncid]->txlatency, ns);
+		metric_observe(METRIC_HIST_DIGI_LATENCY, ns);
+	}
+	free(kf);
+}
+
 void ttyreader_linewrite(struct serialport *S)
 {
-	int i, len;
+	struct iovec iov[TTY_WRITEV_MAX];
+	struct kissframe *kf = S->txq_head;
+	int i, n = 0, wrbuf_first = 1;
 
-	if ((S->wrlen == 0) || (S->wrlen > 0 && S->wrcursor >= S->wrlen)) {
+	if (S->wrcursor >= S->wrlen)
 		S->wrlen = S->wrcursor = 0;	/* already all written */
-		return;
+
+	if (kf != NULL && kf->cursor > 0) {
+		iov[n].iov_base = kf->buf + kf->cursor;
+		iov[n].iov_len  = kf->len - kf->cursor;
+		++n;
+		kf = kf->next;
+		wrbuf_first = 0;
+	}
+	if (S->wrlen > S->wrcursor) {
+		iov[n].iov_base = S->wrbuf + S->wrcursor;
+		iov[n].iov_len  = S->wrlen - S->wrcursor;
+		++n;
 	}
+	for (; kf != NULL && n < TTY_WRITEV_MAX; kf = kf->next) {
+		iov[n].iov_base = kf->buf;
+		iov[n].iov_len  = kf->len;
+		++n;
+	}
+	if (n == 0 || S->fd < 0)
+		return;
 
-	/* Now there is some data in between wrcursor and wrlen */
-
-	len = S->wrlen - S->wrcursor;
-	if (len > 0)
-	  i = write(S->fd, S->wrbuf + S->wrcursor, len);
-	else
-	  i = 0;
-	if (i > 0) {		/* wrote something */
-		S->wrcursor += i;
-		len = S->wrlen - S->wrcursor;
-		if (len == 0) {
-			S->wrcursor = S->wrlen = 0;	/* wrote all ! */
-		} else {
-			/* compact the buffer a bit */
-			memcpy(S->wrbuf, S->wrbuf + S->wrcursor, len);
-			S->wrcursor = 0;
-			S->wrlen = len;
+	i = writev(S->fd, iov, n);
+	if (i <= 0)
+		return;		/* EAGAIN or whatever, poll(2) retries */
+
+	/* Account what was written, in the same order */
+	if (!wrbuf_first) {
+		kf = S->txq_head;
+		if (i < kf->len - kf->cursor) {
+			kf->cursor += i;
+			return;
+		}
+		i -= kf->len - kf->cursor;
+		ttyreader_txq_done(S, kf);
+	}
+	if (S->wrlen > S->wrcursor) {
+		int len = S->wrlen - S->wrcursor;
+		if (i < len) {
+			S->wrcursor += i;
+			return;
+		}
+		i -= len;
+		S->wrlen = S->wrcursor = 0;	/* wrote all ! */
+	}
+	while (i > 0 && (kf = S->txq_head) != NULL) {
+		if (i < kf->len) {
+			kf->cursor = i;
+			break;
 		}
+		i -= kf->len;
+		ttyreader_txq_done(S, kf);
+	}
+	if (S->txq_head == NULL)
+		S->txq_tail = NULL;
+}
+
+/*
+ *  ttyreader_txq_purge()  -- drop queued frames, the port was (re)opened
+ */
+void ttyreader_txq_purge(struct serialport *S)
+{
+	struct kissframe *kf;
+
+	while ((kf = S->txq_head) != NULL) {
+		S->txq_head = kf->next;
+		free(kf);
 	}
+	S->txq_tail  = NULL;
+	S->txq_count = 0;
+	S->txq_bytes = 0;
 }
 
 
@@ -280,18 +360,14 @@ static void ttyreader_lineread(struct serialport *S)
 
 	int rdspace = sizeof(S->rdbuf) - S->rdlen;
 
-	if (S->rdcursor > 0) {
-		/* Read-out cursor is not at block beginning,
-		   is there unread data too ?  */
-		if (S->rdlen > S->rdcursor) {
-			/* Uh..  lets move buffer down a bit,
-			   to make room for more to the end.. */
-			memcpy(S->rdbuf, S->rdbuf + S->rdcursor,
-			       S->rdlen - S->rdcursor);
-			S->rdlen = S->rdlen - S->rdcursor;
-		} else
-			S->rdlen = 0;	/* all processed, mark its size zero */
-		/* Cursor to zero, rdspace recalculated */
+	if (S->rdcursor > 0 && rdspace < sizeof(S->rdbuf) / 4) {
+		/* Read-out cursor is not at block beginning, and the
+		   room at the end is running low.  Move the unread data
+		   down.  The KISS reader always consumes everything, thus
+		   this is for partial text lines only. */
+		memmove(S->rdbuf, S->rdbuf + S->rdcursor,
+			S->rdlen - S->rdcursor);
+		S->rdlen   -= S->rdcursor;
 		S->rdcursor = 0;
 
 		/* recalculate */
@@ -319,6 +395,7 @@ static void ttyreader_lineread(struct serialport *S)
                 
 		S->rdlen += i;
 		S->last_read_something = tick.tv_sec;
+		S->rd_ns = monotonic_ns();
 	}
 
 	/* Done reading, maybe.  Now processing.
@@ -333,8 +410,9 @@ static void ttyreader_lineread(struct serialport *S)
 	    S->linetype == LINETYPE_KISSBPQCRC ||
 	    S->linetype == LINETYPE_KISSSMACK) {
 
+		rx_frame_ns = S->rd_ns;
 		kiss_pullkiss(S);
-
+		rx_frame_ns = 0;
 
 #ifndef DISABLE_IGATE
 	} else if (S->linetype == LINETYPE_DPRSGW) {
@@ -357,14 +435,11 @@ static void ttyreader_lineread(struct serialport *S)
                 aprxlog("TTY %s Unsupported linetype - CLOSED, WAITING %d SECS\n", S->ttyname, TTY_OPEN_RETRY_DELAY_SECS);
 	}
 
-	/* Consumed something, and our read cursor is not in the beginning ? */
-	if (S->rdcursor > 0 && S->rdcursor < S->rdlen) {
-		/* Compact the input buffer! */
-		memcpy(S->rdbuf, S->rdbuf + S->rdcursor,
-		       S->rdlen - S->rdcursor);
-	}
-	S->rdlen -= S->rdcursor;
-	S->rdcursor = 0;
+	/* Consumed everything ?  Then back to the buffer beginning.
+	   Otherwise the unread tail stays where it is, until the
+	   next read needs the room. */
+	if (S->rdcursor >= S->rdlen)
+		S->rdlen = S->rdcursor = 0;
 }
 
 
@@ -380,6 +455,7 @@ static void ttyreader_linesetup(struct serialport *S)
 	S->wait_until.tv_usec = 0;	// Zero it just to be safe
 
 	S->wrlen = S->wrcursor = 0;	// init them at first
+	ttyreader_txq_purge(S);
 
         // If NOT tcp! type socket, it is presumably openable with
         // open(2) instead of something else, like socket(2)...
@@ -413,6 +489,11 @@ static void ttyreader_linesetup(struct serialport *S)
 
 		/* Set attributes */
 		aprx_cfmakeraw(&S->tio, 1); /* hw-flow on */
+		if (S->low_latency) {
+			/* Wake up on every byte, no inter-byte timer */
+			S->tio.c_cc[VMIN]  = 1;
+			S->tio.c_cc[VTIME] = 0;
+		}
 		i = tcsetattr(S->fd, TCSAFLUSH, &S->tio);
 
 		if (i < 0) {
@@ -432,6 +513,25 @@ static void ttyreader_linesetup(struct serialport *S)
 		// Flush buffers once again.
 		i = tcflush(S->fd, TCIOFLUSH);
 
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+		if (S->low_latency) {
+			/* Ask the UART driver to push received bytes to
+			   the line discipline right away instead of on
+			   its next tick.  Not all drivers have it (USB
+			   adapters, PTYs), that is not an error.   */
+			struct serial_struct ss;
+			if (ioctl(S->fd, TIOCGSERIAL, &ss) == 0) {
+				ss.flags |= ASYNC_LOW_LATENCY;
+				if (ioctl(S->fd, TIOCSSERIAL, &ss) != 0 && debug)
+					printf("%ld\tTTY %s: ASYNC_LOW_LATENCY not accepted; errno=%d\n",
+					       tick.tv_sec, S->ttyname, errno);
+			} else if (debug) {
+				printf("%ld\tTTY %s: no TIOCGSERIAL, low-latency is termios only\n",
+				       tick.tv_sec, S->ttyname);
+			}
+		}
+#endif
+
 		for (i = 0; i < 16; ++i) {
 		  if (S->initstring[i] != NULL) {
 		    memcpy(S->wrbuf + S->wrlen, S->initstring[i], S->initlen[i]);
@@ -492,6 +592,11 @@ static void ttyreader_linesetup(struct serialport *S)
 			if (S->fd >= 0) {
 
 				fd_nonblockingmode(S->fd);
+				if (S->low_latency) {
+					int one = 1;
+					setsockopt(S->fd, IPPROTO_TCP, TCP_NODELAY,
+						   &one, sizeof(one));
+				}
 
 				i = connect(S->fd, ai->ai_addr,
 					    ai->ai_addrlen);
@@ -531,6 +636,40 @@ void ttyreader_init(void)
 
 
 
+static int ttyreader_is_kiss(const struct serialport *S)
+{
+	return (S->linetype == LINETYPE_KISS ||
+		S->linetype == LINETYPE_KISSFLEXNET ||
+		S->linetype == LINETYPE_KISSBPQCRC ||
+		S->linetype == LINETYPE_KISSSMACK);
+}
+
+/*
+ *  ttyreader_latency_log()  -- every 10 minutes a LATENCY line per
+ *			      interface that had digipeats written out
+ *			      in the period, along the ERLANG lines.
+ */
+static void ttyreader_latency_log(void)
+{
+	char msgbuf[600];
+	int i, t, len;
+
+	for (i = 0; i < ttycount; ++i) {
+		struct serialport *S = ttys[i];
+		for (t = 0; t < 16; ++t) {
+			struct aprx_interface *aif = S->interface[t];
+			if (aif == NULL || aif->txlatency.count == 0)
+				continue;
+			len = snprintf(msgbuf, sizeof(msgbuf), "LATENCY %s%s ",
+				       aif->callsign, S->low_latency ? " lowlat" : "");
+			latencyhist_format(&aif->txlatency, msgbuf + len,
+					   sizeof(msgbuf) - len);
+			erlang_logline(msgbuf);
+			memset(&aif->txlatency, 0, sizeof(aif->txlatency));
+		}
+	}
+}
+
 /*
  *  ttyreader_prepoll()  --  prepare system for next round of polling
  */
@@ -539,27 +678,38 @@ int ttyreader_prepoll(struct aprxpolls *app)
 {
 	int idx = 0;		/* returns number of *fds filled.. */
 	int i;
+	long wrbytes = 0;
 	struct serialport *S;
 	struct pollfd *pfd;
 
-        if (poll_millis_tv.tv_sec == 0) {
-        	poll_millis_tv = tick;
-        }
+	if (time_reset || latency_log_tv.tv_sec == 0) {
+		tv_timeradd_seconds(&latency_log_tv, &tick, 600);
+	} else if (tv_timercmp(&latency_log_tv, &tick) <= 0) {
+		ttyreader_latency_log();
+		tv_timeradd_seconds(&latency_log_tv, &latency_log_tv, 600);
+	}
+
+	if (pollports_size < ttycount) {
+		pollports_size = ttycount;
+		pollports = realloc(pollports, sizeof(*pollports) * pollports_size);
+	}
+	pollports_first = app->pollcount;
+	pollports_count = 0;
 
-        // if (debug) printf("ttyreader_prepoll() %d\n", poll_millis);
+        // if (debug) printf("ttyreader_prepoll()\n");
 	for (i = 0; i < ttycount; ++i) {
 		S = ttys[i];
 		if (!S->ttyname)
 			continue;	/* No name, no look... */
 
-
-#if 0 // occasional debug mode without real hardware at hand
-                if (poll_millis > 0) {
-                  int deltams = tv_timerdelta_millis(&tick, &poll_millis_tv);
-                  struct timeval tv;
-                  if (debug) printf("%d.%06d .. defining %d ms KISS POLL\n", tick.tv_sec, tick.tv_usec, poll_millis);
-                }
-#endif
+		if (S->metrics_port == -2)
+			S->metrics_port = metrics_port_register(S->ttyname);
+		if (S->metrics_port >= 0) {
+			metric_set(METRIC_PORT_BASE(S->metrics_port) + METRIC_PORT_TXQ_FRAMES,
+				   S->txq_count);
+			metric_set(METRIC_PORT_BASE(S->metrics_port) + METRIC_PORT_TXQ_MAXFRAMES,
+				   S->txq_maxcount);
+		}
 
 		if (S->fd < 0) {
                 	if (time_reset && (S->wait_until.tv_sec != 0)) {
@@ -609,27 +759,35 @@ int ttyreader_prepoll(struct aprxpolls *app)
 		}
 
 
-                if (poll_millis > 0) {
-                        int margin  = poll_millis*2;
-                        // Limit large delta time to within 0..2*poll_millis.
-			int deltams = tv_timerdelta_millis(&tick, &poll_millis_tv);
-                        if (deltams > margin)  deltams = poll_millis;
-                        if (deltams < -margin) deltams = poll_millis;
-                        tv_timeradd_millis(&poll_millis_tv, &tick, deltams);
-
-                        if (debug) printf("%ld.%06d .. defining %d ms KISS POLL\n", (long)tick.tv_sec, (int)tick.tv_usec, poll_millis);
-                }
+		// Active KISS polling on its own timer
+		if (S->poll_millis > 0 && ttyreader_is_kiss(S)) {
+			int deltams = tv_timerdelta_millis(&tick, &S->poll_tv);
+			if (time_reset || S->poll_tv.tv_sec == 0 ||
+			    deltams > 2 * S->poll_millis || deltams < -2 * S->poll_millis) {
+				// Start, or resync after a time jump
+				tv_timeradd_millis(&S->poll_tv, &tick, S->poll_millis);
+				if (debug) printf("%ld.%06d .. defining %d ms KISS POLL on %s\n",
+						  (long)tick.tv_sec, (int)tick.tv_usec,
+						  S->poll_millis, S->ttyname);
+			}
+			if (tv_timercmp(&app->next_timeout, &S->poll_tv) > 0)
+				app->next_timeout = S->poll_tv;
+		}
 
 		/* FD is open, lets mark it for poll read.. */
+		pollports[pollports_count++] = S;
 		pfd = aprxpolls_new(app);
 		pfd->fd = S->fd;
 		pfd->events = POLLIN | POLLPRI;
 		pfd->revents = 0;
-		if (S->wrlen > 0 && S->wrlen > S->wrcursor)
+		if ((S->wrlen > 0 && S->wrlen > S->wrcursor) ||
+		    S->txq_head != NULL)
 			pfd->events |= POLLOUT;
+		wrbytes += S->wrlen - S->wrcursor + S->txq_bytes;
 
 		++idx;
 	}
+	metric_set(METRIC_KISS_WRBUF, wrbytes);
 	return idx;
 }
 
@@ -640,59 +798,38 @@ int ttyreader_prepoll(struct aprxpolls *app)
 
 int ttyreader_postpoll(struct aprxpolls *app)
 {
-	int idx, i;
+	int i;
 
 	struct serialport *S;
 	struct pollfd *P;
 
         // if (debug) printf("ttyreader_postpoll()\n");
 
-	for (idx = 0, P = app->polls; idx < app->pollcount; ++idx, ++P) {
-
-        	// Are we operating in active KISS polling mode?
-        	if (poll_millis > 0) {
-			for (i = 0; i < ttycount; ++i) {
-                               	S = ttys[i];
-
-#if 0  // occasional debug mode without real hardware at hand
-                                if (tv_timercmp(&poll_millis_tv, &tick) <= 0) {
-	                                // Poll interval gone, time for next active POLL request!
-                                        kiss_poll(S);
-                                        tv_timeradd_millis(&poll_millis_tv, &poll_millis_tv, poll_millis);
-                                }
-#endif
-
-                                if (S->fd != P->fd)
-                                	continue;	/* Not this one ? */
-                                if (S->fd < 0)
-                                	continue;	/* Not this one ? */
-
-                                if (!(S->linetype == LINETYPE_KISS ||
-                                      S->linetype == LINETYPE_KISSFLEXNET ||
-                                      S->linetype == LINETYPE_KISSBPQCRC ||
-                                      S->linetype == LINETYPE_KISSSMACK)) {
-                                        // Not a KISS line..
-                                        continue;
-                                }
-                                if (tv_timercmp(&poll_millis_tv, &tick) <= 0) {
-	                                // Poll interval gone, time for next active POLL request!
-                                        kiss_poll(S);
-                                        tv_timeradd_millis(&poll_millis_tv, &poll_millis_tv, poll_millis);
-                                }
-                        }
-                }
+	/* Only our own slots, and only those that have events */
+	for (i = 0; i < pollports_count; ++i) {
+		if (pollports_first + i >= app->pollcount)
+			break;
+		P = &app->polls[pollports_first + i];
+		S = pollports[i];
+		if (P->revents == 0 || S->fd != P->fd)
+			continue;
 
-		for (i = 0; i < ttycount; ++i) {
-			S = ttys[i];
-			if (S->fd != P->fd)
-				continue;	/* Not this one ? */
-			/* It is this one! */
+		if (P->revents & POLLOUT)
+			ttyreader_linewrite(S);
 
-			if (P->revents & POLLOUT)
-				ttyreader_linewrite(S);
+		if (P->revents & (POLLIN | POLLPRI | POLLERR | POLLHUP))
+			ttyreader_lineread(S);
+	}
 
-                        if (P->revents & (POLLIN | POLLPRI | POLLERR | POLLHUP))
-                		ttyreader_lineread(S);
+	/* Active KISS polling timers */
+	for (i = 0; i < pollports_count; ++i) {
+		S = pollports[i];
+		if (S->poll_millis <= 0 || S->fd < 0 || !ttyreader_is_kiss(S))
+			continue;
+		if (tv_timercmp(&S->poll_tv, &tick) <= 0) {
+			// Poll interval gone, time for next active POLL request!
+			kiss_poll(S);
+			tv_timeradd_millis(&S->poll_tv, &S->poll_tv, S->poll_millis);
 		}
 	}
 
@@ -737,6 +874,7 @@ struct serialport *ttyreader_new(void)
         tty->read_timeout = 3600;  /* Default port read timeout is 60 minutes. */
 
 	tty->ttyname = NULL;
+	tty->metrics_port = -2;	/* at the first ttyreader_prepoll() */
 
 
 	/* setup termios parameters for this line.. */
@@ -781,11 +919,7 @@ int ttyreader_parse_nullparams(struct configfile *cf, struct serialport *tty, ch
 			str = config_SKIPTEXT(str, NULL);
 			str = config_SKIPSPACE(str);
 			tty->poll_millis = atol(param1); // milliseconds
-                        if (poll_millis == 0)
-                          poll_millis = tty->poll_millis;
-                        if (tty->poll_millis < poll_millis)
-                          poll_millis = tty->poll_millis;
-                        if (poll_millis < 1 || poll_millis > 10000) {
+                        if (tty->poll_millis < 1 || tty->poll_millis > 10000) {
                           has_fault = 1;
                           printf("%s:%d POLLMILLIS value not in sanity range of 1 to 10 000: '%s'", cf->name, cf->linenum, param1);
                         } else {
@@ -924,6 +1058,12 @@ int ttyreader_parse_ttyparams(struct configfile *cf, struct serialport *tty, cha
 		} else if (strcmp(param1, "poll") == 0) {
 			/* FIXME: Some systems want polling... */
 
+		} else if (strcmp(param1, "lowlatency") == 0 ||
+			   strcmp(param1, "low-latency") == 0) {
+			tty->low_latency = 1;
+			if (debug)
+			  printf(" .. low-latency mode\n");
+
 		} else if (strcmp(param1, "callsign") == 0 ||
 			   strcmp(param1, "alias") == 0) {
 			param1 = str;
@@ -963,11 +1103,7 @@ int ttyreader_parse_ttyparams(struct configfile *cf, struct serialport *tty, cha
 			str = config_SKIPTEXT(str, NULL);
 			str = config_SKIPSPACE(str);
 			tty->poll_millis = atol(param1); // milliseconds
-                        if (poll_millis == 0)
-                          poll_millis = tty->poll_millis;
-                        if (tty->poll_millis < poll_millis)
-                          poll_millis = tty->poll_millis;
-                        if (poll_millis < 1 || poll_millis > 10000) {
+                        if (tty->poll_millis < 1 || tty->poll_millis > 10000) {
                           has_fault = 1;
                           printf("%s:%d POLLMILLIS value not in sanity range of 1 to 10 000: '%s'", cf->name, cf->linenum, param1);
                         } else {